@@ -0,0 +1,488 @@
+/***********************************************************************
+ * Source:
+ *    BENCH MAP
+ * Summary:
+ *    Driver to time custom::map against std::map: random and sequential
+ *    insert, find that hits and find that misses, erase churn, a full
+ *    walk, copy and bulk load, for int, std::string and a heavy struct
+ *    as the key, across sizes. Prints a table, and with --out writes
+ *    the results as JSON in the layout Google Benchmark uses, so runs
+ *    from different releases can be compared by name.
+ *
+ *    Usage:
+ *       benchMap [--sizes=1000,100000] [--filter=find] [--min-time=0.2]
+ *                [--out=results.json]
+ *    The default sizes are 1K, 10K, 100K and 1M. Sizes up to 100M work,
+ *    memory permitting: a 100M string map wants tens of gigabytes.
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#include "map.h"           // for custom::map, under test
+#include "pool.h"          // for custom::node_pool
+#include <array>           // for std::array
+#include <chrono>          // for std::chrono::steady_clock
+#include <cstdint>         // for std::uint64_t
+#include <cstdio>          // for std::snprintf
+#include <ctime>           // for std::time
+#include <fstream>         // for std::ofstream
+#include <iterator>        // for std::back_inserter
+#include <iostream>        // for std::cout
+#include <map>             // for std::map, the baseline
+#include <sstream>         // for std::ostringstream
+#include <string>
+#include <thread>          // for std::thread::hardware_concurrency
+#include <utility>         // for std::pair
+#include <vector>
+
+/*****************************************************************
+ * HEAVY
+ * A key that is expensive to copy: an id and 120 bytes of payload
+ *****************************************************************/
+struct Heavy
+{
+   std::uint64_t id;
+   std::array<char, 120> payload;
+
+   bool operator < (const Heavy& rhs) const
+   {
+      return id < rhs.id;
+   }
+   bool operator == (const Heavy& rhs) const
+   {
+      return id == rhs.id;
+   }
+};
+
+/*****************************************************************
+ * KEY OF
+ * The key for a number, in the same order as the numbers: an int,
+ * 16 zero-padded digits, or a heavy struct with that id
+ *****************************************************************/
+template <class K>
+K keyOf(std::uint64_t n);
+
+template <>
+int keyOf<int>(std::uint64_t n)
+{
+   return static_cast<int>(n);
+}
+template <>
+std::string keyOf<std::string>(std::uint64_t n)
+{
+   char digits[24];
+   std::snprintf(digits, sizeof(digits), "%016llu", static_cast<unsigned long long>(n));
+   return digits;
+}
+template <>
+Heavy keyOf<Heavy>(std::uint64_t n)
+{
+   Heavy heavy;
+   heavy.id = n;
+   heavy.payload.fill(static_cast<char>(n));
+   return heavy;
+}
+
+template <class K> const char* keyName();
+template <> const char* keyName<int>()         { return "int";    }
+template <> const char* keyName<std::string>() { return "string"; }
+template <> const char* keyName<Heavy>()       { return "heavy";  }
+
+/*****************************************************************
+ * CONTAINER
+ * What differs between the maps: their name, their pair, and whether
+ * they can look up a batch of keys with find_interleaved()
+ *****************************************************************/
+template <class M>
+struct container;
+
+template <class K>
+struct container<std::map<K, int>>
+{
+   using pair_type = std::pair<K, int>;
+   static const char* name() { return "std::map"; }
+   static constexpr bool interleaves = false;
+};
+template <class K>
+struct container<custom::map<K, int>>
+{
+   using pair_type = custom::pair<K, int>;
+   static const char* name() { return "custom::map"; }
+   static constexpr bool interleaves = true;
+};
+template <class K>
+struct container<custom::map<K, int, std::less<K>, custom::node_pool<custom::pair<K, int>>>>
+{
+   using pair_type = custom::pair<K, int>;
+   static const char* name() { return "custom::map<node_pool>"; }
+   static constexpr bool interleaves = true;
+};
+
+/*****************************************************************
+ * WORKLOAD
+ * The keys for one size. The map holds the even numbers below 2n;
+ * a miss looks for an odd one.
+ *****************************************************************/
+template <class K>
+struct workload
+{
+   explicit workload(size_t n)
+   {
+      // a bijection on [0, n) that scatters the numbers
+      std::vector<std::uint64_t> order(n);
+      for (size_t i = 0; i < n; i++)
+         order[i] = i;
+      std::uint64_t state = 0x9e3779b97f4a7c15ull;
+      for (size_t i = n; i > 1; i--)
+      {
+         state ^= state << 13;
+         state ^= state >> 7;
+         state ^= state << 17;
+         std::swap(order[i - 1], order[state % i]);
+      }
+
+      random.reserve(n);
+      sequential.reserve(n);
+      misses.reserve(n);
+      for (size_t i = 0; i < n; i++)
+      {
+         random.push_back(keyOf<K>(2 * order[i]));
+         sequential.push_back(keyOf<K>(2 * i));
+         misses.push_back(keyOf<K>(2 * order[i] + 1));
+      }
+   }
+
+   std::vector<K> random;       // every key once, shuffled
+   std::vector<K> sequential;   // every key once, in order
+   std::vector<K> misses;       // as many keys that are not there
+};
+
+/*****************************************************************
+ * RESULT
+ * One benchmark: how long an iteration took, over how many
+ *****************************************************************/
+struct result
+{
+   std::string name;
+   std::string family;
+   std::string container;
+   std::string key;
+   size_t      size;
+   size_t      iterations;
+   double      seconds;          // all iterations together
+   size_t      itemsPerIteration;
+};
+
+/*****************************************************************
+ * OPTIONS
+ * From the command line
+ *****************************************************************/
+struct options
+{
+   std::vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+   std::string filter;           // run only the names that contain this
+   double      minTime = 0.2;    // seconds to spend on each, at least one iteration
+   std::string out;              // the JSON file, or nothing
+};
+
+/*****************************************************************
+ * RUNNER
+ * Times each benchmark until it has run for minTime, and keeps
+ * the results
+ *****************************************************************/
+class runner
+{
+public:
+   explicit runner(const options& opts) : opts(opts), sink(0)
+   {}
+
+   // run(once) where once() does one iteration and returns the seconds
+   // it took, so each benchmark leaves its setup and teardown untimed
+   template <class F>
+   void run(const std::string& family, const char* containerName, const char* keyName, size_t size,
+            size_t items, F once)
+   {
+      std::ostringstream name;
+      name << family << '/' << containerName << '<' << keyName << ">/" << size;
+      if (name.str().find(opts.filter) == std::string::npos)
+         return;
+
+      result r = { name.str(), family, containerName, keyName, size, 0, 0.0, items };
+      do
+      {
+         r.seconds += once();
+         r.iterations++;
+      } while (r.seconds < opts.minTime);
+
+      double ns = r.seconds / r.iterations * 1e9;
+      std::printf("%-48s %12.0f ns %10zu its %14.0f items/s\n", r.name.c_str(), ns, r.iterations,
+                  r.itemsPerIteration * r.iterations / r.seconds);
+      std::fflush(stdout);
+      results.push_back(r);
+   }
+
+   // somewhere for the answers to go, so that they are not optimized away
+   void consume(size_t value)
+   {
+      sink += value;
+   }
+
+   void writeJson(const char* executable) const;
+
+private:
+   const options& opts;
+   std::vector<result> results;
+   volatile size_t sink;
+};
+
+/*****************************************************************
+ * TIMER
+ *****************************************************************/
+using clock_type = std::chrono::steady_clock;
+
+inline double since(clock_type::time_point start)
+{
+   return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+/*****************************************************************
+ * BENCH CONTAINER
+ * Every benchmark for one map type and one size
+ *****************************************************************/
+template <class M, class K>
+void benchContainer(runner& r, const workload<K>& w)
+{
+   using pair_type = typename container<M>::pair_type;
+   const char* name = container<M>::name();
+   const char* key = keyName<K>();
+   size_t n = w.random.size();
+
+   // insert, shuffled and in order
+   r.run("insert_random", name, key, n, n, [&]()
+   {
+      M m;
+      clock_type::time_point start = clock_type::now();
+      for (size_t i = 0; i < n; i++)
+         m.insert(pair_type(w.random[i], static_cast<int>(i)));
+      double seconds = since(start);
+      r.consume(m.size());
+      return seconds;
+   });
+   r.run("insert_sequential", name, key, n, n, [&]()
+   {
+      M m;
+      clock_type::time_point start = clock_type::now();
+      for (size_t i = 0; i < n; i++)
+         m.insert(pair_type(w.sequential[i], static_cast<int>(i)));
+      double seconds = since(start);
+      r.consume(m.size());
+      return seconds;
+   });
+
+   // the rest share one map
+   M m;
+   for (size_t i = 0; i < n; i++)
+      m.insert(pair_type(w.random[i], static_cast<int>(i)));
+
+   r.run("find_hit", name, key, n, n, [&]()
+   {
+      size_t found = 0;
+      clock_type::time_point start = clock_type::now();
+      for (size_t i = 0; i < n; i++)
+         found += m.find(w.random[i]) != m.end();
+      double seconds = since(start);
+      r.consume(found);
+      return seconds;
+   });
+   r.run("find_miss", name, key, n, n, [&]()
+   {
+      size_t found = 0;
+      clock_type::time_point start = clock_type::now();
+      for (size_t i = 0; i < n; i++)
+         found += m.find(w.misses[i]) != m.end();
+      double seconds = since(start);
+      r.consume(found);
+      return seconds;
+   });
+   // the hits again, as one batch: taking turns where the map can
+   r.run("find_batch", name, key, n, n, [&]()
+   {
+      std::vector<typename M::iterator> found;
+      found.reserve(n);
+      clock_type::time_point start = clock_type::now();
+      if constexpr (container<M>::interleaves)
+         m.find_interleaved(w.random.begin(), w.random.end(), std::back_inserter(found));
+      else
+         for (size_t i = 0; i < n; i++)
+            found.push_back(m.find(w.random[i]));
+      double seconds = since(start);
+      r.consume(found.size());
+      return seconds;
+   });
+   r.run("iterate", name, key, n, n, [&]()
+   {
+      size_t sum = 0;
+      clock_type::time_point start = clock_type::now();
+      for (auto it = m.begin(); it != m.end(); ++it)
+         sum += (*it).second;
+      double seconds = since(start);
+      r.consume(sum);
+      return seconds;
+   });
+   r.run("copy", name, key, n, n, [&]()
+   {
+      clock_type::time_point start = clock_type::now();
+      M copy(m);
+      double seconds = since(start);
+      r.consume(copy.size());
+      return seconds;
+   });
+
+   // erase a key and insert one that was not there, n times; the next
+   // iteration trades them back, so the map keeps its size
+   bool back = false;
+   r.run("erase_churn", name, key, n, n, [&]()
+   {
+      const std::vector<K>& out = back ? w.misses : w.random;
+      const std::vector<K>& in = back ? w.random : w.misses;
+      clock_type::time_point start = clock_type::now();
+      for (size_t i = 0; i < n; i++)
+      {
+         m.erase(out[i]);
+         m.insert(pair_type(in[i], static_cast<int>(i)));
+      }
+      double seconds = since(start);
+      back = !back;
+      r.consume(m.size());
+      return seconds;
+   });
+
+   // build from a sorted range
+   std::vector<pair_type> sorted;
+   sorted.reserve(n);
+   for (size_t i = 0; i < n; i++)
+      sorted.push_back(pair_type(w.sequential[i], static_cast<int>(i)));
+   r.run("bulk_load", name, key, n, n, [&]()
+   {
+      clock_type::time_point start = clock_type::now();
+      M loaded(sorted.begin(), sorted.end());
+      double seconds = since(start);
+      r.consume(loaded.size());
+      return seconds;
+   });
+}
+
+/*****************************************************************
+ * BENCH KEY
+ * Every map, every size, one key type
+ *****************************************************************/
+template <class K>
+void benchKey(runner& r, const options& opts)
+{
+   for (size_t n : opts.sizes)
+   {
+      workload<K> w(n);
+      benchContainer<std::map<K, int>>(r, w);
+      benchContainer<custom::map<K, int>>(r, w);
+      benchContainer<custom::map<K, int, std::less<K>, custom::node_pool<custom::pair<K, int>>>>(r, w);
+   }
+}
+
+/*****************************************************************
+ * RUNNER :: WRITE JSON
+ * The layout of Google Benchmark's --benchmark_format=json, with
+ * the family, container, key and size as fields of their own
+ *****************************************************************/
+void runner::writeJson(const char* executable) const
+{
+   std::ofstream out(opts.out);
+   char date[32];
+   std::time_t now = std::time(nullptr);
+   std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+   out << "{\n";
+   out << "  \"context\": {\n";
+   out << "    \"date\": \"" << date << "\",\n";
+   out << "    \"executable\": \"" << executable << "\",\n";
+   out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+   out << "    \"library_build_type\": \"release\"\n";
+#else
+   out << "    \"library_build_type\": \"debug\"\n";
+#endif
+   out << "  },\n";
+   out << "  \"benchmarks\": [\n";
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const result& r = results[i];
+      out << "    {\n";
+      out << "      \"name\": \"" << r.name << "\",\n";
+      out << "      \"run_name\": \"" << r.name << "\",\n";
+      out << "      \"run_type\": \"iteration\",\n";
+      out << "      \"family\": \"" << r.family << "\",\n";
+      out << "      \"container\": \"" << r.container << "\",\n";
+      out << "      \"key\": \"" << r.key << "\",\n";
+      out << "      \"size\": " << r.size << ",\n";
+      out << "      \"iterations\": " << r.iterations << ",\n";
+      out << "      \"real_time\": " << r.seconds / r.iterations * 1e9 << ",\n";
+      out << "      \"time_unit\": \"ns\",\n";
+      out << "      \"items_per_second\": " << r.itemsPerIteration * r.iterations / r.seconds << "\n";
+      out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+   }
+   out << "  ]\n";
+   out << "}\n";
+}
+
+/*****************************************************************
+ * PARSE
+ * --sizes=a,b,c --filter=text --min-time=seconds --out=file
+ *****************************************************************/
+bool parse(int argc, char** argv, options& opts)
+{
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg = argv[i];
+      std::string value = arg.substr(arg.find('=') + 1);
+      if (arg.rfind("--sizes=", 0) == 0)
+      {
+         opts.sizes.clear();
+         std::istringstream in(value);
+         std::string size;
+         while (std::getline(in, size, ','))
+            opts.sizes.push_back(static_cast<size_t>(std::stod(size)));
+      }
+      else if (arg.rfind("--filter=", 0) == 0)
+         opts.filter = value;
+      else if (arg.rfind("--min-time=", 0) == 0)
+         opts.minTime = std::stod(value);
+      else if (arg.rfind("--out=", 0) == 0)
+         opts.out = value;
+      else
+      {
+         std::cerr << "usage: " << argv[0]
+                   << " [--sizes=1000,100000] [--filter=text] [--min-time=0.2] [--out=results.json]\n";
+         return false;
+      }
+   }
+   return true;
+}
+
+/**********************************************************************
+ * MAIN
+ * Every key type in turn
+ ***********************************************************************/
+int main(int argc, char** argv)
+{
+   options opts;
+   if (!parse(argc, argv, opts))
+      return 1;
+
+   runner r(opts);
+   benchKey<int>(r, opts);
+   benchKey<std::string>(r, opts);
+   benchKey<Heavy>(r, opts);
+
+   if (!opts.out.empty())
+      r.writeJson(argv[0]);
+   return 0;
+}
@@ -13,6 +13,7 @@
  *    This will contain the class definition of:
  *        BST                 : A class that represents a binary search tree
  *        BST::iterator       : An iterator through BST
+ *        BST::node_handle    : Owner of a node taken out of a BST
  * Author
  *    Nathan Bird, Brock Hoskins
  ************************************************************************/
@@ -26,48 +27,459 @@
 #endif // !DEBUG
 
 #include <cassert>
+#include <cstdint>     // for std::uintptr_t
 #include <utility>
-#include <memory>     // for std::allocator
-#include <functional> // for std::less
-#include <utility>    // for std::pair
+#include <memory>      // for std::allocator and std::allocator_traits
+#include <functional>  // for std::less
+#include <type_traits> // for std::void_t
+#include <iterator>    // for std::distance
+#include <utility>     // for std::pair
+#include <string>      // for std::basic_string::compare
+#include <optional>    // for std::optional
+#include <exception>   // for std::exception_ptr
+#include <thread>      // for std::thread in buildParallel()
+#include <vector>      // for std::vector
+#include <atomic>      // for std::atomic in stats_counters
+#include "parallel.h"  // for custom::parallel_tasks
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h> // for _mm_prefetch
+#endif
+#ifdef __cpp_impl_three_way_comparison
+#include <compare>     // for operator <=>
+#endif // __cpp_impl_three_way_comparison
 
 class TestBST; // forward declaration for unit tests
 class TestSet;
 class TestMap;
+class TestPool;
 
 namespace custom
 {
 
    template <typename TT>
    class set;
-   template <typename KK, typename VV>
+   template <typename KK, typename VV, typename CC, typename AA, typename PP>
    class map;
 
+   /*****************************************************************
+    * COMPARE BASE
+    * Hold the tree's comparator once, in the tree itself. An empty
+    * comparator (std::less and friends) is an empty base class, so
+    * it takes no space at all.
+    *****************************************************************/
+   template <typename C, bool = std::is_empty<C>::value && !std::is_final<C>::value>
+   class compare_base : private C
+   {
+   public:
+      compare_base(const C& c) : C(c) {}
+      const C& compare() const noexcept { return *this; }
+   };
+   template <typename C>
+   class compare_base<C, false>
+   {
+   public:
+      compare_base(const C& c) : c(c) {}
+      const C& compare() const noexcept { return c; }
+   private:
+      C c;
+   };
+
+   /*****************************************************************
+    * THREE WAY
+    * Can comparator C order a T and a U with one three-way comparison?
+    * If so, compare(c, a, b) is <0, 0 or >0 as a goes before, is
+    * equivalent to, or goes after b, and find() and insert() only
+    * need one comparison a level. A comparator opts in with a
+    * three_way() member; std::less gets it for free from <=> or,
+    * before C++20, from std::basic_string::compare().
+    *****************************************************************/
+   template <typename C, typename T, typename U = T, typename = void>
+   struct three_way : std::false_type {};
+
+   template <typename C, typename T, typename U>
+   struct three_way<C, T, U, std::void_t<decltype(std::declval<const C&>().three_way(
+                                         std::declval<const T&>(), std::declval<const U&>()))>>
+      : std::true_type
+   {
+      static int compare(const C& c, const T& a, const U& b) { return c.three_way(a, b); }
+   };
+
+#ifdef __cpp_impl_three_way_comparison
+   // only a total (or weak) order: a partial order such as double's
+   // would treat NaN as equivalent to everything
+   template <typename T>
+   struct three_way<std::less<T>, T, T, std::enable_if_t<std::is_convertible_v<
+      decltype(std::declval<const T&>() <=> std::declval<const T&>()), std::weak_ordering>>>
+      : std::true_type
+   {
+      static int compare(const std::less<T>&, const T& a, const T& b)
+      {
+         std::weak_ordering order = a <=> b;
+         return order < 0 ? -1 : (order > 0 ? 1 : 0);
+      }
+   };
+#else // !__cpp_impl_three_way_comparison
+   template <typename CharT, typename Traits, typename Alloc>
+   struct three_way<std::less<std::basic_string<CharT, Traits, Alloc>>,
+                    std::basic_string<CharT, Traits, Alloc>,
+                    std::basic_string<CharT, Traits, Alloc>>
+      : std::true_type
+   {
+      using S = std::basic_string<CharT, Traits, Alloc>;
+      static int compare(const std::less<S>&, const S& a, const S& b) { return a.compare(b); }
+   };
+#endif // !__cpp_impl_three_way_comparison
+
+   /*****************************************************************
+    * PREFETCH
+    * Ask for a cache line ahead of time; nothing if the compiler has
+    * no way to say it
+    *****************************************************************/
+   inline void prefetch(const void* p) noexcept
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(p);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+      (void)p;
+#endif
+   }
+
+   /*****************************************************************
+    * IS RELEASABLE
+    * Can the allocator hand back every node it gave out in one call?
+    * node_pool (pool.h) can when the tree is its only user;
+    * std::allocator cannot.
+    *****************************************************************/
+   template <typename Alloc, typename = void>
+   struct is_releasable : std::false_type {};
+   template <typename Alloc>
+   struct is_releasable<Alloc, std::void_t<decltype(std::declval<Alloc&>().release()),
+                                           decltype(std::declval<const Alloc&>().unique())>>
+      : std::true_type {};
+
+   /*****************************************************************
+    * IS CLONEABLE
+    * Can the allocator copy another one's memory whole, chunk by
+    * chunk, and say where each block went? node_pool (pool.h) can.
+    *****************************************************************/
+   template <typename Alloc, typename = void>
+   struct is_cloneable : std::false_type {};
+   template <typename Alloc>
+   struct is_cloneable<Alloc, std::void_t<decltype(std::declval<Alloc&>().clone(std::declval<const Alloc&>()))>>
+      : std::true_type {};
+
+   /*****************************************************************
+    * RB PLAIN
+    * Node layout policy: the parent pointer and the color are two
+    * separate fields. Easy to read in a debugger, and the unit tests
+    * reach into them directly, at the cost of a padded bool per node.
+    *****************************************************************/
+   struct rb_plain
+   {
+      template <typename Node>
+      class links
+      {
+      public:
+         links() : pParent(nullptr), isRed(true) {}
+
+         Node* parent() const noexcept    { return pParent; }
+         void  setParent(Node* p) noexcept { pParent = p;    }
+         bool  red() const noexcept       { return isRed;   }
+         void  setRed(bool red) noexcept  { isRed = red;    }
+
+         Node* pParent;           // Parent
+         bool  isRed;             // Red-black balancing stuff
+      };
+   };
+
+   /*****************************************************************
+    * RB PACKED
+    * Node layout policy: nodes are at least pointer aligned, so the
+    * low bit of the parent pointer is always zero. Keep the color
+    * there and save the padded bool (8 bytes a node on 64-bit).
+    *****************************************************************/
+   struct rb_packed
+   {
+      template <typename Node>
+      class links
+      {
+      public:
+         links() : parentColor(RED) {}
+
+         Node* parent() const noexcept
+         {
+            return reinterpret_cast<Node*>(parentColor & ~RED);
+         }
+         void setParent(Node* p) noexcept
+         {
+            static_assert(alignof(Node) > 1, "the color needs the low bit of the pointer");
+            parentColor = reinterpret_cast<std::uintptr_t>(p) | (parentColor & RED);
+         }
+         bool red() const noexcept
+         {
+            return (parentColor & RED) != 0;
+         }
+         void setRed(bool red) noexcept
+         {
+            parentColor = (parentColor & ~RED) | (red ? RED : 0);
+         }
+
+      private:
+         static constexpr std::uintptr_t RED = 1;
+         std::uintptr_t parentColor;  // parent pointer | 1 when red
+      };
+   };
+
+   /*****************************************************************
+    * RB THREADED
+    * Node layout policy: Base's links plus pointers to the in-order
+    * neighbors, so iterating is one hop a step instead of a climb
+    * up the parents. Costs two pointers a node; insert and erase
+    * keep the threads up, rotations do not touch them.
+    *****************************************************************/
+   template <typename Base>
+   struct rb_threaded
+   {
+      static constexpr bool threaded = true;
+
+      template <typename Node>
+      class links : public Base::template links<Node>
+      {
+      public:
+         links() : pPrev(nullptr), pNext(nullptr) {}
+
+         Node* pPrev;             // in-order predecessor
+         Node* pNext;             // in-order successor
+      };
+   };
+
+   /*****************************************************************
+    * IS THREADED
+    * Does layout policy P keep in-order threads in the nodes?
+    *****************************************************************/
+   template <typename P, typename = void>
+   struct is_threaded : std::false_type {};
+   template <typename P>
+   struct is_threaded<P, std::enable_if_t<P::threaded>> : std::true_type {};
+
+   /*****************************************************************
+    * RB COUNTED
+    * Node layout policy: Base's links plus the number of nodes in
+    * the subtree, so the tree can count: rank(), nth() and
+    * count_range() in O(log n). Costs a size_t a node, and insert,
+    * erase and every rotation fix the counts on their way.
+    *****************************************************************/
+   template <typename Base>
+   struct rb_counted
+   {
+      static constexpr bool counted = true;
+      static constexpr bool threaded = is_threaded<Base>::value;
+
+      template <typename Node>
+      class links : public Base::template links<Node>
+      {
+      public:
+         links() : subtreeSize(1) {}
+
+         std::size_t subtreeSize;  // this node and everything under it
+      };
+   };
+
+   /*****************************************************************
+    * IS COUNTED
+    * Does layout policy P keep subtree sizes in the nodes?
+    *****************************************************************/
+   template <typename P, typename = void>
+   struct is_counted : std::false_type {};
+   template <typename P>
+   struct is_counted<P, std::enable_if_t<P::counted>> : std::true_type {};
+
+   /*****************************************************************
+    * TREE STATS
+    * What a tree has done since it was made (or since reset_stats()),
+    * and how tall it is now
+    *****************************************************************/
+   struct tree_stats
+   {
+      std::size_t allocations   = 0;  // nodes allocated
+      std::size_t deallocations = 0;  // nodes given back
+      std::size_t lookups       = 0;  // walks down from the root: find, the bounds, insert
+      std::size_t comparisons   = 0;  // comparator calls those walks made
+      std::size_t rotations     = 0;  // done rebalancing after insert and erase
+      std::size_t copies        = 0;  // pairs copied into a node, built or assigned
+      std::size_t moves         = 0;  // pairs moved into a node
+      std::size_t height        = 0;  // levels from the root to the deepest leaf
+
+      double comparisons_per_lookup() const noexcept
+      {
+         return lookups ? double(comparisons) / double(lookups) : 0.0;
+      }
+   };
+
+   /*****************************************************************
+    * STATS COUNTERS
+    * The counters behind tree_stats. Relaxed atomics, so readers of
+    * a shared tree can count their lookups side by side.
+    *****************************************************************/
+   struct stats_counters
+   {
+      std::atomic<std::size_t> allocations   { 0 };
+      std::atomic<std::size_t> deallocations { 0 };
+      std::atomic<std::size_t> lookups       { 0 };
+      std::atomic<std::size_t> comparisons   { 0 };
+      std::atomic<std::size_t> rotations     { 0 };
+      std::atomic<std::size_t> copies        { 0 };
+      std::atomic<std::size_t> moves         { 0 };
+   };
+
+   /*****************************************************************
+    * RB STATS
+    * Node layout policy: Base's links, unchanged, and a tree that
+    * counts what it does for stats(): allocations, comparisons per
+    * lookup, rotations, and copies and moves of the pairs. Costs an
+    * atomic add at each of those. Compose it outside the others:
+    * rb_stats<rb_counted<rb_default_threaded>>
+    *****************************************************************/
+   template <typename Base>
+   struct rb_stats
+   {
+      static constexpr bool stats = true;
+      static constexpr bool threaded = is_threaded<Base>::value;
+      static constexpr bool counted = is_counted<Base>::value;
+
+      template <typename Node>
+      class links : public Base::template links<Node>
+      {};
+   };
+
+   /*****************************************************************
+    * IS STATS
+    * Does layout policy P have the tree keep statistics?
+    *****************************************************************/
+   template <typename P, typename = void>
+   struct is_stats : std::false_type {};
+   template <typename P>
+   struct is_stats<P, std::enable_if_t<P::stats>> : std::true_type {};
+
+   /*****************************************************************
+    * STATS ALLOCATOR
+    * The tree's node allocator, Base, carrying the tree's counters.
+    * Every node is made and given back through the allocator, so
+    * that is where they can be reached. The counters belong to the
+    * tree they started in: copying or assigning the allocator does
+    * not take them along.
+    *****************************************************************/
+   template <typename Base>
+   class stats_allocator : public Base
+   {
+      using traits = std::allocator_traits<Base>;
+   public:
+      template <typename U>
+      struct rebind
+      {
+         using other = stats_allocator<typename traits::template rebind_alloc<U>>;
+      };
+      using propagate_on_container_copy_assignment = typename traits::propagate_on_container_copy_assignment;
+      using propagate_on_container_move_assignment = typename traits::propagate_on_container_move_assignment;
+      using propagate_on_container_swap            = typename traits::propagate_on_container_swap;
+      using is_always_equal                        = typename traits::is_always_equal;
+
+      stats_allocator() = default;
+      stats_allocator(const stats_allocator& rhs) : Base(rhs) {}
+      template <typename U, typename = std::enable_if_t<std::is_constructible<Base, const U&>::value>>
+      stats_allocator(const U& rhs) : Base(rhs) {}
+      stats_allocator& operator =(const stats_allocator& rhs)
+      {
+         Base::operator =(rhs);
+         return *this;
+      }
+
+      stats_allocator select_on_container_copy_construction() const
+      {
+         return stats_allocator(traits::select_on_container_copy_construction(*this));
+      }
+
+      friend bool operator ==(const stats_allocator& lhs, const stats_allocator& rhs)
+      {
+         return static_cast<const Base&>(lhs) == static_cast<const Base&>(rhs);
+      }
+      friend bool operator !=(const stats_allocator& lhs, const stats_allocator& rhs)
+      {
+         return !(lhs == rhs);
+      }
+
+      mutable stats_counters counters;
+   };
+
+   /*****************************************************************
+    * MADE FROM
+    * Is a T built from these constructor arguments a copy of a T, a
+    * move of one, or neither (built from its parts)? A leading
+    * std::in_place is passed over.
+    *****************************************************************/
+   template <typename T, typename... Args>
+   struct made_from
+   {
+      static constexpr bool copy = false;
+      static constexpr bool move = false;
+   };
+   template <typename T, typename U>
+   struct made_from<T, U>
+   {
+      static constexpr bool same = std::is_same<std::decay_t<U>, T>::value;
+      static constexpr bool move = same && !std::is_lvalue_reference<U>::value &&
+                                   !std::is_const<std::remove_reference_t<U>>::value;
+      static constexpr bool copy = same && !move;
+   };
+   template <typename T, typename U>
+   struct made_from<T, const std::in_place_t&, U> : made_from<T, U> {};
+   template <typename T, typename U>
+   struct made_from<T, std::in_place_t, U> : made_from<T, U> {};
+
+   // the debug build (and the unit tests) keep the readable layout
+#ifdef DEBUG
+   using rb_default = rb_plain;
+#else // !DEBUG
+   using rb_default = rb_packed;
+#endif // !DEBUG
+   using rb_default_threaded = rb_threaded<rb_default>;
+   using rb_default_counted = rb_counted<rb_default>;
+   using rb_default_stats = rb_stats<rb_default>;
+
 /*****************************************************************
  * BINARY SEARCH TREE
- * Create a Binary Search Tree
+ * Create a Binary Search Tree. P is the node layout policy.
  *****************************************************************/
-   template <typename T>
-   class BST
+   template <typename T, typename C = std::less<T>, typename A = std::allocator<T>,
+             typename P = rb_default>
+   class BST : private compare_base<C>
    {
       friend class ::TestBST; // give unit tests access to private members
       friend class ::TestSet;
       friend class ::TestMap;
+      friend class ::TestPool;
 
       template <class TT>
       friend class custom::set;
 
-      template <class KK, class VV>
+      template <class KK, class VV, class CC, class AA, class PP>
       friend class custom::map;
    public:
+      using value_compare  = C;
+      using allocator_type = A;
+
       //
       // Construct
       //
 
       BST();
+      explicit BST(const C& comp, const A& alloc = A());
+      explicit BST(const A& alloc);
       BST(const BST& rhs);
       BST(BST&& rhs);
-      BST(const std::initializer_list<T>& il);
+      BST(const std::initializer_list<T>& il, const C& comp = C(), const A& alloc = A());
       ~BST();
 
       //
@@ -84,14 +496,110 @@ namespace custom
       //
 
       class iterator;
-      iterator begin() const noexcept;
-      iterator end()   const noexcept { return iterator(nullptr); }
+      iterator begin()  const noexcept;
+      iterator rbegin() const noexcept;   // the last element: walk it back with --
+      iterator end()    const noexcept { return iterator(nullptr); }
 
       //
       // Access
       //
 
-      iterator find(const T& t);
+      iterator find(const T& t) const;
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator find(const K& k) const
+      {
+         return iterator(findNode(k));
+      }
+
+      // the first value that does not go before t, the first that goes
+      // after it, and the two together: O(log n) however many match
+      iterator lower_bound(const T& t) const
+      {
+         return iterator(boundNode(t, /*upper: */false));
+      }
+      iterator upper_bound(const T& t) const
+      {
+         return iterator(boundNode(t, /*upper: */true));
+      }
+      std::pair<iterator, iterator> equal_range(const T& t) const
+      {
+         return std::pair<iterator, iterator>(lower_bound(t), upper_bound(t));
+      }
+      size_t count(const T& t) const
+      {
+         return countEqual(t);
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator lower_bound(const K& k) const
+      {
+         return iterator(boundNode(k, /*upper: */false));
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator upper_bound(const K& k) const
+      {
+         return iterator(boundNode(k, /*upper: */true));
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      std::pair<iterator, iterator> equal_range(const K& k) const
+      {
+         return std::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      size_t count(const K& k) const
+      {
+         return countEqual(k);
+      }
+
+      // call f(value) for every value in [lo, hi), in order, without
+      // making an iterator for each
+      template <typename K, typename F>
+      void visit_range(const K& lo, const K& hi, F&& f) const
+      {
+         visitRange(root, lo, hi, f);
+      }
+
+      // the bound of k, found from finger rather than from the root:
+      // every value before finger must go before k (or, when upper, not
+      // after it), as when the keys come in order. Climb the parents
+      // only as far as k could lie, then go down. Keys in order cost
+      // about an in-order walk, not a descent each. end() starts at
+      // the root.
+      template <typename K>
+      iterator bound_from(const iterator& finger, const K& k, bool upper = false) const
+      {
+         return iterator(fingerBound(finger.pNode, k, upper));
+      }
+
+      // find n keys with several descents under way at once: each goes
+      // down a level, asks for the node below, and makes way for the
+      // next, so their cache misses are waited on together instead of
+      // one after another. found[i] is what find(*keys[i]) gives.
+      template <typename K>
+      void find_interleaved(const K* const* keys, size_t n, iterator* found) const;
+
+      // call f(value) for every value, on up to threads threads at once:
+      // the top few levels are cut off and each subtree below them is a
+      // task. f must be safe to call that way; the order is not defined
+      template <typename F>
+      void parallel_for_each(F&& f, unsigned threads) const;
+
+      // the values of the top levels, in order: at least count, if the
+      // tree has as many, spread through it. Where to cut it in slices.
+      std::vector<const T*> splitters(size_t count) const;
+
+      // order statistics, for a layout policy that counts (rb_counted):
+      // how many values go before k, the value at index i (end() when
+      // there is none), and how many are in [lo, hi). O(log n) each.
+      template <typename K>
+      size_t rank(const K& k) const;
+      iterator nth(size_t i) const;
+      template <typename K>
+      size_t count_range(const K& lo, const K& hi) const;
+
+      // statistics, for a layout policy that keeps them (rb_stats): the
+      // counts so far, and the height, which takes a walk of the tree
+      tree_stats stats() const;
+      void reset_stats() noexcept;
 
       // 
       // Insert
@@ -99,6 +607,14 @@ namespace custom
 
       std::pair<iterator, bool> insert(const T& t, bool keepUnique = false);
       std::pair<iterator, bool> insert(T&& t, bool keepUnique = false);
+      template <typename ... Args>
+      std::pair<iterator, bool> emplace(bool keepUnique, Args&& ... args);
+
+      // with a hint: O(1) plus rebalancing when t goes right before hint
+      std::pair<iterator, bool> insert(const iterator& hint, const T& t, bool keepUnique = false);
+      std::pair<iterator, bool> insert(const iterator& hint, T&& t, bool keepUnique = false);
+      template <typename ... Args>
+      std::pair<iterator, bool> emplace_hint(const iterator& hint, bool keepUnique, Args&& ... args);
 
       //
       // Remove
@@ -107,18 +623,102 @@ namespace custom
       iterator erase(iterator& it);
       void     clear() noexcept;
 
+      //
+      // Node handles: move nodes between trees without allocating
+      //
+
+      class node_handle;
+      node_handle extract(const iterator& it);
+      std::pair<iterator, bool> insert(node_handle&& nh, bool keepUnique = false);
+      void merge(BST& src, bool keepUnique = false);
+
       // 
       // Status
       //
 
       bool   empty() const noexcept { return size() == 0; }
       size_t size()  const noexcept { return numElements; }
+      allocator_type get_allocator() const { return allocator_type(alloc); }
+      value_compare  value_comp()    const { return this->compare(); }
 
    private:
 
       class  BNode;
-      BNode* root;              // root node of the binary search tree
-      size_t numElements;       // number of elements currently in the tree
+      using  NodeBase   = typename std::allocator_traits<A>::template rebind_alloc<BNode>;
+      using  NodeAlloc  = std::conditional_t<is_stats<P>::value, stats_allocator<NodeBase>, NodeBase>;
+      using  NodeTraits = std::allocator_traits<NodeAlloc>;
+
+      template <typename K>
+      BNode* findNode(const K& k) const;
+      template <typename K>
+      BNode* boundNode(const K& k, bool upper) const;
+      template <typename K>
+      BNode* fingerBound(BNode* pFinger, const K& k, bool upper) const;
+      template <typename K>
+      size_t countEqual(const K& k) const;
+      template <typename K, typename F>
+      void visitRange(BNode* pNode, const K& lo, const K& hi, F& f) const;
+      static void recountUp(BNode* pNode) noexcept;
+      template <typename K>
+      BNode* findParent(const K& k, bool keepUnique, bool& isDuplicate, bool& isLeft) const;
+      template <typename K>
+      BNode* findHint(BNode* pHint, const K& k, bool keepUnique, bool& isDuplicate, bool& isLeft) const;
+      template <typename K, typename ... Args>
+      std::pair<iterator, bool> emplaceKey(const K& k, Args&& ... args);
+      static T& data(const iterator& it) { return it.pNode->data; }
+      template <typename ... Args>
+      BNode* link(BNode* pParent, bool isLeft, Args&& ... args);
+      BNode* hook(BNode* pParent, bool isLeft, BNode* newNode);
+      void   unlink(BNode* pNode);
+      void   replace(BNode* pOld, BNode* pNew);
+      void   rotateLeft(BNode* pNode);
+      void   rotateRight(BNode* pNode);
+      void   eraseBalance(BNode* pNode, BNode* pParent);
+      template <typename Iterator>
+      bool   isSorted(Iterator first, Iterator last, bool strict) const;
+      template <typename Iterator>
+      void   buildSorted(Iterator first, size_t n, unsigned threads = 1);
+      template <typename Iterator>
+      static BNode* buildParallel(Iterator first, size_t n, int depth, int redDepth, NodeAlloc& alloc,
+                                  int forkDepth);
+      template <typename F>
+      static void forEach(const BNode* pNode, F& f);
+      void   rethread() noexcept;
+      void   findEnds() noexcept;
+      static void thread(BNode* pNode, BNode*& pPrev) noexcept;
+      bool   clone(const BST& rhs);
+      static void note(const NodeAlloc& alloc, std::atomic<std::size_t> stats_counters::* counter,
+                       std::size_t n = 1) noexcept;
+      static size_t heightOf(const BNode* pNode) noexcept;
+
+      BNode*    root;           // root node of the binary search tree
+      size_t    numElements;    // number of elements currently in the tree
+      NodeAlloc alloc;          // where the BNodes come from
+
+      // the ends of the tree, found when it is built or copied whole
+      // and then kept up by insert and erase. nullptr when not known:
+      // begin() and rbegin() walk down for them, and change nothing,
+      // so readers can share a tree.
+      BNode* pFirst;
+      BNode* pLast;
+   };
+
+
+   /*****************************************************************
+    * TREE OF
+    * The tree a container is built on for layout policy P: a BST,
+    * unless P names another backend with a tree<T, C, A> member
+    * (bplus in btree.h)
+    *****************************************************************/
+   template <typename P, typename T, typename C, typename A, typename = void>
+   struct tree_of
+   {
+      using type = BST<T, C, A, P>;
+   };
+   template <typename P, typename T, typename C, typename A>
+   struct tree_of<P, T, C, A, std::void_t<typename P::template tree<T, C, A>>>
+   {
+      using type = typename P::template tree<T, C, A>;
    };
 
 
@@ -127,53 +727,87 @@ namespace custom
     * A single node in a binary tree. Note that the node does not know
     * anything about the properties of the tree so no validation can be done.
     *****************************************************************/
-   template <typename T>
-   class BST<T>::BNode
+   template <typename T, typename C, typename A, typename P>
+   class BST<T, C, A, P>::BNode : public P::template links<BNode>
    {
    public:
+      using links = typename P::template links<BNode>;
+      using links::parent;
+      using links::setParent;
+      using links::red;
+      using links::setRed;
+
       // 
-      // Construct
+      // Construct: new nodes are red and have no parent
       //
-      BNode() : data(T()), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
+      BNode() : data(T()), pLeft(nullptr), pRight(nullptr)
       {}
-      BNode(const T& t) : data(t), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
+      BNode(const T& t) : data(t), pLeft(nullptr), pRight(nullptr)
       {}
-      BNode(T&& t) : data(std::move(t)), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
+      BNode(T&& t) : data(std::move(t)), pLeft(nullptr), pRight(nullptr)
       {}
+      template <typename ... Args>
+      BNode(std::in_place_t, Args&& ... args)
+         : data(std::forward<Args>(args)...), pLeft(nullptr), pRight(nullptr)
+      {}
+
+      //
+      // Allocate: all BNodes come from and go back to the tree's allocator
+      //
+      template <typename... Args>
+      static BNode* create(NodeAlloc& alloc, Args&&... args);
+      static void   destroy(NodeAlloc& alloc, BNode* pNode) noexcept;
 
       //
       // Copy
       //
-      static BNode* copy(const BNode* pSrc);
+      static BNode* copy(const BNode* pSrc, NodeAlloc& alloc);
 
       //
       // Assign
       //
-      static void assign(BNode*& pDest, const BNode* pSrc);
+      static void assign(BNode*& pDest, const BNode* pSrc, NodeAlloc& alloc);
+
+      //
+      // Build: n nodes from sorted input, nodes at redDepth are red
+      //
+      template <typename Iterator>
+      static BNode* build(Iterator& it, size_t n, int depth, int redDepth, NodeAlloc& alloc);
 
       //
       // Insert
       //
       void addLeft(BNode* pNode);
-      void addLeft(const T& t);
-      void addLeft(T&& t);
       void addRight(BNode* pNode);
-      void addRight(const T& t);
-      void addRight(T&& t);
 
       //
       // Remove
       //
-      static void clear(BST<T>::BNode*& pNode) noexcept;
+      static void clear(BNode*& pNode, NodeAlloc& alloc, bool deallocate = true) noexcept;
 
       // 
       // Status
       //
-      bool isRightChild(BNode* pNode) const { return pParent == pNode && pNode->pRight == this; }
-      bool isLeftChild (BNode* pNode) const { return pParent == pNode && pNode->pLeft == this; }
+      bool isRightChild(BNode* pNode) const { return pNode && parent() == pNode && pNode->pRight == this; }
+      bool isLeftChild (BNode* pNode) const { return pNode && parent() == pNode && pNode->pLeft == this; }
+
+      // how many nodes are under p, counting p: only when P counts
+      static size_t sizeOf(const BNode* p) noexcept
+      {
+         if constexpr (is_counted<P>::value)
+            return p ? p->subtreeSize : 0;
+         else
+            return 0;
+      }
+      // the children changed: count again from them
+      void recount() noexcept
+      {
+         if constexpr (is_counted<P>::value)
+            this->subtreeSize = 1 + sizeOf(pLeft) + sizeOf(pRight);
+      }
 
-      // balance the tree
-      void balance(BNode*& pRoot);
+      // balance the tree, returning how many rotations it took
+      int balance(BNode*& pRoot);
 
    #ifdef DEBUG
       //
@@ -191,24 +825,29 @@ namespace custom
       T data;                  // Actual data stored in the BNode
       BNode* pLeft;            // Left child - smaller
       BNode* pRight;           // Right child - larger
-      BNode* pParent;          // Parent
-      bool isRed;              // Red-black balancing stuff
+                               // Parent and color: see the layout policy P
    };
 
    /**********************************************************
     * BINARY SEARCH TREE ITERATOR
     * Forward and reverse iterator through a BST
     *********************************************************/
-   template <typename T>
-   class BST<T>::iterator
+   template <typename T, typename C, typename A, typename P>
+   class BST<T, C, A, P>::iterator
    {
       friend class ::TestBST; // give unit tests access to the privates
       friend class ::TestSet;
       friend class ::TestMap;
 
-      template <class KK, class VV>
+      template <class KK, class VV, class CC, class AA, class PP>
       friend class custom::map;
    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = T;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const T*;
+      using reference         = const T&;
+
       // constructors and assignment
       iterator(BNode* p = nullptr) : pNode(p)
       {}
@@ -252,8 +891,9 @@ namespace custom
          return temp;
       }
 
-      // must give friend status to remove so it can call getNode() from it
-      friend BST<T>::iterator BST<T>::erase(iterator& it);
+      // must give friend status to the tree so erase() and the hinted
+      // inserts can get at the node
+      friend class BST<T, C, A, P>;
 
    private:
 
@@ -262,6 +902,88 @@ namespace custom
    };
 
 
+   /**************************************************
+    * BST NODE HANDLE
+    * Sole owner of a node taken out of a tree with extract().
+    * It can go into any tree with an equal allocator through
+    * insert(), with no allocation and no copy of the value.
+    * A handle that still holds a node destroys it.
+    *************************************************/
+   template <typename T, typename C, typename A, typename P>
+   class BST<T, C, A, P>::node_handle
+   {
+      friend class ::TestBST; // give unit tests access to the privates
+      friend class ::TestMap;
+      friend class BST<T, C, A, P>;
+   public:
+      using value_type     = T;
+      using allocator_type = A;
+
+      // constructors and assignment: a handle can be moved but not copied
+      node_handle() noexcept : pNode(nullptr)
+      {}
+      node_handle(node_handle&& rhs) noexcept : pNode(rhs.pNode), alloc(std::move(rhs.alloc))
+      {
+         rhs.pNode = nullptr;
+         rhs.alloc.reset();
+      }
+      node_handle& operator =(node_handle&& rhs) noexcept
+      {
+         clear();
+         pNode = rhs.pNode;
+         alloc = std::move(rhs.alloc);
+         rhs.pNode = nullptr;
+         rhs.alloc.reset();
+         return *this;
+      }
+      node_handle(const node_handle& rhs) = delete;
+      node_handle& operator =(const node_handle& rhs) = delete;
+      ~node_handle()
+      {
+         clear();
+      }
+      void swap(node_handle& rhs) noexcept
+      {
+         std::swap(pNode, rhs.pNode);
+         alloc.swap(rhs.alloc);
+      }
+
+      // status
+      bool empty() const noexcept           { return pNode == nullptr; }
+      explicit operator bool() const noexcept { return pNode != nullptr; }
+      allocator_type get_allocator() const  { return allocator_type(*alloc); }
+
+      // access: the node is in no tree, so the value may change
+      T& value() const
+      {
+         return pNode->data;
+      }
+
+   private:
+      node_handle(BNode* pNode, const NodeAlloc& alloc) : pNode(pNode), alloc(alloc)
+      {}
+
+      // give the node up to a tree
+      BNode* release() noexcept
+      {
+         BNode* p = pNode;
+         pNode = nullptr;
+         alloc.reset();
+         return p;
+      }
+      void clear() noexcept
+      {
+         if (pNode)
+            BNode::destroy(*alloc, pNode);
+         pNode = nullptr;
+         alloc.reset();
+      }
+
+      BNode* pNode;                    // the node, or nullptr when empty
+      std::optional<NodeAlloc> alloc;  // where the node goes back to
+   };
+
+
    /*********************************************
     *********************************************
     *********************************************
@@ -274,25 +996,49 @@ namespace custom
     /*********************************************
      * BST :: DEFAULT CONSTRUCTOR
      ********************************************/
-   template <typename T>
-   BST<T>::BST() : numElements(0), root(nullptr) {}
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST() : compare_base<C>(C()), root(nullptr), numElements(0), alloc(),
+                            pFirst(nullptr), pLast(nullptr) {}
+
+   /*********************************************
+    * BST :: COMPARATOR CONSTRUCTOR
+    * Order the nodes by a given comparator
+    ********************************************/
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST(const C& comp, const A& alloc)
+      : compare_base<C>(comp), root(nullptr), numElements(0), alloc(alloc),
+        pFirst(nullptr), pLast(nullptr) {}
+
+   /*********************************************
+    * BST :: ALLOCATOR CONSTRUCTOR
+    * Draw the nodes from a given allocator
+    ********************************************/
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST(const A& alloc)
+      : compare_base<C>(C()), root(nullptr), numElements(0), alloc(alloc),
+        pFirst(nullptr), pLast(nullptr) {}
 
    /*********************************************
     * BST :: COPY CONSTRUCTOR
-    * Copy one tree to another
+    * Copy one tree to another. The allocator decides whether
+    * the copy shares its memory (node_pool gives it a fresh arena).
     ********************************************/
-   template <typename T>
-   BST<T>::BST(const BST<T>& rhs) : BST()
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST(const BST<T, C, A, P>& rhs)
+      : compare_base<C>(rhs.compare()), root(nullptr), numElements(0),
+        alloc(NodeTraits::select_on_container_copy_construction(rhs.alloc)),
+        pFirst(nullptr), pLast(nullptr)
    {
-      *this = rhs;
+      if (!clone(rhs))
+         *this = rhs;
    }
 
    /*********************************************
     * BST :: MOVE CONSTRUCTOR
     * Move one tree to another
     ********************************************/
-   template <typename T>
-   BST<T>::BST(BST<T>&& rhs) : BST()
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST(BST<T, C, A, P>&& rhs) : BST(rhs.compare())
    {
       *this = std::move(rhs);
    }
@@ -301,8 +1047,9 @@ namespace custom
     * BST :: INITIALIZER LIST CONSTRUCTOR
     * Create a BST from an initializer list
     ********************************************/
-   template <typename T>
-   BST<T>::BST(const std::initializer_list<T>& il) : BST()
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::BST(const std::initializer_list<T>& il, const C& comp, const A& alloc)
+      : BST(comp, alloc)
    {
       *this = il;
    }
@@ -310,8 +1057,8 @@ namespace custom
    /*********************************************
     * BST :: DESTRUCTOR
     ********************************************/
-   template <typename T>
-   BST<T>::~BST()
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>::~BST()
    {
       clear();
    }
@@ -319,25 +1066,61 @@ namespace custom
 
    /*********************************************
     * BST :: ASSIGNMENT OPERATOR
-    * Copy one tree to another
+    * Copy one tree to another, and the order it is sorted by
     ********************************************/
-   template <typename T>
-   BST<T>& BST<T>::operator =(const BST<T>& rhs)
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>& BST<T, C, A, P>::operator =(const BST<T, C, A, P>& rhs)
    {
-      BNode::assign(root, rhs.root);
+      if (this != &rhs)
+         static_cast<compare_base<C>&>(*this) = rhs;
+
+      if constexpr (NodeTraits::propagate_on_container_copy_assignment::value)
+         if (alloc != rhs.alloc)
+         {
+            // our nodes must go back to the allocator they came from
+            clear();
+            alloc = rhs.alloc;
+         }
+
+      if (this != &rhs && clone(rhs))
+         return *this;
+
+      BNode::assign(root, rhs.root, alloc);
       numElements = rhs.numElements;
+      rethread();
+      findEnds();
       return *this;
    }
 
    /*********************************************
     * BST :: ASSIGN-MOVE OPERATOR
-    * Move one tree to another
+    * Move one tree to another, and the order it is sorted by
     ********************************************/
-   template <typename T>
-   BST<T>& BST<T>::operator =(BST<T>&& rhs)
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>& BST<T, C, A, P>::operator =(BST<T, C, A, P>&& rhs)
    {
       clear();
-      swap(rhs);
+
+      if constexpr (NodeTraits::propagate_on_container_move_assignment::value)
+      {
+         // take the allocator with the nodes; rhs gets our empty one
+         using std::swap;
+         swap(alloc, rhs.alloc);
+      }
+      else if (alloc != rhs.alloc)
+      {
+         // cannot steal nodes that our allocator cannot free
+         *this = rhs;
+         rhs.clear();
+         return *this;
+      }
+
+      using std::swap;
+      swap(static_cast<compare_base<C>&>(*this), static_cast<compare_base<C>&>(rhs));
+      std::swap(root, rhs.root);
+      std::swap(numElements, rhs.numElements);
+      std::swap(pFirst, rhs.pFirst);
+      std::swap(pLast, rhs.pLast);
       return *this;
    }
 
@@ -345,12 +1128,15 @@ namespace custom
     * BST :: ASSIGNMENT OPERATOR with INITIALIZATION LIST
     * Copy nodes onto a BTree
     ********************************************/
-   template <typename T>
-   BST<T>& BST<T>::operator =(const std::initializer_list<T>& il)
+   template <typename T, typename C, typename A, typename P>
+   BST<T, C, A, P>& BST<T, C, A, P>::operator =(const std::initializer_list<T>& il)
    {
       clear();
-      for (const T& t : il)
-         insert(t);
+      if (isSorted(il.begin(), il.end(), /*strict: */false))
+         buildSorted(il.begin(), il.size());
+      else
+         for (const T& t : il)
+            insert(t);
       return *this;
    }
 
@@ -358,279 +1144,1406 @@ namespace custom
     * BST :: SWAP
     * Swap two trees
     ********************************************/
-   template <typename T>
-   void BST<T>::swap(BST<T>& rhs)
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::swap(BST<T, C, A, P>& rhs)
    {
+      using std::swap;
+      swap(static_cast<compare_base<C>&>(*this), static_cast<compare_base<C>&>(rhs));
       std::swap(root, rhs.root);
       std::swap(numElements, rhs.numElements);
+      std::swap(pFirst, rhs.pFirst);
+      std::swap(pLast, rhs.pLast);
+
+      if constexpr (NodeTraits::propagate_on_container_swap::value)
+      {
+         using std::swap;
+         swap(alloc, rhs.alloc);
+      }
+      else
+         assert(alloc == rhs.alloc && "swapping trees with unequal allocators");
    }
 
    /*****************************************************
     * BST :: INSERT
     * Insert a node at its correct (sorted) location in the tree
     ****************************************************/
-   template <typename T>
-   std::pair<typename BST<T>::iterator, bool> BST<T>::insert(const T& t, bool keepUnique)
+   template <typename T, typename C, typename A, typename P>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::insert(const T& t, bool keepUnique)
+   {
+      // Go down the tree until you reach a leaf.
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findParent(t, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };  // Don't insert duplicates if keepUnique.
+
+      return { iterator(link(pParent, isLeft, t)), true };
+   }  // insert()
+
+   template <typename T, typename C, typename A, typename P>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::insert(T&& t, bool keepUnique)
+   {
+      // Go down the tree until you reach a leaf.
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findParent(t, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };  // Don't insert duplicates if keepUnique.
+
+      return { iterator(link(pParent, isLeft, std::move(t))), true };
+   }  // insert() move
+
+   /*****************************************************
+    * BST :: EMPLACE
+    * Build the value in a new node from args, then find where it
+    * goes. A duplicate (when keepUnique) is destroyed again.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename ... Args>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::emplace(bool keepUnique, Args&& ... args)
+   {
+      BNode* newNode = BNode::create(alloc, std::in_place, std::forward<Args>(args)...);
+
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findParent(newNode->data, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+      {
+         BNode::destroy(alloc, newNode);
+         return { iterator(pParent), false };
+      }
+
+      return { iterator(hook(pParent, isLeft, newNode)), true };
+   }
+
+   /*****************************************************
+    * BST :: INSERT WITH HINT
+    * Insert next to hint when that is where t belongs,
+    * otherwise search from the root like insert()
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::insert(const iterator& hint, const T& t,
+                                                                                bool keepUnique)
+   {
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findHint(hint.pNode, t, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };
+
+      return { iterator(link(pParent, isLeft, t)), true };
+   }
+
+   template <typename T, typename C, typename A, typename P>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::insert(const iterator& hint, T&& t,
+                                                                                bool keepUnique)
+   {
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findHint(hint.pNode, t, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };
+
+      return { iterator(link(pParent, isLeft, std::move(t))), true };
+   }
+
+   /*****************************************************
+    * BST :: EMPLACE WITH HINT
+    * Build the value in a new node, then place it next
+    * to hint if it belongs there
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename ... Args>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::emplace_hint(const iterator& hint,
+                                                                                      bool keepUnique,
+                                                                                      Args&& ... args)
+   {
+      BNode* newNode = BNode::create(alloc, std::in_place, std::forward<Args>(args)...);
+
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findHint(hint.pNode, newNode->data, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+      {
+         BNode::destroy(alloc, newNode);
+         return { iterator(pParent), false };
+      }
+
+      return { iterator(hook(pParent, isLeft, newNode)), true };
+   }
+
+   /*****************************************************
+    * BST :: EMPLACE KEY
+    * Search by key alone. Only when the key is missing build
+    * the value in a new node from args, which have not been
+    * touched otherwise.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K, typename ... Args>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::emplaceKey(const K& k, Args&& ... args)
+   {
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findParent(k, /*keepUnique: */true, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };
+
+      return { iterator(link(pParent, isLeft, std::in_place, std::forward<Args>(args)...)), true };
+   }
+
+   /*****************************************************
+    * BST :: LINK
+    * Build a node from args and hang it off pParent (on the
+    * side findParent() chose), then rebalance
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename ... Args>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::link(BNode* pParent, bool isLeft, Args&& ... args)
+   {
+      return hook(pParent, isLeft, BNode::create(alloc, std::forward<Args>(args)...));
+   }
+
+   /*****************************************************
+    * BST :: HOOK
+    * Hang an existing node off pParent, then rebalance
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::hook(BNode* pParent, bool isLeft, BNode* newNode)
+   {
+      if (!pParent)            // If no root, insert as root.
+         root = pFirst = pLast = newNode;
+      else if (isLeft)         // Left subtree
+      {
+         pParent->addLeft(newNode);
+         if (pParent == pFirst)
+            pFirst = newNode;
+      }
+      else                     // Right subtree
+      {
+         pParent->addRight(newNode);
+         if (pParent == pLast)
+            pLast = newNode;
+      }
+
+      // a left child goes right before its parent, a right child right after
+      if constexpr (is_threaded<P>::value)
+      {
+         newNode->pPrev = !pParent ? nullptr : (isLeft ? pParent->pPrev : pParent);
+         newNode->pNext = !pParent ? nullptr : (isLeft ? pParent : pParent->pNext);
+         if (newNode->pPrev)
+            newNode->pPrev->pNext = newNode;
+         if (newNode->pNext)
+            newNode->pNext->pPrev = newNode;
+      }
+
+      recountUp(pParent);
+      int rotations = newNode->balance(root);
+      note(alloc, &stats_counters::rotations, rotations);
+      numElements++;
+      return newNode;
+   }
+
+   /*************************************************
+    * BST :: ERASE
+    * Remove a given node as specified by the iterator
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator BST<T, C, A, P>::erase(iterator& it)
+   {
+      // If the iterator is at the end, do nothing
+      if (it == end())
+         return end();
+
+      iterator itReturn = it;  // copy assignment operator
+      ++itReturn;  // always return the next node
+
+      unlink(it.pNode);
+      BNode::destroy(alloc, it.pNode);
+      return itReturn;
+   }
+
+   /*************************************************
+    * BST :: UNLINK
+    * Take a node out of the tree and rebalance, leaving the
+    * node itself alone: it comes out as a red node with no
+    * parent or children, ready to be hooked into a tree again
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::unlink(BNode* pDelete)
+   {
+      if (pDelete == pFirst)
+         pFirst = (++iterator(pDelete)).pNode;
+      if (pDelete == pLast)
+         pLast = (--iterator(pDelete)).pNode;
+      if constexpr (is_threaded<P>::value)
+      {
+         if (pDelete->pPrev)
+            pDelete->pPrev->pNext = pDelete->pNext;
+         if (pDelete->pNext)
+            pDelete->pNext->pPrev = pDelete->pPrev;
+         pDelete->pPrev = pDelete->pNext = nullptr;
+      }
+
+      BNode* pChild;           // takes the place of the node that is removed
+      BNode* pChildParent;     // its parent, which we need when it is null
+      bool   removedBlack;     // did a black node leave its place?
+
+      // Case 1 and 2: zero or one child - replace node with child
+      if (!pDelete->pLeft || !pDelete->pRight)
+      {
+         pChild = pDelete->pLeft ? pDelete->pLeft : pDelete->pRight;
+         pChildParent = pDelete->parent();
+         removedBlack = !pDelete->red();
+         replace(pDelete, pChild);
+      }
+
+      // Case 3: Two Children - Replace node with in-order successor
+      else
+      {
+         BNode* pNext = pDelete->pRight;  // the successor has no left child
+         while (pNext->pLeft)
+            pNext = pNext->pLeft;
+         pChild = pNext->pRight;
+         removedBlack = !pNext->red();
+
+         // Special case: if pNext is not pDelete's direct right child,
+         // it gives its right child to its parent and takes pDelete's
+         if (pNext != pDelete->pRight)
+         {
+            pChildParent = pNext->parent();
+            replace(pNext, pChild);
+            pNext->pRight = pDelete->pRight;
+            pNext->pRight->setParent(pNext);
+         }
+         else
+            pChildParent = pNext;
+
+         // pNext takes over pDelete's place, left child, and color
+         replace(pDelete, pNext);
+         pNext->pLeft = pDelete->pLeft;
+         pNext->pLeft->setParent(pNext);
+         pNext->setRed(pDelete->red());
+      }
+
+      numElements--;
+
+      // every node from where the tree changed up to the root lost one
+      recountUp(pChildParent);
+
+      // a missing black node leaves one path short: recolor and rotate
+      if (removedBlack)
+         eraseBalance(pChild, pChildParent);
+
+      pDelete->pLeft = pDelete->pRight = nullptr;
+      pDelete->setParent(nullptr);
+      pDelete->setRed(true);
+      pDelete->recount();
+   }
+
+   /*************************************************
+    * BST :: EXTRACT
+    * Take the node at it out of the tree and hand it to
+    * the caller. Nothing is destroyed or deallocated.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::node_handle BST<T, C, A, P>::extract(const iterator& it)
+   {
+      if (it == end())
+         return node_handle();
+
+      unlink(it.pNode);
+      return node_handle(it.pNode, alloc);
+   }
+
+   /*************************************************
+    * BST :: INSERT NODE HANDLE
+    * Hook an extracted node into the tree. The handle is
+    * emptied only when the node goes in: a duplicate (when
+    * keepUnique) stays with the caller.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   std::pair<typename BST<T, C, A, P>::iterator, bool> BST<T, C, A, P>::insert(node_handle&& nh, bool keepUnique)
+   {
+      if (nh.empty())
+         return { end(), false };
+      assert(*nh.alloc == alloc && "node handle from a tree with an unequal allocator");
+
+      bool isDuplicate;
+      bool isLeft;
+      BNode* pParent = findParent(nh.pNode->data, keepUnique, isDuplicate, isLeft);
+      if (isDuplicate)
+         return { iterator(pParent), false };
+
+      return { iterator(hook(pParent, isLeft, nh.release())), true };
+   }
+
+   /*************************************************
+    * BST :: MERGE
+    * Move every node of src into this tree. When keepUnique,
+    * nodes whose value is already here stay in src.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::merge(BST<T, C, A, P>& src, bool keepUnique)
+   {
+      if (&src == this)
+         return;
+      assert(src.alloc == alloc && "merging trees with unequal allocators");
+
+      for (iterator it = src.begin(); it != src.end(); )
+      {
+         // the successor must be found while the node is still in src
+         BNode* pNode = it.pNode;
+         ++it;
+
+         bool isDuplicate;
+         bool isLeft;
+         BNode* pParent = findParent(pNode->data, keepUnique, isDuplicate, isLeft);
+         if (isDuplicate)
+            continue;
+
+         src.unlink(pNode);
+         hook(pParent, isLeft, pNode);
+      }
+   }
+
+   /*************************************************
+    * BST :: IS SORTED
+    * Is [first, last) in order? When strict, equivalent
+    * neighbors do not count as in order.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename Iterator>
+   bool BST<T, C, A, P>::isSorted(Iterator first, Iterator last, bool strict) const
+   {
+      if (first == last)
+         return true;
+
+      for (Iterator prev = first++; first != last; prev = first++)
+         if (strict ? !this->compare()(*prev, *first) : this->compare()(*first, *prev))
+            return false;
+      return true;
+   }
+
+   /*************************************************
+    * BST :: BUILD SORTED
+    * Turn n sorted values into a perfectly balanced tree in
+    * O(n), without a single comparison or rotation. The
+    * tree must be empty.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename Iterator>
+   void BST<T, C, A, P>::buildSorted(Iterator first, size_t n, unsigned threads)
    {
-      // If no root, insert as root.
+      assert(root == nullptr && numElements == 0);
+
+      // the top redDepth levels are full; only the bottom, partial,
+      // level is red so that every path has the same black depth
+      int redDepth = 0;
+      while ((size_t(2) << redDepth) - 1 <= n)
+         redDepth++;
+
+      // on several threads only when they can jump into the values and
+      // allocate at the same time: node_pool, for one, cannot
+      using category = typename std::iterator_traits<Iterator>::iterator_category;
+      if constexpr (std::is_base_of<std::random_access_iterator_tag, category>::value &&
+                    std::is_same<NodeAlloc, std::allocator<BNode>>::value)
+      {
+         int forkDepth = 0;
+         while ((1u << forkDepth) < threads)
+            forkDepth++;
+         root = buildParallel(first, n, 0, redDepth, alloc, forkDepth);
+      }
+      else
+         root = BNode::build(first, n, 0, redDepth, alloc);
+      numElements = n;
+      rethread();
+      findEnds();
+   }
+
+   /*************************************************
+    * BST :: BUILD PARALLEL
+    * The same tree as BNode::build(), but for the top
+    * forkDepth levels the left half is built on a thread
+    * of its own while this one builds the node and the
+    * right half. Then the three are joined.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename Iterator>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::buildParallel(Iterator first, size_t n, int depth,
+                                                                   int redDepth, NodeAlloc& alloc, int forkDepth)
+   {
+      if (forkDepth == 0 || n < 2 * parallel_grain)
+         return BNode::build(first, n, depth, redDepth, alloc);
+
+      size_t numLeft = (n - 1) / 2;
+      BNode* pLeft = nullptr;
+      std::exception_ptr errorLeft;
+      auto buildLeft = [&]()
+      {
+         try
+         {
+            pLeft = buildParallel(first, numLeft, depth + 1, redDepth, alloc, forkDepth - 1);
+         }
+         catch (...)
+         {
+            errorLeft = std::current_exception();
+         }
+      };
+
+      std::thread left;
+      try
+      {
+         left = std::thread(buildLeft);
+      }
+      catch (...)
+      {
+         buildLeft();                          // no thread to be had: do it here
+      }
+
+      BNode* pNode = nullptr;
+      BNode* pRight = nullptr;
+      std::exception_ptr error;
+      try
+      {
+         pNode = BNode::create(alloc, first[numLeft]);
+         pRight = buildParallel(first + (numLeft + 1), n - 1 - numLeft, depth + 1, redDepth, alloc, forkDepth - 1);
+      }
+      catch (...)
+      {
+         error = std::current_exception();
+      }
+      if (left.joinable())
+         left.join();
+
+      if (error || errorLeft)
+      {
+         BNode::clear(pLeft, alloc);
+         BNode::clear(pNode, alloc);
+         BNode::clear(pRight, alloc);
+         std::rethrow_exception(error ? error : errorLeft);
+      }
+
+      pNode->setRed(depth == redDepth);
+      pNode->addLeft(pLeft);
+      pNode->addRight(pRight);
+      pNode->recount();
+      return pNode;
+   }
+
+   /*************************************************
+    * BST :: PARALLEL FOR EACH
+    * Cut the tree some way down, about four subtrees a
+    * thread so that the uneven ones even out. The nodes
+    * above the cut are one more task.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename F>
+   void BST<T, C, A, P>::parallel_for_each(F&& f, unsigned threads) const
+   {
+      if (threads <= 1 || numElements < 2 * parallel_grain)
+      {
+         forEach(root, f);
+         return;
+      }
+
+      int depthCut = 0;
+      while ((size_t(1) << depthCut) < size_t(4) * threads)
+         depthCut++;
+
+      std::vector<const BNode*> above;
+      std::vector<const BNode*> subtrees;
+      std::vector<std::pair<const BNode*, int>> stack = { { root, 0 } };
+      while (!stack.empty())
+      {
+         std::pair<const BNode*, int> top = stack.back();
+         stack.pop_back();
+         if (!top.first)
+            continue;
+         if (top.second == depthCut)
+            subtrees.push_back(top.first);
+         else
+         {
+            above.push_back(top.first);
+            stack.push_back({ top.first->pLeft, top.second + 1 });
+            stack.push_back({ top.first->pRight, top.second + 1 });
+         }
+      }
+
+      parallel_tasks(subtrees.size() + 1, threads, [&](size_t i)
+      {
+         if (i < subtrees.size())
+            forEach(subtrees[i], f);
+         else
+            for (const BNode* p : above)
+               f(static_cast<const T&>(p->data));
+      });
+   }
+
+   /*************************************************
+    * BST :: FOR EACH
+    * f(value) for the subtree at pNode, in order
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename F>
+   void BST<T, C, A, P>::forEach(const BNode* pNode, F& f)
+   {
+      while (pNode)
+      {
+         forEach(pNode->pLeft, f);
+         f(static_cast<const T&>(pNode->data));
+         pNode = pNode->pRight;
+      }
+   }
+
+   /*************************************************
+    * BST :: SPLITTERS
+    * The nodes of the top levels, in order
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   std::vector<const T*> BST<T, C, A, P>::splitters(size_t count) const
+   {
+      int depth = 0;
+      while ((size_t(1) << depth) - 1 < count && depth < 62)
+         depth++;
+
+      std::vector<const T*> values;
+      std::vector<std::pair<const BNode*, int>> stack;
+      const BNode* p = root;
+      int d = 0;
+      while (p || !stack.empty())
+      {
+         for (; p && d < depth; p = p->pLeft, d++)
+            stack.push_back({ p, d });
+         if (stack.empty())
+            break;
+         std::pair<const BNode*, int> top = stack.back();
+         stack.pop_back();
+         values.push_back(&top.first->data);
+         p = top.first->pRight;
+         d = top.second + 1;
+      }
+      return values;
+   }
+
+   /*************************************************
+    * BST :: RETHREAD
+    * Thread every node to its in-order neighbors after the
+    * whole tree was built or copied at once. Nothing to do
+    * unless the layout policy keeps threads.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::rethread() noexcept
+   {
+      if constexpr (is_threaded<P>::value)
+      {
+         BNode* pPrev = nullptr;
+         thread(root, pPrev);
+         if (pPrev)
+            pPrev->pNext = nullptr;
+      }
+   }
+
+   /*************************************************
+    * BST :: FIND ENDS
+    * Note the first and last nodes after the whole tree
+    * was built or copied at once
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::findEnds() noexcept
+   {
+      pFirst = pLast = root;
       if (!root)
+         return;
+      while (pFirst->pLeft)
+         pFirst = pFirst->pLeft;
+      while (pLast->pRight)
+         pLast = pLast->pRight;
+   }
+
+   /*************************************************
+    * BST :: THREAD
+    * Link the subtree at pNode in order, after pPrev. On
+    * return pPrev is the last node of the subtree.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::thread(BNode* pNode, BNode*& pPrev) noexcept
+   {
+      if constexpr (is_threaded<P>::value)
+         if (pNode)
+         {
+            thread(pNode->pLeft, pPrev);
+            pNode->pPrev = pPrev;
+            if (pPrev)
+               pPrev->pNext = pNode;
+            pPrev = pNode;
+            thread(pNode->pRight, pPrev);
+         }
+   }
+
+   /*************************************************
+    * BST :: CLONE
+    * Copy rhs a chunk at a time instead of a node at a time.
+    * When the nodes are trivially copyable and the allocator can
+    * clone its arena, and neither arena holds anything but its own
+    * tree, our nodes are given back and rhs's chunks are copied
+    * whole; then the pointers in the copies are fixed up to point
+    * at each other, walking the chunks in memory order rather than
+    * the tree. Returns false when rhs has to be copied node by node
+    * instead.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   bool BST<T, C, A, P>::clone(const BST& rhs)
+   {
+      if constexpr (is_cloneable<NodeAlloc>::value && std::is_trivially_copyable<BNode>::value)
       {
-         root = new BNode(t);
-         root->balance(root);
-         numElements++;
-         return { iterator(root), true };
+         if (!rhs.root || !alloc.unique() || !rhs.alloc.unique())
+            return false;
+
+         clear();
+         auto fix = alloc.clone(rhs.alloc);
+         alloc.forEachUsed([&fix](BNode* pNode)
+         {
+            pNode->pLeft  = fix(pNode->pLeft);
+            pNode->pRight = fix(pNode->pRight);
+            pNode->setParent(fix(pNode->parent()));
+         });
+         root = fix(rhs.root);
+         numElements = rhs.numElements;
+         rethread();
+         findEnds();
+         note(alloc, &stats_counters::allocations, numElements);
+         note(alloc, &stats_counters::copies, numElements);
+         return true;
       }
+      else
+         return false;
+   }
 
-      // Go down the tree until you reach a leaf.
-      BNode* current = root;
-      while (true)
+   /*************************************************
+    * BST :: REPLACE
+    * Put pNew (which may be null) where pOld hangs
+    * from its parent, or at the root
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::replace(BNode* pOld, BNode* pNew)
+   {
+      BNode* pParent = pOld->parent();
+      if (!pParent)
+         root = pNew;
+      else if (pParent->pLeft == pOld)
+         pParent->pLeft = pNew;
+      else
+         pParent->pRight = pNew;
+
+      if (pNew)
+         pNew->setParent(pParent);
+   }
+
+   /*************************************************
+    * BST :: ROTATE LEFT
+    * pNode's right child takes its place:
+    *        N                R
+    *       / \              / \
+    *      a   R     =>     N   c
+    *         / \          / \
+    *        b   c        a   b
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::rotateLeft(BNode* pNode)
+   {
+      BNode* pRight = pNode->pRight;
+      pNode->pRight = pRight->pLeft;
+      if (pRight->pLeft)
+         pRight->pLeft->setParent(pNode);
+      replace(pNode, pRight);
+      pRight->pLeft = pNode;
+      pNode->setParent(pRight);
+      pNode->recount();
+      pRight->recount();
+      note(alloc, &stats_counters::rotations);
+   }
+
+   /*************************************************
+    * BST :: ROTATE RIGHT
+    * pNode's left child takes its place
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::rotateRight(BNode* pNode)
+   {
+      BNode* pLeft = pNode->pLeft;
+      pNode->pLeft = pLeft->pRight;
+      if (pLeft->pRight)
+         pLeft->pRight->setParent(pNode);
+      replace(pNode, pLeft);
+      pLeft->pRight = pNode;
+      pNode->setParent(pLeft);
+      pNode->recount();
+      pLeft->recount();
+      note(alloc, &stats_counters::rotations);
+   }
+
+   /*************************************************
+    * BST :: RECOUNT UP
+    * Count pNode's subtree again, then its parent's, and so
+    * on to the root, when the layout policy counts
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::recountUp(BNode* pNode) noexcept
+   {
+      if constexpr (is_counted<P>::value)
+         for (; pNode; pNode = pNode->parent())
+            pNode->recount();
+   }
+
+   /*************************************************
+    * BST :: ERASE BALANCE
+    * Every path through pNode (which may be null, hence
+    * pParent) is one black node short. Push the deficit
+    * up the tree or fix it with at most three rotations.
+    ************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::eraseBalance(BNode* pNode, BNode* pParent)
+   {
+      auto isBlack = [](const BNode* p) { return !p || !p->red(); };
+
+      while (pNode != root && isBlack(pNode))
       {
-         if (keepUnique && t == current->data)
-            return { iterator(current), false };  // Don't insert duplicates if keepUnique.
+         if (pNode == pParent->pLeft)
+         {
+            BNode* pSibling = pParent->pRight;
+
+            // Case 1: red sibling. Rotate it up so the sibling is black.
+            if (pSibling->red())
+            {
+               pSibling->setRed(false);
+               pParent->setRed(true);
+               rotateLeft(pParent);
+               pSibling = pParent->pRight;
+            }
+
+            // Case 2: black sibling with black children. Make it red
+            // and move the deficit up to the parent.
+            if (isBlack(pSibling->pLeft) && isBlack(pSibling->pRight))
+            {
+               pSibling->setRed(true);
+               pNode = pParent;
+               pParent = pNode->parent();
+            }
+            else
+            {
+               // Case 3: only the near nephew is red. Rotate it up.
+               if (isBlack(pSibling->pRight))
+               {
+                  pSibling->pLeft->setRed(false);
+                  pSibling->setRed(true);
+                  rotateRight(pSibling);
+                  pSibling = pParent->pRight;
+               }
+
+               // Case 4: the far nephew is red. Rotate the sibling up;
+               // the extra black on this side fixes the deficit.
+               pSibling->setRed(pParent->red());
+               pParent->setRed(false);
+               pSibling->pRight->setRed(false);
+               rotateLeft(pParent);
+               pNode = root;
+            }
+         }
+         else  // the mirror image
+         {
+            BNode* pSibling = pParent->pLeft;
+
+            if (pSibling->red())
+            {
+               pSibling->setRed(false);
+               pParent->setRed(true);
+               rotateRight(pParent);
+               pSibling = pParent->pLeft;
+            }
+
+            if (isBlack(pSibling->pLeft) && isBlack(pSibling->pRight))
+            {
+               pSibling->setRed(true);
+               pNode = pParent;
+               pParent = pNode->parent();
+            }
+            else
+            {
+               if (isBlack(pSibling->pLeft))
+               {
+                  pSibling->pRight->setRed(false);
+                  pSibling->setRed(true);
+                  rotateLeft(pSibling);
+                  pSibling = pParent->pLeft;
+               }
+
+               pSibling->setRed(pParent->red());
+               pParent->setRed(false);
+               pSibling->pLeft->setRed(false);
+               rotateRight(pParent);
+               pNode = root;
+            }
+         }
+      }
+
+      if (pNode)
+         pNode->setRed(false);
+   }
+
+   /*****************************************************
+    * BST :: CLEAR
+    * Removes all the BNodes from a tree
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::clear() noexcept
+   {
+      if constexpr (is_releasable<NodeAlloc>::value)
+         if (alloc.unique())
+         {
+            // run the destructors, if there are any to run, then
+            // hand back the chunks all at once
+            if constexpr (std::is_trivially_destructible<T>::value)
+               root = nullptr;
+            else
+               BNode::clear(root, alloc, /*deallocate: */false);
+            alloc.release();
+            note(alloc, &stats_counters::deallocations, numElements);
+            numElements = 0;
+            pFirst = pLast = nullptr;
+            return;
+         }
+
+      BNode::clear(root, alloc);
+      numElements = 0;
+      pFirst = pLast = nullptr;
+   }
+
+   /*****************************************************
+    * BST :: BEGIN
+    * Return the first node (left-most) in a binary search tree.
+    * The walk down is only done when the end is not known.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator custom::BST<T, C, A, P>::begin() const noexcept
+   {
+      if (empty())
+         return end();
+      if (pFirst)
+         return iterator(pFirst);
+
+      BNode* p = root;
+      while (p->pLeft)
+         p = p->pLeft;
+      return iterator(p);
+   }
+
+   /*****************************************************
+    * BST :: RBEGIN
+    * Return the last node (right-most) in a binary search tree
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator custom::BST<T, C, A, P>::rbegin() const noexcept
+   {
+      if (empty())
+         return end();
+      if (pLast)
+         return iterator(pLast);
+
+      BNode* p = root;
+      while (p->pRight)
+         p = p->pRight;
+      return iterator(p);
+   }
+
+
+   /****************************************************
+    * BST :: FIND
+    * Return the node corresponding to a given value
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator BST<T, C, A, P>::find(const T& t) const
+   {
+      return iterator(findNode(t));
+   }
+
+   /****************************************************
+    * BST :: FIND NODE
+    * Find the node equivalent to k, or nullptr. With a
+    * transparent comparator k need not be a T at all.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::findNode(const K& k) const
+   {
+      BNode* p = root;
+      note(alloc, &stats_counters::lookups);
+
+      if constexpr (three_way<C, K, T>::value)
+      {
+         while (p)
+         {
+            note(alloc, &stats_counters::comparisons);
+            int order = three_way<C, K, T>::compare(this->compare(), k, p->data);
+            if (order == 0)
+               return p;
+            p = (order < 0) ? p->pLeft : p->pRight;
+         }
+         return nullptr;
+      }
+      else
+      {
+         // one comparison a level: remember the last node that is not
+         // less than k, then check for equivalence once at the bottom
+         BNode* pCandidate = nullptr;
+         while (p)
+         {
+            note(alloc, &stats_counters::comparisons);
+            if (this->compare()(p->data, k))
+               p = p->pRight;
+            else
+            {
+               pCandidate = p;
+               p = p->pLeft;
+            }
+         }
+
+         note(alloc, &stats_counters::comparisons, pCandidate ? 1 : 0);
+         if (pCandidate && !this->compare()(k, pCandidate->data))
+            return pCandidate;
+         return nullptr;
+      }
+   }
+
+   /****************************************************
+    * BST :: FIND INTERLEAVED
+    * A lookup is a few loads that each wait on the one
+    * before: in a tree bigger than the cache, a miss a
+    * level. So LANES lookups take turns instead, each a
+    * little state machine of the node it is at and the
+    * last node not less than its key (one comparison a
+    * level, as in findNode). A lane compares, steps down,
+    * prefetches the node it stepped to, and passes; by the
+    * time its turn comes round again the node is there.
+    * A finished lane takes the next key.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   void BST<T, C, A, P>::find_interleaved(const K* const* keys, size_t n, iterator* found) const
+   {
+      // enough misses in flight to cover the memory latency, few
+      // enough that the lanes stay in registers and the fill buffers
+      constexpr size_t LANES = 8;
+      struct lane
+      {
+         BNode* p;            // where this lookup is
+         BNode* pCandidate;   // the last node not less than its key
+         size_t i;            // which key
+      };
+
+      lane lanes[LANES];
+      size_t numLanes = 0;
+      size_t next = 0;
+      for (; numLanes < LANES && next < n; numLanes++, next++)
+      {
+         lanes[numLanes] = lane{ root, nullptr, next };
+         note(alloc, &stats_counters::lookups);
+      }
 
-         if (t < current->data)  // Left subtree
+      while (numLanes)
+         for (size_t l = 0; l < numLanes; )
          {
-            if (!current->pLeft)
+            lane& x = lanes[l];
+            const K& k = *keys[x.i];
+            if (x.p)
             {
-               BNode* newNode = new BNode(t);
-               current->addLeft(newNode);
-               newNode->balance(root);
-               numElements++;
-               return { iterator(newNode), true };
+               note(alloc, &stats_counters::comparisons);
+               if (this->compare()(x.p->data, k))
+                  x.p = x.p->pRight;
+               else
+               {
+                  x.pCandidate = x.p;
+                  x.p = x.p->pLeft;
+               }
+               prefetch(x.p);
+               l++;
+               continue;
             }
-            current = current->pLeft;
-         }
-         else  // Right subtree
-         {
-            if (!current->pRight)
+
+            // at the bottom: the candidate is it, or nothing is
+            note(alloc, &stats_counters::comparisons, x.pCandidate ? 1 : 0);
+            found[x.i] = iterator(x.pCandidate && !this->compare()(k, x.pCandidate->data) ? x.pCandidate
+                                                                                          : nullptr);
+            if (next < n)
             {
-               BNode* newNode = new BNode(t);
-               current->addRight(newNode);
-               newNode->balance(root);
-               numElements++;
-               return { iterator(newNode), true };
+               x = lane{ root, nullptr, next++ };
+               note(alloc, &stats_counters::lookups);
             }
-            current = current->pRight;
+            else
+               x = lanes[--numLanes];   // l now holds a lane yet to move this round
          }
-      }
-   }  // insert()
+   }
 
-   template <typename T>
-   std::pair<typename BST<T>::iterator, bool> BST<T>::insert(T&& t, bool keepUnique)
+   /****************************************************
+    * BST :: BOUND NODE
+    * The first node that does not go before k (or, when
+    * upper, that goes after it), or nullptr: remember the
+    * last place the walk turned left
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::boundNode(const K& k, bool upper) const
    {
-      // If no root, insert as root.
-      if (!root)
+      BNode* pBound = nullptr;
+      note(alloc, &stats_counters::lookups);
+      for (BNode* p = root; p; )
       {
-         root = new BNode(std::move(t));
-         root->balance(root);
-         numElements++;
-         return { iterator(root), true };
+         note(alloc, &stats_counters::comparisons);
+         if (upper ? !this->compare()(k, p->data) : this->compare()(p->data, k))
+            p = p->pRight;
+         else
+         {
+            pBound = p;
+            p = p->pLeft;
+         }
       }
+      return pBound;
+   }
 
-      // Go down the tree until you reach a leaf.
-      BNode* current = root;
-      while (true)
+   /****************************************************
+    * BST :: FINGER BOUND
+    * Climb from the finger. A parent we are the right child
+    * of goes before us, so before k. A parent we are the
+    * left child of is the next one in order after all we
+    * have passed: if k goes after it too, it is passed; if
+    * not, it is the bound, unless that lies in the right
+    * subtree of the last node we passed. Only that subtree
+    * is searched on the way down.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::fingerBound(BNode* pFinger, const K& k, bool upper) const
+   {
+      auto isBefore = [this, &k, upper](const BNode* p)
       {
-         if (keepUnique && t == current->data)
-            return { iterator(current), false };  // Don't insert duplicates if keepUnique.
+         return upper ? !this->compare()(k, p->data) : this->compare()(p->data, k);
+      };
+
+      if (!pFinger)
+         return boundNode(k, upper);
+      if (!isBefore(pFinger))
+         return pFinger;                       // the same bound again
 
-         if (t < current->data)  // Left subtree
+      BNode* pPassed = pFinger;                // goes before k, as does all before it
+      BNode* pBound = nullptr;
+      for (BNode* p = pFinger, *pParent = p->parent(); pParent; p = pParent, pParent = p->parent())
+      {
+         if (pParent->pLeft != p)
+            continue;
+         if (!isBefore(pParent))
          {
-            if (!current->pLeft)
-            {
-               BNode* newNode = new BNode(std::move(t));
-               current->addLeft(newNode);
-               newNode->balance(root);
-               numElements++;
-               return { iterator(newNode), true };
-            }
-            current = current->pLeft;
+            pBound = pParent;
+            break;
          }
-         else  // Right subtree
+         pPassed = pParent;
+      }
+
+      // between pPassed and pBound: pPassed's right subtree
+      for (BNode* p = pPassed->pRight; p; )
+      {
+         if (isBefore(p))
+            p = p->pRight;
+         else
          {
-            if (!current->pRight)
-            {
-               BNode* newNode = new BNode(std::move(t));
-               current->addRight(newNode);
-               newNode->balance(root);
-               numElements++;
-               return { iterator(newNode), true };
-            }
-            current = current->pRight;
+            pBound = p;
+            p = p->pLeft;
          }
       }
-   }  // insert() move
+      return pBound;
+   }
 
-   /*************************************************
-    * BST :: ERASE
-    * Remove a given node as specified by the iterator
-    ************************************************/
-   template <typename T>
-   typename BST<T>::iterator BST<T>::erase(iterator& it)
+   /****************************************************
+    * BST :: COUNT RANGE
+    * How many values are equivalent to k? Unique trees stop
+    * at the first; others walk the run from the lower bound.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   size_t BST<T, C, A, P>::countEqual(const K& k) const
    {
-      // If the iterator is at the end, do nothing
-      if (it == end())
-         return end();
-
-      iterator itReturn = it;  // copy assignment operator
-      ++itReturn;  // always return the next node
+      size_t n = 0;
+      for (iterator it = lower_bound(k); it != end() && !this->compare()(k, *it); ++it)
+         n++;
+      return n;
+   }
 
-      BNode* pDelete = it.pNode;
-
-      // Case 1: No Children
-      if (!pDelete->pLeft && !pDelete->pRight)
-      {
-         // Make parent forget about us
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = nullptr;
-         else if (pDelete->pParent)
-            // Must be right child if has parent and is not left child
-            pDelete->pParent->pRight = nullptr;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
-      }
-
-      // Case 2: One Child - Replace node with child
-      //   Only left child
-      if (!pDelete->pRight && pDelete->pLeft)
-      {
-         // Hook up child to parent
-         pDelete->pLeft->pParent = pDelete->pParent;
-         // Update root pointer if pDelete was root.
-         if (!pDelete->pLeft->pParent)
-            root = pDelete->pLeft;
-         // Hook up parent to child: left
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pDelete->pLeft;
-         // Hook up parent to child: right
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pDelete->pLeft;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
-      }
-      //   Only right child
-      else if (pDelete->pRight && !pDelete->pLeft)
-      {
-         // Hook up child to parent
-         pDelete->pRight->pParent = pDelete->pParent;
-         // Update root pointer if pDelete was root.
-         if (!pDelete->pRight->pParent)
-            root = pDelete->pRight;
-         // Hook up parent to child: left
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pDelete->pRight;
-         // hook up parent to child: right
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pDelete->pRight;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
+   /****************************************************
+    * BST :: VISIT RANGE
+    * In order through [lo, hi), skipping every subtree that
+    * lies wholly outside it: O(log n + m) for m values, with
+    * no climbing back up through parents.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K, typename F>
+   void BST<T, C, A, P>::visitRange(BNode* pNode, const K& lo, const K& hi, F& f) const
+   {
+      while (pNode)
+      {
+         if (this->compare()(pNode->data, lo))        // so is everything on the left
+            pNode = pNode->pRight;
+         else if (!this->compare()(pNode->data, hi))  // so is everything on the right
+            pNode = pNode->pLeft;
+         else
+         {
+            visitRange(pNode->pLeft, lo, hi, f);
+            f(pNode->data);
+            pNode = pNode->pRight;
+         }
       }
+   }
 
-      // Case 3: Two Children - Replace node with in-order successor
-      if (pDelete->pLeft && pDelete->pRight)
+   /****************************************************
+    * BST :: RANK
+    * How many values go before k: everything left of each
+    * turn to the right on the way down
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   size_t BST<T, C, A, P>::rank(const K& k) const
+   {
+      static_assert(is_counted<P>::value, "rank() needs a layout policy that counts, such as rb_counted");
+      size_t r = 0;
+      for (BNode* p = root; p; )
       {
-         // Find in-order successor
-         BNode* pNext = itReturn.pNode;  // itReturn already points to next node in sequence.
-
-         // Part A: Copy the pointers from pDelete to pNext
-         pNext->pLeft = pDelete->pLeft;
-         pNext->pLeft->pParent = pNext;
-
-         // Special case: if pNext is not pDelete's direct right child
-         if (pNext != pDelete->pRight)
+         if (this->compare()(p->data, k))
          {
-            // Hook up pNext's right child to pNext's parent if it exists
-            if (pNext->pRight)
-            {
-               pNext->pRight->pParent = pNext->pParent;
-               pNext->pParent->pLeft = pNext->pRight;  // pNext must be a left child
-            }
-            else
-               pNext->pParent->pLeft = nullptr;
+            r += BNode::sizeOf(p->pLeft) + 1;
+            p = p->pRight;
+         }
+         else
+            p = p->pLeft;
+      }
+      return r;
+   }
 
-            // Hook up pDelete's right child to pNext
-            pNext->pRight = pDelete->pRight;
-            pNext->pRight->pParent = pNext;
+   /****************************************************
+    * BST :: NTH
+    * The value with i values before it: go left while the
+    * left subtree holds more than i, else skip past it
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator BST<T, C, A, P>::nth(size_t i) const
+   {
+      static_assert(is_counted<P>::value, "nth() needs a layout policy that counts, such as rb_counted");
+      BNode* p = root;
+      while (p)
+      {
+         size_t numLeft = BNode::sizeOf(p->pLeft);
+         if (i < numLeft)
+            p = p->pLeft;
+         else if (i == numLeft)
+            return iterator(p);
+         else
+         {
+            i -= numLeft + 1;
+            p = p->pRight;
          }
+      }
+      return end();
+   }
 
-         // Hook up pNext to pDelete's parent
-         pNext->pParent = pDelete->pParent;
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pNext;
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pNext;
-         else  // pDelete was the root
-            root = pNext;
+   /****************************************************
+    * BST :: COUNT RANGE
+    * How many values are in [lo, hi)? Two ranks, no walk.
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   size_t BST<T, C, A, P>::count_range(const K& lo, const K& hi) const
+   {
+      size_t rankLo = rank(lo);
+      size_t rankHi = rank(hi);
+      return rankHi > rankLo ? rankHi - rankLo : 0;
+   }
 
-         delete pDelete;
-         numElements--;
-         return itReturn;
-      }
+   /****************************************************
+    * BST :: STATS
+    * The counts kept since the tree was made or reset,
+    * and the height as it stands, which takes O(n)
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   tree_stats BST<T, C, A, P>::stats() const
+   {
+      static_assert(is_stats<P>::value, "stats() needs a layout policy that keeps them, such as rb_stats");
+      const stats_counters& counters = alloc.counters;
+      tree_stats s;
+      s.allocations   = counters.allocations.load(std::memory_order_relaxed);
+      s.deallocations = counters.deallocations.load(std::memory_order_relaxed);
+      s.lookups       = counters.lookups.load(std::memory_order_relaxed);
+      s.comparisons   = counters.comparisons.load(std::memory_order_relaxed);
+      s.rotations     = counters.rotations.load(std::memory_order_relaxed);
+      s.copies        = counters.copies.load(std::memory_order_relaxed);
+      s.moves         = counters.moves.load(std::memory_order_relaxed);
+      s.height        = heightOf(root);
+      return s;
+   }
 
-      assert(false && "Unreachable");
+   /****************************************************
+    * BST :: RESET STATS
+    * Start every count again from zero
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::reset_stats() noexcept
+   {
+      static_assert(is_stats<P>::value, "reset_stats() needs a layout policy that keeps them, such as rb_stats");
+      stats_counters& counters = alloc.counters;
+      for (std::atomic<std::size_t>* counter : { &counters.allocations, &counters.deallocations,
+                                                 &counters.lookups, &counters.comparisons,
+                                                 &counters.rotations, &counters.copies, &counters.moves })
+         counter->store(0, std::memory_order_relaxed);
+   }
 
-      return itReturn;
+   /****************************************************
+    * BST :: NOTE
+    * Add n to one of the counters, when the layout policy
+    * keeps them; otherwise nothing at all
+    ****************************************************/
+   template <typename T, typename C, typename A, typename P>
+   inline void BST<T, C, A, P>::note(const NodeAlloc& alloc, std::atomic<std::size_t> stats_counters::* counter,
+                                     std::size_t n) noexcept
+   {
+      if constexpr (is_stats<P>::value)
+         (alloc.counters.*counter).fetch_add(n, std::memory_order_relaxed);
    }
 
-   /*****************************************************
-    * BST :: CLEAR
-    * Removes all the BNodes from a tree
+   /****************************************************
+    * BST :: HEIGHT OF
+    * Levels from pNode down to its deepest leaf
     ****************************************************/
-   template <typename T>
-   void BST<T>::clear() noexcept
+   template <typename T, typename C, typename A, typename P>
+   size_t BST<T, C, A, P>::heightOf(const BNode* pNode) noexcept
    {
-      BNode::clear(root);
-      numElements = 0;
+      if (!pNode)
+         return 0;
+      size_t left = heightOf(pNode->pLeft);
+      size_t right = heightOf(pNode->pRight);
+      return 1 + (left > right ? left : right);
    }
 
-   /*****************************************************
-    * BST :: BEGIN
-    * Return the first node (left-most) in a binary search tree
+   /****************************************************
+    * BST :: FIND PARENT
+    * Walk down to where k belongs. Returns the node that
+    * would be k's parent and which side k goes on, or,
+    * when keepUnique, the node equivalent to k.
+    * Equivalent values go to the right of each other.
     ****************************************************/
-   template <typename T>
-   typename BST<T>::iterator custom::BST<T>::begin() const noexcept
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::findParent(const K& k, bool keepUnique,
+                                                                bool& isDuplicate, bool& isLeft) const
    {
-      if (empty())
-         return end();
+      BNode* pParent = nullptr;
+      isDuplicate = false;
+      isLeft = false;
+      note(alloc, &stats_counters::lookups);
 
-      BST<T>::BNode* p = root;
+      if constexpr (three_way<C, K, T>::value)
+      {
+         for (BNode* p = root; p; p = isLeft ? p->pLeft : p->pRight)
+         {
+            note(alloc, &stats_counters::comparisons);
+            int order = three_way<C, K, T>::compare(this->compare(), k, p->data);
+            if (keepUnique && order == 0)
+            {
+               isDuplicate = true;
+               return p;
+            }
+            pParent = p;
+            isLeft = order < 0;
+         }
+      }
+      else
+      {
+         // the last node we went right of is the only one that can be
+         // equivalent to t: everything else is strictly greater or less
+         BNode* pCandidate = nullptr;
+         for (BNode* p = root; p; p = isLeft ? p->pLeft : p->pRight)
+         {
+            note(alloc, &stats_counters::comparisons);
+            pParent = p;
+            isLeft = this->compare()(k, p->data);
+            if (!isLeft)
+               pCandidate = p;
+         }
 
-      while (p->pLeft)
-         p = p->pLeft;
+         note(alloc, &stats_counters::comparisons, keepUnique && pCandidate ? 1 : 0);
+         if (keepUnique && pCandidate && !this->compare()(pCandidate->data, k))
+         {
+            isDuplicate = true;
+            return pCandidate;
+         }
+      }
 
-      return iterator(p);
+      return pParent;
    }
 
-
    /****************************************************
-    * BST :: FIND
-    * Return the node corresponding to a given value
+    * BST :: FIND HINT
+    * Like findParent(), but first try the gap right before
+    * pHint (nullptr for end). If k fits between pHint and its
+    * predecessor, or between pHint and its successor, the new
+    * node is hung off whichever of the two has the free child.
+    * That takes two or three comparisons and no descent, so
+    * appending with the last insert as the hint is O(1).
+    * Anywhere else, fall back to the search from the root.
     ****************************************************/
-   template <typename T>
-   typename BST<T>::iterator BST<T>::find(const T& t)
+   template <typename T, typename C, typename A, typename P>
+   template <typename K>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::findHint(BNode* pHint, const K& k, bool keepUnique,
+                                                              bool& isDuplicate, bool& isLeft) const
    {
-      BNode* p = root;
+      const C& comp = this->compare();
+      isDuplicate = false;
 
-      if (!p)
-         return end();
+      // an empty tree: k becomes the root
+      if (!root)
+      {
+         isLeft = false;
+         return nullptr;
+      }
 
-      while (p)
+      // does k go before the hint? Everything goes before end().
+      // Equivalent values go before the hint only in a multi-tree.
+      if (!pHint || (keepUnique ? comp(k, pHint->data) : !comp(pHint->data, k)))
       {
-         if (t == p->data)
-            return iterator(p);
-         else if (t < p->data)
-            p = p->pLeft;
-         else
-            p = p->pRight;
+         BNode* pPrev = pHint ? (--iterator(pHint)).pNode : rbegin().pNode;
+
+         // ... and after the one before it?
+         if (!pPrev || (keepUnique ? comp(pPrev->data, k) : !comp(k, pPrev->data)))
+         {
+            // pPrev is either in pHint's left subtree, so it has no
+            // right child, or pHint has no left child
+            isLeft = pHint && !pHint->pLeft;
+            return isLeft ? pHint : pPrev;
+         }
+      }
+      else if (keepUnique && !comp(pHint->data, k))
+      {
+         // neither goes before the other: k is already here
+         isDuplicate = true;
+         return pHint;
+      }
+      else
+      {
+         // k goes after the hint: does it go before the one after it?
+         BNode* pNext = (++iterator(pHint)).pNode;
+         if (!pNext || (keepUnique ? comp(k, pNext->data) : !comp(pNext->data, k)))
+         {
+            isLeft = pHint->pRight != nullptr;
+            return isLeft ? pNext : pHint;
+         }
       }
 
-      return end();
+      // a bad hint: search from the root
+      return findParent(k, keepUnique, isDuplicate, isLeft);
    }
 
    /******************************************************
@@ -642,28 +2555,68 @@ namespace custom
     ******************************************************/
 
 
+   /**********************************************
+    * BINARY NODE :: CREATE
+    * Allocate a node from the tree's allocator and
+    * construct it from the arguments
+    *********************************************/
+   template <typename T, typename C, typename A, typename P>
+   template <typename... Args>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::BNode::create(NodeAlloc& alloc, Args&&... args)
+   {
+      BNode* pNode = NodeTraits::allocate(alloc, 1);
+      try
+      {
+         NodeTraits::construct(alloc, pNode, std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+         NodeTraits::deallocate(alloc, pNode, 1);
+         throw;
+      }
+      note(alloc, &stats_counters::allocations);
+      if constexpr (made_from<T, Args...>::copy)
+         note(alloc, &stats_counters::copies);
+      if constexpr (made_from<T, Args...>::move)
+         note(alloc, &stats_counters::moves);
+      return pNode;
+   }
+
+   /**********************************************
+    * BINARY NODE :: DESTROY
+    * Destruct a node and give it back to the allocator
+    *********************************************/
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::BNode::destroy(NodeAlloc& alloc, BNode* pNode) noexcept
+   {
+      NodeTraits::destroy(alloc, pNode);
+      NodeTraits::deallocate(alloc, pNode, 1);
+      note(alloc, &stats_counters::deallocations);
+   }
+
    /**********************************************
     * COPY BINARY TREE
     * Copy pSrc->pRight to pDest->pRight and
     * pSrc->pLeft onto pDest->pLeft
     *********************************************/
-   template <typename T>
-   inline typename BST<T>::BNode* BST<T>::BNode::copy(const BNode* pSrc)
+   template <typename T, typename C, typename A, typename P>
+   inline typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::BNode::copy(const BNode* pSrc, NodeAlloc& alloc)
    {
       if (!pSrc)
          return nullptr;
 
-      BNode* pDest = new BNode(pSrc->data);
-      pDest->isRed = pSrc->isRed;
+      BNode* pDest = create(alloc, pSrc->data);
+      pDest->setRed(pSrc->red());
 
-      pDest->pLeft = copy(pSrc->pLeft);
+      pDest->pLeft = copy(pSrc->pLeft, alloc);
       if (pDest->pLeft)
-         pDest->pLeft->pParent = pDest;
+         pDest->pLeft->setParent(pDest);
 
-      pDest->pRight = copy(pSrc->pRight);
+      pDest->pRight = copy(pSrc->pRight, alloc);
       if (pDest->pRight)
-         pDest->pRight->pParent = pDest;
+         pDest->pRight->setParent(pDest);
 
+      pDest->recount();
       return pDest;
    }
 
@@ -672,20 +2625,20 @@ namespace custom
     * Copy the values from pSrc onto pDest preserving
     * as many of the nodes as possible.
     ******************************************************/
-   template <typename T>
-   inline void BST<T>::BNode::assign(BNode*& pDest, const BNode* pSrc)
+   template <typename T, typename C, typename A, typename P>
+   inline void BST<T, C, A, P>::BNode::assign(BNode*& pDest, const BNode* pSrc, NodeAlloc& alloc)
    {
       // Case 1: Source is empty.
       if (!pSrc)
       {
-         clear(pDest);
+         clear(pDest, alloc);
          return;
       }
 
       // Case 2: Destination is empty.
       if (!pDest)
       {
-         pDest = copy(pSrc);
+         pDest = copy(pSrc, alloc);
          return;
       }
 
@@ -693,94 +2646,107 @@ namespace custom
       if (pSrc && pDest)
       {
          pDest->data = pSrc->data;
-         assign(pDest->pLeft, pSrc->pLeft);
+         note(alloc, &stats_counters::copies);
+         pDest->setRed(pSrc->red());
+         assign(pDest->pLeft, pSrc->pLeft, alloc);
          if (pDest->pLeft)
-            pDest->pLeft->pParent = pDest;
+            pDest->pLeft->setParent(pDest);
 
-         assign(pDest->pRight, pSrc->pRight);
+         assign(pDest->pRight, pSrc->pRight, alloc);
          if (pDest->pRight)
-            pDest->pRight->pParent = pDest;
+            pDest->pRight->setParent(pDest);
+
+         pDest->recount();
       }
    }
 
    /******************************************************
-    * BINARY NODE :: ADD LEFT
-    * Add a node to the left of the current node
+    * BINARY NODE :: BUILD
+    * Build the n nodes starting at it, in order: the left
+    * half, the middle, then the right half. If an allocation
+    * fails, the nodes built so far are freed again.
     ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addLeft(BNode* pNode)
+   template <typename T, typename C, typename A, typename P>
+   template <typename Iterator>
+   typename BST<T, C, A, P>::BNode* BST<T, C, A, P>::BNode::build(Iterator& it, size_t n, int depth,
+                                                                  int redDepth, NodeAlloc& alloc)
    {
-      if (pNode)
-         pNode->pParent = this;
-      pLeft = pNode;
-   }
+      if (n == 0)
+         return nullptr;
 
-   /******************************************************
-    * BINARY NODE :: ADD RIGHT
-    * Add a node to the right of the current node
-    ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addRight(BNode* pNode)
-   {
-      if (pNode)
-         pNode->pParent = this;
-      pRight = pNode;
-   }
+      size_t numLeft = (n - 1) / 2;
+      BNode* pLeft = build(it, numLeft, depth + 1, redDepth, alloc);
 
-   /******************************************************
-    * BINARY NODE :: ADD LEFT
-    * Add a node to the left of the current node
-    ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addLeft(const T& t)
-   {
-      addLeft(new BNode(t));
+      BNode* pNode;
+      try
+      {
+         pNode = create(alloc, *it);
+      }
+      catch (...)
+      {
+         clear(pLeft, alloc);
+         throw;
+      }
+      ++it;
+      pNode->setRed(depth == redDepth);
+      pNode->addLeft(pLeft);
+
+      try
+      {
+         pNode->addRight(build(it, n - 1 - numLeft, depth + 1, redDepth, alloc));
+      }
+      catch (...)
+      {
+         clear(pNode, alloc);
+         throw;
+      }
+      pNode->recount();
+      return pNode;
    }
 
    /******************************************************
     * BINARY NODE :: ADD LEFT
     * Add a node to the left of the current node
     ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addLeft(T&& t)
-   {
-      addLeft(new BNode(std::move(t)));
-   }
-
-   /******************************************************
-    * BINARY NODE :: ADD RIGHT
-    * Add a node to the right of the current node
-    ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addRight(const T& t)
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::BNode::addLeft(BNode* pNode)
    {
-      addLeft(new BNode(t));
+      if (pNode)
+         pNode->setParent(this);
+      pLeft = pNode;
    }
 
    /******************************************************
     * BINARY NODE :: ADD RIGHT
     * Add a node to the right of the current node
     ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::addRight(T&& t)
+   template <typename T, typename C, typename A, typename P>
+   void BST<T, C, A, P>::BNode::addRight(BNode* pNode)
    {
-      addRight(new BNode(std::move(t)));
+      if (pNode)
+         pNode->setParent(this);
+      pRight = pNode;
    }
 
    /*****************************************************
    * BINARY NODE :: CLEAR RECURSIVE
-   * Removes all the BNodes from a tree
+   * Removes all the BNodes from a tree. When the allocator is
+   * about to release all of its memory at once, only the
+   * destructors need to run.
    ****************************************************/
-   template <typename T>
-   inline void BST<T>::BNode::clear(BNode*& pNode) noexcept
+   template <typename T, typename C, typename A, typename P>
+   inline void BST<T, C, A, P>::BNode::clear(BNode*& pNode, NodeAlloc& alloc, bool deallocate) noexcept
    {
       if (!pNode)
          return;
 
-      clear(pNode->pLeft);
-      clear(pNode->pRight);
+      clear(pNode->pLeft, alloc, deallocate);
+      clear(pNode->pRight, alloc, deallocate);
 
-      delete pNode;
+      if (deallocate)
+         destroy(alloc, pNode);
+      else
+         NodeTraits::destroy(alloc, pNode);
       pNode = nullptr;
    }
 
@@ -790,52 +2756,52 @@ namespace custom
  * Find the depth of the black nodes. This is useful for
  * verifying that a given red-black tree is valid
  ****************************************************/
-   template <typename T>
-   int BST<T>::BNode::findDepth() const
+   template <typename T, typename C, typename A, typename P>
+   int BST<T, C, A, P>::BNode::findDepth() const
    {
       // if there are no children, the depth is ourselves
       if (pRight == nullptr && pLeft == nullptr)
-         return (isRed ? 0 : 1);
+         return (red() ? 0 : 1);
 
       // if there is a right child, go that way
       if (pRight != nullptr)
-         return (isRed ? 0 : 1) + pRight->findDepth();
+         return (red() ? 0 : 1) + pRight->findDepth();
       else
-         return (isRed ? 0 : 1) + pLeft->findDepth();
+         return (red() ? 0 : 1) + pLeft->findDepth();
    }
 
    /****************************************************
     * BINARY NODE :: VERIFY RED BLACK
     * Do all four red-black rules work here?
     ***************************************************/
-   template <typename T>
-   bool BST<T>::BNode::verifyRedBlack(int depth) const
+   template <typename T, typename C, typename A, typename P>
+   bool BST<T, C, A, P>::BNode::verifyRedBlack(int depth) const
    {
       bool fReturn = true;
-      depth -= (isRed == false) ? 1 : 0;
+      depth -= (red() == false) ? 1 : 0;
 
       // Rule a) Every node is either red or black
-      assert(isRed == true || isRed == false); // this feels silly
+      assert(red() == true || red() == false); // this feels silly
 
       // Rule b) The root is black
-      if (pParent == nullptr)
-         if (isRed == true)
+      if (parent() == nullptr)
+         if (red() == true)
             fReturn = false;
 
       // Rule c) Red nodes have black children
-      if (isRed == true)
+      if (red() == true)
       {
          if (pLeft != nullptr)
-            if (pLeft->isRed == true)
+            if (pLeft->red() == true)
                fReturn = false;
 
          if (pRight != nullptr)
-            if (pRight->isRed == true)
+            if (pRight->red() == true)
                fReturn = false;
       }
 
       // Rule d) Every path from a leaf to the root has the same # of black nodes
-      if (pLeft == nullptr && pRight && nullptr)
+      if (pLeft == nullptr || pRight == nullptr)
          if (depth != 0)
             fReturn = false;
       if (pLeft != nullptr)
@@ -853,8 +2819,8 @@ namespace custom
     * VERIFY B TREE
     * Verify that the tree is correctly formed
     ******************************************************/
-   template <typename T>
-   std::pair<T, T> BST<T>::BNode::verifyBTree() const
+   template <typename T, typename C, typename A, typename P>
+   std::pair<T, T> BST<T, C, A, P>::BNode::verifyBTree() const
    {
       // largest and smallest values
       std::pair <T, T> extremes;
@@ -862,15 +2828,14 @@ namespace custom
       extremes.second = data;
 
       // check parent
-      if (pParent)
-         assert(pParent->pLeft == this || pParent->pRight == this);
+      if (parent())
+         assert(parent()->pLeft == this || parent()->pRight == this);
 
       // check left, the smaller sub-tree
       if (pLeft)
       {
          assert(!(data < pLeft->data));
-         assert(pLeft->pParent == this);
-         pLeft->verifyBTree();
+         assert(pLeft->parent() == this);
          std::pair <T, T> p = pLeft->verifyBTree();
          assert(!(data < p.second));
          extremes.first = p.first;
@@ -881,9 +2846,7 @@ namespace custom
       if (pRight)
       {
          assert(!(pRight->data < data));
-         assert(pRight->pParent == this);
-         pRight->verifyBTree();
-
+         assert(pRight->parent() == this);
          std::pair <T, T> p = pRight->verifyBTree();
          assert(!(p.first < data));
          extremes.second = p.second;
@@ -897,8 +2860,8 @@ namespace custom
     * COMPUTE SIZE
     * Verify that the BST is as large as we think it is
     ********************************************/
-   template <typename T>
-   int BST<T>::BNode::computeSize() const
+   template <typename T, typename C, typename A, typename P>
+   int BST<T, C, A, P>::BNode::computeSize() const
    {
       return 1 +
          (pLeft == nullptr ? 0 : pLeft->computeSize()) +
@@ -908,145 +2871,154 @@ namespace custom
 
    /******************************************************
     * BINARY NODE :: BALANCE
-    * Balance the tree from a given location
+    * Balance the tree from a given location. Returns how
+    * many rotations that took: none, one or two
     ******************************************************/
-   template <typename T>
-   void BST<T>::BNode::balance(BNode*& pRoot)
+   template <typename T, typename C, typename A, typename P>
+   int BST<T, C, A, P>::BNode::balance(BNode*& pRoot)
    {
       // Case 1: if we are the root, then color ourselves black and call it a day.
-      if (!pParent)
+      if (!parent())
       {
-         isRed = false;
-         return;
+         setRed(false);
+         return 0;
       }
 
       // Case 2: if the parent is black, then there is nothing left to do
-      if (!pParent->isRed)
-         return;
+      if (!parent()->red())
+         return 0;
 
-      BNode* pGranny = pParent->pParent;
-      BNode* pAunt   = pParent->isLeftChild(pGranny)
+      BNode* pGranny = parent()->parent();
+      BNode* pAunt   = parent()->isLeftChild(pGranny)
          ? pGranny->pRight
          : pGranny->pLeft;
 
-      BNode* pSibling = this->isLeftChild(pParent)
-         ? pParent->pRight
-         : pParent->pLeft;
+      BNode* pSibling = this->isLeftChild(parent())
+         ? parent()->pRight
+         : parent()->pLeft;
 
       // Case 3: if the aunt is red, then just recolor
-      if (pAunt && pAunt->isRed)
+      if (pAunt && pAunt->red())
       {
          // grandparent's kids turn black
-         pParent->isRed = false;
-         pAunt->isRed = false;
+         parent()->setRed(false);
+         pAunt->setRed(false);
          // grandparent turns red
-         pGranny->isRed = true;
+         pGranny->setRed(true);
          // recurse off of grandparent
-         pGranny->balance(pRoot);
-         return;
+         return pGranny->balance(pRoot);
       }
 
       // Case 4: if the aunt is black or non-existant, then we need to rotate
-      if (!pAunt || !pAunt->isRed)
+      if (!pAunt || !pAunt->red())
       {
          // Case 4a: We are mom's left and mom is granny's left
-         if (pParent->isRed && !pGranny->isRed
-             && pParent->pLeft == this
-             && pGranny->pLeft == pParent)
+         if (parent()->red() && !pGranny->red()
+             && parent()->pLeft == this
+             && pGranny->pLeft == parent())
          {
-            pParent->pParent = pGranny->pParent;
-            if (pGranny->pParent && pGranny->isLeftChild(pGranny->pParent))
-               pGranny->pParent->pLeft = pParent;
-            else if (pGranny->pParent)
-               pGranny->pParent->pRight = pParent;
+            parent()->setParent(pGranny->parent());
+            if (pGranny->parent() && pGranny->isLeftChild(pGranny->parent()))
+               pGranny->parent()->pLeft = parent();
+            else if (pGranny->parent())
+               pGranny->parent()->pRight = parent();
 
-            pParent->addRight(pGranny);
+            parent()->addRight(pGranny);
             pGranny->addLeft(pSibling);
+            pGranny->recount();
+            parent()->recount();
 
-            pGranny->isRed = true;
-            pParent->isRed = false;
+            pGranny->setRed(true);
+            parent()->setRed(false);
 
-            if (!pParent->pParent)
-               pRoot = pParent;
+            if (!parent()->parent())
+               pRoot = parent();
 
-            return;
+            return 1;
          }
 
          // case 4b: We are mom's right and mom is granny's right
-         if (pParent->isRed && !pGranny->isRed
-             && pParent->pRight == this
-             && pGranny->pRight == pParent)
+         if (parent()->red() && !pGranny->red()
+             && parent()->pRight == this
+             && pGranny->pRight == parent())
          {
-            pParent->pParent = pGranny->pParent;
-            if (pGranny->pParent && pGranny->isLeftChild(pGranny->pParent))
-               pGranny->pParent->pLeft = pParent;
-            else if (pGranny->pParent)
-               pGranny->pParent->pRight = pParent;
+            parent()->setParent(pGranny->parent());
+            if (pGranny->parent() && pGranny->isLeftChild(pGranny->parent()))
+               pGranny->parent()->pLeft = parent();
+            else if (pGranny->parent())
+               pGranny->parent()->pRight = parent();
 
-            pParent->addLeft(pGranny);
+            parent()->addLeft(pGranny);
             pGranny->addRight(pSibling);
+            pGranny->recount();
+            parent()->recount();
 
-            pGranny->isRed = true;
-            pParent->isRed = false;
+            pGranny->setRed(true);
+            parent()->setRed(false);
 
-            if (!pParent->pParent)
-               pRoot = pParent;
+            if (!parent()->parent())
+               pRoot = parent();
 
-            return;
+            return 1;
          }
 
          // Case 4c: We are mom's right and mom is granny's left
-         if (this->isRightChild(pParent) && pParent->isLeftChild(pGranny))
+         if (this->isRightChild(parent()) && parent()->isLeftChild(pGranny))
          {
             pGranny->addLeft(this->pRight);
-            pParent->addRight(this->pLeft);
+            parent()->addRight(this->pLeft);
 
-            BNode* pParentTemp = pParent;  // Save pointer to parent
-            if (!pGranny->pParent)
-               this->pParent = nullptr;
-            else if (pGranny->isLeftChild(pGranny->pParent))
-               pGranny->pParent->pLeft = this;
-            else
-               pGranny->pParent->pRight = this;
+            BNode* pParentTemp = parent();  // Save pointer to parent
+            this->setParent(pGranny->parent());
+            if (pGranny->isLeftChild(pGranny->parent()))
+               pGranny->parent()->pLeft = this;
+            else if (pGranny->parent())
+               pGranny->parent()->pRight = this;
 
             this->addRight(pGranny);
             this->addLeft(pParentTemp);
+            pGranny->recount();
+            pParentTemp->recount();
+            this->recount();
 
-            pGranny->isRed = true;
-            this->isRed = false;
+            pGranny->setRed(true);
+            this->setRed(false);
 
-            if (!pParent)
+            if (!parent())
                pRoot = this;
 
-            return;
+            return 2;
          }
 
          // case 4d: we are mom's left and mom is granny's right
-         if (this->isLeftChild(pParent) && pParent->isRightChild(pGranny))
+         if (this->isLeftChild(parent()) && parent()->isRightChild(pGranny))
          {
             pGranny->addRight(this->pLeft);
-            pParent->addLeft(this->pRight);
+            parent()->addLeft(this->pRight);
 
-            BNode* pParentTemp = pParent;  // Save pointer to parent
-            if (!pGranny->pParent)
-               this->pParent = nullptr;
-            else if (pGranny->isLeftChild(pGranny->pParent))
-               pGranny->pParent->pLeft = this;
-            else
-               pGranny->pParent->pRight = this;
+            BNode* pParentTemp = parent();  // Save pointer to parent
+            this->setParent(pGranny->parent());
+            if (pGranny->isLeftChild(pGranny->parent()))
+               pGranny->parent()->pLeft = this;
+            else if (pGranny->parent())
+               pGranny->parent()->pRight = this;
 
             this->addLeft(pGranny);
             this->addRight(pParentTemp);
+            pGranny->recount();
+            pParentTemp->recount();
+            this->recount();
 
-            pGranny->isRed = true;
-            this->isRed = false;
+            pGranny->setRed(true);
+            this->setRed(false);
 
-            if (!pParent)
+            if (!parent())
                pRoot = this;
 
-            return;
+            return 2;
          }
       }  // Case 4
+      return 0;
    }  // balance()
 
    /*************************************************
@@ -1061,13 +3033,20 @@ namespace custom
     * BST ITERATOR :: INCREMENT PREFIX
     * advance by one
     *************************************************/
-   template <typename T>
-   typename BST<T>::iterator& BST<T>::iterator::operator ++()
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator& BST<T, C, A, P>::iterator::operator ++()
    {
       // Don't increment if we're already at the end
       if (!pNode)
          return *this;
 
+      // Threaded: one hop
+      if constexpr (is_threaded<P>::value)
+      {
+         pNode = pNode->pNext;
+         return *this;
+      }
+
       // Case 1: Have a right child
       if (pNode->pRight)
       {
@@ -1078,18 +3057,18 @@ namespace custom
       }
 
       // Case 2: No right child and pCurr is parent's left child
-      if (!pNode->pRight && pNode->isLeftChild(pNode->pParent))
+      if (!pNode->pRight && pNode->isLeftChild(pNode->parent()))
       {
-         pNode = pNode->pParent;
+         pNode = pNode->parent();
          return *this;
       }
 
-      // Case 3: No right child and pCurr is parent's right child
-      if (!pNode->pRight && pNode->isRightChild(pNode->pParent))
+      // Case 3: No right child and pCurr is parent's right child (or the root)
+      if (!pNode->pRight)
       {
-         while (pNode->pParent && pNode->isRightChild(pNode->pParent))
-            pNode = pNode->pParent;
-         pNode = pNode->pParent;
+         while (pNode->parent() && pNode->isRightChild(pNode->parent()))
+            pNode = pNode->parent();
+         pNode = pNode->parent();
          return *this;
       }
 
@@ -1102,13 +3081,20 @@ namespace custom
     * BST ITERATOR :: DECREMENT PREFIX
     * advance by one
     *************************************************/
-   template <typename T>
-   typename BST<T>::iterator& BST<T>::iterator::operator --()
+   template <typename T, typename C, typename A, typename P>
+   typename BST<T, C, A, P>::iterator& BST<T, C, A, P>::iterator::operator --()
    {
       // Don't increment if we're already at the end
       if (!pNode)
          return *this;
 
+      // Threaded: one hop
+      if constexpr (is_threaded<P>::value)
+      {
+         pNode = pNode->pPrev;
+         return *this;
+      }
+
       // Case 1: Have a left child
       if (pNode->pLeft)
       {
@@ -1119,18 +3105,18 @@ namespace custom
       }
 
       // Case 2: No left child and pCurr is parent's right child
-      if (!pNode->pLeft && pNode->isRightChild(pNode->pParent))
+      if (!pNode->pLeft && pNode->isRightChild(pNode->parent()))
       {
-         pNode = pNode->pParent;
+         pNode = pNode->parent();
          return *this;
       }
 
-      // Case 3: No left child and pCurr is parent's left child
-      if (!pNode->pLeft && pNode->isLeftChild(pNode->pParent))
+      // Case 3: No left child and pCurr is parent's left child (or the root)
+      if (!pNode->pLeft)
       {
-         while (pNode->pParent && pNode->isLeftChild(pNode->pParent))
-            pNode = pNode->pParent;
-         pNode = pNode->pParent;
+         while (pNode->parent() && pNode->isLeftChild(pNode->parent()))
+            pNode = pNode->parent();
+         pNode = pNode->parent();
          return *this;
       }
 
@@ -0,0 +1,1867 @@
+/***********************************************************************
+ * Header:
+ *    BTREE
+ * Summary:
+ *    A B+tree for map, as an alternative to the red-black BST. The
+ *    values live in wide leaves, side by side, and the leaves are
+ *    linked in order. The inner nodes hold nothing but a sorted array
+ *    of separator keys and the children between them. A lookup takes
+ *    a cache miss or two a level instead of one a comparison, and a
+ *    scan walks contiguous memory.
+ *
+ *    This will contain the class definition of:
+ *        key_of              : The key inside a value (a pair's first)
+ *        BTree               : A class that represents a B+tree
+ *        BTree::iterator     : An iterator through a BTree
+ *        BTree::node_handle  : A value taken out of a BTree
+ *        bplus               : The policy that gives map a BTree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>     // for std::size_t
+#include <iterator>    // for std::iterator_traits
+#include <type_traits> // for std::is_same
+#include <memory>      // for std::allocator_traits
+#include <new>         // for std::launder
+#include <optional>    // for std::optional in node_handle
+#include <utility>     // for std::pair
+#include <vector>      // for std::vector in buildSorted()
+#include "pair.h"      // for custom::pair
+#include "bst.h"       // for custom::compare_base
+#include "search.h"    // for custom::key_lower_bound
+#include "parallel.h"  // for custom::parallel_tasks
+
+class TestBTree;
+
+namespace custom
+{
+
+/*****************************************************************
+ * KEY OF
+ * The part of a value the tree orders by, and so the part the
+ * inner nodes keep a copy of: the first of a pair, or the whole
+ * value for anything else
+ *****************************************************************/
+   template <typename T>
+   struct key_of
+   {
+      using type = T;
+      static const T& get(const T& t) noexcept { return t; }
+   };
+   template <typename K, typename V, typename KC>
+   struct key_of<custom::pair<K, V, KC>>
+   {
+      using type = K;
+      static const K& get(const custom::pair<K, V, KC>& p) noexcept { return p.first; }
+   };
+
+/*****************************************************************
+ * BTREE
+ * A B+tree of T ordered by C. Every leaf holds up to N values and
+ * every inner node up to N keys; nodes other than the root are at
+ * least half full. C must order keys against keys and values as
+ * well as values against values (map::value_compare does).
+ *
+ * Unlike the BST, inserting and erasing move the values within and
+ * between leaves, so they invalidate iterators. erase() returns a
+ * good one for the next value. Leaves and inner nodes differ in
+ * size, so a node_pool (one block size an arena) cannot back it.
+ *****************************************************************/
+   template <typename T, typename C = std::less<T>, typename A = std::allocator<T>,
+             std::size_t N = 64>
+   class BTree : private compare_base<C>
+   {
+      friend class ::TestBTree; // give unit tests access to private members
+
+      template <class KK, class VV, class CC, class AA, class PP>
+      friend class custom::map;
+
+      static_assert(N >= 4, "a node must split into two that are still at least half full");
+   public:
+      using value_compare  = C;
+      using allocator_type = A;
+      using key_type       = typename key_of<T>::type;
+
+      //
+      // Construct
+      //
+
+      BTree();
+      explicit BTree(const C& comp, const A& alloc = A());
+      explicit BTree(const A& alloc);
+      BTree(const BTree& rhs);
+      BTree(BTree&& rhs);
+      ~BTree();
+
+      //
+      // Assign
+      //
+
+      BTree& operator =(const BTree& rhs);
+      BTree& operator =(BTree&& rhs);
+      void swap(BTree& rhs);
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin()  const noexcept;
+      iterator rbegin() const noexcept;   // the last element: walk it back with --
+      iterator end()    const noexcept { return iterator(); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const
+      {
+         return findKey(t);
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator find(const K& k) const
+      {
+         return findKey(k);
+      }
+
+      // bounds, as for BST
+      iterator lower_bound(const T& t) const
+      {
+         return boundKey(t, /*upper: */false);
+      }
+      iterator upper_bound(const T& t) const
+      {
+         return boundKey(t, /*upper: */true);
+      }
+      std::pair<iterator, iterator> equal_range(const T& t) const
+      {
+         return std::pair<iterator, iterator>(lower_bound(t), upper_bound(t));
+      }
+      size_t count(const T& t) const
+      {
+         return countEqual(t);
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator lower_bound(const K& k) const
+      {
+         return boundKey(k, /*upper: */false);
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      iterator upper_bound(const K& k) const
+      {
+         return boundKey(k, /*upper: */true);
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      std::pair<iterator, iterator> equal_range(const K& k) const
+      {
+         return std::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+      template <typename K, typename CC = C, typename = typename CC::is_transparent>
+      size_t count(const K& k) const
+      {
+         return countEqual(k);
+      }
+
+      // the bound of k, found from finger as for the BST: only k's
+      // leaf is searched when it is finger's leaf or the next one
+      template <typename K>
+      iterator bound_from(const iterator& finger, const K& k, bool upper = false) const;
+
+      // f(value) for every value on up to threads threads: each task
+      // runs along the leaves under one node some levels down. As for
+      // the BST, f must be safe to call that way and the order is not
+      // defined
+      template <typename F>
+      void parallel_for_each(F&& f, unsigned threads) const;
+
+      // the first value of the leftmost leaf under each node of the
+      // highest level with more than count nodes (or of every leaf),
+      // in order
+      std::vector<const T*> splitters(size_t count) const;
+
+      // call f(value) for every value in [lo, hi), in order: a leaf's
+      // values at a time
+      template <typename K, typename F>
+      void visit_range(const K& lo, const K& hi, F&& f) const;
+
+      //
+      // Insert
+      //
+
+      std::pair<iterator, bool> insert(const T& t, bool keepUnique = false);
+      std::pair<iterator, bool> insert(T&& t, bool keepUnique = false);
+      template <typename ... Args>
+      std::pair<iterator, bool> emplace(bool keepUnique, Args&& ... args);
+
+      // with a hint: no descent when t goes right next to hint
+      std::pair<iterator, bool> insert(const iterator& hint, const T& t, bool keepUnique = false);
+      std::pair<iterator, bool> insert(const iterator& hint, T&& t, bool keepUnique = false);
+      template <typename ... Args>
+      std::pair<iterator, bool> emplace_hint(const iterator& hint, bool keepUnique, Args&& ... args);
+
+      //
+      // Remove
+      //
+
+      iterator erase(iterator& it);
+      void     clear() noexcept;
+
+      //
+      // Node handles: the same interface as the BST's, but
+      // a value cannot leave its leaf without being moved
+      //
+
+      class node_handle;
+      node_handle extract(const iterator& it);
+      std::pair<iterator, bool> insert(node_handle&& nh, bool keepUnique = false);
+      void merge(BTree& src, bool keepUnique = false);
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return size() == 0; }
+      size_t size()  const noexcept { return numElements; }
+      allocator_type get_allocator() const { return alloc; }
+      value_compare  value_comp()    const { return this->compare(); }
+
+   private:
+
+      struct Inner;
+
+      // the parent link, the only thing leaves and inner nodes share
+      struct Node
+      {
+         Node() : pParent(nullptr) {}
+         Inner* pParent;
+      };
+
+      // up to N values, in order, and the leaves on either side
+      struct Leaf : Node
+      {
+         Leaf() : n(0), pPrev(nullptr), pNext(nullptr) {}
+         T* values() noexcept { return std::launder(reinterpret_cast<T*>(raw)); }
+
+         size_t n;                               // number of values
+         Leaf*  pPrev;                           // leaf before this one
+         Leaf*  pNext;                           // leaf after this one
+         alignas(T) unsigned char raw[N * sizeof(T)];
+      };
+
+      // up to N keys, and the n + 1 children around them. Every value
+      // under children[i] goes at or before keys[i], and at or after keys[i - 1]
+      struct Inner : Node
+      {
+         Inner() : n(0) {}
+         key_type* keys() noexcept { return std::launder(reinterpret_cast<key_type*>(raw)); }
+
+         size_t n;                               // number of keys
+         Node*  children[N + 1];
+         alignas(key_type) unsigned char raw[N * sizeof(key_type)];
+      };
+
+      using ValueTraits = std::allocator_traits<A>;
+      using KeyAlloc    = typename ValueTraits::template rebind_alloc<key_type>;
+      using KeyTraits   = typename ValueTraits::template rebind_traits<key_type>;
+      using LeafAlloc   = typename ValueTraits::template rebind_alloc<Leaf>;
+      using LeafTraits  = typename ValueTraits::template rebind_traits<Leaf>;
+      using InnerAlloc  = typename ValueTraits::template rebind_alloc<Inner>;
+      using InnerTraits = typename ValueTraits::template rebind_traits<Inner>;
+
+      static constexpr size_t MAX = N;          // most values or keys in a node
+      static constexpr size_t MIN = N / 2;      // fewest values or keys in a node but the root
+
+      // search
+      template <typename K>
+      iterator findKey(const K& k) const;
+      template <typename K>
+      iterator boundKey(const K& k, bool upper) const;
+      template <typename K>
+      size_t countEqual(const K& k) const;
+      template <typename K>
+      Leaf*  descend(const K& k, bool upper) const;
+      template <typename K>
+      size_t keyIndex(Inner* pInner, const K& k, bool upper) const;
+      template <typename K>
+      size_t valueIndex(Leaf* pLeaf, const K& k, bool upper) const;
+      static size_t childIndex(Inner* pInner, const Node* pChild) noexcept;
+      std::vector<Leaf*> leafRuns(size_t count) const;
+
+      // can a search for a K compare a whole array of keys at once?
+      template <typename K>
+      static constexpr bool simdSearch = simd_keys<C, key_type>::value &&
+         (std::is_same<K, key_type>::value || std::is_same<K, T>::value);
+      template <typename K>
+      static const key_type& searchKey(const K& k) noexcept
+      {
+         if constexpr (std::is_same<K, key_type>::value)
+            return k;
+         else
+            return key_of<T>::get(k);
+      }
+
+      // insert
+      template <typename K, typename ... Args>
+      std::pair<iterator, bool> emplaceKey(const K& k, Args&& ... args);
+      template <typename K, typename ... Args>
+      std::pair<iterator, bool> insertKey(const K& k, bool keepUnique, Args&& ... args);
+      template <typename ... Args>
+      std::pair<iterator, bool> insertHint(const iterator& hint, const T& t, bool keepUnique, Args&& ... args);
+      template <typename ... Args>
+      iterator insertAt(Leaf* pLeaf, size_t i, Args&& ... args);
+      void     splitLeaf(Leaf* pLeaf);
+      void     insertParent(Node* pLeft, key_type&& key, Node* pRight, Inner*& pSpare) noexcept;
+      static Inner* takeSpare(Inner*& pSpare) noexcept;
+      void     setLowerBound(Leaf* pLeaf, const key_type& key);
+      void     setUpperBound(Leaf* pLeaf, const key_type& key);
+
+      // remove
+      void     rebalanceLeaf(Leaf* pLeaf, Leaf*& pPos, size_t& iPos);
+      void     rebalanceInner(Inner* pInner);
+      void     removeKey(Inner* pInner, size_t i);
+      void     destroy(Node* pNode, size_t depth) noexcept;
+
+      // bulk
+      template <typename Iterator>
+      bool     isSorted(Iterator first, Iterator last, bool strict) const;
+      template <typename Iterator>
+      void     buildSorted(Iterator first, size_t n, unsigned threads = 1);
+
+      // nodes
+      Leaf*    newLeaf();
+      Inner*   newInner();
+      void     deleteLeaf(Leaf* pLeaf) noexcept;
+      void     deleteInner(Inner* pInner) noexcept;
+
+      // arrays of constructed objects
+      template <typename Alloc, typename X, typename ... Args>
+      static void insertSlot(Alloc& a, X* v, size_t n, size_t i, Args&& ... args);
+      template <typename Alloc, typename X>
+      static void eraseSlot(Alloc& a, X* v, size_t n, size_t i) noexcept;
+      template <typename Alloc, typename X>
+      static void moveSlots(Alloc& a, X* src, size_t n, X* dest);
+
+      static T& data(const iterator& it);
+
+      Node*  root;            // a Leaf when height is 0, else an Inner
+      size_t height;          // inner levels above the leaves
+      size_t numElements;     // number of values in the tree
+      Leaf*  pFirst;          // leftmost leaf
+      Leaf*  pLast;           // rightmost leaf
+      A      alloc;           // where the values, keys and nodes come from
+   };
+
+/*****************************************************************
+ * BPLUS
+ * Layout policy for map: build it on a BTree with N values a leaf
+ *****************************************************************/
+   template <std::size_t N = 64>
+   struct bplus
+   {
+      template <typename T, typename C, typename A>
+      using tree = BTree<T, C, A, N>;
+   };
+
+
+   /**************************************************
+    * BTREE ITERATOR
+    * A leaf and a slot in it; the end is no leaf at all.
+    *************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   class BTree<T, C, A, N>::iterator
+   {
+      friend class ::TestBTree; // give unit tests access to the privates
+      friend class BTree<T, C, A, N>;
+
+      template <class KK, class VV, class CC, class AA, class PP>
+      friend class custom::map;
+   public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = T;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const T*;
+      using reference         = const T&;
+
+      // constructors and assignment
+      iterator() : pLeaf(nullptr), slot(0)
+      {}
+      iterator(Leaf* pLeaf, size_t slot) : pLeaf(pLeaf), slot(slot)
+      {}
+
+      // compare
+      bool operator ==(const iterator& rhs) const
+      {
+         return pLeaf == rhs.pLeaf && slot == rhs.slot;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      // de-reference. Cannot change because it will invalidate the BTree
+      const T& operator *() const
+      {
+         return pLeaf->values()[slot];
+      }
+
+      // increment and decrement: along the leaf, then to the next one
+      iterator& operator ++()
+      {
+         if (pLeaf && ++slot == pLeaf->n)
+         {
+            pLeaf = pLeaf->pNext;
+            slot = 0;
+         }
+         return *this;
+      }
+      iterator operator ++(int postfix)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         if (pLeaf && slot-- == 0)
+         {
+            pLeaf = pLeaf->pPrev;
+            slot = pLeaf ? pLeaf->n - 1 : 0;
+         }
+         return *this;
+      }
+      iterator operator --(int postfix)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+
+      Leaf*  pLeaf;   // the leaf, or nullptr for the end
+      size_t slot;    // which value in the leaf
+   };
+
+
+   /**************************************************
+    * BTREE NODE HANDLE
+    * Sole owner of a value taken out of a tree with extract().
+    * The value lives in a block of its own while it is out,
+    * so it is moved once on the way out and once on the way
+    * back in. A handle that still holds a value destroys it.
+    *************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   class BTree<T, C, A, N>::node_handle
+   {
+      friend class ::TestBTree; // give unit tests access to the privates
+      friend class BTree<T, C, A, N>;
+   public:
+      using value_type     = T;
+      using allocator_type = A;
+
+      // constructors and assignment: a handle can be moved but not copied
+      node_handle() noexcept : pValue(nullptr)
+      {}
+      node_handle(node_handle&& rhs) noexcept : pValue(rhs.pValue), alloc(std::move(rhs.alloc))
+      {
+         rhs.pValue = nullptr;
+         rhs.alloc.reset();
+      }
+      node_handle& operator =(node_handle&& rhs) noexcept
+      {
+         clear();
+         pValue = rhs.pValue;
+         alloc = std::move(rhs.alloc);
+         rhs.pValue = nullptr;
+         rhs.alloc.reset();
+         return *this;
+      }
+      node_handle(const node_handle& rhs) = delete;
+      node_handle& operator =(const node_handle& rhs) = delete;
+      ~node_handle()
+      {
+         clear();
+      }
+      void swap(node_handle& rhs) noexcept
+      {
+         std::swap(pValue, rhs.pValue);
+         alloc.swap(rhs.alloc);
+      }
+
+      // status
+      bool empty() const noexcept             { return pValue == nullptr; }
+      explicit operator bool() const noexcept { return pValue != nullptr; }
+      allocator_type get_allocator() const    { return *alloc; }
+
+      // access: the value is in no tree, so it may change
+      T& value() const
+      {
+         return *pValue;
+      }
+
+   private:
+      // move t out of a tree into a block of its own
+      node_handle(T&& t, const A& a) : pValue(nullptr), alloc(a)
+      {
+         T* p = ValueTraits::allocate(*alloc, 1);
+         try
+         {
+            ValueTraits::construct(*alloc, p, std::move(t));
+         }
+         catch (...)
+         {
+            ValueTraits::deallocate(*alloc, p, 1);
+            throw;
+         }
+         pValue = p;
+      }
+
+      void clear() noexcept
+      {
+         if (pValue)
+         {
+            ValueTraits::destroy(*alloc, pValue);
+            ValueTraits::deallocate(*alloc, pValue, 1);
+         }
+         pValue = nullptr;
+         alloc.reset();
+      }
+
+      T* pValue;                // the value, or nullptr when empty
+      std::optional<A> alloc;   // where the value's block goes back to
+   };
+
+
+   /*********************************************
+    *********************************************
+    *********************************************
+    ******************* BTREE *******************
+    *********************************************
+    *********************************************
+    *********************************************/
+
+
+   /*********************************************
+    * BTREE :: DEFAULT CONSTRUCTOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::BTree()
+      : compare_base<C>(C()), root(nullptr), height(0), numElements(0),
+        pFirst(nullptr), pLast(nullptr), alloc() {}
+
+   /*********************************************
+    * BTREE :: COMPARATOR CONSTRUCTOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::BTree(const C& comp, const A& alloc)
+      : compare_base<C>(comp), root(nullptr), height(0), numElements(0),
+        pFirst(nullptr), pLast(nullptr), alloc(alloc) {}
+
+   /*********************************************
+    * BTREE :: ALLOCATOR CONSTRUCTOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::BTree(const A& alloc)
+      : compare_base<C>(C()), root(nullptr), height(0), numElements(0),
+        pFirst(nullptr), pLast(nullptr), alloc(alloc) {}
+
+   /*********************************************
+    * BTREE :: COPY CONSTRUCTOR
+    * The values are already in order: build the copy
+    * bottom up in O(n)
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::BTree(const BTree& rhs)
+      : compare_base<C>(rhs.compare()), root(nullptr), height(0), numElements(0),
+        pFirst(nullptr), pLast(nullptr),
+        alloc(ValueTraits::select_on_container_copy_construction(rhs.alloc))
+   {
+      buildSorted(rhs.begin(), rhs.size());
+   }
+
+   /*********************************************
+    * BTREE :: MOVE CONSTRUCTOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::BTree(BTree&& rhs) : BTree(rhs.compare(), rhs.alloc)
+   {
+      swap(rhs);
+   }
+
+   /*********************************************
+    * BTREE :: DESTRUCTOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>::~BTree()
+   {
+      clear();
+   }
+
+   /*********************************************
+    * BTREE :: ASSIGNMENT OPERATOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>& BTree<T, C, A, N>::operator =(const BTree& rhs)
+   {
+      if (this == &rhs)
+         return *this;
+
+      clear();
+      if constexpr (ValueTraits::propagate_on_container_copy_assignment::value)
+         alloc = rhs.alloc;
+      static_cast<compare_base<C>&>(*this) = rhs;
+      buildSorted(rhs.begin(), rhs.size());
+      return *this;
+   }
+
+   /*********************************************
+    * BTREE :: ASSIGN-MOVE OPERATOR
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   BTree<T, C, A, N>& BTree<T, C, A, N>::operator =(BTree&& rhs)
+   {
+      clear();
+
+      if constexpr (!ValueTraits::propagate_on_container_move_assignment::value)
+         if (alloc != rhs.alloc)
+         {
+            // cannot steal nodes that our allocator cannot free
+            *this = rhs;
+            rhs.clear();
+            return *this;
+         }
+
+      swap(rhs);
+      return *this;
+   }
+
+   /*********************************************
+    * BTREE :: SWAP
+    ********************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::swap(BTree& rhs)
+   {
+      using std::swap;
+      swap(static_cast<compare_base<C>&>(*this), static_cast<compare_base<C>&>(rhs));
+      std::swap(root, rhs.root);
+      std::swap(height, rhs.height);
+      std::swap(numElements, rhs.numElements);
+      std::swap(pFirst, rhs.pFirst);
+      std::swap(pLast, rhs.pLast);
+      swap(alloc, rhs.alloc);
+   }
+
+   /*****************************************************
+    * BTREE :: BEGIN
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::begin() const noexcept
+   {
+      return pFirst ? iterator(pFirst, 0) : end();
+   }
+
+   /*****************************************************
+    * BTREE :: RBEGIN
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::rbegin() const noexcept
+   {
+      return pLast ? iterator(pLast, pLast->n - 1) : end();
+   }
+
+   /*****************************************************
+    * BTREE :: DATA
+    * Write access to the value at it, for map
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   T& BTree<T, C, A, N>::data(const iterator& it)
+   {
+      return it.pLeaf->values()[it.slot];
+   }
+
+   /****************************************************
+    * BTREE :: FIND KEY
+    * The leaf where k would go, then the first value there
+    * that does not go before k. Equivalent values can start
+    * the next leaf, so step over when we run off the end.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::findKey(const K& k) const
+   {
+      if (!root)
+         return end();
+
+      Leaf* pLeaf = descend(k, /*upper: */false);
+      size_t i = valueIndex(pLeaf, k, /*upper: */false);
+      if (i == pLeaf->n)
+      {
+         pLeaf = pLeaf->pNext;
+         i = 0;
+      }
+
+      if (!pLeaf || this->compare()(k, pLeaf->values()[i]))
+         return end();
+      return iterator(pLeaf, i);
+   }
+
+   /****************************************************
+    * BTREE :: BOUND KEY
+    * The first value that does not go before k (or, when
+    * upper, that goes after it). It is in the leaf the search
+    * lands in, or else first in the next one.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::boundKey(const K& k, bool upper) const
+   {
+      if (!root)
+         return end();
+
+      Leaf* pLeaf = descend(k, upper);
+      size_t i = valueIndex(pLeaf, k, upper);
+      if (i == pLeaf->n)
+      {
+         pLeaf = pLeaf->pNext;
+         i = 0;
+      }
+      return pLeaf ? iterator(pLeaf, i) : end();
+   }
+
+   /****************************************************
+    * BTREE :: BOUND FROM
+    * Every value before finger goes before k, so when k
+    * does not go after the last value in finger's leaf the
+    * bound is in that leaf. Try the next leaf too, then
+    * give up and descend from the root.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::bound_from(const iterator& finger, const K& k,
+                                                                       bool upper) const
+   {
+      Leaf* pLeaf = finger.pLeaf;
+      for (int hop = 0; pLeaf && hop < 2; hop++)
+      {
+         const T& last = pLeaf->values()[pLeaf->n - 1];
+         if (upper ? this->compare()(k, last) : !this->compare()(last, k))
+            return iterator(pLeaf, valueIndex(pLeaf, k, upper));
+         pLeaf = pLeaf->pNext;
+         if (!pLeaf)
+            return end();                      // after everything
+      }
+      return boundKey(k, upper);
+   }
+
+   /****************************************************
+    * BTREE :: COUNT RANGE
+    * How many values are equivalent to k?
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   size_t BTree<T, C, A, N>::countEqual(const K& k) const
+   {
+      size_t n = 0;
+      for (iterator it = boundKey(k, /*upper: */false); it != end() && !this->compare()(k, *it); ++it)
+         n++;
+      return n;
+   }
+
+   /****************************************************
+    * BTREE :: VISIT RANGE
+    * From the lower bound of lo along the leaves until a
+    * value reaches hi
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K, typename F>
+   void BTree<T, C, A, N>::visit_range(const K& lo, const K& hi, F&& f) const
+   {
+      iterator it = boundKey(lo, /*upper: */false);
+      for (Leaf* pLeaf = it.pLeaf; pLeaf; pLeaf = pLeaf->pNext)
+      {
+         const T* values = pLeaf->values();
+         for (size_t i = (pLeaf == it.pLeaf) ? it.slot : 0; i < pLeaf->n; i++)
+         {
+            if (!this->compare()(values[i], hi))
+               return;
+            f(values[i]);
+         }
+      }
+   }
+
+   /****************************************************
+    * BTREE :: LEAF RUNS
+    * Go down a level at a time until there are more than
+    * count nodes. The leaves from the leftmost under one up
+    * to the leftmost under the next are a run.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   std::vector<typename BTree<T, C, A, N>::Leaf*> BTree<T, C, A, N>::leafRuns(size_t count) const
+   {
+      std::vector<Leaf*> runs;
+      if (!root)
+         return runs;
+
+      std::vector<Node*> level = { root };
+      size_t depth = height;
+      for (; depth > 0 && level.size() <= count; depth--)
+      {
+         std::vector<Node*> below;
+         for (Node* pNode : level)
+         {
+            Inner* pInner = static_cast<Inner*>(pNode);
+            for (size_t c = 0; c <= pInner->n; c++)
+               below.push_back(pInner->children[c]);
+         }
+         level.swap(below);
+      }
+
+      runs.reserve(level.size());
+      for (Node* pNode : level)
+      {
+         for (size_t d = depth; d > 0; d--)
+            pNode = static_cast<Inner*>(pNode)->children[0];
+         runs.push_back(static_cast<Leaf*>(pNode));
+      }
+      return runs;
+   }
+
+   /****************************************************
+    * BTREE :: PARALLEL FOR EACH
+    * About four runs of leaves a thread
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename F>
+   void BTree<T, C, A, N>::parallel_for_each(F&& f, unsigned threads) const
+   {
+      std::vector<Leaf*> runs;
+      if (threads > 1 && numElements >= 2 * parallel_grain)
+         runs = leafRuns(size_t(4) * threads);
+      else if (pFirst)
+         runs.push_back(pFirst);
+
+      parallel_tasks(runs.size(), threads, [&](size_t i)
+      {
+         Leaf* pStop = i + 1 < runs.size() ? runs[i + 1] : nullptr;
+         for (Leaf* pLeaf = runs[i]; pLeaf != pStop; pLeaf = pLeaf->pNext)
+         {
+            const T* values = pLeaf->values();
+            for (size_t j = 0; j < pLeaf->n; j++)
+               f(values[j]);
+         }
+      });
+   }
+
+   /****************************************************
+    * BTREE :: SPLITTERS
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   std::vector<const T*> BTree<T, C, A, N>::splitters(size_t count) const
+   {
+      std::vector<const T*> values;
+      for (Leaf* pLeaf : leafRuns(count))
+         values.push_back(pLeaf->values());
+      return values;
+   }
+
+   /****************************************************
+    * BTREE :: DESCEND
+    * Go from the root to the leaf where k belongs: before
+    * the values equivalent to it, or after them when upper
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   typename BTree<T, C, A, N>::Leaf* BTree<T, C, A, N>::descend(const K& k, bool upper) const
+   {
+      Node* pNode = root;
+      for (size_t depth = height; depth > 0; depth--)
+      {
+         Inner* pInner = static_cast<Inner*>(pNode);
+         pNode = pInner->children[keyIndex(pInner, k, upper)];
+      }
+      return static_cast<Leaf*>(pNode);
+   }
+
+   /****************************************************
+    * BTREE :: KEY INDEX
+    * Binary search: how many keys go before k (or, when
+    * upper, do not go after it)?
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   size_t BTree<T, C, A, N>::keyIndex(Inner* pInner, const K& k, bool upper) const
+   {
+      const key_type* keys = pInner->keys();
+      if constexpr (simdSearch<K>)
+         return upper ? key_upper_bound(keys, pInner->n, searchKey(k))
+                      : key_lower_bound(keys, pInner->n, searchKey(k));
+
+      size_t lo = 0;
+      size_t hi = pInner->n;
+      while (lo < hi)
+      {
+         size_t mid = lo + (hi - lo) / 2;
+         if (upper ? !this->compare()(k, keys[mid]) : this->compare()(keys[mid], k))
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   /****************************************************
+    * BTREE :: VALUE INDEX
+    * The same search over the values in a leaf. Only when the
+    * values are the keys are they side by side for SIMD: a
+    * map's leaves hold pairs, and get a binary search.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K>
+   size_t BTree<T, C, A, N>::valueIndex(Leaf* pLeaf, const K& k, bool upper) const
+   {
+      const T* values = pLeaf->values();
+      if constexpr (simdSearch<K> && std::is_same<T, key_type>::value)
+         return upper ? key_upper_bound(values, pLeaf->n, searchKey(k))
+                      : key_lower_bound(values, pLeaf->n, searchKey(k));
+
+      size_t lo = 0;
+      size_t hi = pLeaf->n;
+      while (lo < hi)
+      {
+         size_t mid = lo + (hi - lo) / 2;
+         if (upper ? !this->compare()(k, values[mid]) : this->compare()(values[mid], k))
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   /****************************************************
+    * BTREE :: CHILD INDEX
+    * Where pChild is among pInner's children
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   size_t BTree<T, C, A, N>::childIndex(Inner* pInner, const Node* pChild) noexcept
+   {
+      size_t i = 0;
+      while (pInner->children[i] != pChild)
+         i++;
+      assert(i <= pInner->n);
+      return i;
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT
+    * Insert a value at its correct (sorted) location
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insert(const T& t, bool keepUnique)
+   {
+      return insertKey(t, keepUnique, t);
+   }
+
+   template <typename T, typename C, typename A, std::size_t N>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insert(T&& t, bool keepUnique)
+   {
+      return insertKey(t, keepUnique, std::move(t));
+   }
+
+   /*****************************************************
+    * BTREE :: EMPLACE
+    * The key is inside the value, so build the value first.
+    * It is moved into the leaf once its place is known.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename ... Args>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::emplace(bool keepUnique, Args&& ... args)
+   {
+      T t(std::forward<Args>(args)...);
+      return insertKey(t, keepUnique, std::move(t));
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT WITH HINT
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insert(const iterator& hint, const T& t,
+                                                                                    bool keepUnique)
+   {
+      return insertHint(hint, t, keepUnique, t);
+   }
+
+   template <typename T, typename C, typename A, std::size_t N>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insert(const iterator& hint, T&& t,
+                                                                                    bool keepUnique)
+   {
+      return insertHint(hint, t, keepUnique, std::move(t));
+   }
+
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename ... Args>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::emplace_hint(const iterator& hint,
+                                                                                          bool keepUnique,
+                                                                                          Args&& ... args)
+   {
+      T t(std::forward<Args>(args)...);
+      return insertHint(hint, t, keepUnique, std::move(t));
+   }
+
+   /*****************************************************
+    * BTREE :: EMPLACE KEY
+    * Search by key alone; only when it is missing build
+    * the value from args, right in its slot
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K, typename ... Args>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::emplaceKey(const K& k, Args&& ... args)
+   {
+      return insertKey(k, /*keepUnique: */true, std::forward<Args>(args)...);
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT KEY
+    * Find the slot for k and, unless an equivalent value is
+    * there and keepUnique, build the value from args in it.
+    * Equivalent values go after each other.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename K, typename ... Args>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insertKey(const K& k, bool keepUnique,
+                                                                                       Args&& ... args)
+   {
+      if (!root)
+      {
+         root = pFirst = pLast = newLeaf();
+         return { insertAt(pFirst, 0, std::forward<Args>(args)...), true };
+      }
+
+      Leaf* pLeaf = descend(k, /*upper: */!keepUnique);
+      size_t i = valueIndex(pLeaf, k, /*upper: */!keepUnique);
+
+      if (keepUnique)
+      {
+         // the first value that does not go before k, maybe in the next leaf
+         iterator it(pLeaf, i);
+         if (i == pLeaf->n)
+            it = iterator(pLeaf->pNext, 0);
+         if (it.pLeaf && !this->compare()(k, *it))
+            return { it, false };
+      }
+
+      return { insertAt(pLeaf, i, std::forward<Args>(args)...), true };
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT HINT
+    * Like the BST: when k fits between hint and the value
+    * before it, or between hint and the value after it, it
+    * goes into hint's leaf with no descent. At the edge of a
+    * leaf the separator above may need to move to let it in.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename ... Args>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insertHint(const iterator& hint, const T& k,
+                                                                                        bool keepUnique, Args&& ... args)
+   {
+      if (!root)
+         return insertKey(k, keepUnique, std::forward<Args>(args)...);
+
+      const C& comp = this->compare();
+      iterator itHint = hint.pLeaf ? hint : iterator(pLast, pLast->n);   // end(): after the last value
+      Leaf* pLeaf = itHint.pLeaf;
+      size_t i = itHint.slot;
+      const T* pAt = i < pLeaf->n ? &pLeaf->values()[i] : nullptr;
+
+      // does k go before the hint? Everything goes before end().
+      if (!pAt || (keepUnique ? comp(k, *pAt) : !comp(*pAt, k)))
+      {
+         iterator itPrev = itHint;
+         if (i == 0)
+            itPrev = iterator(pLeaf->pPrev, pLeaf->pPrev ? pLeaf->pPrev->n - 1 : 0);
+         else
+            itPrev.slot--;
+
+         // ... and after the one before it?
+         if (!itPrev.pLeaf || (keepUnique ? comp(*itPrev, k) : !comp(k, *itPrev)))
+         {
+            if (i == 0 && itPrev.pLeaf)
+               setLowerBound(pLeaf, key_of<T>::get(k));
+            return { insertAt(pLeaf, i, std::forward<Args>(args)...), true };
+         }
+      }
+      else if (keepUnique && !comp(*pAt, k))
+         return { itHint, false };            // neither goes before the other
+      else
+      {
+         // k goes after the hint: does it go before the one after it?
+         iterator itNext = itHint;
+         ++itNext;
+         if (!itNext.pLeaf || (keepUnique ? comp(k, *itNext) : !comp(*itNext, k)))
+         {
+            if (i + 1 == pLeaf->n && itNext.pLeaf)
+               setUpperBound(pLeaf, key_of<T>::get(k));
+            return { insertAt(pLeaf, i + 1, std::forward<Args>(args)...), true };
+         }
+      }
+
+      // a bad hint: search from the root
+      return insertKey(k, keepUnique, std::forward<Args>(args)...);
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT AT
+    * Build a value from args in slot i of pLeaf, splitting
+    * the leaf first when it is full
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename ... Args>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::insertAt(Leaf* pLeaf, size_t i, Args&& ... args)
+   {
+      if (pLeaf->n == N)
+      {
+         splitLeaf(pLeaf);
+         if (i > pLeaf->n)
+         {
+            i -= pLeaf->n;
+            pLeaf = pLeaf->pNext;
+         }
+      }
+
+      insertSlot(alloc, pLeaf->values(), pLeaf->n, i, std::forward<Args>(args)...);
+      pLeaf->n++;
+      numElements++;
+      return iterator(pLeaf, i);
+   }
+
+   /*****************************************************
+    * BTREE :: SPLIT LEAF
+    * Move the top half of a full leaf into a new leaf to
+    * its right, with the new leaf's first key above them.
+    * Everything that can throw (the nodes, the key copy)
+    * happens before the first value moves.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::splitLeaf(Leaf* pLeaf)
+   {
+      size_t half = pLeaf->n / 2;
+      key_type key(key_of<T>::get(pLeaf->values()[half]));
+
+      // one inner node for every full ancestor, and a root if they all are
+      size_t numInner = 0;
+      Inner* pAbove = pLeaf->pParent;
+      for (; pAbove && pAbove->n == N; pAbove = pAbove->pParent)
+         numInner++;
+      if (!pAbove)
+         numInner++;
+
+      Leaf* pRight = newLeaf();
+      Inner* pSpare = nullptr;
+      try
+      {
+         for (size_t j = 0; j < numInner; j++)
+         {
+            Inner* pInner = newInner();
+            pInner->children[0] = pSpare;
+            pSpare = pInner;
+         }
+      }
+      catch (...)
+      {
+         while (pSpare)
+         {
+            Inner* pNext = static_cast<Inner*>(pSpare->children[0]);
+            pSpare->n = 0;
+            deleteInner(pSpare);
+            pSpare = pNext;
+         }
+         deleteLeaf(pRight);
+         throw;
+      }
+
+      moveSlots(alloc, pLeaf->values() + half, pLeaf->n - half, pRight->values());
+      pRight->n = pLeaf->n - half;
+      pLeaf->n = half;
+
+      pRight->pPrev = pLeaf;
+      pRight->pNext = pLeaf->pNext;
+      if (pRight->pNext)
+         pRight->pNext->pPrev = pRight;
+      else
+         pLast = pRight;
+      pLeaf->pNext = pRight;
+
+      insertParent(pLeaf, std::move(key), pRight, pSpare);
+      assert(pSpare == nullptr);
+   }
+
+   /*****************************************************
+    * BTREE :: INSERT PARENT
+    * pRight was split off pLeft: put it and the key between
+    * them in pLeft's parent, splitting that as needed. A
+    * split root grows the tree a level. New inner nodes come
+    * off pSpare, so nothing here throws.
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::insertParent(Node* pLeft, key_type&& key, Node* pRight, Inner*& pSpare) noexcept
+   {
+      KeyAlloc keyAlloc(alloc);
+      Inner* pParent = pLeft->pParent;
+      if (!pParent)
+      {
+         root = pParent = takeSpare(pSpare);
+         pParent->children[0] = pLeft;
+         pLeft->pParent = pParent;
+         height++;
+      }
+
+      size_t i = childIndex(pParent, pLeft);
+      if (pParent->n == N)
+      {
+         // the top half of the keys and children go to a new node, and
+         // the key in the middle goes up between the two. Split so both
+         // come out half full once the new key is in.
+         Inner* pSplit = takeSpare(pSpare);
+         size_t half = N / 2;
+         if (i == half)
+         {
+            // the new key is the one in the middle
+            moveSlots(keyAlloc, pParent->keys() + half, N - half, pSplit->keys());
+            pSplit->children[0] = pRight;
+            pRight->pParent = pSplit;
+            for (size_t j = half + 1; j <= N; j++)
+            {
+               pSplit->children[j - half] = pParent->children[j];
+               pParent->children[j]->pParent = pSplit;
+            }
+            pSplit->n = N - half;
+            pParent->n = half;
+            insertParent(pParent, std::move(key), pSplit, pSpare);
+            return;
+         }
+
+         size_t mid = (i < half) ? half - 1 : half;
+         moveSlots(keyAlloc, pParent->keys() + mid + 1, N - mid - 1, pSplit->keys());
+         for (size_t j = mid + 1; j <= N; j++)
+         {
+            pSplit->children[j - mid - 1] = pParent->children[j];
+            pParent->children[j]->pParent = pSplit;
+         }
+         pSplit->n = N - mid - 1;
+         pParent->n = mid;
+
+         key_type middle(std::move(pParent->keys()[mid]));
+         KeyTraits::destroy(keyAlloc, pParent->keys() + mid);
+         insertParent(pParent, std::move(middle), pSplit, pSpare);
+
+         if (i > mid)
+         {
+            i -= mid + 1;
+            pParent = pSplit;
+         }
+      }
+
+      insertSlot(keyAlloc, pParent->keys(), pParent->n, i, std::move(key));
+      for (size_t j = pParent->n + 1; j > i + 1; j--)
+         pParent->children[j] = pParent->children[j - 1];
+      pParent->children[i + 1] = pRight;
+      pRight->pParent = pParent;
+      pParent->n++;
+   }
+
+   /*****************************************************
+    * BTREE :: TAKE SPARE
+    * Pop an inner node off the list splitLeaf() allocated
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::Inner* BTree<T, C, A, N>::takeSpare(Inner*& pSpare) noexcept
+   {
+      Inner* pInner = pSpare;
+      assert(pInner);
+      pSpare = static_cast<Inner*>(pInner->children[0]);
+      return pInner;
+   }
+
+   /*****************************************************
+    * BTREE :: SET LOWER BOUND
+    * A hinted value goes first in pLeaf but after the whole
+    * leaf before it: lower the key that separates the two
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::setLowerBound(Leaf* pLeaf, const key_type& key)
+   {
+      Node* pNode = pLeaf;
+      while (pNode->pParent && pNode->pParent->children[0] == pNode)
+         pNode = pNode->pParent;
+      if (pNode->pParent)
+         pNode->pParent->keys()[childIndex(pNode->pParent, pNode) - 1] = key;
+   }
+
+   /*****************************************************
+    * BTREE :: SET UPPER BOUND
+    * A hinted value goes last in pLeaf but before the whole
+    * leaf after it: raise the key that separates the two
+    ****************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::setUpperBound(Leaf* pLeaf, const key_type& key)
+   {
+      Node* pNode = pLeaf;
+      while (pNode->pParent && pNode->pParent->children[pNode->pParent->n] == pNode)
+         pNode = pNode->pParent;
+      if (pNode->pParent)
+         pNode->pParent->keys()[childIndex(pNode->pParent, pNode)] = key;
+   }
+
+   /*************************************************
+    * BTREE :: ERASE
+    * Remove the value at it. A leaf left less than half
+    * full borrows from or merges with a sibling. Returns
+    * the value that came after it, wherever it moved.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::iterator BTree<T, C, A, N>::erase(iterator& it)
+   {
+      if (it == end())
+         return end();
+
+      Leaf* pLeaf = it.pLeaf;
+      eraseSlot(alloc, pLeaf->values(), pLeaf->n, it.slot);
+      pLeaf->n--;
+      numElements--;
+
+      Leaf* pPos = pLeaf;      // where the next value is: one past
+      size_t iPos = it.slot;   // the end means the next leaf
+
+      if (pLeaf == root)
+      {
+         if (pLeaf->n == 0)
+         {
+            deleteLeaf(pLeaf);
+            root = pFirst = pLast = nullptr;
+            return end();
+         }
+      }
+      else if (pLeaf->n < MIN)
+         rebalanceLeaf(pLeaf, pPos, iPos);
+
+      if (iPos == pPos->n)
+         return iterator(pPos->pNext, 0);
+      return iterator(pPos, iPos);
+   }
+
+   /*************************************************
+    * BTREE :: REBALANCE LEAF
+    * Take a value from a sibling that can spare one, or
+    * else merge with a sibling. (pPos, iPos) follows the
+    * value it points at as the values move.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::rebalanceLeaf(Leaf* pLeaf, Leaf*& pPos, size_t& iPos)
+   {
+      Inner* pParent = pLeaf->pParent;
+      size_t i = childIndex(pParent, pLeaf);
+      Leaf* pLeft  = i > 0          ? static_cast<Leaf*>(pParent->children[i - 1]) : nullptr;
+      Leaf* pRight = i < pParent->n ? static_cast<Leaf*>(pParent->children[i + 1]) : nullptr;
+
+      // borrow the last value of the left sibling
+      if (pLeft && pLeft->n > MIN)
+      {
+         T* pBorrow = pLeft->values() + pLeft->n - 1;
+         insertSlot(alloc, pLeaf->values(), pLeaf->n, 0, std::move(*pBorrow));
+         ValueTraits::destroy(alloc, pBorrow);
+         pLeft->n--;
+         pLeaf->n++;
+         pParent->keys()[i - 1] = key_of<T>::get(pLeaf->values()[0]);
+         if (pPos == pLeaf)
+            iPos++;
+         return;
+      }
+
+      // borrow the first value of the right sibling
+      if (pRight && pRight->n > MIN)
+      {
+         ValueTraits::construct(alloc, pLeaf->values() + pLeaf->n, std::move(pRight->values()[0]));
+         eraseSlot(alloc, pRight->values(), pRight->n, 0);
+         pRight->n--;
+         if (pPos == pRight)
+         {
+            if (iPos == 0)
+               pPos = pLeaf, iPos = pLeaf->n;
+            else
+               iPos--;
+         }
+         pLeaf->n++;
+         pParent->keys()[i] = key_of<T>::get(pRight->values()[0]);
+         return;
+      }
+
+      // merge into the left sibling, or the right sibling into this leaf
+      if (!pLeft)
+      {
+         pLeft = pLeaf;
+         pLeaf = pRight;
+         i++;
+      }
+      if (pPos == pLeaf)
+         pPos = pLeft, iPos += pLeft->n;
+      moveSlots(alloc, pLeaf->values(), pLeaf->n, pLeft->values() + pLeft->n);
+      pLeft->n += pLeaf->n;
+      pLeaf->n = 0;
+
+      pLeft->pNext = pLeaf->pNext;
+      if (pLeft->pNext)
+         pLeft->pNext->pPrev = pLeft;
+      else
+         pLast = pLeft;
+      deleteLeaf(pLeaf);
+
+      removeKey(pParent, i - 1);
+      rebalanceInner(pParent);
+   }
+
+   /*************************************************
+    * BTREE :: REBALANCE INNER
+    * The same for an inner node, rotating keys through the
+    * parent. A root with no keys left gives way to its
+    * only child and the tree shrinks a level.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::rebalanceInner(Inner* pInner)
+   {
+      KeyAlloc keyAlloc(alloc);
+
+      if (pInner == root)
+      {
+         if (pInner->n == 0)
+         {
+            root = pInner->children[0];
+            root->pParent = nullptr;
+            deleteInner(pInner);
+            height--;
+         }
+         return;
+      }
+      if (pInner->n >= MIN)
+         return;
+
+      Inner* pParent = pInner->pParent;
+      size_t i = childIndex(pParent, pInner);
+      Inner* pLeft  = i > 0          ? static_cast<Inner*>(pParent->children[i - 1]) : nullptr;
+      Inner* pRight = i < pParent->n ? static_cast<Inner*>(pParent->children[i + 1]) : nullptr;
+
+      // rotate right: the parent's key comes down, the left's last key goes up
+      if (pLeft && pLeft->n > MIN)
+      {
+         insertSlot(keyAlloc, pInner->keys(), pInner->n, 0, std::move(pParent->keys()[i - 1]));
+         for (size_t j = pInner->n + 1; j > 0; j--)
+            pInner->children[j] = pInner->children[j - 1];
+         pInner->children[0] = pLeft->children[pLeft->n];
+         pInner->children[0]->pParent = pInner;
+         pInner->n++;
+         pParent->keys()[i - 1] = std::move(pLeft->keys()[pLeft->n - 1]);
+         KeyTraits::destroy(keyAlloc, pLeft->keys() + pLeft->n - 1);
+         pLeft->n--;
+         return;
+      }
+
+      // rotate left: the parent's key comes down, the right's first key goes up
+      if (pRight && pRight->n > MIN)
+      {
+         KeyTraits::construct(keyAlloc, pInner->keys() + pInner->n, std::move(pParent->keys()[i]));
+         pInner->children[pInner->n + 1] = pRight->children[0];
+         pInner->children[pInner->n + 1]->pParent = pInner;
+         pInner->n++;
+         pParent->keys()[i] = std::move(pRight->keys()[0]);
+         eraseSlot(keyAlloc, pRight->keys(), pRight->n, 0);
+         for (size_t j = 0; j < pRight->n; j++)
+            pRight->children[j] = pRight->children[j + 1];
+         pRight->n--;
+         return;
+      }
+
+      // merge: left, the parent's key between, then right
+      if (!pLeft)
+      {
+         pLeft = pInner;
+         pInner = pRight;
+         i++;
+      }
+      KeyTraits::construct(keyAlloc, pLeft->keys() + pLeft->n, pParent->keys()[i - 1]);
+      moveSlots(keyAlloc, pInner->keys(), pInner->n, pLeft->keys() + pLeft->n + 1);
+      for (size_t j = 0; j <= pInner->n; j++)
+      {
+         pLeft->children[pLeft->n + 1 + j] = pInner->children[j];
+         pInner->children[j]->pParent = pLeft;
+      }
+      pLeft->n += pInner->n + 1;
+      pInner->n = 0;
+      deleteInner(pInner);
+
+      removeKey(pParent, i - 1);
+      rebalanceInner(pParent);
+   }
+
+   /*************************************************
+    * BTREE :: REMOVE KEY
+    * Take keys[i] and the child to its right out of an
+    * inner node
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::removeKey(Inner* pInner, size_t i)
+   {
+      KeyAlloc keyAlloc(alloc);
+      eraseSlot(keyAlloc, pInner->keys(), pInner->n, i);
+      for (size_t j = i + 1; j < pInner->n; j++)
+         pInner->children[j] = pInner->children[j + 1];
+      pInner->n--;
+   }
+
+   /*************************************************
+    * BTREE :: EXTRACT
+    * Move the value at it out of the tree into a handle
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::node_handle BTree<T, C, A, N>::extract(const iterator& it)
+   {
+      if (it == end())
+         return node_handle();
+
+      node_handle nh(std::move(data(it)), alloc);
+      iterator itErase(it);
+      erase(itErase);
+      return nh;
+   }
+
+   /*************************************************
+    * BTREE :: INSERT NODE HANDLE
+    * Move the value in a handle into the tree. The handle is
+    * emptied only when the value goes in: a duplicate (when
+    * keepUnique) stays with the caller.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   std::pair<typename BTree<T, C, A, N>::iterator, bool> BTree<T, C, A, N>::insert(node_handle&& nh, bool keepUnique)
+   {
+      if (nh.empty())
+         return { end(), false };
+
+      std::pair<iterator, bool> result = insertKey(nh.value(), keepUnique, std::move(nh.value()));
+      if (result.second)
+         nh.clear();
+      return result;
+   }
+
+   /*************************************************
+    * BTREE :: MERGE
+    * Move every value of src into this tree. When keepUnique,
+    * values that are already here stay in src.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::merge(BTree<T, C, A, N>& src, bool keepUnique)
+   {
+      if (&src == this)
+         return;
+
+      for (iterator it = src.begin(); it != src.end(); )
+      {
+         // the value is only moved from when it goes in
+         if (insertKey(*it, keepUnique, std::move(data(it))).second)
+            it = src.erase(it);
+         else
+            ++it;
+      }
+   }
+
+   /*************************************************
+    * BTREE :: CLEAR
+    * Delete every node and value
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::clear() noexcept
+   {
+      if (root)
+         destroy(root, height);
+      root = pFirst = pLast = nullptr;
+      height = 0;
+      numElements = 0;
+   }
+
+   /*************************************************
+    * BTREE :: DESTROY
+    * Delete the subtree at pNode, depth levels above the leaves
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::destroy(Node* pNode, size_t depth) noexcept
+   {
+      if (depth == 0)
+      {
+         deleteLeaf(static_cast<Leaf*>(pNode));
+         return;
+      }
+
+      Inner* pInner = static_cast<Inner*>(pNode);
+      for (size_t i = 0; i <= pInner->n; i++)
+         destroy(pInner->children[i], depth - 1);
+      deleteInner(pInner);
+   }
+
+   /*************************************************
+    * BTREE :: IS SORTED
+    * Is [first, last) in order? When strict, equivalent
+    * neighbors do not count as in order.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename Iterator>
+   bool BTree<T, C, A, N>::isSorted(Iterator first, Iterator last, bool strict) const
+   {
+      if (first == last)
+         return true;
+
+      for (Iterator prev = first++; first != last; prev = first++)
+         if (strict ? !this->compare()(*prev, *first) : this->compare()(*first, *prev))
+            return false;
+      return true;
+   }
+
+   /*************************************************
+    * BTREE :: BUILD SORTED
+    * Pack n sorted values into leaves as evenly as possible,
+    * then each level of inner nodes above them, in O(n) and
+    * with no comparisons. The tree must be empty.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename Iterator>
+   void BTree<T, C, A, N>::buildSorted(Iterator first, size_t n, unsigned threads)
+   {
+      assert(root == nullptr && numElements == 0);
+      if (n == 0)
+         return;
+
+      std::vector<Node*>  level;     // the nodes of the level just built
+      std::vector<Leaf*>  leftmost;  // the first leaf under each of them
+      std::vector<Inner*> inners;    // every inner node, to clean up after a throw
+      try
+      {
+         size_t numLeaves = (n + N - 1) / N;
+         level.reserve(numLeaves);
+         leftmost.reserve(numLeaves);
+         for (size_t j = 0; j < numLeaves; j++)
+         {
+            Leaf* pLeaf = newLeaf();
+            pLeaf->pPrev = pLast;
+            if (pLast)
+               pLast->pNext = pLeaf;
+            else
+               pFirst = pLeaf;
+            pLast = pLeaf;
+            level.push_back(pLeaf);
+            leftmost.push_back(pLeaf);
+         }
+
+         // leaf j holds the count(j) values from firstOf(j)
+         auto count = [n, numLeaves](size_t j) { return n / numLeaves + (j < n % numLeaves ? 1 : 0); };
+         auto firstOf = [n, numLeaves](size_t j) { return j * (n / numLeaves) + (j < n % numLeaves ? j : n % numLeaves); };
+
+         // the leaves are all there: with an iterator that can jump and an
+         // allocator that is safe to share, fill runs of them on threads
+         using category = typename std::iterator_traits<Iterator>::iterator_category;
+         if constexpr (std::is_base_of<std::random_access_iterator_tag, category>::value &&
+                       std::is_same<A, std::allocator<T>>::value)
+         {
+            size_t numTasks = (threads > 1 && n >= 2 * parallel_grain) ? size_t(4) * threads : 1;
+            if (numTasks > numLeaves)
+               numTasks = numLeaves;
+            parallel_tasks(numTasks, threads, [&](size_t t)
+            {
+               for (size_t j = t * numLeaves / numTasks; j < (t + 1) * numLeaves / numTasks; j++)
+               {
+                  Leaf* pLeaf = leftmost[j];
+                  for (Iterator it = first + firstOf(j); pLeaf->n < count(j); ++it)
+                  {
+                     ValueTraits::construct(alloc, pLeaf->values() + pLeaf->n, *it);
+                     pLeaf->n++;
+                  }
+               }
+            });
+         }
+         else
+         {
+            (void)firstOf;
+            (void)threads;
+            for (size_t j = 0; j < numLeaves; j++)
+               for (Leaf* pLeaf = leftmost[j]; pLeaf->n < count(j); ++first)
+               {
+                  ValueTraits::construct(alloc, pLeaf->values() + pLeaf->n, *first);
+                  pLeaf->n++;
+               }
+         }
+         numElements = n;
+
+         // N keys make N + 1 children a node
+         KeyAlloc keyAlloc(alloc);
+         for (; level.size() > 1; height++)
+         {
+            size_t numNodes = (level.size() + N) / (N + 1);
+            std::vector<Node*> above;
+            std::vector<Leaf*> aboveLeftmost;
+            above.reserve(numNodes);
+            aboveLeftmost.reserve(numNodes);
+
+            for (size_t j = 0, next = 0; j < numNodes; j++)
+            {
+               inners.push_back(nullptr);
+               Inner* pInner = inners.back() = newInner();
+               above.push_back(pInner);
+               aboveLeftmost.push_back(leftmost[next]);
+
+               size_t count = level.size() / numNodes + (j < level.size() % numNodes ? 1 : 0);
+               for (size_t c = 0; c < count; c++, next++)
+               {
+                  if (c > 0)
+                  {
+                     KeyTraits::construct(keyAlloc, pInner->keys() + pInner->n,
+                                          key_of<T>::get(leftmost[next]->values()[0]));
+                     pInner->n++;
+                  }
+                  pInner->children[c] = level[next];
+                  level[next]->pParent = pInner;
+               }
+            }
+            level.swap(above);
+            leftmost.swap(aboveLeftmost);
+         }
+         root = level[0];
+      }
+      catch (...)
+      {
+         for (Inner* pInner : inners)
+            if (pInner)
+               deleteInner(pInner);
+         while (pFirst)
+         {
+            Leaf* pNext = pFirst->pNext;
+            deleteLeaf(pFirst);
+            pFirst = pNext;
+         }
+         root = pLast = nullptr;
+         height = 0;
+         numElements = 0;
+         throw;
+      }
+   }
+
+   /*************************************************
+    * BTREE :: NEW LEAF, NEW INNER
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::Leaf* BTree<T, C, A, N>::newLeaf()
+   {
+      LeafAlloc leafAlloc(alloc);
+      Leaf* pLeaf = LeafTraits::allocate(leafAlloc, 1);
+      ::new (static_cast<void*>(pLeaf)) Leaf;
+      return pLeaf;
+   }
+
+   template <typename T, typename C, typename A, std::size_t N>
+   typename BTree<T, C, A, N>::Inner* BTree<T, C, A, N>::newInner()
+   {
+      InnerAlloc innerAlloc(alloc);
+      Inner* pInner = InnerTraits::allocate(innerAlloc, 1);
+      ::new (static_cast<void*>(pInner)) Inner;
+      return pInner;
+   }
+
+   /*************************************************
+    * BTREE :: DELETE LEAF, DELETE INNER
+    * Destroy what the node holds and free it
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::deleteLeaf(Leaf* pLeaf) noexcept
+   {
+      for (size_t i = 0; i < pLeaf->n; i++)
+         ValueTraits::destroy(alloc, pLeaf->values() + i);
+      pLeaf->~Leaf();
+      LeafAlloc leafAlloc(alloc);
+      LeafTraits::deallocate(leafAlloc, pLeaf, 1);
+   }
+
+   template <typename T, typename C, typename A, std::size_t N>
+   void BTree<T, C, A, N>::deleteInner(Inner* pInner) noexcept
+   {
+      KeyAlloc keyAlloc(alloc);
+      for (size_t i = 0; i < pInner->n; i++)
+         KeyTraits::destroy(keyAlloc, pInner->keys() + i);
+      pInner->~Inner();
+      InnerAlloc innerAlloc(alloc);
+      InnerTraits::deallocate(innerAlloc, pInner, 1);
+   }
+
+   /*************************************************
+    * BTREE :: INSERT SLOT
+    * Open slot i in the n constructed objects of v, shifting
+    * the rest up one, and build an object there from args.
+    * If that throws, the others are shifted back.
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename Alloc, typename X, typename ... Args>
+   void BTree<T, C, A, N>::insertSlot(Alloc& a, X* v, size_t n, size_t i, Args&& ... args)
+   {
+      using Traits = std::allocator_traits<Alloc>;
+      if (i == n)
+      {
+         Traits::construct(a, v + n, std::forward<Args>(args)...);
+         return;
+      }
+
+      Traits::construct(a, v + n, std::move(v[n - 1]));
+      for (size_t j = n - 1; j > i; j--)
+         v[j] = std::move(v[j - 1]);
+      Traits::destroy(a, v + i);
+      try
+      {
+         Traits::construct(a, v + i, std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+         Traits::construct(a, v + i, std::move(v[i + 1]));
+         for (size_t j = i + 1; j < n; j++)
+            v[j] = std::move(v[j + 1]);
+         Traits::destroy(a, v + n);
+         throw;
+      }
+   }
+
+   /*************************************************
+    * BTREE :: ERASE SLOT
+    * Destroy v[i] by shifting the rest down over it
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename Alloc, typename X>
+   void BTree<T, C, A, N>::eraseSlot(Alloc& a, X* v, size_t n, size_t i) noexcept
+   {
+      for (size_t j = i; j + 1 < n; j++)
+         v[j] = std::move(v[j + 1]);
+      std::allocator_traits<Alloc>::destroy(a, v + n - 1);
+   }
+
+   /*************************************************
+    * BTREE :: MOVE SLOTS
+    * Move n objects from src into the raw memory at dest,
+    * leaving src raw
+    ************************************************/
+   template <typename T, typename C, typename A, std::size_t N>
+   template <typename Alloc, typename X>
+   void BTree<T, C, A, N>::moveSlots(Alloc& a, X* src, size_t n, X* dest)
+   {
+      using Traits = std::allocator_traits<Alloc>;
+      for (size_t i = 0; i < n; i++)
+      {
+         Traits::construct(a, dest + i, std::move(src[i]));
+         Traits::destroy(a, src + i);
+      }
+   }
+
+} // namespace custom
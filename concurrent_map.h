@@ -0,0 +1,293 @@
+/***********************************************************************
+ * Header:
+ *    CONCURRENT MAP
+ * Summary:
+ *    A map many threads can read while one at a time writes, with no
+ *    lock on the read side. It keeps two copies of a custom::map and
+ *    uses the Left-Right scheme: readers always read the copy that
+ *    is not being written, a writer changes the other copy, turns the
+ *    readers onto it, waits for the readers still on the old copy to
+ *    finish, and then makes the same change there. A read costs two
+ *    atomic increments on a counter shared with few other threads;
+ *    it never waits for a writer, and it runs at the full speed of
+ *    the tree underneath.
+ *
+ *    The price is twice the memory and every change made twice, and
+ *    a writer that waits for the slowest reader in flight.
+ *
+ *    Memory ordering: a read that begins after a write returns sees
+ *    that write, and sees each write (or update() batch) either
+ *    entirely or not at all. Everything uses sequentially consistent
+ *    atomics.
+ *
+ *    This will contain the class definition of:
+ *        concurrent_map      : A class that represents a concurrent map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "map.h"             // for custom::map, the two copies
+#include <atomic>            // for std::atomic
+#include <cstddef>           // for std::size_t
+#include <functional>        // for std::hash
+#include <initializer_list>  // for std::initializer_list
+#include <mutex>             // for std::mutex
+#include <optional>          // for std::optional
+#include <thread>            // for std::this_thread
+#include <type_traits>       // for std::is_void
+#include <utility>           // for std::forward
+
+class TestConcurrentMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * READ INDICATOR
+ * How many readers are inside one side? A counter split across
+ * cache lines so that readers on different cores seldom touch
+ * the same one. A thread always uses the same slot.
+ *****************************************************************/
+   class read_indicator
+   {
+   public:
+      static constexpr std::size_t SLOTS = 16;
+
+      read_indicator()
+      {
+         for (slot& s : slots)
+            s.count.store(0);
+      }
+      read_indicator(const read_indicator&) = delete;
+      read_indicator& operator =(const read_indicator&) = delete;
+
+      void arrive() noexcept
+      {
+         slots[mySlot()].count.fetch_add(1);
+      }
+      void depart() noexcept
+      {
+         slots[mySlot()].count.fetch_sub(1);
+      }
+      bool empty() const noexcept
+      {
+         for (const slot& s : slots)
+            if (s.count.load() != 0)
+               return false;
+         return true;
+      }
+
+   private:
+      static std::size_t mySlot() noexcept
+      {
+         thread_local std::size_t i = std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+         return i;
+      }
+
+      struct alignas(64) slot
+      {
+         std::atomic<long> count;
+      };
+      slot slots[SLOTS];
+   };
+
+/*****************************************************************
+ * CONCURRENT MAP
+ * Readers: find(), at(), count(), contains(), visit_range() and
+ * read(f), which hands f the map to read. Nothing read escapes:
+ * lookups return copies, and what read(f) is given is good only
+ * until f returns.
+ *
+ * Writers: insert(), insert_or_assign(), erase(), clear() and
+ * update(f), which runs f on each copy in turn. f is called twice
+ * and must make the same change both times. If it throws the
+ * first time nothing has changed; if the second, the copy is
+ * reassigned from the first.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>,
+             class P = rb_default>
+   class concurrent_map
+   {
+      friend class ::TestConcurrentMap;
+   public:
+      using map_type = custom::map<K, V, C, A, P>;
+      using Pair = typename map_type::Pair;
+      using key_type = K;
+      using mapped_type = V;
+
+      //
+      // Construct
+      //
+      concurrent_map() : leftRight(0), versionIndex(0)
+      {}
+      explicit concurrent_map(const map_type& rhs)
+         : sides{ rhs, rhs }, leftRight(0), versionIndex(0)
+      {}
+      concurrent_map(const std::initializer_list<Pair>& il)
+         : sides{ map_type(il), map_type(il) }, leftRight(0), versionIndex(0)
+      {}
+      concurrent_map(const concurrent_map&) = delete;
+      concurrent_map& operator =(const concurrent_map&) = delete;
+
+      //
+      // Read
+      //
+      template <class F>
+      decltype(auto) read(F&& f) const
+      {
+         reader r(*this);
+         return std::forward<F>(f)(sides[leftRight.load()]);
+      }
+      std::optional<V> find(const K& k) const
+      {
+         // map::find() and map::end() change nothing; they are only
+         // not const because map's iterator is not
+         return read([&k](const map_type& m) -> std::optional<V>
+         {
+            map_type& mRead = const_cast<map_type&>(m);
+            auto it = mRead.find(k);
+            if (it == mRead.end())
+               return std::nullopt;
+            return (*it).second;
+         });
+      }
+      V at(const K& k) const
+      {
+         return read([&k](const map_type& m) -> V { return m.at(k); });
+      }
+      size_t count(const K& k) const
+      {
+         return read([&k](const map_type& m) { return m.count(k); });
+      }
+      bool contains(const K& k) const
+      {
+         return count(k) != 0;
+      }
+      template <class F>
+      void visit_range(const K& lo, const K& hi, F&& f) const
+      {
+         read([&](const map_type& m) { m.visit_range(lo, hi, f); });
+      }
+      size_t size() const
+      {
+         return read([](const map_type& m) { return m.size(); });
+      }
+      bool empty() const
+      {
+         return size() == 0;
+      }
+
+      //
+      // Write
+      //
+      template <class F>
+      decltype(auto) update(F&& f);
+      bool insert(const Pair& rhs)
+      {
+         return update([&rhs](map_type& m) { return m.insert(rhs).second; });
+      }
+      template <class M>
+      bool insert_or_assign(const K& k, M&& obj)
+      {
+         return update([&](map_type& m) { return m.insert_or_assign(k, obj).second; });
+      }
+      size_t erase(const K& k)
+      {
+         return update([&k](map_type& m) { return m.erase(k); });
+      }
+      void clear()
+      {
+         update([](map_type& m) { m.clear(); });
+      }
+
+   private:
+
+      // a read in progress on whichever side versionIndex names
+      class reader
+      {
+      public:
+         reader(const concurrent_map& cm) : indicator(cm.indicators[cm.versionIndex.load()])
+         {
+            indicator.arrive();
+         }
+         ~reader()
+         {
+            indicator.depart();
+         }
+      private:
+         read_indicator& indicator;
+      };
+
+      void toggleVersionAndWait();
+
+      map_type                    sides[2];       // the two copies
+      std::atomic<int>            leftRight;      // the copy readers read
+      std::atomic<int>            versionIndex;   // the indicator readers arrive at
+      mutable read_indicator      indicators[2];  // readers arrived at each version
+      std::mutex                  writer;         // one writer at a time
+   };
+
+   /*****************************************************
+    * CONCURRENT MAP :: UPDATE
+    * Change the copy nobody reads, send new readers to it,
+    * wait out the readers of the other copy, change that
+    * one too. Returns what f returned the first time.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   template <class F>
+   decltype(auto) concurrent_map<K, V, C, A, P>::update(F&& f)
+   {
+      std::lock_guard<std::mutex> lock(writer);
+      int lr = leftRight.load();
+
+      // readers are all on sides[lr]: sides[1 - lr] is ours
+      using R = decltype(f(sides[1 - lr]));
+      auto second = [&]()
+      {
+         leftRight.store(1 - lr);
+         toggleVersionAndWait();
+         try
+         {
+            f(sides[lr]);
+         }
+         catch (...)
+         {
+            sides[lr] = sides[1 - lr];
+            throw;
+         }
+      };
+
+      if constexpr (std::is_void<R>::value)
+      {
+         f(sides[1 - lr]);
+         second();
+      }
+      else
+      {
+         R result = f(sides[1 - lr]);
+         second();
+         return result;
+      }
+   }
+
+   /*****************************************************
+    * CONCURRENT MAP :: TOGGLE VERSION AND WAIT
+    * Readers that arrived before leftRight moved may still
+    * be on the old copy. Drain the idle indicator, switch
+    * new readers to it, then drain the one they left.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void concurrent_map<K, V, C, A, P>::toggleVersionAndWait()
+   {
+      int prev = versionIndex.load();
+      int next = 1 - prev;
+      while (!indicators[next].empty())
+         std::this_thread::yield();
+      versionIndex.store(next);
+      while (!indicators[prev].empty())
+         std::this_thread::yield();
+   }
+
+}; //  namespace custom
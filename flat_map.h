@@ -0,0 +1,879 @@
+/***********************************************************************
+ * Header:
+ *    FLAT MAP
+ * Summary:
+ *    A map kept as two sorted arrays, one of keys and one of values,
+ *    with the interface of custom::map. There are no nodes: an entry
+ *    costs its key and its value and nothing else, a lookup is a
+ *    binary search (SIMD for arithmetic keys) over the keys alone,
+ *    and a scan walks contiguous memory. The price is that inserting
+ *    or erasing in the middle shifts everything after it, so build
+ *    in bulk with insert(first, last) and then read.
+ *
+ *    This will contain the class definition of:
+ *        flat_map            : A class that represents a flat map
+ *        flat_map::iterator  : An iterator through a flat map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "bst.h"             // for custom::compare_base
+#include "map.h"             // for custom::map, to convert to and from
+#include "search.h"          // for custom::key_lower_bound
+#include <algorithm>         // for std::lower_bound and std::stable_sort
+#include <initializer_list>  // for std::initializer_list
+#include <iterator>          // for std::bidirectional_iterator_tag
+#include <memory>            // for std::allocator_traits
+#include <stdexcept>         // for std::out_of_range
+#include <tuple>             // for std::forward_as_tuple
+#include <utility>           // for std::pair
+#include <vector>            // for std::vector
+
+class TestFlatMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * FLAT MAP
+ * Keys and values in two arrays side by side: keys[i] goes with
+ * values[i], and the keys are sorted and unique. A is an allocator
+ * of pairs, as for map, rebound for the two arrays.
+ *
+ * As with a vector, inserting and erasing invalidate iterators.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>>
+   class flat_map : private compare_base<C>
+   {
+      friend class ::TestFlatMap;
+
+      template <class KK, class VV, class CC, class AA>
+      friend void swap(flat_map<KK, VV, CC, AA>& lhs, flat_map<KK, VV, CC, AA>& rhs);
+   public:
+      using Pair = custom::pair<K, V>;
+      using key_type = K;
+      using mapped_type = V;
+      using key_compare = C;
+      using allocator_type = A;
+      using key_container_type   = std::vector<K, typename std::allocator_traits<A>::template rebind_alloc<K>>;
+      using mapped_container_type = std::vector<V, typename std::allocator_traits<A>::template rebind_alloc<V>>;
+
+      //
+      // Construct
+      //
+      flat_map() : compare_base<C>(C())
+      {}
+      explicit flat_map(const C& comp, const A& alloc = A())
+         : compare_base<C>(comp), keySlots(alloc), valueSlots(alloc)
+      {}
+      explicit flat_map(const A& alloc)
+         : compare_base<C>(C()), keySlots(alloc), valueSlots(alloc)
+      {}
+      flat_map(const flat_map& rhs) = default;
+      flat_map(flat_map&& rhs) = default;
+      template <class Iterator>
+      flat_map(Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : flat_map(comp, alloc)
+      {
+         insert(first, last);
+      }
+      flat_map(const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : flat_map(comp, alloc)
+      {
+         insert(il);
+      }
+      template <class Iterator>
+      flat_map(sorted_unique_t, Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : flat_map(comp, alloc)
+      {
+         insertSorted(first, last, /*trusted: */true);
+      }
+      flat_map(sorted_unique_t, const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : flat_map(comp, alloc)
+      {
+         insertSorted(il.begin(), il.end(), /*trusted: */true);
+      }
+
+      // from a map: its pairs are already sorted and unique, so this
+      // is one pass of appends and no comparisons
+      template <class AA, class PP>
+      explicit flat_map(const map<K, V, C, AA, PP>& rhs);
+
+      //
+      // Assign
+      //
+      flat_map& operator =(const flat_map& rhs) = default;
+      flat_map& operator =(flat_map&& rhs) = default;
+      flat_map& operator =(const std::initializer_list<Pair>& il)
+      {
+         clear();
+         insert(il);
+         return *this;
+      }
+
+      // to a map: built bottom up in O(n), with no comparisons
+      template <class AA, class PP>
+      explicit operator map<K, V, C, AA, PP>() const;
+
+      //
+      // Iterator
+      //
+      class iterator;
+      iterator begin()
+      {
+         return iterator(this, 0);
+      }
+      iterator rbegin()
+      {
+         // the last pair: walk it back with --
+         return iterator(this, empty() ? size() : size() - 1);
+      }
+      iterator end()
+      {
+         return iterator(this, size());
+      }
+
+      //
+      // Access
+      //
+      const V& operator [] (const K& k) const;
+      V& operator [] (const K& k);
+      V& operator [] (K&& k);
+      const V& at (const K& k) const;
+      V& at (const K& k);
+      iterator find(const K& k)
+      {
+         return iterator(this, findIndex(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      const V& at(const KK& k) const
+      {
+         return atKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      V& at(const KK& k)
+      {
+         return atKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator find(const KK& k)
+      {
+         return iterator(this, findIndex(k));
+      }
+
+      // ordered queries, as for map
+      iterator lower_bound(const K& k)
+      {
+         return iterator(this, lowerIndex(k));
+      }
+      iterator upper_bound(const K& k)
+      {
+         return iterator(this, upperIndex(k));
+      }
+      custom::pair<iterator, iterator> equal_range(const K& k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator lower_bound(const KK& k)
+      {
+         return iterator(this, lowerIndex(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator upper_bound(const KK& k)
+      {
+         return iterator(this, upperIndex(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      custom::pair<iterator, iterator> equal_range(const KK& k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+
+      // call f(key, value) for every key in [lo, hi), in order
+      template <class F>
+      void visit_range(const K& lo, const K& hi, F&& f) const
+      {
+         visitRange(lo, hi, f);
+      }
+      template <class KK, class F, class CC = C, class = typename CC::is_transparent>
+      void visit_range(const KK& lo, const KK& hi, F&& f) const
+      {
+         visitRange(lo, hi, f);
+      }
+
+      // the arrays themselves, in order
+      const key_container_type&    keys()   const noexcept { return keySlots;   }
+      const mapped_container_type& values() const noexcept { return valueSlots; }
+
+      //
+      // Insert
+      //
+      custom::pair<iterator, bool> insert(Pair&& rhs)
+      {
+         return tryEmplace(std::move(rhs.first), std::move(rhs.second));
+      }
+      custom::pair<iterator, bool> insert(const Pair& rhs)
+      {
+         return tryEmplace(rhs.first, rhs.second);
+      }
+
+      // with a hint: no search when the key goes right before hint
+      iterator insert(iterator hint, Pair&& rhs)
+      {
+         return insertHint(hint, std::move(rhs.first), std::move(rhs.second));
+      }
+      iterator insert(iterator hint, const Pair& rhs)
+      {
+         return insertHint(hint, rhs.first, rhs.second);
+      }
+
+      template <class M>
+      custom::pair<iterator, bool> insert_or_assign(const K& k, M&& obj)
+      {
+         return insertOrAssign(k, std::forward<M>(obj));
+      }
+      template <class M>
+      custom::pair<iterator, bool> insert_or_assign(K&& k, M&& obj)
+      {
+         return insertOrAssign(std::move(k), std::forward<M>(obj));
+      }
+
+      //
+      // Emplace: the key and value go into their arrays separately,
+      // so the pair is built first and taken apart
+      //
+      template <class ... Args>
+      custom::pair<iterator, bool> emplace(Args&& ... args)
+      {
+         return insert(Pair(std::forward<Args>(args)...));
+      }
+      template <class ... Args>
+      iterator emplace_hint(iterator hint, Args&& ... args)
+      {
+         return insert(hint, Pair(std::forward<Args>(args)...));
+      }
+      template <class ... Args>
+      custom::pair<iterator, bool> try_emplace(const K& k, Args&& ... args)
+      {
+         return tryEmplace(k, std::forward<Args>(args)...);
+      }
+      template <class ... Args>
+      custom::pair<iterator, bool> try_emplace(K&& k, Args&& ... args)
+      {
+         return tryEmplace(std::move(k), std::forward<Args>(args)...);
+      }
+
+      // a whole range at once: sorted, then merged in one pass
+      template <class Iterator>
+      void insert(Iterator first, Iterator last)
+      {
+         insertSorted(first, last, /*trusted: */false);
+      }
+      void insert(const std::initializer_list<Pair>& il)
+      {
+         insertSorted(il.begin(), il.end(), /*trusted: */false);
+      }
+
+      // move in every pair of src whose key is not here yet
+      void merge(flat_map& src);
+      void merge(flat_map&& src)
+      {
+         merge(src);
+      }
+
+      //
+      // Remove
+      //
+      void clear() noexcept
+      {
+         keySlots.clear();
+         valueSlots.clear();
+      }
+      size_t   erase(const K& k)
+      {
+         return eraseKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t   erase(const KK& k)
+      {
+         return eraseKey(k);
+      }
+      iterator erase(iterator it);
+      iterator erase(iterator first, iterator last);
+
+      //
+      // Status
+      //
+      bool empty() const noexcept
+      {
+         return size() == 0;
+      }
+      size_t size() const noexcept
+      {
+         return keySlots.size();
+      }
+      void reserve(size_t n)
+      {
+         keySlots.reserve(n);
+         valueSlots.reserve(n);
+      }
+      size_t count(const K& k) const
+      {
+         return findIndex(k) != size() ? 1 : 0;
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t count(const KK& k) const
+      {
+         return findIndex(k) != size() ? 1 : 0;
+      }
+      allocator_type get_allocator() const
+      {
+         return allocator_type(keySlots.get_allocator());
+      }
+      key_compare key_comp() const
+      {
+         return this->compare();
+      }
+
+   private:
+
+      class pair_iterator;
+
+      template <class KK>
+      size_t lowerIndex(const KK& k) const;
+      template <class KK>
+      size_t upperIndex(const KK& k) const;
+      template <class KK>
+      size_t findIndex(const KK& k) const;
+      template <class KK, class F>
+      void visitRange(const KK& lo, const KK& hi, F& f) const;
+      template <class KK>
+      V& atKey(const KK& k) const;
+      template <class KK>
+      size_t eraseKey(const KK& k);
+      template <class KK, class ... Args>
+      iterator insertAt(size_t i, KK&& k, Args&& ... args);
+      template <class KK, class ... Args>
+      custom::pair<iterator, bool> tryEmplace(KK&& k, Args&& ... args);
+      template <class KK, class M>
+      custom::pair<iterator, bool> insertOrAssign(KK&& k, M&& obj);
+      template <class KK, class VV>
+      iterator insertHint(iterator hint, KK&& k, VV&& v);
+      template <class Iterator>
+      void insertSorted(Iterator first, Iterator last, bool trusted);
+
+      key_container_type    keySlots;     // sorted, unique keys
+      mapped_container_type valueSlots;   // valueSlots[i] goes with keySlots[i]
+   };
+
+
+   /**********************************************************
+    * FLAT MAP PAIR ITERATOR
+    * Walks the arrays yielding pairs by value, for building a
+    * map out of them
+    *********************************************************/
+   template <class K, class V, class C, class A>
+   class flat_map<K, V, C, A>::pair_iterator
+   {
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Pair*;
+      using reference         = Pair;
+
+      pair_iterator(const flat_map* pMap, size_t i) : pMap(pMap), i(i)
+      {}
+
+      bool operator ==(const pair_iterator& rhs) const
+      {
+         return i == rhs.i;
+      }
+      bool operator !=(const pair_iterator& rhs) const
+      {
+         return i != rhs.i;
+      }
+      Pair operator *() const
+      {
+         return Pair(pMap->keySlots[i], pMap->valueSlots[i]);
+      }
+      pair_iterator& operator ++()
+      {
+         ++i;
+         return *this;
+      }
+      pair_iterator operator ++(int)
+      {
+         pair_iterator temp(*this);
+         ++i;
+         return temp;
+      }
+
+   private:
+
+      const flat_map* pMap;
+      size_t          i;
+   };
+
+
+   /**********************************************************
+    * FLAT MAP ITERATOR
+    * A position in the two arrays. Dereferencing gives a pair
+    * of references, since no pair is stored anywhere.
+    *********************************************************/
+   template <class K, class V, class C, class A>
+   class flat_map<K, V, C, A>::iterator
+   {
+      friend class ::TestFlatMap;
+      friend class flat_map<K, V, C, A>;
+   public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = void;
+      using reference         = std::pair<const K&, V&>;
+
+      //
+      // Construct
+      //
+      iterator() : pMap(nullptr), i(0)
+      {}
+      iterator(flat_map* pMap, size_t i) : pMap(pMap), i(i)
+      {}
+
+      //
+      // Compare
+      //
+      bool operator ==(const iterator& rhs) const
+      {
+         return pMap == rhs.pMap && i == rhs.i;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      //
+      // Access
+      //
+      reference operator *() const
+      {
+         return reference(pMap->keySlots[i], pMap->valueSlots[i]);
+      }
+
+      //
+      // Increment: back from the first pair is the end, as in map
+      //
+      iterator& operator ++()
+      {
+         ++i;
+         return *this;
+      }
+      iterator operator ++(int)
+      {
+         iterator temp(*this);
+         ++i;
+         return temp;
+      }
+      iterator& operator --()
+      {
+         i = (i == 0) ? pMap->size() : i - 1;
+         return *this;
+      }
+      iterator operator --(int postfix)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+
+      flat_map* pMap;   // the map whose arrays these are
+      size_t    i;      // index into both arrays
+   };
+
+
+   /*****************************************************
+    * FLAT MAP :: CONSTRUCT FROM MAP
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class AA, class PP>
+   flat_map<K, V, C, A>::flat_map(const map<K, V, C, AA, PP>& rhs)
+      : compare_base<C>(rhs.key_comp())
+   {
+      reserve(rhs.size());
+      for (auto it = rhs.bst.begin(); it != rhs.bst.end(); ++it)
+      {
+         keySlots.push_back((*it).first);
+         valueSlots.push_back((*it).second);
+      }
+   }
+
+   /*****************************************************
+    * FLAT MAP :: CONVERT TO MAP
+    * Pairs made on the fly from the arrays feed the sorted
+    * bulk build, so the map is built with no comparisons
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class AA, class PP>
+   flat_map<K, V, C, A>::operator map<K, V, C, AA, PP>() const
+   {
+      return map<K, V, C, AA, PP>(sorted_unique, pair_iterator(this, 0), pair_iterator(this, size()),
+                                  key_comp());
+   }
+
+   /*****************************************************
+    * FLAT MAP :: LOWER INDEX
+    * Index of the first key that does not go before k.
+    * With arithmetic keys and std::less, this compares the
+    * keys a vector at a time.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t flat_map<K, V, C, A>::lowerIndex(const KK& k) const
+   {
+      if constexpr (simd_keys<C, K>::value && std::is_same<KK, K>::value)
+         return key_lower_bound(keySlots.data(), keySlots.size(), k);
+      else
+         return std::lower_bound(keySlots.begin(), keySlots.end(), k, this->compare()) - keySlots.begin();
+   }
+
+   /*****************************************************
+    * FLAT MAP :: UPPER INDEX
+    * Index of the first key that goes after k
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t flat_map<K, V, C, A>::upperIndex(const KK& k) const
+   {
+      if constexpr (simd_keys<C, K>::value && std::is_same<KK, K>::value)
+         return key_upper_bound(keySlots.data(), keySlots.size(), k);
+      else
+         return std::upper_bound(keySlots.begin(), keySlots.end(), k, this->compare()) - keySlots.begin();
+   }
+
+   /*****************************************************
+    * FLAT MAP :: VISIT RANGE
+    * Both ends are found by search, so the walk between them
+    * compares nothing
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK, class F>
+   void flat_map<K, V, C, A>::visitRange(const KK& lo, const KK& hi, F& f) const
+   {
+      size_t last = lowerIndex(hi);
+      for (size_t i = lowerIndex(lo); i < last; i++)
+         f(keySlots[i], valueSlots[i]);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: FIND INDEX
+    * Index of the key equivalent to k, or size()
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t flat_map<K, V, C, A>::findIndex(const KK& k) const
+   {
+      size_t i = lowerIndex(k);
+      if (i == size() || this->compare()(k, keySlots[i]))
+         return size();
+      return i;
+   }
+
+   /*****************************************************
+    * FLAT MAP :: INSERT AT
+    * Put k and a value built from args at index i of the
+    * arrays. If the value throws, the key comes back out.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK, class ... Args>
+   typename flat_map<K, V, C, A>::iterator flat_map<K, V, C, A>::insertAt(size_t i, KK&& k, Args&& ... args)
+   {
+      keySlots.insert(keySlots.begin() + i, std::forward<KK>(k));
+      try
+      {
+         valueSlots.emplace(valueSlots.begin() + i, std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+         keySlots.erase(keySlots.begin() + i);
+         throw;
+      }
+      return iterator(this, i);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: TRY EMPLACE
+    * Search by key alone and only touch args when it is missing
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK, class ... Args>
+   custom::pair<typename flat_map<K, V, C, A>::iterator, bool> flat_map<K, V, C, A>::tryEmplace(KK&& k,
+                                                                                                Args&& ... args)
+   {
+      size_t i = lowerIndex(k);
+      if (i != size() && !this->compare()(k, keySlots[i]))
+         return custom::make_pair(iterator(this, i), false);
+      return custom::make_pair(insertAt(i, std::forward<KK>(k), std::forward<Args>(args)...), true);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: INSERT OR ASSIGN
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK, class M>
+   custom::pair<typename flat_map<K, V, C, A>::iterator, bool> flat_map<K, V, C, A>::insertOrAssign(KK&& k, M&& obj)
+   {
+      size_t i = lowerIndex(k);
+      if (i != size() && !this->compare()(k, keySlots[i]))
+      {
+         valueSlots[i] = std::forward<M>(obj);
+         return custom::make_pair(iterator(this, i), false);
+      }
+      return custom::make_pair(insertAt(i, std::forward<KK>(k), std::forward<M>(obj)), true);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: INSERT HINT
+    * When k goes between the key before hint and hint, it
+    * goes in right there: O(1) search for an ascending stream
+    * hinted with end(). Otherwise search as usual.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK, class VV>
+   typename flat_map<K, V, C, A>::iterator flat_map<K, V, C, A>::insertHint(iterator hint, KK&& k, VV&& v)
+   {
+      const C& comp = this->compare();
+      size_t i = hint.i;
+      if ((i == size() || comp(k, keySlots[i])) && (i == 0 || comp(keySlots[i - 1], k)))
+         return insertAt(i, std::forward<KK>(k), std::forward<VV>(v));
+      return tryEmplace(std::forward<KK>(k), std::forward<VV>(v)).first;
+   }
+
+   /*****************************************************
+    * FLAT MAP :: INSERT SORTED
+    * Insert a range. The range is copied out, sorted by key
+    * (unless it already is), and cut down to the first pair
+    * of each key. Then one merge pass with the arrays builds
+    * the new arrays, keeping the pair already here when a key
+    * is in both. O(n + m log m) instead of O(n m) for m inserts.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class Iterator>
+   void flat_map<K, V, C, A>::insertSorted(Iterator first, Iterator last, bool trusted)
+   {
+      const C& comp = this->compare();
+      std::vector<Pair> run(first, last);
+      if (run.empty())
+         return;
+
+      auto less = [&comp](const Pair& lhs, const Pair& rhs) { return comp(lhs.first, rhs.first); };
+      if (!trusted)
+      {
+         if (!std::is_sorted(run.begin(), run.end(), less))
+            std::stable_sort(run.begin(), run.end(), less);
+         run.erase(std::unique(run.begin(), run.end(),
+                               [&comp](const Pair& lhs, const Pair& rhs) { return !comp(lhs.first, rhs.first); }),
+                   run.end());
+      }
+
+      key_container_type    keysMerged(keySlots.get_allocator());
+      mapped_container_type valuesMerged(valueSlots.get_allocator());
+      keysMerged.reserve(size() + run.size());
+      valuesMerged.reserve(size() + run.size());
+
+      size_t i = 0;
+      auto itRun = run.begin();
+      while (i < size() || itRun != run.end())
+      {
+         if (itRun == run.end() || (i < size() && comp(keySlots[i], itRun->first)))
+         {
+            keysMerged.push_back(std::move(keySlots[i]));
+            valuesMerged.push_back(std::move(valueSlots[i]));
+            i++;
+         }
+         else
+         {
+            if (i < size() && !comp(itRun->first, keySlots[i]))
+            {
+               // the key is already here: it keeps its value
+               keysMerged.push_back(std::move(keySlots[i]));
+               valuesMerged.push_back(std::move(valueSlots[i]));
+               i++;
+            }
+            else
+            {
+               keysMerged.push_back(std::move(itRun->first));
+               valuesMerged.push_back(std::move(itRun->second));
+            }
+            ++itRun;
+         }
+      }
+
+      keySlots.swap(keysMerged);
+      valueSlots.swap(valuesMerged);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: MERGE
+    * Like insert(first, last) over src, except that the pairs
+    * taken are moved, and the ones whose key is already here
+    * stay in src
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void flat_map<K, V, C, A>::merge(flat_map& src)
+   {
+      if (&src == this)
+         return;
+
+      const C& comp = this->compare();
+      key_container_type    keysMerged(keySlots.get_allocator());
+      mapped_container_type valuesMerged(valueSlots.get_allocator());
+      key_container_type    keysLeft(src.keySlots.get_allocator());
+      mapped_container_type valuesLeft(src.valueSlots.get_allocator());
+      keysMerged.reserve(size() + src.size());
+      valuesMerged.reserve(size() + src.size());
+
+      size_t i = 0;
+      size_t j = 0;
+      while (i < size() || j < src.size())
+      {
+         if (j == src.size() || (i < size() && comp(keySlots[i], src.keySlots[j])))
+         {
+            keysMerged.push_back(std::move(keySlots[i]));
+            valuesMerged.push_back(std::move(valueSlots[i]));
+            i++;
+         }
+         else if (i < size() && !comp(src.keySlots[j], keySlots[i]))
+         {
+            keysLeft.push_back(std::move(src.keySlots[j]));
+            valuesLeft.push_back(std::move(src.valueSlots[j]));
+            j++;
+         }
+         else
+         {
+            keysMerged.push_back(std::move(src.keySlots[j]));
+            valuesMerged.push_back(std::move(src.valueSlots[j]));
+            j++;
+         }
+      }
+
+      keySlots.swap(keysMerged);
+      valueSlots.swap(valuesMerged);
+      src.keySlots.swap(keysLeft);
+      src.valueSlots.swap(valuesLeft);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: SUBSCRIPT
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   V& flat_map<K, V, C, A>::operator [](const K& key)
+   {
+      return valueSlots[tryEmplace(key).first.i];
+   }
+
+   template <class K, class V, class C, class A>
+   V& flat_map<K, V, C, A>::operator [](K&& key)
+   {
+      return valueSlots[tryEmplace(std::move(key)).first.i];
+   }
+
+   template <class K, class V, class C, class A>
+   const V& flat_map<K, V, C, A>::operator [](const K& key) const
+   {
+      size_t i = findIndex(key);
+      if (i != size())
+         return valueSlots[i];
+      static const V vDefault{};
+      return vDefault;
+   }
+
+   /*****************************************************
+    * FLAT MAP :: AT
+    * Retrieve an element, throwing when it is missing
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   V& flat_map<K, V, C, A>::at(const K& key)
+   {
+      return atKey(key);
+   }
+
+   template <class K, class V, class C, class A>
+   const V& flat_map<K, V, C, A>::at(const K& key) const
+   {
+      return atKey(key);
+   }
+
+   template <class K, class V, class C, class A>
+   template <class KK>
+   V& flat_map<K, V, C, A>::atKey(const KK& k) const
+   {
+      size_t i = findIndex(k);
+      if (i != size())
+         return const_cast<V&>(valueSlots[i]);
+      throw std::out_of_range("invalid map<K, T> key");
+   }
+
+   /*****************************************************
+    * FLAT MAP :: ERASE
+    * Erase by key: 1 if it was there, 0 otherwise
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t flat_map<K, V, C, A>::eraseKey(const KK& k)
+   {
+      size_t i = findIndex(k);
+      if (i == size())
+         return 0;
+      keySlots.erase(keySlots.begin() + i);
+      valueSlots.erase(valueSlots.begin() + i);
+      return 1;
+   }
+
+   /*****************************************************
+    * FLAT MAP :: ERASE
+    * Erase one element. What came after it moves into its
+    * index, so the iterator returned is at the same index.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename flat_map<K, V, C, A>::iterator flat_map<K, V, C, A>::erase(iterator it)
+   {
+      if (it.i >= size())
+         return end();
+      keySlots.erase(keySlots.begin() + it.i);
+      valueSlots.erase(valueSlots.begin() + it.i);
+      return iterator(this, it.i);
+   }
+
+   /*****************************************************
+    * FLAT MAP :: ERASE
+    * Erase several elements, shifting the rest down once
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename flat_map<K, V, C, A>::iterator flat_map<K, V, C, A>::erase(iterator first, iterator last)
+   {
+      keySlots.erase(keySlots.begin() + first.i, keySlots.begin() + last.i);
+      valueSlots.erase(valueSlots.begin() + first.i, valueSlots.begin() + last.i);
+      return iterator(this, first.i);
+   }
+
+   /*****************************************************
+    * SWAP
+    * Swap two flat maps
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void swap(flat_map<K, V, C, A>& lhs, flat_map<K, V, C, A>& rhs)
+   {
+      using std::swap;
+      swap(static_cast<compare_base<C>&>(lhs), static_cast<compare_base<C>&>(rhs));
+      lhs.keySlots.swap(rhs.keySlots);
+      lhs.valueSlots.swap(rhs.valueSlots);
+   }
+
+}; //  namespace custom
@@ -0,0 +1,477 @@
+/***********************************************************************
+ * Header:
+ *    FROZEN MAP
+ * Summary:
+ *    A read-only map for lookups and nothing else. The keys are laid
+ *    out in Eytzinger order -- the breadth-first order of a complete
+ *    binary search tree, with the children of slot k at 2k and 2k+1
+ *    -- in one contiguous array. A search walks down that implicit
+ *    tree with no pointers and no branches on the keys, and the first
+ *    four levels or so share a handful of cache lines that stay hot,
+ *    while the next levels down can be prefetched while this one is
+ *    compared. Iteration still visits the keys in sorted order.
+ *
+ *    Build one from a map or flat_map once it is done changing.
+ *
+ *    This will contain the class definition of:
+ *        frozen_map            : A class that represents a frozen map
+ *        frozen_map::iterator  : An iterator through a frozen map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "bst.h"             // for custom::compare_base
+#include "map.h"             // for custom::map, to build from
+#include "flat_map.h"        // for custom::flat_map, to build from
+#include <algorithm>         // for std::stable_sort and std::unique
+#include <initializer_list>  // for std::initializer_list
+#include <iterator>          // for std::bidirectional_iterator_tag
+#include <memory>            // for std::allocator_traits
+#include <stdexcept>         // for std::out_of_range
+#include <utility>           // for std::pair
+#include <vector>            // for std::vector
+
+class TestFrozenMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * FROZEN MAP
+ * Keys and values in two arrays in Eytzinger order: slot k (counting
+ * from 1) holds the root of a subtree whose left half is under slot
+ * 2k and right half under 2k+1. Nothing can be inserted or erased;
+ * build a new one instead.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>>
+   class frozen_map : private compare_base<C>
+   {
+      friend class ::TestFrozenMap;
+   public:
+      using Pair = custom::pair<K, V>;
+      using key_type = K;
+      using mapped_type = V;
+      using key_compare = C;
+      using allocator_type = A;
+
+      //
+      // Construct
+      //
+      frozen_map() : compare_base<C>(C())
+      {}
+      frozen_map(const frozen_map& rhs) = default;
+      frozen_map(frozen_map&& rhs) = default;
+      template <class AA, class PP>
+      explicit frozen_map(const map<K, V, C, AA, PP>& rhs, const A& alloc = A());
+      template <class AA>
+      explicit frozen_map(const flat_map<K, V, C, AA>& rhs, const A& alloc = A());
+      template <class Iterator>
+      frozen_map(Iterator first, Iterator last, const C& comp = C(), const A& alloc = A());
+      frozen_map(const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : frozen_map(il.begin(), il.end(), comp, alloc)
+      {}
+
+      //
+      // Assign
+      //
+      frozen_map& operator =(const frozen_map& rhs) = default;
+      frozen_map& operator =(frozen_map&& rhs) = default;
+
+      //
+      // Iterator
+      //
+      class iterator;
+      iterator begin() const
+      {
+         return iterator(this, leftmost(1));
+      }
+      iterator rbegin() const
+      {
+         return iterator(this, rightmost(1));
+      }
+      iterator end() const
+      {
+         return iterator(this, 0);
+      }
+
+      //
+      // Access
+      //
+      const V& at(const K& k) const;
+      iterator find(const K& k) const
+      {
+         return iterator(this, findSlot(k));
+      }
+      iterator lower_bound(const K& k) const
+      {
+         return iterator(this, lowerSlot(k));
+      }
+      iterator upper_bound(const K& k) const
+      {
+         return iterator(this, upperSlot(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator find(const KK& k) const
+      {
+         return iterator(this, findSlot(k));
+      }
+
+      //
+      // Status
+      //
+      bool empty() const noexcept
+      {
+         return size() == 0;
+      }
+      size_t size() const noexcept
+      {
+         return keySlots.size();
+      }
+      size_t count(const K& k) const
+      {
+         return findSlot(k) != 0 ? 1 : 0;
+      }
+      allocator_type get_allocator() const
+      {
+         return allocator_type(keySlots.get_allocator());
+      }
+      key_compare key_comp() const
+      {
+         return this->compare();
+      }
+
+   private:
+
+      // slot k of the implicit tree is keySlots[k - 1]; slot 0 is the end
+      size_t leftmost(size_t k) const noexcept
+      {
+         if (k > size())
+            return 0;
+         while (2 * k <= size())
+            k = 2 * k;
+         return k;
+      }
+      size_t rightmost(size_t k) const noexcept
+      {
+         if (k > size())
+            return 0;
+         while (2 * k + 1 <= size())
+            k = 2 * k + 1;
+         return k;
+      }
+      size_t nextSlot(size_t k) const noexcept;
+      size_t prevSlot(size_t k) const noexcept;
+
+      template <class KK>
+      size_t lowerSlot(const KK& k) const noexcept;
+      template <class KK>
+      size_t upperSlot(const KK& k) const noexcept;
+      template <class KK>
+      size_t findSlot(const KK& k) const noexcept;
+
+      template <class KeyAt, class ValueAt>
+      void layout(size_t n, KeyAt keyAt, ValueAt valueAt);
+
+      static size_t afterDescent(size_t k) noexcept;
+
+      // keys a cache line holds: the subtree that many levels down
+      // from slot k starts at slot k * LINE
+      static constexpr size_t LINE = sizeof(K) < 64 ? 64 / sizeof(K) : 1;
+
+      std::vector<K, typename std::allocator_traits<A>::template rebind_alloc<K>> keySlots;
+      std::vector<V, typename std::allocator_traits<A>::template rebind_alloc<V>> valueSlots;
+   };
+
+
+   /**********************************************************
+    * FROZEN MAP ITERATOR
+    * A slot of the implicit tree, walked in order. Dereferencing
+    * gives a pair of references, since no pair is stored.
+    *********************************************************/
+   template <class K, class V, class C, class A>
+   class frozen_map<K, V, C, A>::iterator
+   {
+      friend class ::TestFrozenMap;
+   public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = void;
+      using reference         = std::pair<const K&, const V&>;
+
+      //
+      // Construct
+      //
+      iterator() : pMap(nullptr), k(0)
+      {}
+      iterator(const frozen_map* pMap, size_t k) : pMap(pMap), k(k)
+      {}
+
+      //
+      // Compare
+      //
+      bool operator ==(const iterator& rhs) const
+      {
+         return pMap == rhs.pMap && k == rhs.k;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      //
+      // Access
+      //
+      reference operator *() const
+      {
+         return reference(pMap->keySlots[k - 1], pMap->valueSlots[k - 1]);
+      }
+
+      //
+      // Increment: back from the first pair is the end, as in map
+      //
+      iterator& operator ++()
+      {
+         k = pMap->nextSlot(k);
+         return *this;
+      }
+      iterator operator ++(int postfix)
+      {
+         iterator temp(*this);
+         k = pMap->nextSlot(k);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         k = (k == 0) ? pMap->rightmost(1) : pMap->prevSlot(k);
+         return *this;
+      }
+      iterator operator --(int postfix)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+
+      const frozen_map* pMap;   // the map whose arrays these are
+      size_t            k;      // slot in the implicit tree, 0 for the end
+   };
+
+
+   /*****************************************************
+    * FROZEN MAP :: CONSTRUCT FROM MAP
+    * The tree already walks in order; point at each pair
+    * so the layout can visit them by rank
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class AA, class PP>
+   frozen_map<K, V, C, A>::frozen_map(const map<K, V, C, AA, PP>& rhs, const A& alloc)
+      : compare_base<C>(rhs.key_comp()), keySlots(alloc), valueSlots(alloc)
+   {
+      std::vector<const Pair*> sorted;
+      sorted.reserve(rhs.size());
+      for (auto it = rhs.bst.begin(); it != rhs.bst.end(); ++it)
+         sorted.push_back(&*it);
+      layout(sorted.size(),
+             [&sorted](size_t r) -> const K& { return sorted[r]->first;  },
+             [&sorted](size_t r) -> const V& { return sorted[r]->second; });
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: CONSTRUCT FROM FLAT MAP
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class AA>
+   frozen_map<K, V, C, A>::frozen_map(const flat_map<K, V, C, AA>& rhs, const A& alloc)
+      : compare_base<C>(rhs.key_comp()), keySlots(alloc), valueSlots(alloc)
+   {
+      layout(rhs.size(),
+             [&rhs](size_t r) -> const K& { return rhs.keys()[r];   },
+             [&rhs](size_t r) -> const V& { return rhs.values()[r]; });
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: CONSTRUCT FROM RANGE
+    * Sort by key and keep the first pair of each, as a map
+    * built from the same range would
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class Iterator>
+   frozen_map<K, V, C, A>::frozen_map(Iterator first, Iterator last, const C& comp, const A& alloc)
+      : compare_base<C>(comp), keySlots(alloc), valueSlots(alloc)
+   {
+      std::vector<Pair> sorted(first, last);
+      auto less = [&comp](const Pair& lhs, const Pair& rhs) { return comp(lhs.first, rhs.first); };
+      if (!std::is_sorted(sorted.begin(), sorted.end(), less))
+         std::stable_sort(sorted.begin(), sorted.end(), less);
+      sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                               [&comp](const Pair& lhs, const Pair& rhs) { return !comp(lhs.first, rhs.first); }),
+                   sorted.end());
+      layout(sorted.size(),
+             [&sorted](size_t r) -> K& { return sorted[r].first;  },
+             [&sorted](size_t r) -> V& { return sorted[r].second; });
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: LAYOUT
+    * Fill the slots from n pairs given by rank. An in-order
+    * walk of the empty slots says which rank each one gets;
+    * then the arrays fill front to back.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KeyAt, class ValueAt>
+   void frozen_map<K, V, C, A>::layout(size_t n, KeyAt keyAt, ValueAt valueAt)
+   {
+      // the walk needs size() to be n before anything is in the slots
+      std::vector<size_t> rankOf(n);
+      size_t r = 0;
+      for (size_t k = 1; k <= n; k *= 2)
+         r = k;                                    // the leftmost slot
+      for (size_t k = r, rank = 0; k != 0; rank++)
+      {
+         rankOf[k - 1] = rank;
+         if (2 * k + 1 <= n)
+         {
+            k = 2 * k + 1;
+            while (2 * k <= n)
+               k = 2 * k;
+         }
+         else
+            k = afterDescent(k);
+      }
+
+      keySlots.reserve(n);
+      valueSlots.reserve(n);
+      for (size_t k = 0; k < n; k++)
+      {
+         keySlots.push_back(std::move(keyAt(rankOf[k])));
+         valueSlots.push_back(std::move(valueAt(rankOf[k])));
+      }
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: NEXT SLOT
+    * In order: the leftmost of the right subtree, or else up
+    * past every right turn and then one more
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   size_t frozen_map<K, V, C, A>::nextSlot(size_t k) const noexcept
+   {
+      if (2 * k + 1 <= size())
+         return leftmost(2 * k + 1);
+      return afterDescent(k);
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: PREV SLOT
+    * The rightmost of the left subtree, or else up past every
+    * left turn and then one more: 0 from the first slot
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   size_t frozen_map<K, V, C, A>::prevSlot(size_t k) const noexcept
+   {
+      if (2 * k <= size())
+         return rightmost(2 * k);
+      while (k > 1 && !(k & 1))
+         k >>= 1;
+      return k >> 1;
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: AFTER DESCENT
+    * A descent ends below the slot it wants, having turned left
+    * there and right ever after: the low bits of k are those
+    * right turns (ones) and that left turn (a zero). Peel them
+    * off. Gives 0 when every turn was right.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   size_t frozen_map<K, V, C, A>::afterDescent(size_t k) noexcept
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+#else
+      while (k & 1)
+         k >>= 1;
+      return k >> 1;
+#endif
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: LOWER SLOT
+    * Slot of the first key that does not go before k, or 0.
+    * Every step goes left or right by the comparison alone,
+    * so the loop runs exactly the height of the tree with
+    * nothing to mispredict; the descendants LINE levels down
+    * are fetched while it runs.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t frozen_map<K, V, C, A>::lowerSlot(const KK& k) const noexcept
+   {
+      const C& comp = this->compare();
+      const K* keys = keySlots.data();
+      const size_t n = size();
+      size_t slot = 1;
+      while (slot <= n)
+      {
+         if (slot * LINE <= n)
+            prefetch(keys + slot * LINE - 1);
+         slot = 2 * slot + static_cast<size_t>(comp(keys[slot - 1], k));
+      }
+      return afterDescent(slot);
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: UPPER SLOT
+    * Slot of the first key that goes after k, or 0
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t frozen_map<K, V, C, A>::upperSlot(const KK& k) const noexcept
+   {
+      const C& comp = this->compare();
+      const K* keys = keySlots.data();
+      const size_t n = size();
+      size_t slot = 1;
+      while (slot <= n)
+      {
+         if (slot * LINE <= n)
+            prefetch(keys + slot * LINE - 1);
+         slot = 2 * slot + static_cast<size_t>(!comp(k, keys[slot - 1]));
+      }
+      return afterDescent(slot);
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: FIND SLOT
+    * Slot of the key equivalent to k, or 0
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class KK>
+   size_t frozen_map<K, V, C, A>::findSlot(const KK& k) const noexcept
+   {
+      size_t slot = lowerSlot(k);
+      if (slot == 0 || this->compare()(k, keySlots[slot - 1]))
+         return 0;
+      return slot;
+   }
+
+   /*****************************************************
+    * FROZEN MAP :: AT
+    * Retrieve an element, throwing when it is missing
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   const V& frozen_map<K, V, C, A>::at(const K& key) const
+   {
+      size_t slot = findSlot(key);
+      if (slot == 0)
+         throw std::out_of_range("invalid map<K, T> key");
+      return valueSlots[slot - 1];
+   }
+
+}; //  namespace custom
@@ -0,0 +1,845 @@
+/***********************************************************************
+ * Header:
+ *    JOURNAL
+ * Summary:
+ *    A map whose changes survive a crash. Every insert, erase, clear
+ *    and assignment through [] is appended to a write-ahead log as a
+ *    small binary record. The records go to the disk from a thread of
+ *    their own, a batch at a time (group commit): a write only adds
+ *    to a buffer, and one flush to the disk covers every write made
+ *    while the last one was in flight.
+ *
+ *    Now and then the whole map is written out as a checkpoint, in
+ *    the binary format of serialize.h, and the log starts over. The
+ *    map is copied on the caller's thread; finishing the old log,
+ *    starting the new one and writing the checkpoint are left to the
+ *    log's, so a checkpoint costs the service a copy and nothing
+ *    that waits on the disk. On
+ *    opening, the newest checkpoint and the logs after it are merged
+ *    as sorted runs and the map is built from them in O(n), with no
+ *    insert per record.
+ *
+ *    Files, for a path of "dir/name":
+ *        dir/name.<g>.ckpt   the map as of the start of generation g
+ *        dir/name.<g>.log    what changed during generation g
+ *    A log file, every number little-endian:
+ *        offset  0   "CLOG"               magic
+ *        offset  4   uint32  1            version
+ *        offset  8   uint32  sizeof(K)    key size
+ *        offset 12   uint32  sizeof(V)    value size
+ *        offset 16   uint64  g            generation
+ *        offset 24   batches, each:
+ *                        uint32  bytes    size of the records
+ *                        uint32  check    FNV-1a of the records
+ *                        records: uint8 op, the key, then the value
+ *                                 when op is put
+ *    A batch cut short by a crash fails its check, and it and
+ *    everything after it is ignored.
+ *
+ *    This will contain the definitions of:
+ *        journal_options       : How often to commit and checkpoint
+ *        journal_file          : A file appended to and synced to disk
+ *        journal_format        : The log layout above
+ *        journaled_map         : A map with a write-ahead log
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "map.h"             // for custom::map
+#include "serialize.h"       // for custom::serialize, map_view and mapped_file
+#include <algorithm>         // for std::stable_sort
+#include <chrono>            // for std::chrono::milliseconds
+#include <condition_variable> // for std::condition_variable
+#include <cstddef>           // for std::size_t
+#include <cstdint>           // for std::uint8_t, std::uint32_t and std::uint64_t
+#include <cstdio>            // for std::FILE
+#include <cstring>           // for std::memcpy
+#include <deque>             // for std::deque
+#include <exception>         // for std::exception_ptr
+#include <filesystem>        // for std::filesystem::directory_iterator
+#include <fstream>           // for std::ifstream
+#include <iterator>          // for std::istreambuf_iterator
+#include <memory>            // for std::unique_ptr
+#include <mutex>             // for std::mutex
+#include <sstream>           // for std::ostringstream
+#include <stdexcept>         // for std::runtime_error
+#include <string>            // for std::string
+#include <thread>            // for std::thread
+#include <vector>            // for std::vector
+
+#ifdef _WIN32
+#include <io.h>              // for _commit
+#else
+#include <unistd.h>          // for fsync
+#endif
+
+class TestJournal;
+
+namespace custom
+{
+
+/*****************************************************************
+ * JOURNAL OPTIONS
+ * How long a write may wait for the disk, and how long the log
+ * may grow before the map is checkpointed on its own
+ *****************************************************************/
+   struct journal_options
+   {
+      std::chrono::milliseconds commit_interval { 2 };  // a batch collects writes this long
+      std::size_t   commit_bytes     = 1 << 20;          // or until it is this big
+      std::uint64_t checkpoint_bytes = 64 << 20;         // log size that starts a checkpoint; 0: never
+   };
+
+/*****************************************************************
+ * JOURNAL FILE
+ * A file written front to back whose bytes can be pushed all the
+ * way to the disk with sync(). Throws std::runtime_error when the
+ * file cannot be created or written.
+ *****************************************************************/
+   class journal_file
+   {
+   public:
+      journal_file() : pFile(nullptr), numBytes(0)
+      {}
+      journal_file(const journal_file&) = delete;
+      journal_file& operator =(const journal_file&) = delete;
+      ~journal_file()
+      {
+         close();
+      }
+
+      void create(const std::string& path)
+      {
+         close();
+         pFile = std::fopen(path.c_str(), "wb");
+         if (!pFile)
+            throw std::runtime_error("cannot create " + path);
+         numBytes = 0;
+      }
+      void write(const void* p, std::size_t n)
+      {
+         if (n && std::fwrite(p, 1, n, pFile) != n)
+            throw std::runtime_error("cannot write the journal");
+         numBytes += n;
+      }
+      void sync()
+      {
+         if (std::fflush(pFile) != 0)
+            throw std::runtime_error("cannot write the journal");
+#ifdef _WIN32
+         if (_commit(_fileno(pFile)) != 0)
+#else
+         if (::fsync(::fileno(pFile)) != 0)
+#endif // _WIN32
+            throw std::runtime_error("cannot sync the journal");
+      }
+      void close() noexcept
+      {
+         if (pFile)
+            std::fclose(pFile);
+         pFile = nullptr;
+      }
+
+      std::uint64_t size() const noexcept { return numBytes; }
+
+   private:
+      std::FILE*    pFile;
+      std::uint64_t numBytes;   // written since create()
+   };
+
+/*****************************************************************
+ * JOURNAL FORMAT
+ * The log layout: its header, its records and the check on a
+ * batch. Numbers go through binary_format, so they are
+ * little-endian on every machine.
+ *****************************************************************/
+   template <class K, class V>
+   class journal_format
+   {
+      using format = binary_format<K, V>;
+   public:
+      enum op : std::uint8_t { PUT = 1, ERASE = 2, CLEAR = 3 };
+
+      static constexpr char          magic[4]    = { 'C', 'L', 'O', 'G' };
+      static constexpr std::uint32_t version     = 1;
+      static constexpr std::size_t   headerSize  = 24;
+      static constexpr std::size_t   batchHeader = 8;
+      static constexpr std::size_t   maxRecord   = 1 + sizeof(K) + sizeof(V);
+
+      // one change, as read back from a log
+      struct record
+      {
+         std::uint8_t op;
+         K key;
+         V value;
+      };
+
+      static void writeHeader(unsigned char* p, std::uint64_t generation)
+      {
+         std::memcpy(p, magic, 4);
+         format::store(p + 4,  version);
+         format::store(p + 8,  static_cast<std::uint32_t>(sizeof(K)));
+         format::store(p + 12, static_cast<std::uint32_t>(sizeof(V)));
+         format::store(p + 16, generation);
+      }
+
+      // append a record to buffer
+      static void writeRecord(std::vector<unsigned char>& buffer, op o, const K* pKey, const V* pValue)
+      {
+         unsigned char bytes[maxRecord];
+         std::size_t n = 0;
+         bytes[n++] = o;
+         if (pKey)
+         {
+            format::store(bytes + n, *pKey);
+            n += sizeof(K);
+         }
+         if (pValue)
+         {
+            format::store(bytes + n, *pValue);
+            n += sizeof(V);
+         }
+         buffer.insert(buffer.end(), bytes, bytes + n);
+      }
+
+      // FNV-1a: enough to tell a whole batch from a torn one
+      static std::uint32_t check(const unsigned char* p, std::size_t n) noexcept
+      {
+         std::uint32_t hash = 2166136261u;
+         for (std::size_t i = 0; i < n; i++)
+            hash = (hash ^ p[i]) * 16777619u;
+         return hash;
+      }
+
+      // the records of a whole log file, in order, up to the first
+      // torn or damaged batch. Throws when it is not a log of K and V.
+      static void readLog(const std::vector<unsigned char>& file, std::vector<record>& records)
+      {
+         if (file.size() < headerSize)
+            return;   // cut off as it was created: nothing was logged
+         const unsigned char* p = file.data();
+         if (std::memcmp(p, magic, 4) != 0 || format::template load<std::uint32_t>(p + 4) != version)
+            throw std::runtime_error("not a map journal");
+         if (format::template load<std::uint32_t>(p + 8) != sizeof(K) ||
+             format::template load<std::uint32_t>(p + 12) != sizeof(V))
+            throw std::runtime_error("map journal of other types");
+
+         std::size_t offset = headerSize;
+         while (file.size() - offset >= batchHeader)
+         {
+            std::uint32_t bytes = format::template load<std::uint32_t>(p + offset);
+            std::uint32_t sum   = format::template load<std::uint32_t>(p + offset + 4);
+            offset += batchHeader;
+            if (bytes > file.size() - offset || check(p + offset, bytes) != sum)
+               return;
+
+            std::size_t end = offset + bytes;
+            while (offset < end)
+            {
+               record r{};
+               r.op = p[offset++];
+               std::size_t need = (r.op == CLEAR ? 0 : sizeof(K)) + (r.op == PUT ? sizeof(V) : 0);
+               if ((r.op != PUT && r.op != ERASE && r.op != CLEAR) || end - offset < need)
+                  return;
+               if (r.op != CLEAR)
+               {
+                  r.key = format::template load<K>(p + offset);
+                  offset += sizeof(K);
+               }
+               if (r.op == PUT)
+               {
+                  r.value = format::template load<V>(p + offset);
+                  offset += sizeof(V);
+               }
+               records.push_back(r);
+            }
+         }
+      }
+   };
+
+/*****************************************************************
+ * JOURNALED MAP
+ * A custom::map with a write-ahead log. It is used from one thread
+ * at a time, like map; the log's own thread only touches the log,
+ * the checkpoints, and the copy of the map a checkpoint is made
+ * from. K and V must be trivially copyable, as for serialize().
+ *
+ * Writes return as soon as their record is in the buffer. sync()
+ * waits until everything written so far is on the disk, and a
+ * crash loses at most the last commit_interval of writes that no
+ * sync() covered. After a failed write to the disk, sync(),
+ * checkpoint() and every write throw.
+ *
+ * Reads go straight to the map. Its iterators are read-only, so
+ * begin(), find() and the rest can hand them out as they are.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>,
+             class P = rb_default>
+   class journaled_map
+   {
+      friend class ::TestJournal;
+      using format = journal_format<K, V>;
+      using record = typename format::record;
+   public:
+      using map_type = custom::map<K, V, C, A, P>;
+      using Pair = typename map_type::Pair;
+      using iterator = typename map_type::iterator;
+      using key_type = K;
+      using mapped_type = V;
+      class reference;
+
+      //
+      // Construct: open the map at path, recovering what was there
+      //
+      explicit journaled_map(const std::string& path, const journal_options& opts = journal_options(),
+                             const C& comp = C(), const A& alloc = A());
+      journaled_map(const journaled_map&) = delete;
+      journaled_map& operator =(const journaled_map&) = delete;
+      ~journaled_map();
+
+      //
+      // Access: the map itself, read-only
+      //
+      iterator begin()            { return m.begin();      }
+      iterator end()              { return m.end();        }
+      iterator find(const K& k)   { return m.find(k);      }
+      const V& at(const K& k) const { return m.at(k);      }
+      size_t count(const K& k) const { return m.count(k);  }
+      size_t size() const noexcept  { return m.size();     }
+      bool   empty() const noexcept { return m.empty();    }
+      const map_type& contents() const noexcept { return m; }
+
+      //
+      // Write: change the map and log the change
+      //
+      custom::pair<iterator, bool> insert(const Pair& rhs);
+      custom::pair<iterator, bool> insert_or_assign(const K& k, const V& v);
+      size_t erase(const K& k);
+      void clear();
+
+      // m[k] = v logs the assignment; reading m[k] logs only the
+      // default value put in when k was missing
+      reference operator [](const K& k);
+
+      //
+      // Durability
+      //
+      void sync();
+      void checkpoint();
+      std::uint64_t generation() const noexcept { return gen; }
+
+   private:
+      std::string filePath(std::uint64_t g, const char* suffix) const
+      {
+         return path + "." + std::to_string(g) + suffix;
+      }
+      void recover();
+      void replay(std::vector<Pair>& base, std::vector<record>& records);
+      void startLog(std::uint64_t g);
+      void log(typename format::op o, const K* pKey, const V* pValue);
+      void startCheckpoint();
+      void writerLoop();
+      void commit(const std::vector<unsigned char>& batch);
+      void writeCheckpoint(const map_type& snapshot, std::uint64_t g);
+      void throwIfFailed() const;
+
+      map_type           m;              // the map, on the caller's thread
+      std::string        path;           // the files are path.<g>.log and path.<g>.ckpt
+      journal_options    opts;
+      std::uint64_t      gen;            // generation new records belong to
+      std::uint64_t      logged;         // bytes logged since the last checkpoint
+
+      // a switch to generation g: the records logged before it go to
+      // the old log, then the new log starts and the copy of the map
+      // is saved as its checkpoint
+      struct switch_job
+      {
+         std::vector<unsigned char> tail;   // the last records of the old log
+         std::unique_ptr<map_type>  pSnapshot;
+         std::uint64_t              g;
+      };
+
+      // shared with the writer thread, under lock
+      std::mutex              lock;
+      std::condition_variable cvWork;    // something for the writer to do
+      std::condition_variable cvDone;    // the writer finished something
+      std::vector<unsigned char> pending;   // records not yet handed to the disk
+      std::uint64_t      appended;       // records ever logged
+      std::uint64_t      durable;        // of those, how many are on the disk
+      bool               syncWanted;     // someone is waiting in sync()
+      bool               stopping;       // the destructor is waiting for the writer
+      std::deque<switch_job> jobs;       // generations to switch to, in order
+      bool               checkpointing;  // a switch is waiting or being written
+      std::exception_ptr failure;        // the first write to the disk that failed
+
+      // the writer thread's own, once it is running
+      journal_file       file;           // the log being written
+      std::uint64_t      firstGen;       // the oldest generation that may have files
+      std::thread        writer;
+   };
+
+   /**********************************************************
+    * JOURNALED MAP REFERENCE
+    * What m[k] gives: reads as the value, and assigning to it
+    * goes through the log
+    *********************************************************/
+   template <class K, class V, class C, class A, class P>
+   class journaled_map<K, V, C, A, P>::reference
+   {
+      friend class journaled_map<K, V, C, A, P>;
+   public:
+      reference& operator =(const V& v)
+      {
+         it = pMap->insert_or_assign((*it).first, v).first;
+         return *this;
+      }
+      operator const V& () const
+      {
+         return (*it).second;
+      }
+
+   private:
+      reference(journaled_map* pMap, const iterator& it) : pMap(pMap), it(it)
+      {}
+
+      journaled_map* pMap;
+      iterator       it;
+   };
+
+   /*****************************************************
+    * JOURNALED MAP :: CONSTRUCTOR
+    * Recover the map from the files at path, start a log
+    * of the next generation and the thread that writes it
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   journaled_map<K, V, C, A, P>::journaled_map(const std::string& path, const journal_options& opts,
+                                               const C& comp, const A& alloc)
+      : m(comp, alloc), path(path), opts(opts), gen(0), logged(0), appended(0), durable(0),
+        syncWanted(false), stopping(false), checkpointing(false), firstGen(0)
+   {
+      recover();
+      writer = std::thread(&journaled_map::writerLoop, this);
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: DESTRUCTOR
+    * The writer commits what is left before it stops, and
+    * finishes the checkpoints it was given
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   journaled_map<K, V, C, A, P>::~journaled_map()
+   {
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         stopping = true;
+      }
+      cvWork.notify_one();
+      writer.join();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: RECOVER
+    * Find the newest checkpoint, load it, and replay every
+    * log from its generation on. A checkpoint left half
+    * written (still .tmp) is thrown away; the log it was
+    * to replace is still there.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::recover()
+   {
+      namespace fs = std::filesystem;
+      fs::path dir = fs::path(path).parent_path();
+      std::string stem = fs::path(path).filename().string() + ".";
+      if (dir.empty())
+         dir = ".";
+
+      // the generations on disk
+      bool haveCheckpoint = false;
+      std::uint64_t checkpointGen = 0;
+      std::vector<std::uint64_t> logs;
+      if (fs::exists(dir))
+         for (const fs::directory_entry& entry : fs::directory_iterator(dir))
+         {
+            std::string name = entry.path().filename().string();
+            if (name.compare(0, stem.size(), stem) != 0)
+               continue;
+            std::string rest = name.substr(stem.size());
+            std::size_t digits = rest.find_first_not_of("0123456789");
+            if (digits == 0 || digits == std::string::npos)
+               continue;
+            std::uint64_t g = std::stoull(rest.substr(0, digits));
+            std::string suffix = rest.substr(digits);
+            if (suffix == ".log")
+               logs.push_back(g);
+            else if (suffix == ".ckpt" && (!haveCheckpoint || g > checkpointGen))
+            {
+               haveCheckpoint = true;
+               checkpointGen = g;
+            }
+            else if (suffix == ".ckpt.tmp")
+               fs::remove(entry.path());
+         }
+      std::sort(logs.begin(), logs.end());
+      firstGen = logs.empty() ? checkpointGen : std::min(logs.front(), checkpointGen);
+
+      // the checkpoint, in order already
+      std::vector<Pair> base;
+      if (haveCheckpoint)
+      {
+         mapped_file checkpointFile(filePath(checkpointGen, ".ckpt"));
+         map_view<K, V, C> view(checkpointFile.data(), checkpointFile.size(), m.key_comp());
+         base.reserve(view.size());
+         for (auto it = view.begin(); it != view.end(); ++it)
+            base.push_back(Pair(it.key(), it.value()));
+      }
+
+      // then every log since, oldest first
+      std::vector<record> records;
+      gen = checkpointGen;
+      for (std::uint64_t g : logs)
+         if (g >= checkpointGen)
+         {
+            std::ifstream in(filePath(g, ".log"), std::ios::binary);
+            std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            format::readLog(bytes, records);
+            gen = g + 1;   // a torn log is never appended to
+         }
+
+      replay(base, records);
+      startLog(gen);
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: REPLAY
+    * Build the map from a checkpoint and the records after
+    * it. The records are stably sorted by key, so the last
+    * one of each key says what became of it, and merged with
+    * the sorted checkpoint in one pass. The tree is then
+    * built from the result in O(n): no insert per record.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::replay(std::vector<Pair>& base, std::vector<record>& records)
+   {
+      // nothing before the last clear matters
+      for (size_t i = records.size(); i > 0; i--)
+         if (records[i - 1].op == format::CLEAR)
+         {
+            base.clear();
+            records.erase(records.begin(), records.begin() + i);
+            break;
+         }
+
+      C comp = m.key_comp();
+      std::stable_sort(records.begin(), records.end(),
+                       [&comp](const record& lhs, const record& rhs) { return comp(lhs.key, rhs.key); });
+
+      std::vector<Pair> merged;
+      merged.reserve(base.size() + records.size());
+      size_t i = 0;
+      size_t j = 0;
+      while (i < base.size() || j < records.size())
+      {
+         if (j == records.size() || (i < base.size() && comp(base[i].first, records[j].key)))
+         {
+            merged.push_back(std::move(base[i++]));
+            continue;
+         }
+
+         // the last record of this key wins, and replaces the checkpoint's pair
+         while (j + 1 < records.size() && !comp(records[j].key, records[j + 1].key))
+            j++;
+         if (i < base.size() && !comp(records[j].key, base[i].first))
+            i++;
+         if (records[j].op == format::PUT)
+            merged.push_back(Pair(records[j].key, records[j].value));
+         j++;
+      }
+
+      m = map_type(sorted_unique, merged.begin(), merged.end(), m.key_comp(), m.get_allocator());
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: START LOG
+    * Create the log of generation g, header and all, and
+    * make sure the header is on the disk
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::startLog(std::uint64_t g)
+   {
+      unsigned char header[format::headerSize];
+      format::writeHeader(header, g);
+      file.create(filePath(g, ".log"));
+      file.write(header, sizeof(header));
+      file.sync();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: LOG
+    * Add a record to the next batch. The writer is woken
+    * early when the batch is full. A log grown past
+    * checkpoint_bytes starts a checkpoint, unless the last
+    * one is still being written: the next write tries again.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::log(typename format::op o, const K* pKey, const V* pValue)
+   {
+      bool wake;
+      bool due;
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         throwIfFailed();
+         size_t before = pending.size();
+         format::writeRecord(pending, o, pKey, pValue);
+         logged += pending.size() - before;
+         appended++;
+         wake = before == 0 || pending.size() >= opts.commit_bytes;
+         due = opts.checkpoint_bytes && logged >= opts.checkpoint_bytes && !checkpointing;
+      }
+      if (wake)
+         cvWork.notify_one();
+
+      if (due)
+         startCheckpoint();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: INSERT
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   custom::pair<typename journaled_map<K, V, C, A, P>::iterator, bool>
+      journaled_map<K, V, C, A, P>::insert(const Pair& rhs)
+   {
+      custom::pair<iterator, bool> result = m.insert(rhs);
+      if (result.second)
+         log(format::PUT, &rhs.first, &rhs.second);
+      return result;
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: INSERT OR ASSIGN
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   custom::pair<typename journaled_map<K, V, C, A, P>::iterator, bool>
+      journaled_map<K, V, C, A, P>::insert_or_assign(const K& k, const V& v)
+   {
+      custom::pair<iterator, bool> result = m.insert_or_assign(k, v);
+      log(format::PUT, &k, &v);
+      return result;
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: ERASE
+    * Only a key that was there is logged
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   size_t journaled_map<K, V, C, A, P>::erase(const K& k)
+   {
+      size_t erased = m.erase(k);
+      if (erased)
+         log(format::ERASE, &k, nullptr);
+      return erased;
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: CLEAR
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::clear()
+   {
+      m.clear();
+      log(format::CLEAR, nullptr, nullptr);
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: SUBSCRIPT
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   typename journaled_map<K, V, C, A, P>::reference journaled_map<K, V, C, A, P>::operator [](const K& k)
+   {
+      custom::pair<iterator, bool> result = m.try_emplace(k);
+      if (result.second)
+         log(format::PUT, &k, &(*result.first).second);
+      return reference(this, result.first);
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: SYNC
+    * Wait until every write made so far is on the disk
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::sync()
+   {
+      std::unique_lock<std::mutex> guard(lock);
+      std::uint64_t target = appended;
+      syncWanted = true;
+      cvWork.notify_one();
+      cvDone.wait(guard, [&]() { return durable >= target || failure; });
+      throwIfFailed();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: CHECKPOINT
+    * Start the next generation: its log takes the writes
+    * from here on, and the map as it stands now is saved
+    * as its checkpoint. Returns once the map is copied,
+    * without waiting for any file; once the checkpoint is
+    * written, the older files are removed.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::checkpoint()
+   {
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         throwIfFailed();
+      }
+      startCheckpoint();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: START CHECKPOINT
+    * Copy the map and queue the switch for the writer. The
+    * records not yet written go with it, to the old log.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::startCheckpoint()
+   {
+      switch_job job;
+      job.pSnapshot.reset(new map_type(m));
+      job.g = gen + 1;
+
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         job.tail.swap(pending);
+         jobs.push_back(std::move(job));
+         checkpointing = true;
+      }
+      gen++;
+      logged = 0;
+      cvWork.notify_one();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: WRITER LOOP
+    * The log's thread. Once there is a record, it waits up
+    * to commit_interval for more (less when the batch fills
+    * or someone is waiting in sync()), then writes them all
+    * and syncs once: a group commit. The switches to new
+    * generations happen here too, in order: the old log's
+    * last records, the new log, the records since, and
+    * then the checkpoints.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::writerLoop()
+   {
+      std::unique_lock<std::mutex> guard(lock);
+      for (;;)
+      {
+         cvWork.wait(guard, [this]() { return stopping || syncWanted || !jobs.empty() || !pending.empty(); });
+         cvWork.wait_for(guard, opts.commit_interval, [this]()
+         {
+            return stopping || syncWanted || !jobs.empty() || pending.size() >= opts.commit_bytes;
+         });
+
+         std::vector<unsigned char> batch;
+         batch.swap(pending);
+         std::deque<switch_job> todo;
+         todo.swap(jobs);
+         std::uint64_t upTo = appended;
+         bool stop = stopping;
+         syncWanted = false;
+         guard.unlock();
+
+         std::exception_ptr error;
+         try
+         {
+            for (switch_job& job : todo)
+            {
+               if (!job.tail.empty())
+                  commit(job.tail);
+               startLog(job.g);
+            }
+            if (!batch.empty())
+               commit(batch);
+            for (switch_job& job : todo)
+               writeCheckpoint(*job.pSnapshot, job.g);
+         }
+         catch (...)
+         {
+            error = std::current_exception();
+         }
+
+         guard.lock();
+         if (error && !failure)
+            failure = error;
+         durable = upTo;
+         if (jobs.empty())
+            checkpointing = false;
+         cvDone.notify_all();
+         if (stop && pending.empty() && jobs.empty())
+            return;
+      }
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: COMMIT
+    * One batch: its size, its check, its records, then one
+    * sync for the lot
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::commit(const std::vector<unsigned char>& batch)
+   {
+      unsigned char header[format::batchHeader];
+      binary_format<K, V>::store(header, static_cast<std::uint32_t>(batch.size()));
+      binary_format<K, V>::store(header + 4, format::check(batch.data(), batch.size()));
+
+      file.write(header, sizeof(header));
+      file.write(batch.data(), batch.size());
+      file.sync();
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: WRITE CHECKPOINT
+    * Write the snapshot to a .tmp file, sync it, and rename
+    * it into place, so a checkpoint on disk is always whole.
+    * Then the files of older generations can go.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::writeCheckpoint(const map_type& snapshot, std::uint64_t g)
+   {
+      namespace fs = std::filesystem;
+      std::string target = filePath(g, ".ckpt");
+      std::string temp = target + ".tmp";
+      {
+         std::ostringstream out(std::ios::binary);
+         serialize(snapshot, out);
+         std::string bytes = out.str();
+         journal_file checkpointFile;
+         checkpointFile.create(temp);
+         checkpointFile.write(bytes.data(), bytes.size());
+         checkpointFile.sync();
+      }
+      fs::rename(temp, target);
+
+      for (; firstGen < g; firstGen++)
+      {
+         std::error_code ignored;
+         fs::remove(filePath(firstGen, ".log"), ignored);
+         fs::remove(filePath(firstGen, ".ckpt"), ignored);
+      }
+   }
+
+   /*****************************************************
+    * JOURNALED MAP :: THROW IF FAILED
+    * Called with lock held
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void journaled_map<K, V, C, A, P>::throwIfFailed() const
+   {
+      if (failure)
+         std::rethrow_exception(failure);
+   }
+
+}; //  namespace custom
@@ -13,6 +13,7 @@
  *    This will contain the class definition of:
  *        map                 : A class that represents a map
  *        map::iterator       : An iterator through a map
+ *        map::node_type      : A pair taken out of a map with extract()
  * Author
  *    Nathan Bird, Brock Hoskins
  ************************************************************************/
@@ -22,8 +23,16 @@
 #include "pair.h"            // for custom::pair
 #include <utility>           // for std::pair
 #include "bst.h"             // for custom::bst
+#include "btree.h"           // for custom::bplus
 #include <initializer_list>  // for std::initializer_list
 #include <stdexcept>         // for std::out_of_range
+#include <memory>            // for std::allocator
+#include <tuple>             // for std::forward_as_tuple
+#include <iterator>          // for std::iterator_traits
+#include <type_traits>       // for std::is_base_of
+#include <algorithm>         // for std::stable_sort
+#include <vector>            // for std::vector
+#include "parallel.h"        // for custom::parallel_t
 
 #ifndef debug
 #ifdef DEBUG
@@ -34,43 +43,120 @@
 #endif // !debug
 
 class TestMap;
+class TestPool;
 
 namespace custom
 {
 
+/*****************************************************************
+ * SORTED UNIQUE
+ * Tag for the constructors: the caller promises the input is
+ * sorted by key with no duplicates, so the map can be built in
+ * O(n) without checking
+ *****************************************************************/
+   struct sorted_unique_t
+   {
+      explicit sorted_unique_t() = default;
+   };
+   inline constexpr sorted_unique_t sorted_unique{};
+
+   template <class K, class V, class C, class A>
+   class flat_map;
+   template <class K, class V, class C, class A>
+   class frozen_map;
+   template <class K, class V, class C, class A>
+   class persistent_map;
+   template <class M>
+   class set_operation;
+   template <class V, class A, std::size_t B>
+   class string_map;
+
 /*****************************************************************
  * MAP
- * Create a Map, similar to a Binary Search Tree
+ * Create a Map, similar to a Binary Search Tree. P is the node
+ * layout policy of the BST underneath.
  *****************************************************************/
-   template <class K, class V>
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>,
+             class P = rb_default>
    class map
    {
       friend class ::TestMap;
-
-      template <class KK, class VV>
-      friend void swap(map<KK, VV>& lhs, map<KK, VV>& rhs);
+      friend class ::TestPool;
+      friend class ::TestBTree;
+
+      template <class KK, class VV, class CC, class AA>
+      friend class flat_map;
+      template <class KK, class VV, class CC, class AA>
+      friend class frozen_map;
+      template <class KK, class VV, class CC, class AA>
+      friend class persistent_map;
+      template <class M>
+      friend class set_operation;
+      template <class VV, class AA, std::size_t BB>
+      friend class string_map;
+
+      template <class KK, class VV, class CC, class AA, class PP>
+      friend void swap(map<KK, VV, CC, AA, PP>& lhs, map<KK, VV, CC, AA, PP>& rhs);
+      template <class KK, class VV, class CC, class AA, class PP>
+      friend std::ostream& serialize(const map<KK, VV, CC, AA, PP>& m, std::ostream& out);
    public:
       using Pair = custom::pair<K, V>;
-      using BST = BST<Pair>;
+      using key_compare = C;
+      class value_compare;
+      using BST = typename custom::tree_of<P, Pair, value_compare, A>::type;  // BST unless P picks a B+tree
+      using allocator_type = A;
 
       // 
       // Construct
       //
-      map()
+      map() : bst(value_compare(C()))
+      {}
+      explicit map(const C& comp, const A& alloc = A()) : bst(value_compare(comp), alloc)
+      {}
+      explicit map(const A& alloc) : bst(value_compare(C()), alloc)
       {}
       map(const map& rhs) : bst(rhs.bst)
       {}
       map(map&& rhs) : bst(std::move(rhs.bst))
       {}
       template <class Iterator>
-      map(Iterator first, Iterator last)
+      map(Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : bst(value_compare(comp), alloc)
       {
          insert(first, last);
       }
-      map(const std::initializer_list<Pair>& il)
+      template <class Iterator>
+      map(Iterator first, Iterator last, const A& alloc) : bst(value_compare(C()), alloc)
+      {
+         insert(first, last);
+      }
+      map(const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : bst(value_compare(comp), alloc)
       {
          *this = il;
       }
+      map(const std::initializer_list<Pair>& il, const A& alloc) : bst(value_compare(C()), alloc)
+      {
+         *this = il;
+      }
+      template <class Iterator>
+      map(sorted_unique_t, Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : bst(value_compare(comp), alloc)
+      {
+         insertSorted(first, last, /*trusted: */true);
+      }
+      map(sorted_unique_t, const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : bst(value_compare(comp), alloc)
+      {
+         insertSorted(il.begin(), il.end(), /*trusted: */true);
+      }
+      template <class Iterator>
+      map(sorted_unique_t, Iterator first, Iterator last, parallel_t par, const C& comp = C(),
+          const A& alloc = A())
+         : bst(value_compare(comp), alloc)
+      {
+         insertSorted(first, last, /*trusted: */true, par.count());
+      }
       ~map() // calls bst::destructor which clears itself
       {}
 
@@ -104,6 +190,11 @@ namespace custom
          // Explicitly convert bst::iterator to map::iterator
          return map::iterator(bst.begin());
       }
+      iterator rbegin()
+      {
+         // the last pair: walk it back with --
+         return map::iterator(bst.rbegin());
+      }
       iterator end()
       {
          // Explicitly convert bst::iterator to map::iterator
@@ -115,13 +206,116 @@ namespace custom
       //
       const V& operator [] (const K& k) const;
       V& operator [] (const K& k);
+      V& operator [] (K&& k);
       const V& at (const K& k) const;
       V& at (const K& k);
       iterator find(const K& k)
       {
-         // custom::pair has a constructor that just takes first/key
-         pair<K, V> searchPair(k);
-         return map::iterator(bst.find(searchPair));
+         // search by the key alone: no pair, no V
+         return map::iterator(bst.find(k));
+      }
+
+      // a transparent comparator (std::less<>) can look up by anything
+      // it can compare with a K, such as a string_view for a string key
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      const V& at(const KK& k) const
+      {
+         return atKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      V& at(const KK& k)
+      {
+         return atKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator find(const KK& k)
+      {
+         return map::iterator(bst.find(k));
+      }
+
+      // ordered queries, by key: O(log n) to find the bound
+      iterator lower_bound(const K& k)
+      {
+         return map::iterator(bst.lower_bound(k));
+      }
+      iterator upper_bound(const K& k)
+      {
+         return map::iterator(bst.upper_bound(k));
+      }
+      custom::pair<iterator, iterator> equal_range(const K& k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator lower_bound(const KK& k)
+      {
+         return map::iterator(bst.lower_bound(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      iterator upper_bound(const KK& k)
+      {
+         return map::iterator(bst.upper_bound(k));
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      custom::pair<iterator, iterator> equal_range(const KK& k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+
+      // call f(pair) for every pair with a key in [lo, hi), in order
+      template <class F>
+      void visit_range(const K& lo, const K& hi, F&& f) const
+      {
+         bst.visit_range(lo, hi, f);
+      }
+      template <class KK, class F, class CC = C, class = typename CC::is_transparent>
+      void visit_range(const KK& lo, const KK& hi, F&& f) const
+      {
+         bst.visit_range(lo, hi, f);
+      }
+
+      // call f(pair) for every pair, on par.count() threads at once and
+      // in no set order, so f must be safe to call that way
+      template <class F>
+      void parallel_for_each(F&& f, parallel_t par = parallel) const
+      {
+         bst.parallel_for_each(f, par.count());
+      }
+
+      // order statistics, when P counts (rb_counted): how many keys go
+      // before k, the pair at index i, and how many keys are in [lo, hi)
+      size_t rank(const K& k) const
+      {
+         return bst.rank(k);
+      }
+      iterator nth(size_t i)
+      {
+         return map::iterator(bst.nth(i));
+      }
+      size_t count_range(const K& lo, const K& hi) const
+      {
+         return bst.count_range(lo, hi);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t rank(const KK& k) const
+      {
+         return bst.rank(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t count_range(const KK& lo, const KK& hi) const
+      {
+         return bst.count_range(lo, hi);
+      }
+
+      // statistics, when P keeps them (rb_stats): allocations, comparisons
+      // per lookup, rotations, copies and moves of the pairs, and height
+      tree_stats stats() const
+      {
+         return bst.stats();
+      }
+      void reset_stats() noexcept
+      {
+         bst.reset_stats();
       }
 
       //
@@ -138,21 +332,82 @@ namespace custom
          return custom::make_pair(map::iterator(itBSTPair.first), itBSTPair.second);
       }
 
+      // with a hint: appending after the last insert is O(1)
+      iterator insert(iterator hint, Pair&& rhs)
+      {
+         return iterator(bst.insert(hint.it, std::move(rhs), /*keepUnique: */true).first);
+      }
+      iterator insert(iterator hint, const Pair& rhs)
+      {
+         return iterator(bst.insert(hint.it, rhs, /*keepUnique: */true).first);
+      }
+
+      template <class M>
+      custom::pair<typename map::iterator, bool> insert_or_assign(const K& k, M&& obj)
+      {
+         return insertOrAssign(k, std::forward<M>(obj));
+      }
+      template <class M>
+      custom::pair<typename map::iterator, bool> insert_or_assign(K&& k, M&& obj)
+      {
+         return insertOrAssign(std::move(k), std::forward<M>(obj));
+      }
+
+      // 
+      // Emplace: build the pair right in the new node
+      //
+      template <class ... Args>
+      custom::pair<typename map::iterator, bool> emplace(Args&& ... args)
+      {
+         std::pair<typename BST::iterator, bool> itBSTPair = bst.emplace(/*keepUnique: */true, std::forward<Args>(args)...);
+         return custom::make_pair(map::iterator(itBSTPair.first), itBSTPair.second);
+      }
+      template <class ... Args>
+      iterator emplace_hint(iterator hint, Args&& ... args)
+      {
+         return iterator(bst.emplace_hint(hint.it, /*keepUnique: */true, std::forward<Args>(args)...).first);
+      }
+      template <class ... Args>
+      custom::pair<typename map::iterator, bool> try_emplace(const K& k, Args&& ... args)
+      {
+         return tryEmplace(k, std::forward<Args>(args)...);
+      }
+      template <class ... Args>
+      custom::pair<typename map::iterator, bool> try_emplace(K&& k, Args&& ... args)
+      {
+         return tryEmplace(std::move(k), std::forward<Args>(args)...);
+      }
+
       template <class Iterator>
       void insert(Iterator first, Iterator last)
       {
-         while (first != last)
-         {
-            insert(*first);
-            ++first;
-         }
+         insertSorted(first, last, /*trusted: */false);
       }
       void insert(const std::initializer_list<Pair>& il)
       {
-         for (const Pair& pair : il)
-            insert(pair);
+         insertSorted(il.begin(), il.end(), /*trusted: */false);
       }
 
+      // a batch of keys at once: sorted first, then found in order, each
+      // with a finger search from the one before instead of a descent
+      // from the root. One iterator per key, end() when it is missing,
+      // goes to out in the order the keys came.
+      template <class Iterator, class OutputIterator>
+      OutputIterator find_many(Iterator first, Iterator last, OutputIterator out);
+
+      // the same for keys with no order to share: nothing is sorted,
+      // and several descents from the root take turns a level at a
+      // time, each prefetching its next node while the others compare.
+      // For random batches in maps far bigger than the cache. The
+      // red-black layouts only.
+      template <class Iterator, class OutputIterator>
+      OutputIterator find_interleaved(Iterator first, Iterator last, OutputIterator out);
+
+      // the same for pairs: each is linked in beside its bound with no
+      // descent. The first pair of a key wins; returns how many went in
+      template <class Iterator>
+      size_t insert_many(Iterator first, Iterator last);
+
       //
       // Remove
       //
@@ -160,10 +415,41 @@ namespace custom
       {
          bst.clear();
       }
-      size_t   erase(const K& k);
+      size_t   erase(const K& k)
+      {
+         return eraseKey(k);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t   erase(const KK& k)
+      {
+         return eraseKey(k);
+      }
       iterator erase(iterator it);
       iterator erase(iterator first, iterator last);
 
+      //
+      // Node handles: move pairs between maps without allocating
+      //
+      class  node_type;
+      struct insert_return_type;
+      node_type extract(iterator it)
+      {
+         return node_type(bst.extract(it.it));
+      }
+      node_type extract(const K& k)
+      {
+         return node_type(bst.extract(bst.find(k)));
+      }
+      insert_return_type insert(node_type&& nh);
+      void merge(map& src)
+      {
+         bst.merge(src.bst, /*keepUnique: */true);
+      }
+      void merge(map&& src)
+      {
+         bst.merge(src.bst, /*keepUnique: */true);
+      }
+
       //
       // Status
       //
@@ -175,27 +461,141 @@ namespace custom
       {
          return bst.size();
       }
+      size_t count(const K& k) const
+      {
+         return bst.find(k) != bst.end() ? 1 : 0;
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      size_t count(const KK& k) const
+      {
+         return bst.find(k) != bst.end() ? 1 : 0;
+      }
+      allocator_type get_allocator() const
+      {
+         return bst.get_allocator();
+      }
+      key_compare key_comp() const
+      {
+         return bst.value_comp().key_comp();
+      }
+      value_compare value_comp() const
+      {
+         return bst.value_comp();
+      }
 
 
    private:
 
+      template <class KK>
+      V& atKey(const KK& k) const;
+      template <class KK>
+      size_t eraseKey(const KK& k);
+      template <class KK, class ... Args>
+      custom::pair<iterator, bool> tryEmplace(KK&& k, Args&& ... args);
+      template <class KK, class M>
+      custom::pair<iterator, bool> insertOrAssign(KK&& k, M&& obj);
+      template <class Iterator>
+      void insertSorted(Iterator first, Iterator last, bool trusted, unsigned threads = 1);
+      template <class T, class KeyOf>
+      std::vector<size_t> sortedOrder(const std::vector<const T*>& batch, KeyOf keyOf) const;
+
       // the students DO NOT need to use a nested class
       BST bst;
    };
 
 
+   /**********************************************************
+    * MAP VALUE COMPARE
+    * Order two pairs by their keys alone. The key comparator is a
+    * private base so an empty one (std::less) costs nothing; the
+    * BST stores this exactly once, not once per node.
+    *********************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   class map<K, V, C, A, P>::value_compare : private C
+   {
+   public:
+      explicit value_compare(const C& comp) : C(comp)
+      {}
+      // the BST can search by key alone, without building a pair
+      using is_transparent = void;
+      // the B+tree checks this for a std::less it can do with SIMD
+      using key_compare = C;
+
+      bool operator ()(const Pair& lhs, const Pair& rhs) const
+      {
+         return C::operator()(lhs.first, rhs.first);
+      }
+      bool operator ()(const Pair& lhs, const K& rhs) const
+      {
+         return C::operator()(lhs.first, rhs);
+      }
+      bool operator ()(const K& lhs, const Pair& rhs) const
+      {
+         return C::operator()(lhs, rhs.first);
+      }
+      bool operator ()(const K& lhs, const K& rhs) const
+      {
+         return C::operator()(lhs, rhs);   // the separator keys of a B+tree
+      }
+
+      // other key types only when the key comparator is transparent too
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      bool operator ()(const Pair& lhs, const KK& rhs) const
+      {
+         return C::operator()(lhs.first, rhs);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      bool operator ()(const KK& lhs, const Pair& rhs) const
+      {
+         return C::operator()(lhs, rhs.first);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      bool operator ()(const K& lhs, const KK& rhs) const
+      {
+         return C::operator()(lhs, rhs);
+      }
+      template <class KK, class CC = C, class = typename CC::is_transparent>
+      bool operator ()(const KK& lhs, const K& rhs) const
+      {
+         return C::operator()(lhs, rhs);
+      }
+
+      // one comparison a level in the BST when the keys support it
+      template <class CC = C, class = std::enable_if_t<custom::three_way<CC, K>::value>>
+      int three_way(const Pair& lhs, const Pair& rhs) const
+      {
+         return custom::three_way<C, K>::compare(key_comp(), lhs.first, rhs.first);
+      }
+      template <class CC = C, class = std::enable_if_t<custom::three_way<CC, K>::value>>
+      int three_way(const K& lhs, const Pair& rhs) const
+      {
+         return custom::three_way<C, K>::compare(key_comp(), lhs, rhs.first);
+      }
+
+      const C& key_comp() const noexcept
+      {
+         return *this;
+      }
+   };
+
    /**********************************************************
     * MAP ITERATOR
     * Forward and reverse iterator through a Map, just call
     * through to BSTIterator
     *********************************************************/
-   template <typename K, typename V>
-   class map<K, V>::iterator
+   template <typename K, typename V, typename C, typename A, typename P>
+   class map<K, V, C, A, P>::iterator
    {
       friend class ::TestMap;
-      template <class KK, class VV>
+      template <class KK, class VV, class CC, class AA, class PP>
       friend class custom::map;
    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Pair*;
+      using reference         = const Pair&;
+
       //
       // Construct
       //
@@ -272,55 +672,299 @@ namespace custom
     * MAP :: SUBSCRIPT
     * Retrieve an element from the map
     ****************************************************/
-   template <typename K, typename V>
-   V& map<K, V>::operator [](const K& key)
+   template <typename K, typename V, typename C, typename A, typename P>
+   V& map<K, V, C, A, P>::operator [](const K& key)
+   {
+      // only build a pair (and a V) when the key is missing
+      return BST::data(tryEmplace(key).first.it).second;
+   }
+
+   /*****************************************************
+    * MAP :: SUBSCRIPT
+    * Retrieve an element from the map, moving in a new key
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   V& map<K, V, C, A, P>::operator [](K&& key)
+   {
+      return BST::data(tryEmplace(std::move(key)).first.it).second;
+   }
+
+   /*****************************************************
+    * MAP :: TRY EMPLACE
+    * Search by key. Only when it is missing build the
+    * pair in a new node: the key from k, the value from args.
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class KK, class ... Args>
+   custom::pair<typename map<K, V, C, A, P>::iterator, bool> map<K, V, C, A, P>::tryEmplace(KK&& k, Args&& ... args)
+   {
+      std::pair<typename BST::iterator, bool> itBSTPair =
+         bst.emplaceKey(k, std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<KK>(k)),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+      return custom::make_pair(iterator(itBSTPair.first), itBSTPair.second);
+   }
+
+   /*****************************************************
+    * MAP :: INSERT OR ASSIGN
+    * Assign obj to the value of an existing key, or build
+    * a new pair in place when the key is missing
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class KK, class M>
+   custom::pair<typename map<K, V, C, A, P>::iterator, bool> map<K, V, C, A, P>::insertOrAssign(KK&& k, M&& obj)
+   {
+      // emplaceKey() only uses k and obj when the key is missing,
+      // so obj is still there to assign when it is not
+      std::pair<typename BST::iterator, bool> itBSTPair =
+         bst.emplaceKey(k, std::forward<KK>(k), std::forward<M>(obj));
+      if (!itBSTPair.second)
+         BST::data(itBSTPair.first).second = std::forward<M>(obj);
+      return custom::make_pair(iterator(itBSTPair.first), itBSTPair.second);
+   }
+
+   /**********************************************************
+    * MAP NODE TYPE
+    * One pair out of a map, owned by nobody else. Both the
+    * key and the value can be changed before it goes back in.
+    *********************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   class map<K, V, C, A, P>::node_type : public BST::node_handle
+   {
+      friend class custom::map<K, V, C, A, P>;
+   public:
+      using key_type    = K;
+      using mapped_type = V;
+
+      node_type() noexcept
+      {}
+
+      K& key() const
+      {
+         return this->value().first;
+      }
+      V& mapped() const
+      {
+         return this->value().second;
+      }
+
+   private:
+      node_type(typename BST::node_handle&& nh) noexcept : BST::node_handle(std::move(nh))
+      {}
+   };
+
+   /**********************************************************
+    * MAP INSERT RETURN TYPE
+    * Where insert(node_type&&) put the node. When the key was
+    * already there, the node comes back in node.
+    *********************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   struct map<K, V, C, A, P>::insert_return_type
+   {
+      iterator  position;
+      bool      inserted;
+      node_type node;
+   };
+
+   /*****************************************************
+    * MAP :: INSERT NODE
+    * Hook an extracted pair into the map. Nothing is
+    * allocated, copied or moved.
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   typename map<K, V, C, A, P>::insert_return_type map<K, V, C, A, P>::insert(node_type&& nh)
    {
-      Pair pair(key);
-      std::pair<typename BST::iterator, bool> returnValue = bst.insert(pair, /*keepUnique: */true);
-      typename BST::iterator itBST = returnValue.first;
-      return itBST.pNode->data.second;
+      std::pair<typename BST::iterator, bool> itBSTPair = bst.insert(std::move(nh), /*keepUnique: */true);
+      if (itBSTPair.second || nh.empty())
+         return { iterator(itBSTPair.first), itBSTPair.second, node_type() };
+      return { iterator(itBSTPair.first), false, std::move(nh) };
    }
 
    /*****************************************************
     * MAP :: SUBSCRIPT
     * Retrieve an element from the map
     ****************************************************/
-   template <typename K, typename V>
-   const V& map<K, V>::operator [](const K& key) const
+   template <typename K, typename V, typename C, typename A, typename P>
+   const V& map<K, V, C, A, P>::operator [](const K& key) const
    {
-      Pair pair(key);
-      typename BST::iterator itBST = bst.find(pair);
-      if (itBST != bst.end())
-         return itBST.pNode->data.second;
-      else
-         return pair.second;
+      typename BST::iterator it = bst.find(key);
+      if (it != bst.end())
+         return BST::data(it).second;
+
+      // a read-only map cannot add the key: hand back a default value
+      static const V missing = V();
+      return missing;
    }
 
    /*****************************************************
     * MAP :: AT
     * Retrieve an element from the map
     ****************************************************/
-   template <typename K, typename V>
-   V& map<K, V>::at(const K& key)
+   template <typename K, typename V, typename C, typename A, typename P>
+   V& map<K, V, C, A, P>::at(const K& key)
    {
-      iterator at(find(key));
-      if (at != end())
-         // can't use `*at` because there is only a const version, need non-const
-         return at.it.pNode->data.second;
-      throw std::out_of_range("invalid map<K, T> key");
+      return atKey(key);
    }
 
    /*****************************************************
     * MAP :: AT READ ONLY
     * Retrieve an element from the map
     ****************************************************/
-   template <typename K, typename V>
-   const V& map<K, V>::at(const K& key) const
+   template <typename K, typename V, typename C, typename A, typename P>
+   const V& map<K, V, C, A, P>::at(const K& key) const
+   {
+      return atKey(key);
+   }
+
+   /*****************************************************
+    * MAP :: INSERT SORTED
+    * Insert a range. When the map is empty and the range is
+    * sorted with unique keys (checked in one pass, or promised
+    * by sorted_unique), build the tree directly in O(n).
+    * Otherwise insert the elements one at a time.
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class Iterator>
+   void map<K, V, C, A, P>::insertSorted(Iterator first, Iterator last, bool trusted, unsigned threads)
+   {
+      using category = typename std::iterator_traits<Iterator>::iterator_category;
+      if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+      {
+         if (empty() && (trusted || bst.isSorted(first, last, /*strict: */true)))
+         {
+            bst.buildSorted(first, static_cast<size_t>(std::distance(first, last)), threads);
+            return;
+         }
+      }
+
+      while (first != last)
+      {
+         insert(*first);
+         ++first;
+      }
+   }
+
+   /*****************************************************
+    * MAP :: SORTED ORDER
+    * The indices of the batch in key order, equivalent keys
+    * in the order given, or nothing when the batch is in
+    * order already: that costs one pass and no sort
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class T, class KeyOf>
+   std::vector<size_t> map<K, V, C, A, P>::sortedOrder(const std::vector<const T*>& batch, KeyOf keyOf) const
+   {
+      const C comp = key_comp();
+      std::vector<size_t> order;
+      for (size_t i = 1; i < batch.size(); i++)
+      {
+         if (comp(keyOf(*batch[i]), keyOf(*batch[i - 1])))
+         {
+            order.resize(batch.size());
+            for (size_t j = 0; j < order.size(); j++)
+               order[j] = j;
+            std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+            {
+               return comp(keyOf(*batch[lhs]), keyOf(*batch[rhs]));
+            });
+            break;
+         }
+      }
+      return order;
+   }
+
+   /*****************************************************
+    * MAP :: FIND MANY
+    * Each bound is found from the last, so a sorted batch
+    * walks the tree about once, in order. An unsorted one
+    * is answered in key order and handed back in its own.
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class Iterator, class OutputIterator>
+   OutputIterator map<K, V, C, A, P>::find_many(Iterator first, Iterator last, OutputIterator out)
    {
-      iterator at(find(key));
-      if (at != end())
-         // `map::iterator::operator *()` returns `const pair&`, therefore `pair.second` will be `const V&`
-         return at->second; // same as `(*at).second`
+      std::vector<const K*> keys;
+      for (; first != last; ++first)
+         keys.push_back(&*first);
+      std::vector<size_t> order = sortedOrder(keys, [](const K& k) -> const K& { return k; });
+
+      const C comp = key_comp();
+      std::vector<typename BST::iterator> found(order.size(), bst.end());
+      typename BST::iterator finger = bst.end();
+      for (size_t j = 0; j < keys.size(); j++)
+      {
+         size_t i = order.empty() ? j : order[j];
+         finger = bst.bound_from(finger, *keys[i]);
+         bool isFound = finger != bst.end() && !comp(*keys[i], (*finger).first);
+         if (order.empty())
+            *out++ = map::iterator(isFound ? finger : bst.end());
+         else if (isFound)
+            found[i] = finger;
+      }
+
+      for (const typename BST::iterator& it : found)
+         *out++ = map::iterator(it);
+      return out;
+   }
+
+   /*****************************************************
+    * MAP :: FIND INTERLEAVED
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class Iterator, class OutputIterator>
+   OutputIterator map<K, V, C, A, P>::find_interleaved(Iterator first, Iterator last, OutputIterator out)
+   {
+      std::vector<const K*> keys;
+      for (; first != last; ++first)
+         keys.push_back(&*first);
+
+      std::vector<typename BST::iterator> found(keys.size(), bst.end());
+      bst.find_interleaved(keys.data(), keys.size(), found.data());
+      for (const typename BST::iterator& it : found)
+         *out++ = map::iterator(it);
+      return out;
+   }
+
+   /*****************************************************
+    * MAP :: INSERT MANY
+    * The bound of each new key is the node it goes right
+    * before, so it makes a perfect hint
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class Iterator>
+   size_t map<K, V, C, A, P>::insert_many(Iterator first, Iterator last)
+   {
+      std::vector<const Pair*> pairs;
+      for (; first != last; ++first)
+         pairs.push_back(&*first);
+      std::vector<size_t> order = sortedOrder(pairs, [](const Pair& p) -> const K& { return p.first; });
+
+      const C comp = key_comp();
+      size_t numInserted = 0;
+      typename BST::iterator finger = bst.end();
+      for (size_t j = 0; j < pairs.size(); j++)
+      {
+         const Pair& rhs = *pairs[order.empty() ? j : order[j]];
+         finger = bst.bound_from(finger, rhs.first);
+         if (finger != bst.end() && !comp(rhs.first, (*finger).first))
+            continue;                          // already there
+         finger = bst.insert(finger, rhs, /*keepUnique: */true).first;
+         numInserted++;
+      }
+      return numInserted;
+   }
+
+   /*****************************************************
+    * MAP :: AT KEY
+    * Find the value for any key the comparator accepts
+    ****************************************************/
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class KK>
+   V& map<K, V, C, A, P>::atKey(const KK& key) const
+   {
+      typename BST::iterator it = bst.find(key);
+      if (it != bst.end())
+         return BST::data(it).second;
       throw std::out_of_range("invalid map<K, T> key");
    }
 
@@ -328,23 +972,24 @@ namespace custom
     * SWAP
     * Swap two maps
     ****************************************************/
-   template <typename K, typename V>
-   void swap(map<K, V>& lhs, map<K, V>& rhs)
+   template <typename K, typename V, typename C, typename A, typename P>
+   void swap(map<K, V, C, A, P>& lhs, map<K, V, C, A, P>& rhs)
    {
-      std::swap(lhs.bst, rhs.bst);
+      lhs.bst.swap(rhs.bst);
    }
 
    /*****************************************************
     * ERASE
     * Erase one element
     ****************************************************/
-   template <typename K, typename V>
-   size_t map<K, V>::erase(const K& k)
+   template <typename K, typename V, typename C, typename A, typename P>
+   template <class KK>
+   size_t map<K, V, C, A, P>::eraseKey(const KK& k)
    {
-      iterator it(find(k));
-      if (it != end())
+      typename BST::iterator it = bst.find(k);
+      if (it != bst.end())
       {
-         erase(it);
+         bst.erase(it);
          return 1;
       }
       return 0;
@@ -354,10 +999,11 @@ namespace custom
     * ERASE
     * Erase several elements
     ****************************************************/
-   template <typename K, typename V>
-   typename map<K, V>::iterator map<K, V>::erase(map<K, V>::iterator first, map<K, V>::iterator last)
+   template <typename K, typename V, typename C, typename A, typename P>
+   typename map<K, V, C, A, P>::iterator map<K, V, C, A, P>::erase(map<K, V, C, A, P>::iterator first, map<K, V, C, A, P>::iterator last)
    {
-      while (first != last)
+      // count first: a B+tree moves the pairs after first, and last with them
+      for (std::ptrdiff_t n = std::distance(first, last); n > 0; n--)
          first = erase(first);
       return first;
    }
@@ -366,8 +1012,8 @@ namespace custom
     * ERASE
     * Erase one element
     ****************************************************/
-   template <typename K, typename V>
-   typename map<K, V>::iterator map<K, V>::erase(map<K, V>::iterator it)
+   template <typename K, typename V, typename C, typename A, typename P>
+   typename map<K, V, C, A, P>::iterator map<K, V, C, A, P>::erase(map<K, V, C, A, P>::iterator it)
    {
       return map::iterator(bst.erase(it.it));
    }
@@ -10,6 +10,10 @@
 #pragma once
 
 #include <iostream>  // for ISTREAM and OSTREAM
+#include <functional> // for std::less
+#include <tuple>      // for std::tuple and std::piecewise_construct
+#include <type_traits>
+#include <utility>    // for std::index_sequence
 
 namespace custom
 {
@@ -21,7 +25,9 @@ namespace custom
  * accessed through its public members first and second.
  *
  * Additionally, when compairing two pairs, only T1 is compared. This
- * is a key in a name-value pair.
+ * is a key in a name-value pair. C is only used for the ordering
+ * operators; no comparator is stored, so a pair is just its two members.
+ * Containers keep their own comparator.
  ***********************************************/
 template <class T1, class T2, typename C = std::less<T1>>
 class pair
@@ -32,43 +38,41 @@ public:
    //
    
    // Default Constructor: call the T1, T2 default constructors
-   pair(const C& c = C())
-       : first(     ), second(      ), compare(c) {}
+   pair()
+       : first(     ), second(      ) {}
    // Non-Default Constructor: call the T1, T2 copy constructors
-   pair(const T1 & first, const T2 & second, const C& c = C())
-       : first(first), second(second), compare(c) {}
-   pair(const T1& first, T2 && second, const C& c = C())
-      : first(first), second(std::move(second)), compare(c) {}
-   pair(const T1& first, const C& c = C())
-      : first(first), second(), compare(c) {}
-   // Copy Constructor: call the T1, T2 copy constructors
-   pair(const pair <T1, T2> & rhs, const C& c = C())
-       : first(rhs.first), second(rhs.second), compare(c) {}
+   pair(const T1 & first, const T2 & second)
+       : first(first), second(second) {}
+   pair(const T1& first, T2 && second)
+      : first(first), second(std::move(second)) {}
+   pair(const T1& first)
+      : first(first), second() {}
+   // Copy Constructor: call the T1, T2 copy constructors. Defaulted,
+   // so a pair of trivially copyable types is trivially copyable too
+   pair(const pair <T1, T2, C> & rhs) = default;
    // Non-Default Move Constructor: call the T1, T2 move constructors
-   pair(T1 && first, T2 && second, const C& c = C())
-       : first(std::move(first)), second(std::move(second)), compare(c) {}
+   pair(T1 && first, T2 && second)
+       : first(std::move(first)), second(std::move(second)) {}
    // Move Constructor: call the T1, T2 move constructors
-   pair(pair <T1, T2> && rhs, const C& c = C())
-       : first(std::move(rhs.first)), second(std::move(rhs.second)), compare(c) {}
+   pair(pair <T1, T2, C> && rhs) = default;
+   // Forwarding Constructor: build T1 and T2 from anything they take
+   template <class U1, class U2, class = std::enable_if_t<
+      std::is_constructible<T1, U1&&>::value && std::is_constructible<T2, U2&&>::value>>
+   pair(U1 && first, U2 && second)
+       : first(std::forward<U1>(first)), second(std::forward<U2>(second)) {}
+   // Piecewise Constructor: build T1 and T2 in place from two argument tuples
+   template <class ... Args1, class ... Args2>
+   pair(std::piecewise_construct_t, std::tuple<Args1...> args1, std::tuple<Args2...> args2)
+       : pair(args1, args2, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
 
    //
    // Assignment Operators
    //
    
    // Standard assignment operator: call the T1, T2 assignment operator
-   pair <T1, T2> & operator = (const pair <T1, T2> & rhs)
-   {
-      first  = rhs.first;
-      second = rhs.second;
-      return *this;
-   }
+   pair <T1, T2, C> & operator = (const pair <T1, T2, C> & rhs) = default;
    // Move assignment operator: call the T1, T2 move assignment operators
-   pair <T1, T2> & operator = (pair <T1, T2> && rhs)
-   {
-      first  = std::move(rhs.first);
-      second = std::move(rhs.second);
-      return *this;
-   }
+   pair <T1, T2, C> & operator = (pair <T1, T2, C> && rhs) = default;
    
    //
    // Equivalence: only the first will be compared
@@ -81,10 +85,10 @@ public:
    // Relative: only the first will be compared
    //
 
-   bool operator <  (const pair & rhs) const { return compare(first, rhs.first); }
-   bool operator >  (const pair & rhs) const { return compare(rhs.first, first);        }
-   bool operator >= (const pair & rhs) const { return !(compare(first, rhs.first));     }
-   bool operator <= (const pair & rhs) const { return !(compare(rhs.first, first));     }
+   bool operator <  (const pair & rhs) const { return C()(first, rhs.first);      }
+   bool operator >  (const pair & rhs) const { return C()(rhs.first, first);      }
+   bool operator >= (const pair & rhs) const { return !(C()(first, rhs.first));   }
+   bool operator <= (const pair & rhs) const { return !(C()(rhs.first, first));   }
    
    //
    // Swap: swap the places
@@ -101,16 +105,17 @@ public:
    // Member Variables: direct access to the two member variables
    //
    
-   //
-   // Get: retrieve a value
-   //
-   
-   C    compare;              // comparision operator
-
-   
    // these are public. We cannot validate because we know nothing about T
    T1 first;
    T2 second;
+
+private:
+   // unpack the piecewise tuples
+   template <class ... Args1, class ... Args2, std::size_t ... I1, std::size_t ... I2>
+   pair(std::tuple<Args1...>& args1, std::tuple<Args2...>& args2,
+        std::index_sequence<I1...>, std::index_sequence<I2...>)
+       : first(std::forward<Args1>(std::get<I1>(args1))...),
+         second(std::forward<Args2>(std::get<I2>(args2))...) {}
 };
 
 
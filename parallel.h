@@ -0,0 +1,105 @@
+/***********************************************************************
+ * Header:
+ *    PARALLEL
+ * Summary:
+ *    What the trees need to spread bulk work over threads: a tag that
+ *    asks for it, and a fork-join runner that hands out a list of
+ *    tasks to a few worker threads and waits for them all.
+ *
+ *    This will contain the definitions of:
+ *        parallel_t          : How many threads to use, and the tag to ask
+ *        parallel_tasks      : Run tasks 0 to n - 1 on up to so many threads
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <atomic>      // for std::atomic
+#include <cstddef>     // for std::size_t
+#include <exception>   // for std::exception_ptr
+#include <mutex>       // for std::mutex
+#include <thread>      // for std::thread
+#include <vector>      // for std::vector
+
+namespace custom
+{
+
+/*****************************************************************
+ * PARALLEL
+ * Pass custom::parallel for one thread a core, or parallel_t{ n }
+ * for n threads
+ *****************************************************************/
+   struct parallel_t
+   {
+      unsigned threads = 0;                  // 0 for one a core
+
+      unsigned count() const noexcept
+      {
+         if (threads)
+            return threads;
+         unsigned cores = std::thread::hardware_concurrency();
+         return cores ? cores : 1;
+      }
+   };
+   inline constexpr parallel_t parallel{};
+
+   // below this many values, a thread costs more than it saves
+   inline constexpr std::size_t parallel_grain = 4096;
+
+   /*****************************************************
+    * PARALLEL TASKS
+    * Call task(i) once for every i in [0, n), on this thread
+    * and up to threads - 1 more, each taking the next i not
+    * yet taken. Returns when every task is done. If a task
+    * throws, no new ones start, and the first exception is
+    * thrown again here.
+    ****************************************************/
+   template <class F>
+   void parallel_tasks(size_t n, unsigned threads, F&& task)
+   {
+      std::atomic<size_t> next(0);
+      std::atomic<bool> failed(false);
+      std::exception_ptr error;
+      std::mutex errorLock;
+
+      auto work = [&]()
+      {
+         for (size_t i = next++; i < n && !failed.load(); i = next++)
+         {
+            try
+            {
+               task(i);
+            }
+            catch (...)
+            {
+               std::lock_guard<std::mutex> lock(errorLock);
+               if (!error)
+                  error = std::current_exception();
+               failed.store(true);
+            }
+         }
+      };
+
+      std::vector<std::thread> workers;
+      size_t numWorkers = threads > 1 ? threads - 1 : 0;
+      if (numWorkers > n)
+         numWorkers = n ? n - 1 : 0;
+      try
+      {
+         for (size_t i = 0; i < numWorkers; i++)
+            workers.emplace_back(work);
+      }
+      catch (...)
+      {
+         // no more threads to be had: make do with the ones we have
+      }
+      work();
+      for (std::thread& worker : workers)
+         worker.join();
+
+      if (error)
+         std::rethrow_exception(error);
+   }
+
+}; //  namespace custom
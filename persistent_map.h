@@ -0,0 +1,750 @@
+/***********************************************************************
+ * Header:
+ *    PERSISTENT MAP
+ * Summary:
+ *    A map whose copies share structure. Nodes are reference counted
+ *    and never changed while more than one map can reach them, so
+ *    copying a persistent_map -- or taking a snapshot() -- is O(1):
+ *    one new reference to the root. A later write copies just the
+ *    O(log n) nodes on the path it changes and leaves the old ones
+ *    to whoever still holds them. A node only this map can reach is
+ *    changed in place, so with no snapshot outstanding a write copies
+ *    nothing at all.
+ *
+ *    The tree is height balanced (AVL) rather than red-black, and
+ *    has no parent pointers: a shared node cannot point back at two
+ *    parents. The rebalancing happens on the way back up the path a
+ *    write has already made its own, and never recolors a sibling,
+ *    so it copies at most one extra node per rotation.
+ *
+ *    This will contain the class definition of:
+ *        persistent_map            : A class that represents a persistent map
+ *        persistent_map::iterator  : An iterator through a persistent map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "bst.h"             // for custom::compare_base
+#include "map.h"             // for custom::map, to build from
+#include <atomic>            // for std::atomic
+#include <cstddef>           // for std::size_t
+#include <initializer_list>  // for std::initializer_list
+#include <iterator>          // for std::forward_iterator_tag
+#include <memory>            // for std::allocator_traits
+#include <stdexcept>         // for std::out_of_range
+#include <utility>           // for std::swap
+#include <vector>            // for std::vector
+
+class TestPersistentMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * PERSISTENT MAP
+ * Pairs can be read but not changed through an iterator, since
+ * the node may belong to a snapshot as well. Writes go through
+ * insert(), insert_or_assign() and erase().
+ *
+ * Threads: the reference counts are atomic, so a snapshot may be
+ * handed to another thread and read there while this map keeps
+ * being written. One map is still one writer: take the snapshot
+ * on the thread that writes, then pass it on.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>, class A = std::allocator<custom::pair<K, V>>>
+   class persistent_map : private compare_base<C>
+   {
+      friend class ::TestPersistentMap;
+
+      template <class KK, class VV, class CC, class AA>
+      friend void swap(persistent_map<KK, VV, CC, AA>& lhs, persistent_map<KK, VV, CC, AA>& rhs);
+
+      class Node;
+      using node_allocator = typename std::allocator_traits<A>::template rebind_alloc<Node>;
+   public:
+      using Pair = custom::pair<K, V>;
+      using key_type = K;
+      using mapped_type = V;
+      using key_compare = C;
+      using allocator_type = A;
+
+      //
+      // Construct
+      //
+      persistent_map() : compare_base<C>(C()), root(nullptr), numElements(0)
+      {}
+      explicit persistent_map(const C& comp, const A& alloc = A())
+         : compare_base<C>(comp), alloc(alloc), root(nullptr), numElements(0)
+      {}
+      persistent_map(const persistent_map& rhs)
+         : compare_base<C>(rhs.key_comp()), alloc(rhs.alloc), root(retain(rhs.root)),
+           numElements(rhs.numElements)
+      {}
+      persistent_map(persistent_map&& rhs) noexcept
+         : compare_base<C>(rhs.key_comp()), alloc(rhs.alloc), root(rhs.root), numElements(rhs.numElements)
+      {
+         rhs.root = nullptr;
+         rhs.numElements = 0;
+      }
+      template <class Iterator>
+      persistent_map(Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : persistent_map(comp, alloc)
+      {
+         for (; first != last; ++first)
+            insert(*first);
+      }
+      persistent_map(const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : persistent_map(il.begin(), il.end(), comp, alloc)
+      {}
+
+      // from a map: its pairs are in order, so the tree is built
+      // balanced in O(n) with no comparisons
+      template <class AA, class PP>
+      explicit persistent_map(const map<K, V, C, AA, PP>& rhs);
+
+      ~persistent_map()
+      {
+         release(root);
+      }
+
+      //
+      // Assign
+      //
+      persistent_map& operator =(const persistent_map& rhs)
+      {
+         Node* pOld = root;
+         root = retain(rhs.root);
+         numElements = rhs.numElements;
+         release(pOld);
+         return *this;
+      }
+      persistent_map& operator =(persistent_map&& rhs) noexcept
+      {
+         swap(rhs);
+         return *this;
+      }
+      void swap(persistent_map& rhs) noexcept
+      {
+         std::swap(alloc, rhs.alloc);
+         std::swap(root, rhs.root);
+         std::swap(numElements, rhs.numElements);
+      }
+
+      // the map as it is now, for keeps: O(1), whatever the size
+      persistent_map snapshot() const
+      {
+         return *this;
+      }
+
+      //
+      // Iterator
+      //
+      class iterator;
+      iterator begin() const;
+      iterator end() const
+      {
+         return iterator();
+      }
+
+      //
+      // Access
+      //
+      iterator find(const K& k) const;
+      iterator lower_bound(const K& k) const;
+      const V& at(const K& k) const;
+      size_t count(const K& k) const
+      {
+         return findNode(k) ? 1 : 0;
+      }
+      bool contains(const K& k) const
+      {
+         return findNode(k) != nullptr;
+      }
+      template <class F>
+      void visit_range(const K& lo, const K& hi, F&& f) const
+      {
+         visitRange(root, lo, hi, f);
+      }
+
+      //
+      // Insert
+      //
+      bool insert(const Pair& rhs);
+      template <class M>
+      bool insert_or_assign(const K& k, M&& obj);
+
+      //
+      // Remove
+      //
+      size_t erase(const K& k);
+      void clear() noexcept
+      {
+         release(root);
+         root = nullptr;
+         numElements = 0;
+      }
+
+      //
+      // Status
+      //
+      size_t size() const noexcept
+      {
+         return numElements;
+      }
+      bool empty() const noexcept
+      {
+         return numElements == 0;
+      }
+      key_compare key_comp() const
+      {
+         return this->compare();
+      }
+
+   private:
+
+      //
+      // Reference counting
+      //
+      Node* retain(Node* p) const noexcept
+      {
+         if (p)
+            p->refs.fetch_add(1, std::memory_order_relaxed);
+         return p;
+      }
+      void release(Node* p) noexcept;
+      Node* own(Node* p);
+      Node* newNode(const Pair& pair, Node* pLeft = nullptr, Node* pRight = nullptr, int height = 1);
+
+      //
+      // Balance
+      //
+      static int heightOf(const Node* p) noexcept
+      {
+         return p ? p->height : 0;
+      }
+      static void fixHeight(Node* p) noexcept
+      {
+         int hLeft = heightOf(p->pLeft);
+         int hRight = heightOf(p->pRight);
+         p->height = 1 + (hLeft > hRight ? hLeft : hRight);
+      }
+      Node* rotateLeft(Node* p);
+      Node* rotateRight(Node* p);
+      Node* rebalance(Node* p);
+
+      //
+      // Writes, along a path this map owns
+      //
+      void insertAt(Node*& slot, const Pair& rhs);
+      template <class M>
+      void assignAt(Node*& slot, const K& k, M&& obj);
+      void eraseAt(Node*& slot, const K& k);
+      Node* removeMin(Node*& slot);
+
+      Node* findNode(const K& k) const;
+      template <class Iterator>
+      Node* build(Iterator& it, size_t n);
+      template <class F>
+      void visitRange(const Node* p, const K& lo, const K& hi, F& f) const;
+
+      node_allocator alloc;
+      Node*          root;
+      size_t         numElements;
+   };
+
+   /*****************************************************************
+    * PERSISTENT MAP NODE
+    * One pair and its two subtrees. refs counts the maps and nodes
+    * that point here; height is that of the subtree rooted here
+    *****************************************************************/
+   template <class K, class V, class C, class A>
+   class persistent_map<K, V, C, A>::Node
+   {
+   public:
+      Node(const Pair& pair, Node* pLeft, Node* pRight, int height)
+         : pair(pair), pLeft(pLeft), pRight(pRight), refs(1), height(height)
+      {}
+
+      Pair                pair;
+      Node*               pLeft;
+      Node*               pRight;
+      std::atomic<size_t> refs;
+      int                 height;
+   };
+
+   /**************************************************
+    * PERSISTENT MAP ITERATOR
+    * Forward only: a stack of the nodes still to visit,
+    * the current one on top. Valid as long as the map
+    * it came from is not written.
+    *************************************************/
+   template <class K, class V, class C, class A>
+   class persistent_map<K, V, C, A>::iterator
+   {
+      friend class persistent_map;
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Pair;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Pair*;
+      using reference = const Pair&;
+
+      iterator() = default;
+
+      bool operator == (const iterator& rhs) const
+      {
+         return current() == rhs.current();
+      }
+      bool operator != (const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      const Pair& operator * () const
+      {
+         return stack.back()->pair;
+      }
+      const Pair* operator -> () const
+      {
+         return &stack.back()->pair;
+      }
+
+      // the next pair: the least of the right subtree, or the nearest
+      // ancestor still waiting on the stack
+      iterator& operator ++ ()
+      {
+         const Node* p = stack.back()->pRight;
+         stack.pop_back();
+         descendLeft(p);
+         return *this;
+      }
+      iterator operator ++ (int)
+      {
+         iterator tmp(*this);
+         ++(*this);
+         return tmp;
+      }
+
+   private:
+      const Node* current() const
+      {
+         return stack.empty() ? nullptr : stack.back();
+      }
+      void descendLeft(const Node* p)
+      {
+         for (; p; p = p->pLeft)
+            stack.push_back(p);
+      }
+
+      std::vector<const Node*> stack;
+   };
+
+   /*****************************************************
+    * PERSISTENT MAP :: CONVERT FROM MAP
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class AA, class PP>
+   persistent_map<K, V, C, A>::persistent_map(const map<K, V, C, AA, PP>& rhs)
+      : compare_base<C>(rhs.key_comp()), root(nullptr), numElements(rhs.size())
+   {
+      auto it = rhs.bst.begin();
+      root = build(it, rhs.size());
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: BUILD
+    * A balanced tree of the next n pairs from it, in order:
+    * the left half, then the middle, then the right half
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class Iterator>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::build(Iterator& it, size_t n)
+   {
+      if (n == 0)
+         return nullptr;
+      size_t nLeft = n / 2;
+      Node* pLeft = build(it, nLeft);
+      Node* p;
+      try
+      {
+         p = newNode(*it, pLeft);
+      }
+      catch (...)
+      {
+         release(pLeft);
+         throw;
+      }
+      ++it;
+      p->pRight = build(it, n - nLeft - 1);
+      fixHeight(p);
+      return p;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: BEGIN
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::iterator persistent_map<K, V, C, A>::begin() const
+   {
+      iterator it;
+      it.descendLeft(root);
+      return it;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: LOWER BOUND
+    * Every node we go left from is still to come, so the
+    * stack is the iterator's, with the bound on top
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::iterator persistent_map<K, V, C, A>::lower_bound(const K& k) const
+   {
+      iterator it;
+      for (const Node* p = root; p; )
+      {
+         if (this->compare()(p->pair.first, k))
+            p = p->pRight;
+         else
+         {
+            it.stack.push_back(p);
+            p = p->pLeft;
+         }
+      }
+      return it;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: FIND
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::iterator persistent_map<K, V, C, A>::find(const K& k) const
+   {
+      iterator it = lower_bound(k);
+      if (it != end() && this->compare()(k, (*it).first))
+         return end();
+      return it;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: FIND NODE
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::findNode(const K& k) const
+   {
+      Node* p = root;
+      while (p)
+      {
+         if (this->compare()(k, p->pair.first))
+            p = p->pLeft;
+         else if (this->compare()(p->pair.first, k))
+            p = p->pRight;
+         else
+            return p;
+      }
+      return nullptr;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: AT
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   const V& persistent_map<K, V, C, A>::at(const K& k) const
+   {
+      Node* p = findNode(k);
+      if (!p)
+         throw std::out_of_range("invalid map<K, T> key");
+      return p->pair.second;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: VISIT RANGE
+    * f(pair) for every key in [lo, hi), skipping subtrees
+    * that lie wholly outside it
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class F>
+   void persistent_map<K, V, C, A>::visitRange(const Node* p, const K& lo, const K& hi, F& f) const
+   {
+      if (!p)
+         return;
+      bool aboveLo = !this->compare()(p->pair.first, lo);
+      bool belowHi = this->compare()(p->pair.first, hi);
+      if (aboveLo)
+         visitRange(p->pLeft, lo, hi, f);
+      if (aboveLo && belowHi)
+         f(static_cast<const Pair&>(p->pair));
+      if (belowHi)
+         visitRange(p->pRight, lo, hi, f);
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: INSERT
+    * Nothing is copied unless the key is new
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   bool persistent_map<K, V, C, A>::insert(const Pair& rhs)
+   {
+      if (findNode(rhs.first))
+         return false;
+      insertAt(root, rhs);
+      numElements++;
+      return true;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: INSERT OR ASSIGN
+    * True when inserted, false when assigned
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class M>
+   bool persistent_map<K, V, C, A>::insert_or_assign(const K& k, M&& obj)
+   {
+      if (findNode(k))
+      {
+         assignAt(root, k, std::forward<M>(obj));
+         return false;
+      }
+      insertAt(root, Pair(k, std::forward<M>(obj)));
+      numElements++;
+      return true;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: ERASE
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   size_t persistent_map<K, V, C, A>::erase(const K& k)
+   {
+      if (!findNode(k))
+         return 0;
+      eraseAt(root, k);
+      numElements--;
+      return 1;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: NEW NODE
+    * Holds a reference to each child it is given
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::newNode(
+      const Pair& pair, Node* pLeft, Node* pRight, int height)
+   {
+      Node* p = std::allocator_traits<node_allocator>::allocate(alloc, 1);
+      try
+      {
+         std::allocator_traits<node_allocator>::construct(alloc, p, pair, pLeft, pRight, height);
+      }
+      catch (...)
+      {
+         std::allocator_traits<node_allocator>::deallocate(alloc, p, 1);
+         throw;
+      }
+      return p;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: RELEASE
+    * Drop one reference; the last one frees the node and
+    * drops its references to its children
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void persistent_map<K, V, C, A>::release(Node* p) noexcept
+   {
+      while (p && p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+         Node* pRight = p->pRight;
+         release(p->pLeft);
+         std::allocator_traits<node_allocator>::destroy(alloc, p);
+         std::allocator_traits<node_allocator>::deallocate(alloc, p, 1);
+         p = pRight;                 // the right spine iteratively
+      }
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: OWN
+    * The caller holds p through a slot only this map can
+    * reach. If p is shared, trade that reference for one
+    * to a private copy; either way the result can change.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::own(Node* p)
+   {
+      if (p->refs.load(std::memory_order_acquire) == 1)
+         return p;
+      Node* pCopy = newNode(p->pair, retain(p->pLeft), retain(p->pRight), p->height);
+      release(p);
+      return pCopy;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: ROTATE LEFT
+    *      p               r
+    *     / \             / \
+    *    a   r    =>     p   c
+    *       / \         / \
+    *      b   c       a   b
+    * p is ours; r becomes ours. Every reference moves
+    * with its pointer, so no count changes.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::rotateLeft(Node* p)
+   {
+      Node* r = p->pRight = own(p->pRight);
+      p->pRight = r->pLeft;
+      r->pLeft = p;
+      fixHeight(p);
+      fixHeight(r);
+      return r;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: ROTATE RIGHT
+    * The mirror of rotate left
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::rotateRight(Node* p)
+   {
+      Node* l = p->pLeft = own(p->pLeft);
+      p->pLeft = l->pRight;
+      l->pRight = p;
+      fixHeight(p);
+      fixHeight(l);
+      return l;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: REBALANCE
+    * p is ours and its subtrees differ in height by at
+    * most two. Returns the new root of the subtree.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::rebalance(Node* p)
+   {
+      fixHeight(p);
+      int balance = heightOf(p->pLeft) - heightOf(p->pRight);
+      if (balance > 1)
+      {
+         if (heightOf(p->pLeft->pLeft) < heightOf(p->pLeft->pRight))
+            p->pLeft = rotateLeft(own(p->pLeft));
+         return rotateRight(p);
+      }
+      if (balance < -1)
+      {
+         if (heightOf(p->pRight->pRight) < heightOf(p->pRight->pLeft))
+            p->pRight = rotateRight(own(p->pRight));
+         return rotateLeft(p);
+      }
+      return p;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: INSERT AT
+    * The key is not in the subtree at slot. Make the path
+    * down to its place ours, hang it there, and balance
+    * on the way back up.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void persistent_map<K, V, C, A>::insertAt(Node*& slot, const Pair& rhs)
+   {
+      if (!slot)
+      {
+         slot = newNode(rhs);
+         return;
+      }
+      slot = own(slot);
+      if (this->compare()(rhs.first, slot->pair.first))
+         insertAt(slot->pLeft, rhs);
+      else
+         insertAt(slot->pRight, rhs);
+      slot = rebalance(slot);
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: ASSIGN AT
+    * The key is in the subtree at slot: make the path to
+    * it ours and change the value. The shape stays.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   template <class M>
+   void persistent_map<K, V, C, A>::assignAt(Node*& slot, const K& k, M&& obj)
+   {
+      slot = own(slot);
+      if (this->compare()(k, slot->pair.first))
+         assignAt(slot->pLeft, k, std::forward<M>(obj));
+      else if (this->compare()(slot->pair.first, k))
+         assignAt(slot->pRight, k, std::forward<M>(obj));
+      else
+         slot->pair.second = std::forward<M>(obj);
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: REMOVE MIN
+    * Unhook the least node of the subtree at slot and
+    * return it, ours, with no children
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   typename persistent_map<K, V, C, A>::Node* persistent_map<K, V, C, A>::removeMin(Node*& slot)
+   {
+      slot = own(slot);
+      if (slot->pLeft)
+      {
+         Node* pMin = removeMin(slot->pLeft);
+         slot = rebalance(slot);
+         return pMin;
+      }
+      Node* pMin = slot;
+      slot = pMin->pRight;
+      pMin->pRight = nullptr;
+      return pMin;
+   }
+
+   /*****************************************************
+    * PERSISTENT MAP :: ERASE AT
+    * The key is in the subtree at slot. A node with two
+    * children is replaced by the least node on its right,
+    * relinked rather than copied.
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void persistent_map<K, V, C, A>::eraseAt(Node*& slot, const K& k)
+   {
+      slot = own(slot);
+      if (this->compare()(k, slot->pair.first))
+         eraseAt(slot->pLeft, k);
+      else if (this->compare()(slot->pair.first, k))
+         eraseAt(slot->pRight, k);
+      else
+      {
+         Node* pDelete = slot;
+         if (!pDelete->pLeft || !pDelete->pRight)
+         {
+            // the child, shared or not, is balanced already
+            slot = pDelete->pLeft ? pDelete->pLeft : pDelete->pRight;
+            pDelete->pLeft = pDelete->pRight = nullptr;
+            release(pDelete);
+            return;
+         }
+         Node* pSuccessor = removeMin(pDelete->pRight);
+         pSuccessor->pLeft = pDelete->pLeft;
+         pSuccessor->pRight = pDelete->pRight;
+         pDelete->pLeft = pDelete->pRight = nullptr;
+         release(pDelete);
+         slot = pSuccessor;
+      }
+      slot = rebalance(slot);
+   }
+
+   /*****************************************************
+    * SWAP
+    * Swap two persistent maps
+    ****************************************************/
+   template <class K, class V, class C, class A>
+   void swap(persistent_map<K, V, C, A>& lhs, persistent_map<K, V, C, A>& rhs)
+   {
+      lhs.swap(rhs);
+   }
+
+}; //  namespace custom
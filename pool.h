@@ -0,0 +1,409 @@
+/***********************************************************************
+ * Header:
+ *    POOL
+ * Summary:
+ *    A slab/arena allocator for the nodes of a BST. Nodes are handed
+ *    out from large contiguous chunks instead of one heap call each,
+ *    and the whole arena can be returned to the heap in O(chunks)
+ *    when the tree that owns it is cleared or destroyed.
+ *
+ *    This will contain the class definition of:
+ *        relocation          : Where arena::clone() copied each chunk to
+ *        arena               : The chunks shared by copies of a node_pool
+ *        node_pool           : A standard allocator backed by an arena
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>     // for std::size_t and std::max_align_t
+#include <cstring>     // for std::memcpy
+#include <algorithm>   // for std::sort and std::binary_search
+#include <memory>      // for std::shared_ptr
+#include <new>         // for ::operator new
+#include <type_traits> // for std::true_type
+#include <vector>      // for std::vector
+
+class TestPool;
+
+namespace custom
+{
+
+/*****************************************************************
+ * RELOCATION
+ * Where arena::clone() copied each chunk of the source arena to.
+ * Translates a pointer into one of those chunks to the same byte
+ * of the copy, so the pointers inside the copied blocks can be
+ * made to point at each other instead of back at the source.
+ *****************************************************************/
+   class relocation
+   {
+   public:
+      void add(const char* pSrc, std::size_t bytes, char* pDest)
+      {
+         spans.push_back({ pSrc, pSrc + bytes, pDest });
+      }
+      void sort()
+      {
+         std::sort(spans.begin(), spans.end(),
+                   [](const Span& lhs, const Span& rhs) { return lhs.pBegin < rhs.pBegin; });
+      }
+
+      // the copy of *p. p must be null or inside a copied chunk
+      template <typename T>
+      T* operator ()(T* p) const noexcept
+      {
+         if (!p)
+            return nullptr;
+         const char* pByte = reinterpret_cast<const char*>(p);
+
+         // the last span that starts at or before p, without a branch
+         // on the comparisons: the pointers come in no useful order
+         const Span* it = spans.data();
+         for (std::size_t n = spans.size(); n > 1; n -= n / 2)
+            it = it[n / 2].pBegin <= pByte ? it + n / 2 : it;
+         assert(it->pBegin <= pByte && pByte < it->pEnd && "pointer into the source arena");
+         return reinterpret_cast<T*>(it->pDest + (pByte - it->pBegin));
+      }
+
+   private:
+      struct Span
+      {
+         const char* pBegin;    // the chunk's blocks in the source
+         const char* pEnd;
+         char*       pDest;     // where they were copied to
+      };
+      std::vector<Span> spans;  // sorted by pBegin
+   };
+
+/*****************************************************************
+ * ARENA
+ * A singly-linked list of chunks plus a free list threaded through
+ * the unused blocks. The block size is fixed by the first allocation
+ * so that node_pool<pair> and node_pool<BNode> can share one arena.
+ *****************************************************************/
+   class arena
+   {
+   public:
+      arena() : pChunks(nullptr), pFree(nullptr), pNext(nullptr), pEnd(nullptr),
+                blockSize(0), chunkBlocks(MIN_BLOCKS), numChunks(0)
+      {}
+      arena(const arena& rhs) = delete;
+      arena& operator =(const arena& rhs) = delete;
+      ~arena()
+      {
+         release();
+      }
+
+      void* allocate(std::size_t n, std::size_t size);
+      void  deallocate(void* p, std::size_t n, std::size_t size) noexcept;
+      void  release() noexcept;
+      relocation clone(const arena& rhs);
+      template <typename F>
+      void forEachUsed(F f) const;
+
+      // every chunk starts with this header
+      struct Chunk
+      {
+         Chunk*      pNext;
+         std::size_t bytes;    // usable bytes after the header
+      };
+
+      // a free block is reused to store the link to the next free block
+      struct Block
+      {
+         Block* pNext;
+      };
+
+      static constexpr std::size_t MIN_BLOCKS = 64;
+      static constexpr std::size_t MAX_BLOCKS = 65536;
+      static constexpr std::size_t ALIGN      = alignof(std::max_align_t);
+
+      Chunk*      pChunks;     // every chunk owned by the arena
+      Block*      pFree;       // blocks handed back by deallocate()
+      char*       pNext;       // next never-used byte in the newest chunk
+      char*       pEnd;        // end of the newest chunk
+      std::size_t blockSize;   // size of one block, fixed on first use
+      std::size_t chunkBlocks; // number of blocks in the next chunk
+      std::size_t numChunks;   // number of chunks allocated
+
+   private:
+      static std::size_t roundUp(std::size_t size)
+      {
+         if (size < sizeof(Block))
+            size = sizeof(Block);
+         return (size + ALIGN - 1) / ALIGN * ALIGN;
+      }
+      char* newChunk(std::size_t bytes);
+   };
+
+   /*********************************************
+    * ARENA :: ALLOCATE
+    * Hand out n contiguous blocks. Single blocks come off the
+    * free list first, then from the tail of the newest chunk.
+    ********************************************/
+   inline void* arena::allocate(std::size_t n, std::size_t size)
+   {
+      if (blockSize == 0)
+         blockSize = roundUp(size);
+      assert(roundUp(size) == blockSize && "one block size per arena");
+
+      if (n == 1 && pFree)
+      {
+         Block* p = pFree;
+         pFree = p->pNext;
+         return p;
+      }
+
+      std::size_t bytes = n * blockSize;
+
+      // a request bigger than a chunk gets a chunk of its own
+      if (n > chunkBlocks)
+         return newChunk(bytes);
+
+      if (pNext == nullptr || static_cast<std::size_t>(pEnd - pNext) < bytes)
+      {
+         // the rest of the old chunk is too short: keep its blocks for later
+         if (pNext)
+            deallocate(pNext, static_cast<std::size_t>(pEnd - pNext) / blockSize, blockSize);
+         pNext = newChunk(chunkBlocks * blockSize);
+         pEnd  = pNext + chunkBlocks * blockSize;
+         if (chunkBlocks < MAX_BLOCKS)
+            chunkBlocks *= 2;
+      }
+
+      void* p = pNext;
+      pNext += bytes;
+      return p;
+   }
+
+   /*********************************************
+    * ARENA :: DEALLOCATE
+    * Put the blocks on the free list. The chunk itself is only given
+    * back to the heap when the arena is released.
+    ********************************************/
+   inline void arena::deallocate(void* p, std::size_t n, [[maybe_unused]] std::size_t size) noexcept
+   {
+      assert(roundUp(size) == blockSize);
+      char* pBlock = static_cast<char*>(p);
+      for (std::size_t i = 0; i < n; i++, pBlock += blockSize)
+      {
+         Block* pFreed = reinterpret_cast<Block*>(pBlock);
+         pFreed->pNext = pFree;
+         pFree = pFreed;
+      }
+   }
+
+   /*********************************************
+    * ARENA :: RELEASE
+    * Free every chunk: O(chunks), not O(nodes)
+    ********************************************/
+   inline void arena::release() noexcept
+   {
+      while (pChunks)
+      {
+         Chunk* pDelete = pChunks;
+         pChunks = pChunks->pNext;
+         ::operator delete(pDelete);
+      }
+      pFree       = nullptr;
+      pNext       = nullptr;
+      pEnd        = nullptr;
+      chunkBlocks = MIN_BLOCKS;
+      numChunks   = 0;
+   }
+
+   /*********************************************
+    * ARENA :: CLONE
+    * Become a copy of rhs, byte for byte: the same chunks, each
+    * copied whole with one memcpy, and the same free list. Only
+    * legal when nothing allocated from this arena is still alive.
+    * The blocks' contents are copied but not fixed up; the returned
+    * relocation says where each pointer into rhs went.
+    ********************************************/
+   inline relocation arena::clone(const arena& rhs)
+   {
+      assert(this != &rhs);
+      release();
+
+      relocation relocate;
+      const std::size_t header = roundUp(sizeof(Chunk));
+      Chunk** ppTail = &pChunks;   // keep the chunks in rhs's order
+      for (const Chunk* pSrc = rhs.pChunks; pSrc; pSrc = pSrc->pNext)
+      {
+         const char* pBegin = reinterpret_cast<const char*>(pSrc) + header;
+         const char* srcEnd = pBegin + pSrc->bytes;
+
+         // the newest chunk is only used up to rhs.pNext
+         bool newest = rhs.pNext && pBegin <= rhs.pNext && rhs.pNext <= srcEnd;
+         std::size_t used = newest ? std::size_t(rhs.pNext - pBegin) : pSrc->bytes;
+
+         Chunk* pChunk = static_cast<Chunk*>(::operator new(header + pSrc->bytes));
+         pChunk->pNext = nullptr;
+         pChunk->bytes = pSrc->bytes;
+         *ppTail = pChunk;
+         ppTail = &pChunk->pNext;
+
+         char* pDest = reinterpret_cast<char*>(pChunk) + header;
+         std::memcpy(pDest, pBegin, used);
+         relocate.add(pBegin, pSrc->bytes, pDest);
+         if (newest)
+         {
+            pNext = pDest + used;
+            pEnd  = pDest + pSrc->bytes;
+         }
+      }
+      relocate.sort();
+
+      // the free list runs through the copied blocks
+      pFree = relocate(rhs.pFree);
+      for (Block* p = pFree; p; p = p->pNext)
+         p->pNext = relocate(p->pNext);
+
+      blockSize   = rhs.blockSize;
+      chunkBlocks = rhs.chunkBlocks;
+      numChunks   = rhs.numChunks;
+      return relocate;
+   }
+
+   /*********************************************
+    * ARENA :: FOR EACH USED
+    * Call f on every block handed out and not given back, in the
+    * order they sit in memory. Every block up to pNext is either
+    * that or on the free list.
+    ********************************************/
+   template <typename F>
+   void arena::forEachUsed(F f) const
+   {
+      std::vector<const char*> free;
+      for (const Block* p = pFree; p; p = p->pNext)
+         free.push_back(reinterpret_cast<const char*>(p));
+      std::sort(free.begin(), free.end());
+
+      const std::size_t header = roundUp(sizeof(Chunk));
+      for (const Chunk* pChunk = pChunks; pChunk; pChunk = pChunk->pNext)
+      {
+         char* pBegin = const_cast<char*>(reinterpret_cast<const char*>(pChunk)) + header;
+         char* pStop  = pBegin + pChunk->bytes;
+         if (pNext && pBegin <= pNext && pNext <= pStop)
+            pStop = pNext;
+         for (char* pBlock = pBegin; pBlock < pStop; pBlock += blockSize)
+            if (free.empty() || !std::binary_search(free.begin(), free.end(), pBlock))
+               f(static_cast<void*>(pBlock));
+      }
+   }
+
+   /*********************************************
+    * ARENA :: NEW CHUNK
+    * Get a chunk from the heap and link it in. Returns the first
+    * usable (aligned) byte after the chunk header.
+    ********************************************/
+   inline char* arena::newChunk(std::size_t bytes)
+   {
+      const std::size_t header = roundUp(sizeof(Chunk));
+      Chunk* pChunk = static_cast<Chunk*>(::operator new(header + bytes));
+      pChunk->pNext = pChunks;
+      pChunk->bytes = bytes;
+      pChunks = pChunk;
+      numChunks++;
+      return reinterpret_cast<char*>(pChunk) + header;
+   }
+
+/*****************************************************************
+ * NODE POOL
+ * An allocator that carves fixed-size blocks out of big chunks.
+ * Freed blocks go on a free list and are reused before a new chunk
+ * is requested. Copies (and rebinds) of a node_pool share one arena,
+ * so a BST that rebinds node_pool<pair> to node_pool<BNode> still
+ * draws from the pool the caller handed it.
+ *
+ * The arena is not thread-safe: one pool per container.
+ *****************************************************************/
+   template <typename T>
+   class node_pool
+   {
+      friend class ::TestPool;
+
+      template <typename U>
+      friend class node_pool;
+   public:
+      using value_type = T;
+
+      // each container gets its own arena: copying a tree should not
+      // make the copy share (and later release) the original's chunks
+      using propagate_on_container_copy_assignment = std::false_type;
+      using propagate_on_container_move_assignment = std::true_type;
+      using propagate_on_container_swap            = std::true_type;
+      using is_always_equal                        = std::false_type;
+
+      //
+      // Construct
+      //
+      node_pool() : pArena(std::make_shared<arena>())
+      {}
+      node_pool(const node_pool& rhs) noexcept : pArena(rhs.pArena)
+      {}
+      template <typename U>
+      node_pool(const node_pool<U>& rhs) noexcept : pArena(rhs.pArena)
+      {}
+
+      node_pool select_on_container_copy_construction() const
+      {
+         return node_pool();
+      }
+
+      //
+      // Allocate
+      //
+      T* allocate(std::size_t n)
+      {
+         return static_cast<T*>(pArena->allocate(n, sizeof(T)));
+      }
+      void deallocate(T* p, std::size_t n) noexcept
+      {
+         pArena->deallocate(p, n, sizeof(T));
+      }
+
+      //
+      // Release: return every chunk to the heap at once. Only legal
+      // when nothing allocated from the arena is still alive.
+      //
+      bool unique() const noexcept { return pArena.use_count() == 1; }
+      void release() noexcept      { pArena->release();              }
+
+      //
+      // Clone: copy every chunk of rhs's arena into ours, whole. Only
+      // legal when nothing allocated from our arena is still alive.
+      // The copies still point into rhs: see relocation.
+      //
+      relocation clone(const node_pool& rhs) { return pArena->clone(*rhs.pArena); }
+
+      //
+      // Visit: call f(T*) on everything allocated and not yet given back
+      //
+      template <typename F>
+      void forEachUsed(F f) const
+      {
+         pArena->forEachUsed([&f](void* p) { f(static_cast<T*>(p)); });
+      }
+
+      //
+      // Status
+      //
+      std::size_t numChunks() const noexcept { return pArena->numChunks; }
+
+      //
+      // Compare: equal when they draw from the same arena
+      //
+      template <typename U>
+      bool operator ==(const node_pool<U>& rhs) const noexcept { return pArena == rhs.pArena; }
+      template <typename U>
+      bool operator !=(const node_pool<U>& rhs) const noexcept { return pArena != rhs.pArena; }
+
+   private:
+      std::shared_ptr<arena> pArena;
+   };
+
+} // namespace custom
@@ -0,0 +1,259 @@
+/***********************************************************************
+ * Header:
+ *    SEARCH
+ * Summary:
+ *    Searches over a sorted array of arithmetic keys that compare a
+ *    whole block of keys with each instruction (SSE2, AVX2 or NEON)
+ *    instead of one key a call to the comparator. A B+tree node's
+ *    keys, or the key array of a flat map, are searched this way
+ *    when the comparator is a plain std::less.
+ *
+ *    This will contain the definition of:
+ *        simd_keys           : Can keys of type K ordered by C use these?
+ *        key_lower_bound     : The first key that does not go before k
+ *        key_upper_bound     : The first key that goes after k
+ *
+ *    Define CUSTOM_NO_SIMD to build the scalar loops only.
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cstddef>     // for std::size_t
+#include <cstdint>     // for std::int32_t and std::int64_t
+#include <functional>  // for std::less
+#include <limits>      // for std::numeric_limits
+#include <type_traits> // for std::is_same
+
+#ifndef CUSTOM_NO_SIMD
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define CUSTOM_SIMD_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CUSTOM_SIMD_NEON
+#endif
+#endif // !CUSTOM_NO_SIMD
+
+namespace custom
+{
+
+/*****************************************************************
+ * SIMD KEYS
+ * Can keys of type K ordered by C be searched with key_lower_bound()?
+ * Only 32- and 64-bit signed integers and doubles in ascending
+ * order: std::less<K>, std::less<>, or a comparator that orders by
+ * one of those and names it key_compare (map::value_compare).
+ *****************************************************************/
+   template <typename K>
+   struct is_simd_key : std::integral_constant<bool,
+      std::is_same<K, double>::value ||
+      (std::is_integral<K>::value && std::is_signed<K>::value &&
+       (sizeof(K) == sizeof(std::int32_t) || sizeof(K) == sizeof(std::int64_t)))> {};
+
+   template <typename C, typename K, typename = void>
+   struct simd_keys : std::false_type {};
+
+   template <typename K>
+   struct simd_keys<std::less<K>, K> : is_simd_key<K> {};
+
+   template <typename K>
+   struct simd_keys<std::less<>, K> : is_simd_key<K> {};
+
+   template <typename C, typename K>
+   struct simd_keys<C, K, std::void_t<typename C::key_compare>> : simd_keys<typename C::key_compare, K> {};
+
+   namespace search
+   {
+      // arrays this short are counted end to end; longer ones are cut
+      // down to this by bisection first
+      constexpr std::size_t WINDOW = 64;
+
+      /**************************************************
+       * COUNT LESS
+       * How many of the n keys go before k? On a sorted array
+       * this is the lower bound. No branches on the keys, so
+       * nothing to mispredict.
+       *************************************************/
+      template <typename K>
+      std::size_t countLess(const K* keys, std::size_t n, K k) noexcept
+      {
+         std::size_t i = 0;
+         std::size_t count = 0;
+#if defined(CUSTOM_SIMD_X86)
+         if constexpr (std::is_same<K, double>::value)
+         {
+#ifdef __AVX2__
+            __m256d key = _mm256_set1_pd(k);
+            __m256i sum = _mm256_setzero_si256();
+            for (; i + 4 <= n; i += 4)   // a true lane is all ones: -1
+               sum = _mm256_sub_epi64(sum, _mm256_castpd_si256(
+                  _mm256_cmp_pd(_mm256_loadu_pd(keys + i), key, _CMP_LT_OQ)));
+            alignas(32) std::int64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+            count = static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#else
+            __m128d key = _mm_set1_pd(k);
+            __m128i sum = _mm_setzero_si128();
+            for (; i + 2 <= n; i += 2)
+               sum = _mm_sub_epi64(sum, _mm_castpd_si128(_mm_cmplt_pd(_mm_loadu_pd(keys + i), key)));
+            alignas(16) std::int64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+            count = static_cast<std::size_t>(lanes[0] + lanes[1]);
+#endif
+         }
+         else if constexpr (sizeof(K) == sizeof(std::int32_t))
+         {
+#ifdef __AVX2__
+            __m256i key = _mm256_set1_epi32(static_cast<std::int32_t>(k));
+            __m256i sum = _mm256_setzero_si256();
+            for (; i + 8 <= n; i += 8)
+               sum = _mm256_sub_epi32(sum, _mm256_cmpgt_epi32(key,
+                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i))));
+            alignas(32) std::int32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+            for (std::int32_t lane : lanes)
+               count += static_cast<std::size_t>(lane);
+#else
+            __m128i key = _mm_set1_epi32(static_cast<std::int32_t>(k));
+            __m128i sum = _mm_setzero_si128();
+            for (; i + 4 <= n; i += 4)
+               sum = _mm_sub_epi32(sum, _mm_cmpgt_epi32(key,
+                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i))));
+            alignas(16) std::int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+            count = static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+         }
+#if defined(__AVX2__) || defined(__SSE4_2__)
+         else   // 64-bit integers: SSE2 has no 64-bit compare
+         {
+#ifdef __AVX2__
+            __m256i key = _mm256_set1_epi64x(static_cast<std::int64_t>(k));
+            __m256i sum = _mm256_setzero_si256();
+            for (; i + 4 <= n; i += 4)
+               sum = _mm256_sub_epi64(sum, _mm256_cmpgt_epi64(key,
+                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i))));
+            alignas(32) std::int64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+            count = static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#else
+            __m128i key = _mm_set1_epi64x(static_cast<std::int64_t>(k));
+            __m128i sum = _mm_setzero_si128();
+            for (; i + 2 <= n; i += 2)
+               sum = _mm_sub_epi64(sum, _mm_cmpgt_epi64(key,
+                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i))));
+            alignas(16) std::int64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+            count = static_cast<std::size_t>(lanes[0] + lanes[1]);
+#endif
+         }
+#endif // __AVX2__ || __SSE4_2__
+#elif defined(CUSTOM_SIMD_NEON)
+         if constexpr (std::is_same<K, double>::value)
+         {
+            float64x2_t key = vdupq_n_f64(k);
+            int64x2_t sum = vdupq_n_s64(0);
+            for (; i + 2 <= n; i += 2)
+               sum = vsubq_s64(sum, vreinterpretq_s64_u64(vcltq_f64(vld1q_f64(keys + i), key)));
+            count = static_cast<std::size_t>(vaddvq_s64(sum));
+         }
+         else if constexpr (sizeof(K) == sizeof(std::int32_t))
+         {
+            int32x4_t key = vdupq_n_s32(static_cast<std::int32_t>(k));
+            int32x4_t sum = vdupq_n_s32(0);
+            for (; i + 4 <= n; i += 4)
+               sum = vsubq_s32(sum, vreinterpretq_s32_u32(vcltq_s32(
+                  vld1q_s32(reinterpret_cast<const std::int32_t*>(keys + i)), key)));
+            count = static_cast<std::size_t>(vaddvq_s32(sum));
+         }
+         else
+         {
+            int64x2_t key = vdupq_n_s64(static_cast<std::int64_t>(k));
+            int64x2_t sum = vdupq_n_s64(0);
+            for (; i + 2 <= n; i += 2)
+               sum = vsubq_s64(sum, vreinterpretq_s64_u64(vcltq_s64(
+                  vld1q_s64(reinterpret_cast<const std::int64_t*>(keys + i)), key)));
+            count = static_cast<std::size_t>(vaddvq_s64(sum));
+         }
+#endif // CUSTOM_SIMD_NEON
+
+         // whatever is left over, or everything without SIMD
+         for (; i < n; i++)
+            count += keys[i] < k;
+         return count;
+      }
+
+      /**************************************************
+       * COUNT NOT GREATER
+       * How many of the n keys do not go after k? On a sorted
+       * array this is the upper bound.
+       *************************************************/
+      template <typename K>
+      std::size_t countNotGreater(const K* keys, std::size_t n, K k) noexcept
+      {
+         if constexpr (std::is_same<K, double>::value)
+         {
+            // k's place among the keys, then across the ones equal to it
+            std::size_t i = countLess(keys, n, k);
+            while (i < n && !(k < keys[i]))
+               i++;
+            return i;
+         }
+         else if (k == std::numeric_limits<K>::max())
+            return n;   // nothing goes after it
+         else
+            return countLess(keys, n, static_cast<K>(k + 1));
+      }
+   } // namespace search
+
+   /*****************************************************
+    * KEY LOWER BOUND
+    * Index of the first of the n sorted keys that does not go
+    * before k. Bisect down to a WINDOW of keys, then count the
+    * window a block at a time.
+    ****************************************************/
+   template <typename K>
+   std::size_t key_lower_bound(const K* keys, std::size_t n, K k) noexcept
+   {
+      static_assert(is_simd_key<K>::value, "key_lower_bound() takes signed integers or doubles");
+      std::size_t base = 0;
+      while (n > search::WINDOW)
+      {
+         std::size_t half = n / 2;
+         if (keys[base + half - 1] < k)
+         {
+            base += half;
+            n -= half;
+         }
+         else
+            n = half;
+      }
+      return base + search::countLess(keys + base, n, k);
+   }
+
+   /*****************************************************
+    * KEY UPPER BOUND
+    * Index of the first of the n sorted keys that goes after k
+    ****************************************************/
+   template <typename K>
+   std::size_t key_upper_bound(const K* keys, std::size_t n, K k) noexcept
+   {
+      static_assert(is_simd_key<K>::value, "key_upper_bound() takes signed integers or doubles");
+      std::size_t base = 0;
+      while (n > search::WINDOW)
+      {
+         std::size_t half = n / 2;
+         if (!(k < keys[base + half - 1]))
+         {
+            base += half;
+            n -= half;
+         }
+         else
+            n = half;
+      }
+      return base + search::countNotGreater(keys + base, n, k);
+   }
+
+} // namespace custom
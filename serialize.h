@@ -0,0 +1,464 @@
+/***********************************************************************
+ * Header:
+ *    SERIALIZE
+ * Summary:
+ *    A binary file format for a map, and the ways to write, read, map
+ *    into memory and search one. The file is a sorted array, so it can
+ *    be searched where it lies (mapped read-only, say) or loaded into a
+ *    map in O(n), where the text format of operator >> for pair takes
+ *    a parse and an O(log n) insert for every pair.
+ *
+ *    Version 1 of the format, every number little-endian:
+ *        offset  0   "CMAP"               magic
+ *        offset  4   uint32  1            version
+ *        offset  8   uint32  sizeof(K)    key size
+ *        offset 12   uint32  sizeof(V)    value size
+ *        offset 16   uint64  n            how many pairs
+ *        offset 24   uint64  0            reserved
+ *        offset 32   n keys, in order, each sizeof(K) bytes
+ *                    zeros to the next multiple of 8
+ *                    n values, in the order of their keys
+ *    K and V must be trivially copyable. Integers, floating point and
+ *    enums are stored little-endian whatever the machine; any other
+ *    type is stored as its bytes, so reads back only on a machine that
+ *    lays it out the same way.
+ *
+ *    This will contain the definitions of:
+ *        binary_format         : The layout above, and checks on it
+ *        serialize             : Write a map to a binary stream
+ *        deserialize           : Load a map from a stream or a buffer
+ *        map_view              : Search a file in place, read-only
+ *        mapped_file           : A file mapped into memory, read-only
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "map.h"             // for custom::map
+#include <cstddef>           // for std::size_t
+#include <cstdint>           // for std::uint32_t and std::uint64_t
+#include <cstring>           // for std::memcpy
+#include <functional>        // for std::less
+#include <iostream>          // for std::ostream and std::istream
+#include <iterator>          // for std::random_access_iterator_tag
+#include <stdexcept>         // for std::runtime_error and std::out_of_range
+#include <string>            // for std::string
+#include <type_traits>       // for std::is_trivially_copyable
+#include <vector>            // for std::vector
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>         // for CreateFileMapping and MapViewOfFile
+#else
+#include <fcntl.h>           // for open
+#include <sys/mman.h>        // for mmap
+#include <sys/stat.h>        // for fstat
+#include <unistd.h>          // for close
+#endif
+
+namespace custom
+{
+
+/*****************************************************************
+ * BINARY FORMAT
+ * Where everything is in a file of n pairs of K and V, and how a
+ * number is written there and read back
+ *****************************************************************/
+   template <class K, class V>
+   class binary_format
+   {
+      static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                    "the binary format stores keys and values as bytes");
+   public:
+      static constexpr char          magic[4]   = { 'C', 'M', 'A', 'P' };
+      static constexpr std::uint32_t version    = 1;
+      static constexpr std::size_t   headerSize = 32;
+
+      static std::size_t keysOffset() noexcept
+      {
+         return headerSize;
+      }
+      static std::size_t valuesOffset(std::uint64_t n) noexcept
+      {
+         std::size_t end = headerSize + static_cast<std::size_t>(n) * sizeof(K);
+         return (end + 7) / 8 * 8;
+      }
+      static std::size_t fileSize(std::uint64_t n) noexcept
+      {
+         return valuesOffset(n) + static_cast<std::size_t>(n) * sizeof(V);
+      }
+
+      // the header of a file of n pairs
+      static void writeHeader(unsigned char* p, std::uint64_t n)
+      {
+         std::memcpy(p, magic, 4);
+         store(p + 4,  version);
+         store(p + 8,  static_cast<std::uint32_t>(sizeof(K)));
+         store(p + 12, static_cast<std::uint32_t>(sizeof(V)));
+         store(p + 16, n);
+         store(p + 24, std::uint64_t(0));
+      }
+
+      // how many pairs the size bytes at p hold, or throw if they are
+      // not a version 1 file of K and V
+      static std::uint64_t readHeader(const unsigned char* p, std::size_t size)
+      {
+         if (size < headerSize || std::memcmp(p, magic, 4) != 0)
+            throw std::runtime_error("not a map file");
+         if (load<std::uint32_t>(p + 4) != version)
+            throw std::runtime_error("unsupported map file version");
+         if (load<std::uint32_t>(p + 8) != sizeof(K) || load<std::uint32_t>(p + 12) != sizeof(V) ||
+             load<std::uint64_t>(p + 24) != 0)
+            throw std::runtime_error("map file of other types");
+
+         std::uint64_t n = load<std::uint64_t>(p + 16);
+         if (n > (size - headerSize) / (sizeof(K) + sizeof(V)) || fileSize(n) > size)
+            throw std::runtime_error("truncated map file");
+         return n;
+      }
+
+      // write t at p, little-endian when it is a number
+      template <class T>
+      static void store(unsigned char* p, const T& t) noexcept
+      {
+         std::memcpy(p, &t, sizeof(T));
+         if (swapped<T>())
+            reverse(p, sizeof(T));
+      }
+
+      // read a T from p
+      template <class T>
+      static T load(const unsigned char* p) noexcept
+      {
+         T t;
+         if (swapped<T>())
+         {
+            unsigned char bytes[sizeof(T)];
+            std::memcpy(bytes, p, sizeof(T));
+            reverse(bytes, sizeof(T));
+            std::memcpy(&t, bytes, sizeof(T));
+         }
+         else
+            std::memcpy(&t, p, sizeof(T));
+         return t;
+      }
+
+   private:
+      // a number on a big-endian machine has its bytes in the other order
+      template <class T>
+      static bool swapped() noexcept
+      {
+         if (!std::is_arithmetic<T>::value && !std::is_enum<T>::value)
+            return false;
+         const std::uint16_t one = 1;
+         unsigned char first;
+         std::memcpy(&first, &one, 1);
+         return first != 1;
+      }
+
+      static void reverse(unsigned char* p, std::size_t n) noexcept
+      {
+         for (std::size_t i = 0; i < n / 2; i++)
+         {
+            unsigned char byte = p[i];
+            p[i] = p[n - 1 - i];
+            p[n - 1 - i] = byte;
+         }
+      }
+   };
+
+/*****************************************************************
+ * MAP VIEW
+ * A map file searched where it lies: nothing is copied or built,
+ * and a key is read from the buffer only when it is compared. The
+ * buffer must outlive the view.
+ *****************************************************************/
+   template <class K, class V, class C = std::less<K>>
+   class map_view : private compare_base<C>
+   {
+      using format = binary_format<K, V>;
+   public:
+      using Pair = custom::pair<K, V>;
+      class iterator;
+
+      map_view(const void* data, std::size_t size, const C& comp = C())
+         : compare_base<C>(comp), data(static_cast<const unsigned char*>(data)),
+           numElements(static_cast<std::size_t>(format::readHeader(this->data, size))),
+           keys(this->data + format::keysOffset()),
+           values(this->data + format::valuesOffset(numElements))
+      {}
+
+      //
+      // Access
+      //
+      std::size_t size()  const noexcept { return numElements;      }
+      bool        empty() const noexcept { return numElements == 0; }
+      K key(std::size_t i)   const noexcept { return format::template load<K>(keys + i * sizeof(K));   }
+      V value(std::size_t i) const noexcept { return format::template load<V>(values + i * sizeof(V)); }
+
+      iterator begin() const noexcept { return iterator(this, 0);           }
+      iterator end()   const noexcept { return iterator(this, numElements); }
+
+      iterator lower_bound(const K& k) const noexcept
+      {
+         return iterator(this, bound(k, /*upper: */false));
+      }
+      iterator upper_bound(const K& k) const noexcept
+      {
+         return iterator(this, bound(k, /*upper: */true));
+      }
+      iterator find(const K& k) const noexcept
+      {
+         std::size_t i = bound(k, /*upper: */false);
+         return iterator(this, i < numElements && !this->compare()(k, key(i)) ? i : numElements);
+      }
+      std::size_t count(const K& k) const noexcept
+      {
+         return find(k) == end() ? 0 : 1;
+      }
+      V at(const K& k) const
+      {
+         iterator it = find(k);
+         if (it == end())
+            throw std::out_of_range("invalid map<K, T> key");
+         return it.value();
+      }
+
+   private:
+      const unsigned char* data;
+      std::size_t numElements;
+      const unsigned char* keys;
+      const unsigned char* values;
+
+      // the first index whose key is not before k (or after, when upper)
+      std::size_t bound(const K& k, bool upper) const noexcept
+      {
+         std::size_t lo = 0;
+         std::size_t n = numElements;
+         while (n > 0)
+         {
+            std::size_t half = n / 2;
+            bool right = upper ? !this->compare()(k, key(lo + half)) : this->compare()(key(lo + half), k);
+            if (right)
+            {
+               lo += half + 1;
+               n -= half + 1;
+            }
+            else
+               n = half;
+         }
+         return lo;
+      }
+   };
+
+   /*****************************************************************
+    * MAP VIEW :: ITERATOR
+    * An index into the view. The pair is read out of the buffer, so
+    * dereferencing gives a copy, not a reference.
+    *****************************************************************/
+   template <class K, class V, class C>
+   class map_view<K, V, C>::iterator
+   {
+   public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = void;
+      using reference         = Pair;
+
+      iterator() : pView(nullptr), i(0) {}
+      iterator(const map_view* pView, std::size_t i) : pView(pView), i(i) {}
+
+      Pair operator * () const                     { return Pair(key(), value());   }
+      Pair operator [] (std::ptrdiff_t d) const    { return *(*this + d);           }
+      K    key()   const noexcept                  { return pView->key(i);          }
+      V    value() const noexcept                  { return pView->value(i);        }
+
+      iterator& operator ++ ()    { ++i; return *this; }
+      iterator  operator ++ (int) { iterator it(*this); ++i; return it; }
+      iterator& operator -- ()    { --i; return *this; }
+      iterator  operator -- (int) { iterator it(*this); --i; return it; }
+
+      iterator& operator += (std::ptrdiff_t d) { i += d; return *this; }
+      iterator& operator -= (std::ptrdiff_t d) { i -= d; return *this; }
+      iterator  operator +  (std::ptrdiff_t d) const { return iterator(pView, i + d); }
+      iterator  operator -  (std::ptrdiff_t d) const { return iterator(pView, i - d); }
+      std::ptrdiff_t operator - (const iterator& rhs) const
+      {
+         return static_cast<std::ptrdiff_t>(i) - static_cast<std::ptrdiff_t>(rhs.i);
+      }
+
+      bool operator == (const iterator& rhs) const { return i == rhs.i; }
+      bool operator != (const iterator& rhs) const { return i != rhs.i; }
+      bool operator <  (const iterator& rhs) const { return i <  rhs.i; }
+      bool operator >  (const iterator& rhs) const { return i >  rhs.i; }
+      bool operator <= (const iterator& rhs) const { return i <= rhs.i; }
+      bool operator >= (const iterator& rhs) const { return i >= rhs.i; }
+
+   private:
+      const map_view* pView;
+      std::size_t i;
+   };
+
+   /*****************************************************
+    * SERIALIZE
+    * Write the map in the binary format. Open the stream
+    * in binary mode; a failed write shows in its state.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   std::ostream& serialize(const map<K, V, C, A, P>& m, std::ostream& out)
+   {
+      using format = binary_format<K, V>;
+      std::uint64_t n = m.size();
+      std::vector<unsigned char> file(format::fileSize(n), 0);
+
+      format::writeHeader(file.data(), n);
+      unsigned char* pKey = file.data() + format::keysOffset();
+      unsigned char* pValue = file.data() + format::valuesOffset(n);
+      for (auto it = m.bst.begin(); it != m.bst.end(); ++it)
+      {
+         format::store(pKey, (*it).first);
+         format::store(pValue, (*it).second);
+         pKey += sizeof(K);
+         pValue += sizeof(V);
+      }
+
+      return out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+   }
+
+   /*****************************************************
+    * DESERIALIZE
+    * Replace the map with the pairs in a buffer holding a
+    * file. The keys are checked to be in order in one pass
+    * and the tree is then built in O(n); a file that is
+    * out of order for this map's comparator still loads,
+    * one insert at a time. Throws std::runtime_error when
+    * the buffer is not a file of K and V.
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void deserialize(const void* data, std::size_t size, map<K, V, C, A, P>& m)
+   {
+      map_view<K, V, C> view(data, size);
+      m.clear();
+      m.insert(view.begin(), view.end());
+   }
+
+   /*****************************************************
+    * DESERIALIZE
+    * The same, from a stream opened in binary mode
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   void deserialize(std::istream& in, map<K, V, C, A, P>& m)
+   {
+      std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      deserialize(file.data(), file.size(), m);
+   }
+
+/*****************************************************************
+ * MAPPED FILE
+ * A whole file mapped into memory read-only, for a map_view to
+ * search. The pages are read in as they are touched. Throws
+ * std::runtime_error when the file cannot be opened or mapped.
+ *****************************************************************/
+   class mapped_file
+   {
+   public:
+      explicit mapped_file(const std::string& path);
+      mapped_file(mapped_file&& rhs) noexcept : pData(rhs.pData), numBytes(rhs.numBytes)
+      {
+         rhs.pData = nullptr;
+         rhs.numBytes = 0;
+      }
+      mapped_file(const mapped_file&) = delete;
+      mapped_file& operator = (const mapped_file&) = delete;
+      ~mapped_file();
+
+      const void* data() const noexcept { return pData;    }
+      std::size_t size() const noexcept { return numBytes; }
+
+   private:
+      void* pData;
+      std::size_t numBytes;
+   };
+
+#ifdef _WIN32
+   /*****************************************************
+    * MAPPED FILE :: CONSTRUCTOR
+    * Windows: a read-only file mapping. The view keeps the
+    * mapping open, so both handles can close at once.
+    ****************************************************/
+   inline mapped_file::mapped_file(const std::string& path) : pData(nullptr), numBytes(0)
+   {
+      HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+         throw std::runtime_error("cannot open " + path);
+
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(file, &size))
+      {
+         CloseHandle(file);
+         throw std::runtime_error("cannot read the size of " + path);
+      }
+      numBytes = static_cast<std::size_t>(size.QuadPart);
+      if (numBytes)
+      {
+         HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+         if (mapping)
+         {
+            pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+         }
+      }
+      CloseHandle(file);
+      if (numBytes && !pData)
+         throw std::runtime_error("cannot map " + path);
+   }
+
+   inline mapped_file::~mapped_file()
+   {
+      if (pData)
+         UnmapViewOfFile(pData);
+   }
+#else
+   /*****************************************************
+    * MAPPED FILE :: CONSTRUCTOR
+    * POSIX: mmap the file shared and read-only. The mapping
+    * holds the file, so the descriptor closes right away.
+    ****************************************************/
+   inline mapped_file::mapped_file(const std::string& path) : pData(nullptr), numBytes(0)
+   {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+         throw std::runtime_error("cannot open " + path);
+
+      struct stat status;
+      if (::fstat(fd, &status) != 0)
+      {
+         ::close(fd);
+         throw std::runtime_error("cannot read the size of " + path);
+      }
+      numBytes = static_cast<std::size_t>(status.st_size);
+      if (numBytes)
+      {
+         void* p = ::mmap(nullptr, numBytes, PROT_READ, MAP_SHARED, fd, 0);
+         if (p != MAP_FAILED)
+            pData = p;
+      }
+      ::close(fd);
+      if (numBytes && !pData)
+         throw std::runtime_error("cannot map " + path);
+   }
+
+   inline mapped_file::~mapped_file()
+   {
+      if (pData)
+         ::munmap(pData, numBytes);
+   }
+#endif // _WIN32
+
+}; //  namespace custom
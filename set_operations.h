@@ -0,0 +1,239 @@
+/***********************************************************************
+ * Header:
+ *    SET OPERATIONS
+ * Summary:
+ *    Union, intersection and difference of two maps, split over
+ *    threads. The larger map gives a few splitter keys from near its
+ *    root; those cut both maps into slices with the same key range,
+ *    each slice pair is merged on its own thread, and the result is
+ *    built from the merged pairs in O(n) the way sorted_unique builds.
+ *
+ *    Neither map is changed, and the result is a new map with the
+ *    comparator and allocator of the first.
+ *
+ *    This will contain the definitions of:
+ *        parallel_union          : The pairs in either map
+ *        parallel_intersection   : The pairs of a with a key in b
+ *        parallel_difference     : The pairs of a with no key in b
+ *        set_operation           : What the three of them share
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "map.h"             // for custom::map
+#include "parallel.h"        // for custom::parallel_t
+#include <algorithm>         // for std::copy
+#include <cstddef>           // for std::ptrdiff_t
+#include <iterator>          // for std::random_access_iterator_tag
+#include <vector>            // for std::vector
+
+namespace custom
+{
+
+/*****************************************************************
+ * SET OPERATION
+ * Slice both maps at the same keys, merge the slices in parallel,
+ * and build the result. M is the map type.
+ *****************************************************************/
+   template <class M>
+   class set_operation
+   {
+   public:
+      using Pair = typename M::Pair;
+
+      enum kind { UNION, INTERSECTION, DIFFERENCE };
+
+      static M run(const M& a, const M& b, kind op, parallel_t par);
+
+   private:
+      using Tree = typename M::BST;
+      using tree_iterator = typename Tree::iterator;
+      using value_compare = typename Tree::value_compare;
+
+      class pointer_iterator;
+
+      static std::vector<tree_iterator> cuts(const Tree& tree, const std::vector<const Pair*>& keys);
+      static void merge(tree_iterator itA, tree_iterator endA, tree_iterator itB, tree_iterator endB,
+                        kind op, const value_compare& comp, std::vector<const Pair*>& out);
+   };
+
+   /*****************************************************************
+    * SET OPERATION :: POINTER ITERATOR
+    * Walks the merged pointers, handing out the pairs they point to,
+    * so the result is built straight from the two maps
+    *****************************************************************/
+   template <class M>
+   class set_operation<M>::pointer_iterator
+   {
+   public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Pair*;
+      using reference         = const Pair&;
+
+      explicit pointer_iterator(const Pair* const* p) : p(p) {}
+
+      const Pair& operator * () const                  { return **p;  }
+      const Pair* operator -> () const                 { return *p;   }
+      const Pair& operator [] (std::ptrdiff_t i) const { return *p[i]; }
+
+      pointer_iterator& operator ++ ()    { ++p; return *this; }
+      pointer_iterator  operator ++ (int) { pointer_iterator it(*this); ++p; return it; }
+      pointer_iterator& operator -- ()    { --p; return *this; }
+      pointer_iterator  operator -- (int) { pointer_iterator it(*this); --p; return it; }
+
+      pointer_iterator& operator += (std::ptrdiff_t i) { p += i; return *this; }
+      pointer_iterator& operator -= (std::ptrdiff_t i) { p -= i; return *this; }
+      pointer_iterator  operator +  (std::ptrdiff_t i) const { return pointer_iterator(p + i); }
+      pointer_iterator  operator -  (std::ptrdiff_t i) const { return pointer_iterator(p - i); }
+      std::ptrdiff_t    operator -  (const pointer_iterator& rhs) const { return p - rhs.p; }
+
+      bool operator == (const pointer_iterator& rhs) const { return p == rhs.p; }
+      bool operator != (const pointer_iterator& rhs) const { return p != rhs.p; }
+      bool operator <  (const pointer_iterator& rhs) const { return p <  rhs.p; }
+      bool operator >  (const pointer_iterator& rhs) const { return p >  rhs.p; }
+      bool operator <= (const pointer_iterator& rhs) const { return p <= rhs.p; }
+      bool operator >= (const pointer_iterator& rhs) const { return p >= rhs.p; }
+
+   private:
+      const Pair* const* p;
+   };
+
+   /*****************************************************
+    * SET OPERATION :: RUN
+    * About four slices a thread. A slice with nothing in
+    * it costs a lower_bound and no more.
+    ****************************************************/
+   template <class M>
+   M set_operation<M>::run(const M& a, const M& b, kind op, parallel_t par)
+   {
+      unsigned threads = par.count();
+      value_compare comp = a.bst.value_comp();
+
+      std::vector<const Pair*> keys;
+      if (threads > 1 && a.size() + b.size() >= 2 * parallel_grain)
+         keys = (a.size() < b.size() ? b : a).bst.splitters(size_t(4) * threads - 1);
+
+      std::vector<tree_iterator> cutsA = cuts(a.bst, keys);
+      std::vector<tree_iterator> cutsB = cuts(b.bst, keys);
+
+      // merge each slice on its own, then put them end to end
+      std::vector<std::vector<const Pair*>> slices(cutsA.size() - 1);
+      parallel_tasks(slices.size(), threads, [&](size_t i)
+      {
+         merge(cutsA[i], cutsA[i + 1], cutsB[i], cutsB[i + 1], op, comp, slices[i]);
+      });
+
+      std::vector<size_t> offsets(slices.size() + 1, 0);
+      for (size_t i = 0; i < slices.size(); i++)
+         offsets[i + 1] = offsets[i] + slices[i].size();
+      std::vector<const Pair*> merged(offsets.back());
+      parallel_tasks(slices.size(), threads, [&](size_t i)
+      {
+         std::copy(slices[i].begin(), slices[i].end(), merged.begin() + offsets[i]);
+      });
+
+      return M(sorted_unique, pointer_iterator(merged.data()), pointer_iterator(merged.data() + merged.size()),
+               par, comp.key_comp(), a.bst.get_allocator());
+   }
+
+   /*****************************************************
+    * SET OPERATION :: CUTS
+    * Where every key lands in the tree, with begin() and
+    * end() on either side
+    ****************************************************/
+   template <class M>
+   std::vector<typename set_operation<M>::tree_iterator>
+      set_operation<M>::cuts(const Tree& tree, const std::vector<const Pair*>& keys)
+   {
+      std::vector<tree_iterator> its;
+      its.reserve(keys.size() + 2);
+      its.push_back(tree.begin());
+      for (const Pair* pKey : keys)
+         its.push_back(tree.lower_bound(pKey->first));
+      its.push_back(tree.end());
+      return its;
+   }
+
+   /*****************************************************
+    * SET OPERATION :: MERGE
+    * One slice of each map, both in key order. When a key
+    * is in both, the pair comes from a.
+    ****************************************************/
+   template <class M>
+   void set_operation<M>::merge(tree_iterator itA, tree_iterator endA, tree_iterator itB, tree_iterator endB,
+                                kind op, const value_compare& comp, std::vector<const Pair*>& out)
+   {
+      while (itA != endA && itB != endB)
+      {
+         if (comp(*itA, *itB))
+         {
+            if (op != INTERSECTION)
+               out.push_back(&*itA);
+            ++itA;
+         }
+         else if (comp(*itB, *itA))
+         {
+            if (op == UNION)
+               out.push_back(&*itB);
+            ++itB;
+         }
+         else
+         {
+            if (op != DIFFERENCE)
+               out.push_back(&*itA);
+            ++itA;
+            ++itB;
+         }
+      }
+
+      if (op == INTERSECTION)
+         return;
+      for (; itA != endA; ++itA)
+         out.push_back(&*itA);
+      if (op == UNION)
+         for (; itB != endB; ++itB)
+            out.push_back(&*itB);
+   }
+
+   /*****************************************************
+    * PARALLEL UNION
+    * Every key in a or b; a's pair when it is in both
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   map<K, V, C, A, P> parallel_union(const map<K, V, C, A, P>& a, const map<K, V, C, A, P>& b,
+                                     parallel_t par = parallel)
+   {
+      using op = set_operation<map<K, V, C, A, P>>;
+      return op::run(a, b, op::UNION, par);
+   }
+
+   /*****************************************************
+    * PARALLEL INTERSECTION
+    * a's pairs with a key also in b
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   map<K, V, C, A, P> parallel_intersection(const map<K, V, C, A, P>& a, const map<K, V, C, A, P>& b,
+                                            parallel_t par = parallel)
+   {
+      using op = set_operation<map<K, V, C, A, P>>;
+      return op::run(a, b, op::INTERSECTION, par);
+   }
+
+   /*****************************************************
+    * PARALLEL DIFFERENCE
+    * a's pairs with a key not in b
+    ****************************************************/
+   template <class K, class V, class C, class A, class P>
+   map<K, V, C, A, P> parallel_difference(const map<K, V, C, A, P>& a, const map<K, V, C, A, P>& b,
+                                          parallel_t par = parallel)
+   {
+      using op = set_operation<map<K, V, C, A, P>>;
+      return op::run(a, b, op::DIFFERENCE, par);
+   }
+
+}; //  namespace custom
@@ -0,0 +1,427 @@
+/***********************************************************************
+ * Header:
+ *    SHARDED MAP
+ * Summary:
+ *    A map split by the hash of the key into Shards independent
+ *    custom::maps, each behind its own reader-writer lock. Threads
+ *    working on different shards never meet, so writes scale with
+ *    the cores instead of lining up behind one tree. The batch
+ *    operations sort their keys by shard first and take each lock
+ *    once. Walking the keys in order merges the shards.
+ *
+ *    This will contain the class definition of:
+ *        sharded_map         : A class that represents a sharded map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "map.h"             // for custom::map, one a shard
+#include <cstddef>           // for std::size_t
+#include <cstdint>           // for std::uint64_t
+#include <functional>        // for std::hash
+#include <mutex>             // for std::unique_lock
+#include <optional>          // for std::optional
+#include <queue>             // for std::priority_queue
+#include <shared_mutex>      // for std::shared_mutex
+#include <vector>            // for std::vector
+
+class TestShardedMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * SHARDED MAP
+ * Every key lives in shard hash(key) mod Shards. Each call locks
+ * only the shards it touches: shared to read, unique to write.
+ * Calls that touch several shards (the batches, size(), the
+ * ordered walks) lock them in index order, so they cannot
+ * deadlock, but they see each shard at a slightly different time
+ * -- except the ordered walks, which hold every lock throughout.
+ *****************************************************************/
+   template <class K, class V, std::size_t Shards = 16, class C = std::less<K>, class H = std::hash<K>,
+             class A = std::allocator<custom::pair<K, V>>, class P = rb_default>
+   class sharded_map
+   {
+      friend class ::TestShardedMap;
+      static_assert(Shards > 0, "a sharded map needs at least one shard");
+   public:
+      using map_type = custom::map<K, V, C, A, P>;
+      using Pair = typename map_type::Pair;
+      using key_type = K;
+      using mapped_type = V;
+      using hasher = H;
+
+      //
+      // Construct
+      //
+      sharded_map() = default;
+      sharded_map(const sharded_map&) = delete;
+      sharded_map& operator =(const sharded_map&) = delete;
+
+      //
+      // Access: values come back as copies, since the lock is gone
+      // by the time the caller sees them
+      //
+      std::optional<V> find(const K& k) const;
+      V at(const K& k) const;
+      size_t count(const K& k) const
+      {
+         const shard& s = shardOf(k);
+         std::shared_lock<std::shared_mutex> lock(s.lock);
+         return s.m.count(k);
+      }
+      bool contains(const K& k) const
+      {
+         return count(k) != 0;
+      }
+
+      //
+      // Insert and remove, one key
+      //
+      bool insert(const Pair& rhs)
+      {
+         shard& s = shardOf(rhs.first);
+         std::unique_lock<std::shared_mutex> lock(s.lock);
+         return s.m.insert(rhs).second;
+      }
+      template <class M>
+      bool insert_or_assign(const K& k, M&& obj)
+      {
+         shard& s = shardOf(k);
+         std::unique_lock<std::shared_mutex> lock(s.lock);
+         return s.m.insert_or_assign(k, std::forward<M>(obj)).second;
+      }
+      size_t erase(const K& k)
+      {
+         shard& s = shardOf(k);
+         std::unique_lock<std::shared_mutex> lock(s.lock);
+         return s.m.erase(k);
+      }
+      void clear();
+
+      //
+      // Batches: one lock a shard, not one a key
+      //
+      template <class Iterator>
+      std::vector<std::optional<V>> find_many(Iterator first, Iterator last) const;
+      template <class Iterator>
+      size_t insert_many(Iterator first, Iterator last);
+      template <class Iterator>
+      size_t erase_many(Iterator first, Iterator last);
+
+      //
+      // In order: a k-way merge of the shards, all locked shared
+      //
+      template <class F>
+      void for_each_sorted(F&& f) const;
+      template <class F>
+      void visit_range(const K& lo, const K& hi, F&& f) const;
+
+      //
+      // Status
+      //
+      size_t size() const;
+      bool empty() const
+      {
+         return size() == 0;
+      }
+      static constexpr size_t shard_count() noexcept
+      {
+         return Shards;
+      }
+      size_t shard_index(const K& k) const
+      {
+         // std::hash of an integer is often the integer itself: mix
+         // the bits so sequential keys spread out
+         std::uint64_t h = static_cast<std::uint64_t>(hash(k));
+         h ^= h >> 33;
+         h *= 0xff51afd7ed558ccdULL;
+         h ^= h >> 33;
+         return static_cast<size_t>(h % Shards);
+      }
+
+   private:
+
+      // padded so that two shards' locks never share a cache line
+      struct alignas(64) shard
+      {
+         mutable std::shared_mutex lock;
+         map_type m;
+      };
+
+      shard& shardOf(const K& k)
+      {
+         return shards[shard_index(k)];
+      }
+      const shard& shardOf(const K& k) const
+      {
+         return shards[shard_index(k)];
+      }
+
+      template <class Iterator, class KeyOf>
+      std::vector<size_t> groupByShard(Iterator first, size_t n, KeyOf keyOf, size_t (&start)[Shards + 1]) const;
+      template <class F>
+      void merge(F& f, const K* pLo, const K* pHi) const;
+
+      shard shards[Shards];
+      H     hash;
+   };
+
+   /*****************************************************
+    * SHARDED MAP :: FIND
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   std::optional<V> sharded_map<K, V, Shards, C, H, A, P>::find(const K& k) const
+   {
+      const shard& s = shardOf(k);
+      std::shared_lock<std::shared_mutex> lock(s.lock);
+      // only not const because map's iterator is not: find() and end()
+      // write nothing but the relaxed atomic counters of rb_stats, so
+      // readers can share the lock
+      map_type& m = const_cast<map_type&>(s.m);
+      auto it = m.find(k);
+      if (it == m.end())
+         return std::nullopt;
+      return (*it).second;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: AT
+    * A copy of the value, throwing when it is missing
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   V sharded_map<K, V, Shards, C, H, A, P>::at(const K& k) const
+   {
+      const shard& s = shardOf(k);
+      std::shared_lock<std::shared_mutex> lock(s.lock);
+      return s.m.at(k);
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: CLEAR
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   void sharded_map<K, V, Shards, C, H, A, P>::clear()
+   {
+      for (shard& s : shards)
+      {
+         std::unique_lock<std::shared_mutex> lock(s.lock);
+         s.m.clear();
+      }
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: SIZE
+    * The sum of the shards, each counted under its lock
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   size_t sharded_map<K, V, Shards, C, H, A, P>::size() const
+   {
+      size_t n = 0;
+      for (const shard& s : shards)
+      {
+         std::shared_lock<std::shared_mutex> lock(s.lock);
+         n += s.m.size();
+      }
+      return n;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: GROUP BY SHARD
+    * A counting sort of the n elements at first by shard:
+    * the indices of shard i's elements are order[start[i]]
+    * up to order[start[i+1]], each in the order given
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class Iterator, class KeyOf>
+   std::vector<size_t> sharded_map<K, V, Shards, C, H, A, P>::groupByShard(Iterator first, size_t n, KeyOf keyOf,
+                                                                          size_t (&start)[Shards + 1]) const
+   {
+      std::vector<size_t> shardOfElement(n);
+      for (size_t i = 0; i <= Shards; i++)
+         start[i] = 0;
+      Iterator it = first;
+      for (size_t i = 0; i < n; i++, ++it)
+      {
+         shardOfElement[i] = shard_index(keyOf(*it));
+         start[shardOfElement[i] + 1]++;
+      }
+      for (size_t i = 0; i < Shards; i++)
+         start[i + 1] += start[i];
+
+      std::vector<size_t> order(n);
+      size_t next[Shards];
+      for (size_t i = 0; i < Shards; i++)
+         next[i] = start[i];
+      for (size_t i = 0; i < n; i++)
+         order[next[shardOfElement[i]]++] = i;
+      return order;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: FIND MANY
+    * The value for each key, or nothing, in the order of
+    * the keys. Each shard is locked once, shared.
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class Iterator>
+   std::vector<std::optional<V>> sharded_map<K, V, Shards, C, H, A, P>::find_many(Iterator first,
+                                                                                 Iterator last) const
+   {
+      std::vector<const K*> keys;
+      for (; first != last; ++first)
+         keys.push_back(&*first);
+
+      size_t start[Shards + 1];
+      std::vector<size_t> order = groupByShard(keys.begin(), keys.size(),
+                                               [](const K* pKey) -> const K& { return *pKey; }, start);
+      std::vector<std::optional<V>> values(keys.size());
+      for (size_t i = 0; i < Shards; i++)
+      {
+         if (start[i] == start[i + 1])
+            continue;
+         std::shared_lock<std::shared_mutex> lock(shards[i].lock);
+         map_type& m = const_cast<map_type&>(shards[i].m);   // read only, as in find()
+         for (size_t j = start[i]; j < start[i + 1]; j++)
+         {
+            auto it = m.find(*keys[order[j]]);
+            if (it != m.end())
+               values[order[j]] = (*it).second;
+         }
+      }
+      return values;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: INSERT MANY
+    * Insert each pair whose key is not there yet; a key given
+    * twice keeps the first. Returns how many went in.
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class Iterator>
+   size_t sharded_map<K, V, Shards, C, H, A, P>::insert_many(Iterator first, Iterator last)
+   {
+      std::vector<const Pair*> pairs;
+      for (; first != last; ++first)
+         pairs.push_back(&*first);
+
+      size_t start[Shards + 1];
+      std::vector<size_t> order = groupByShard(pairs.begin(), pairs.size(),
+                                               [](const Pair* pPair) -> const K& { return pPair->first; }, start);
+      size_t numInserted = 0;
+      for (size_t i = 0; i < Shards; i++)
+      {
+         if (start[i] == start[i + 1])
+            continue;
+         std::unique_lock<std::shared_mutex> lock(shards[i].lock);
+         for (size_t j = start[i]; j < start[i + 1]; j++)
+            numInserted += shards[i].m.insert(*pairs[order[j]]).second ? 1 : 0;
+      }
+      return numInserted;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: ERASE MANY
+    * Erase every key given. Returns how many were there.
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class Iterator>
+   size_t sharded_map<K, V, Shards, C, H, A, P>::erase_many(Iterator first, Iterator last)
+   {
+      std::vector<const K*> keys;
+      for (; first != last; ++first)
+         keys.push_back(&*first);
+
+      size_t start[Shards + 1];
+      std::vector<size_t> order = groupByShard(keys.begin(), keys.size(),
+                                               [](const K* pKey) -> const K& { return *pKey; }, start);
+      size_t numErased = 0;
+      for (size_t i = 0; i < Shards; i++)
+      {
+         if (start[i] == start[i + 1])
+            continue;
+         std::unique_lock<std::shared_mutex> lock(shards[i].lock);
+         for (size_t j = start[i]; j < start[i + 1]; j++)
+            numErased += shards[i].m.erase(*keys[order[j]]);
+      }
+      return numErased;
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: FOR EACH SORTED
+    * f(pair) for every pair, in key order across the shards
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class F>
+   void sharded_map<K, V, Shards, C, H, A, P>::for_each_sorted(F&& f) const
+   {
+      merge(f, nullptr, nullptr);
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: VISIT RANGE
+    * f(pair) for every key in [lo, hi), in order
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class F>
+   void sharded_map<K, V, Shards, C, H, A, P>::visit_range(const K& lo, const K& hi, F&& f) const
+   {
+      merge(f, &lo, &hi);
+   }
+
+   /*****************************************************
+    * SHARDED MAP :: MERGE
+    * Every shard locked shared (in order) for the whole walk,
+    * so it sees one moment. A heap of each shard's next pair
+    * says which comes next: O(n log Shards). From the lower
+    * bound of *pLo, or the start, and to *pHi, or the end.
+    ****************************************************/
+   template <class K, class V, std::size_t Shards, class C, class H, class A, class P>
+   template <class F>
+   void sharded_map<K, V, Shards, C, H, A, P>::merge(F& f, const K* pLo, const K* pHi) const
+   {
+      using iterator = typename map_type::iterator;
+      struct cursor
+      {
+         iterator it;
+         iterator itEnd;
+      };
+
+      std::vector<std::shared_lock<std::shared_mutex>> locks;
+      locks.reserve(Shards);
+      for (const shard& s : shards)
+         locks.emplace_back(s.lock);
+
+      C comp = shards[0].m.key_comp();
+      auto later = [&comp](const cursor& lhs, const cursor& rhs)
+      {
+         return comp((*rhs.it).first, (*lhs.it).first);
+      };
+      std::priority_queue<cursor, std::vector<cursor>, decltype(later)> heap(later);
+      for (const shard& s : shards)
+      {
+         // map's iterators are not const, but nothing here writes to the
+         // tree: begin() walks down for an end it does not know rather
+         // than caching it, and lower_bound() and ++ only read
+         map_type& m = const_cast<map_type&>(s.m);
+         cursor c{ pLo ? m.lower_bound(*pLo) : m.begin(), m.end() };
+         if (c.it != c.itEnd)
+            heap.push(c);
+      }
+
+      while (!heap.empty())
+      {
+         cursor c = heap.top();
+         heap.pop();
+         if (pHi && !comp((*c.it).first, *pHi))
+            continue;                          // this shard is done
+         f(*c.it);
+         if (++c.it != c.itEnd)
+            heap.push(c);
+      }
+   }
+
+}; //  namespace custom
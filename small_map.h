@@ -0,0 +1,711 @@
+/***********************************************************************
+ * Header:
+ *    SMALL MAP
+ * Summary:
+ *    A map that keeps its first few pairs inside itself. Up to N
+ *    pairs sit in a sorted array in the map object, searched one
+ *    after another with no pointers to chase and no allocation at
+ *    all. The pair that would make N + 1 moves them all into a
+ *    custom::map, built in O(N) from the sorted array, and from then
+ *    on the map does the work. For the many maps that only ever hold
+ *    a handful of pairs, made and thrown away by the million.
+ *
+ *    This will contain the class definition of:
+ *        small_map           : A class that represents a small map
+ *        small_map::iterator : An iterator through a small map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "bst.h"             // for custom::compare_base
+#include "map.h"             // for custom::map, where the pairs spill to
+#include <cassert>
+#include <cstddef>           // for std::size_t
+#include <initializer_list>  // for std::initializer_list
+#include <iterator>          // for std::make_move_iterator
+#include <memory>            // for std::allocator
+#include <new>               // for std::launder and placement new
+#include <stdexcept>         // for std::out_of_range
+#include <tuple>             // for std::forward_as_tuple
+#include <utility>           // for std::piecewise_construct
+
+class TestSmallMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * SMALL MAP
+ * While it is inline, the first numInline slots of the array hold
+ * the pairs, sorted and unique by key. Once spilled, the array is
+ * empty and the pairs are all in the map, which the small map then
+ * stays until clear().
+ *
+ * Inserting and erasing shift the inline array, and spilling moves
+ * every pair, so they invalidate iterators. After the spill the
+ * map's rules apply.
+ *****************************************************************/
+   template <class K, class V, std::size_t N = 8, class C = std::less<K>,
+             class A = std::allocator<custom::pair<K, V>>, class P = rb_default>
+   class small_map : private compare_base<C>
+   {
+      friend class ::TestSmallMap;
+      static_assert(N > 0, "a small map needs room for at least one pair");
+   public:
+      using map_type = custom::map<K, V, C, A, P>;
+      using Pair = typename map_type::Pair;
+      using key_type = K;
+      using mapped_type = V;
+      using key_compare = C;
+      using allocator_type = A;
+      static constexpr std::size_t inline_capacity = N;
+
+      //
+      // Construct
+      //
+      small_map() : compare_base<C>(C()), numInline(0), spilled(false), big()
+      {}
+      explicit small_map(const C& comp, const A& alloc = A())
+         : compare_base<C>(comp), numInline(0), spilled(false), big(comp, alloc)
+      {}
+      explicit small_map(const A& alloc)
+         : compare_base<C>(C()), numInline(0), spilled(false), big(alloc)
+      {}
+      small_map(const small_map& rhs);
+      small_map(small_map&& rhs);
+      template <class Iterator>
+      small_map(Iterator first, Iterator last, const C& comp = C(), const A& alloc = A())
+         : small_map(comp, alloc)
+      {
+         insert(first, last);
+      }
+      small_map(const std::initializer_list<Pair>& il, const C& comp = C(), const A& alloc = A())
+         : small_map(comp, alloc)
+      {
+         insert(il);
+      }
+      ~small_map()
+      {
+         destroyInline();
+      }
+
+      //
+      // Assign
+      //
+      small_map& operator =(const small_map& rhs);
+      small_map& operator =(small_map&& rhs);
+      small_map& operator =(const std::initializer_list<Pair>& il)
+      {
+         clear();
+         insert(il);
+         return *this;
+      }
+
+      //
+      // Iterator
+      //
+      class iterator;
+      iterator begin()
+      {
+         return spilled ? iterator(this, big.begin()) : iterator(this, 0);
+      }
+      iterator rbegin()
+      {
+         // the last pair: walk it back with --
+         if (spilled)
+            return iterator(this, big.rbegin());
+         return iterator(this, numInline == 0 ? 0 : numInline - 1);
+      }
+      iterator end()
+      {
+         return spilled ? iterator(this, big.end()) : iterator(this, numInline);
+      }
+
+      //
+      // Access
+      //
+      V& operator [] (const K& k)
+      {
+         return const_cast<V&>((*tryEmplace(k).first).second);
+      }
+      V& operator [] (K&& k)
+      {
+         return const_cast<V&>((*tryEmplace(std::move(k)).first).second);
+      }
+      const V& at(const K& k) const;
+      V& at(const K& k)
+      {
+         return const_cast<V&>(static_cast<const small_map*>(this)->at(k));
+      }
+      iterator find(const K& k);
+      iterator lower_bound(const K& k)
+      {
+         return spilled ? iterator(this, big.lower_bound(k)) : iterator(this, lowerIndex(k));
+      }
+      iterator upper_bound(const K& k)
+      {
+         return spilled ? iterator(this, big.upper_bound(k)) : iterator(this, upperIndex(k));
+      }
+      custom::pair<iterator, iterator> equal_range(const K& k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+
+      //
+      // Insert
+      //
+      custom::pair<iterator, bool> insert(Pair&& rhs)
+      {
+         return tryEmplace(std::move(rhs.first), std::move(rhs.second));
+      }
+      custom::pair<iterator, bool> insert(const Pair& rhs)
+      {
+         return tryEmplace(rhs.first, rhs.second);
+      }
+      template <class M>
+      custom::pair<iterator, bool> insert_or_assign(const K& k, M&& obj)
+      {
+         return insertOrAssign(k, std::forward<M>(obj));
+      }
+      template <class M>
+      custom::pair<iterator, bool> insert_or_assign(K&& k, M&& obj)
+      {
+         return insertOrAssign(std::move(k), std::forward<M>(obj));
+      }
+
+      // the inline array holds pairs, so the pair is built first
+      // and moved into its slot
+      template <class ... Args>
+      custom::pair<iterator, bool> emplace(Args&& ... args)
+      {
+         return insert(Pair(std::forward<Args>(args)...));
+      }
+      template <class ... Args>
+      custom::pair<iterator, bool> try_emplace(const K& k, Args&& ... args)
+      {
+         return tryEmplace(k, std::forward<Args>(args)...);
+      }
+      template <class ... Args>
+      custom::pair<iterator, bool> try_emplace(K&& k, Args&& ... args)
+      {
+         return tryEmplace(std::move(k), std::forward<Args>(args)...);
+      }
+
+      // one at a time while they fit, and whatever is left once the
+      // pairs have spilled goes to the map's bulk insert
+      template <class Iterator>
+      void insert(Iterator first, Iterator last);
+      void insert(const std::initializer_list<Pair>& il)
+      {
+         insert(il.begin(), il.end());
+      }
+
+      //
+      // Remove
+      //
+      void clear() noexcept
+      {
+         // back to inline: a cleared map is as cheap as a new one
+         destroyInline();
+         big.clear();
+         spilled = false;
+      }
+      size_t   erase(const K& k);
+      iterator erase(iterator it);
+
+      //
+      // Status
+      //
+      bool empty() const noexcept
+      {
+         return size() == 0;
+      }
+      size_t size() const noexcept
+      {
+         return spilled ? big.size() : numInline;
+      }
+      size_t count(const K& k) const
+      {
+         return spilled ? big.count(k) : (findIndex(k) != numInline ? 1 : 0);
+      }
+      bool is_inline() const noexcept
+      {
+         return !spilled;
+      }
+      allocator_type get_allocator() const
+      {
+         return big.get_allocator();
+      }
+      key_compare key_comp() const
+      {
+         return this->compare();
+      }
+
+   private:
+
+      // the inline array: the first numInline slots are live
+      Pair* slots() noexcept
+      {
+         return std::launder(reinterpret_cast<Pair*>(storage));
+      }
+      const Pair* slots() const noexcept
+      {
+         return std::launder(reinterpret_cast<const Pair*>(storage));
+      }
+
+      size_t lowerIndex(const K& k) const;
+      size_t upperIndex(const K& k) const;
+      size_t findIndex(const K& k) const;
+      iterator insertAt(size_t i, Pair&& pair);
+      void eraseAt(size_t i);
+      void spill();
+      void copyInline(const small_map& rhs);
+      void moveInline(small_map& rhs);
+      void destroyInline() noexcept;
+      template <class KK, class ... Args>
+      custom::pair<iterator, bool> tryEmplace(KK&& k, Args&& ... args);
+      template <class KK, class M>
+      custom::pair<iterator, bool> insertOrAssign(KK&& k, M&& obj);
+
+      alignas(Pair) unsigned char storage[N * sizeof(Pair)];  // room for N pairs
+      size_t   numInline;   // pairs in the inline array
+      bool     spilled;     // are the pairs in big instead?
+      map_type big;         // where they go past N; empty until then
+   };
+
+
+   /**********************************************************
+    * SMALL MAP ITERATOR
+    * An index into the inline array or, once the pairs have
+    * spilled, an iterator into the map. Which one is read off
+    * the small map itself.
+    *********************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   class small_map<K, V, N, C, A, P>::iterator
+   {
+      friend class ::TestSmallMap;
+      friend class small_map<K, V, N, C, A, P>;
+   public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Pair*;
+      using reference         = const Pair&;
+
+      //
+      // Construct
+      //
+      iterator() : pMap(nullptr), i(0)
+      {}
+      iterator(small_map* pMap, size_t i) : pMap(pMap), i(i)
+      {}
+      iterator(small_map* pMap, const typename map_type::iterator& it) : pMap(pMap), i(0), it(it)
+      {}
+
+      //
+      // Compare
+      //
+      bool operator ==(const iterator& rhs) const
+      {
+         return pMap == rhs.pMap && i == rhs.i && it == rhs.it;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      //
+      // Access
+      //
+      reference operator *() const
+      {
+         return pMap->spilled ? *it : pMap->slots()[i];
+      }
+
+      //
+      // Increment: back from the first pair is the end, as in map
+      //
+      iterator& operator ++()
+      {
+         if (pMap->spilled)
+            ++it;
+         else
+            ++i;
+         return *this;
+      }
+      iterator operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         if (pMap->spilled)
+            --it;
+         else
+            i = (i == 0) ? pMap->numInline : i - 1;
+         return *this;
+      }
+      iterator operator --(int postfix)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+
+      small_map*                     pMap;  // the map this walks
+      size_t                         i;     // index into the inline array
+      typename map_type::iterator    it;    // position in big, once spilled
+   };
+
+
+   /*****************************************************
+    * SMALL MAP :: COPY CONSTRUCTOR
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   small_map<K, V, N, C, A, P>::small_map(const small_map& rhs)
+      : compare_base<C>(rhs.compare()), numInline(0), spilled(rhs.spilled), big(rhs.big)
+   {
+      copyInline(rhs);
+   }
+
+   /*****************************************************
+    * SMALL MAP :: MOVE CONSTRUCTOR
+    * rhs is left empty, and inline
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   small_map<K, V, N, C, A, P>::small_map(small_map&& rhs)
+      : compare_base<C>(rhs.compare()), numInline(0), spilled(rhs.spilled), big(std::move(rhs.big))
+   {
+      moveInline(rhs);
+      rhs.clear();
+   }
+
+   /*****************************************************
+    * SMALL MAP :: ASSIGNMENT OPERATOR
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   small_map<K, V, N, C, A, P>& small_map<K, V, N, C, A, P>::operator =(const small_map& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         compare_base<C>::operator =(rhs);
+         big = rhs.big;
+         spilled = rhs.spilled;
+         copyInline(rhs);
+      }
+      return *this;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: ASSIGN-MOVE OPERATOR
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   small_map<K, V, N, C, A, P>& small_map<K, V, N, C, A, P>::operator =(small_map&& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         compare_base<C>::operator =(rhs);
+         big = std::move(rhs.big);
+         spilled = rhs.spilled;
+         moveInline(rhs);
+         rhs.clear();
+      }
+      return *this;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: COPY INLINE
+    * Copy rhs's inline pairs into our empty array. If one
+    * throws, the ones copied so far are destroyed again.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void small_map<K, V, N, C, A, P>::copyInline(const small_map& rhs)
+   {
+      try
+      {
+         for (; numInline < rhs.numInline; numInline++)
+            ::new (static_cast<void*>(slots() + numInline)) Pair(rhs.slots()[numInline]);
+      }
+      catch (...)
+      {
+         destroyInline();
+         throw;
+      }
+   }
+
+   /*****************************************************
+    * SMALL MAP :: MOVE INLINE
+    * Move rhs's inline pairs into our empty array
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void small_map<K, V, N, C, A, P>::moveInline(small_map& rhs)
+   {
+      try
+      {
+         for (; numInline < rhs.numInline; numInline++)
+            ::new (static_cast<void*>(slots() + numInline)) Pair(std::move(rhs.slots()[numInline]));
+      }
+      catch (...)
+      {
+         destroyInline();
+         throw;
+      }
+   }
+
+   /*****************************************************
+    * SMALL MAP :: DESTROY INLINE
+    * Destroy the pairs in the inline array, leaving it empty
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void small_map<K, V, N, C, A, P>::destroyInline() noexcept
+   {
+      if constexpr (!std::is_trivially_destructible<Pair>::value)
+         for (size_t i = 0; i < numInline; i++)
+            slots()[i].~Pair();
+      numInline = 0;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: LOWER INDEX
+    * Index of the first inline key that does not go before k.
+    * With so few keys, one after another beats a binary search:
+    * no hard-to-predict branches, and the loop stops early.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   size_t small_map<K, V, N, C, A, P>::lowerIndex(const K& k) const
+   {
+      const C& comp = this->compare();
+      const Pair* pSlots = slots();
+      size_t i = 0;
+      while (i < numInline && comp(pSlots[i].first, k))
+         i++;
+      return i;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: UPPER INDEX
+    * Index of the first inline key that goes after k
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   size_t small_map<K, V, N, C, A, P>::upperIndex(const K& k) const
+   {
+      const C& comp = this->compare();
+      const Pair* pSlots = slots();
+      size_t i = 0;
+      while (i < numInline && !comp(k, pSlots[i].first))
+         i++;
+      return i;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: FIND INDEX
+    * Index of the inline key equivalent to k, or numInline
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   size_t small_map<K, V, N, C, A, P>::findIndex(const K& k) const
+   {
+      size_t i = lowerIndex(k);
+      if (i == numInline || this->compare()(k, slots()[i].first))
+         return numInline;
+      return i;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: FIND
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   typename small_map<K, V, N, C, A, P>::iterator small_map<K, V, N, C, A, P>::find(const K& k)
+   {
+      if (spilled)
+         return iterator(this, big.find(k));
+      return iterator(this, findIndex(k));
+   }
+
+   /*****************************************************
+    * SMALL MAP :: AT
+    * Retrieve an element, throwing when it is missing
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   const V& small_map<K, V, N, C, A, P>::at(const K& k) const
+   {
+      if (spilled)
+         return big.at(k);
+      size_t i = findIndex(k);
+      if (i == numInline)
+         throw std::out_of_range("invalid map<K, T> key");
+      return slots()[i].second;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: INSERT AT
+    * Move pair into slot i of the inline array, shifting the
+    * pairs from i up one slot. There must be room.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   typename small_map<K, V, N, C, A, P>::iterator small_map<K, V, N, C, A, P>::insertAt(size_t i, Pair&& pair)
+   {
+      assert(numInline < N && i <= numInline);
+      Pair* pSlots = slots();
+      if (i == numInline)
+         ::new (static_cast<void*>(pSlots + numInline)) Pair(std::move(pair));
+      else
+      {
+         ::new (static_cast<void*>(pSlots + numInline)) Pair(std::move(pSlots[numInline - 1]));
+         for (size_t j = numInline - 1; j > i; j--)
+            pSlots[j] = std::move(pSlots[j - 1]);
+         pSlots[i] = std::move(pair);
+      }
+      numInline++;
+      return iterator(this, i);
+   }
+
+   /*****************************************************
+    * SMALL MAP :: ERASE AT
+    * Take slot i out of the inline array, shifting the pairs
+    * after it down one slot
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void small_map<K, V, N, C, A, P>::eraseAt(size_t i)
+   {
+      Pair* pSlots = slots();
+      for (size_t j = i + 1; j < numInline; j++)
+         pSlots[j - 1] = std::move(pSlots[j]);
+      pSlots[numInline - 1].~Pair();
+      numInline--;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: SPILL
+    * Move the inline pairs into the map. They are sorted and
+    * unique already, so the tree is built in O(N) with no
+    * comparisons.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void small_map<K, V, N, C, A, P>::spill()
+   {
+      assert(!spilled);
+      Pair* pSlots = slots();
+      big = map_type(sorted_unique, std::make_move_iterator(pSlots), std::make_move_iterator(pSlots + numInline),
+                     key_comp(), big.get_allocator());
+      destroyInline();
+      spilled = true;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: TRY EMPLACE
+    * Search by key alone and only touch args when it is
+    * missing. A full array spills first.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   template <class KK, class ... Args>
+   custom::pair<typename small_map<K, V, N, C, A, P>::iterator, bool>
+      small_map<K, V, N, C, A, P>::tryEmplace(KK&& k, Args&& ... args)
+   {
+      if (!spilled)
+      {
+         size_t i = lowerIndex(k);
+         if (i != numInline && !this->compare()(k, slots()[i].first))
+            return custom::make_pair(iterator(this, i), false);
+         if (numInline < N)
+            return custom::make_pair(insertAt(i, Pair(std::piecewise_construct,
+                                                      std::forward_as_tuple(std::forward<KK>(k)),
+                                                      std::forward_as_tuple(std::forward<Args>(args)...))),
+                                     true);
+         spill();
+      }
+
+      auto itPair = big.try_emplace(std::forward<KK>(k), std::forward<Args>(args)...);
+      return custom::make_pair(iterator(this, itPair.first), itPair.second);
+   }
+
+   /*****************************************************
+    * SMALL MAP :: INSERT OR ASSIGN
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   template <class KK, class M>
+   custom::pair<typename small_map<K, V, N, C, A, P>::iterator, bool>
+      small_map<K, V, N, C, A, P>::insertOrAssign(KK&& k, M&& obj)
+   {
+      if (spilled)
+      {
+         auto itPair = big.insert_or_assign(std::forward<KK>(k), std::forward<M>(obj));
+         return custom::make_pair(iterator(this, itPair.first), itPair.second);
+      }
+
+      size_t i = findIndex(k);
+      if (i != numInline)
+      {
+         slots()[i].second = std::forward<M>(obj);
+         return custom::make_pair(iterator(this, i), false);
+      }
+      return tryEmplace(std::forward<KK>(k), std::forward<M>(obj));
+   }
+
+   /*****************************************************
+    * SMALL MAP :: INSERT RANGE
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   template <class Iterator>
+   void small_map<K, V, N, C, A, P>::insert(Iterator first, Iterator last)
+   {
+      for (; first != last && !spilled; ++first)
+         insert(*first);
+      if (first != last)
+         big.insert(first, last);
+   }
+
+   /*****************************************************
+    * SMALL MAP :: ERASE
+    * Erase by key: 1 if it was there, 0 otherwise
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   size_t small_map<K, V, N, C, A, P>::erase(const K& k)
+   {
+      if (spilled)
+         return big.erase(k);
+      size_t i = findIndex(k);
+      if (i == numInline)
+         return 0;
+      eraseAt(i);
+      return 1;
+   }
+
+   /*****************************************************
+    * SMALL MAP :: ERASE
+    * Erase one element, returning the one after it. Inline,
+    * that one moves into the erased slot.
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   typename small_map<K, V, N, C, A, P>::iterator small_map<K, V, N, C, A, P>::erase(iterator it)
+   {
+      if (spilled)
+         return iterator(this, big.erase(it.it));
+      if (it.i >= numInline)
+         return end();
+      eraseAt(it.i);
+      return iterator(this, it.i);
+   }
+
+   /*****************************************************
+    * SWAP
+    * Swap two small maps. The inline pairs have to move, so
+    * this is O(N), not O(1).
+    ****************************************************/
+   template <class K, class V, std::size_t N, class C, class A, class P>
+   void swap(small_map<K, V, N, C, A, P>& lhs, small_map<K, V, N, C, A, P>& rhs)
+   {
+      small_map<K, V, N, C, A, P> temp(std::move(lhs));
+      lhs = std::move(rhs);
+      rhs = std::move(temp);
+   }
+
+}; //  namespace custom
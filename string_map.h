@@ -0,0 +1,964 @@
+/***********************************************************************
+ * Header:
+ *    STRING MAP
+ * Summary:
+ *    A map from std::string keys with the interface of custom::map,
+ *    for keys such as URLs and paths that share long prefixes. The
+ *    keys are kept sorted in blocks of up to B, like the leaves of a
+ *    B+tree, and within a block every key after the first is front
+ *    coded: how many leading bytes it shares with the key before it,
+ *    and the bytes after those. A shared prefix is stored once a block
+ *    instead of once a key, and there are no nodes and no pointers
+ *    per key.
+ *
+ *    A lookup binary searches the first keys of the blocks, then runs
+ *    along one block comparing only the bytes where each key differs
+ *    from the one before it: a key that shares more with its neighbor
+ *    than that neighbor shares with the one looked for is passed over
+ *    without reading it at all.
+ *
+ *    Inserting or erasing recodes one or two keys and shifts the rest
+ *    of one block, so it invalidates iterators, as the B+tree does.
+ *
+ *    This will contain the class definition of:
+ *        string_map            : A class that represents a string map
+ *        string_map::iterator  : An iterator through a string map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include "pair.h"            // for custom::pair
+#include "map.h"             // for custom::map, to convert from
+#include <algorithm>         // for std::upper_bound
+#include <cstddef>           // for std::size_t
+#include <initializer_list>  // for std::initializer_list
+#include <iterator>          // for std::bidirectional_iterator_tag
+#include <memory>            // for std::allocator_traits
+#include <stdexcept>         // for std::out_of_range
+#include <string>            // for std::string
+#include <string_view>       // for std::string_view
+#include <type_traits>       // for std::is_base_of
+#include <utility>           // for std::pair
+#include <vector>            // for std::vector
+
+class TestStringMap;
+
+namespace custom
+{
+
+/*****************************************************************
+ * STRING MAP
+ * Keys in the order of std::less<std::string>: bytes compared as
+ * unsigned char, a prefix before anything longer. B is the most
+ * keys a block holds. A is an allocator of pairs, as for map,
+ * rebound for the values and the coded keys.
+ *****************************************************************/
+   template <class V, class A = std::allocator<custom::pair<std::string, V>>, std::size_t B = 32>
+   class string_map
+   {
+      static_assert(B >= 4, "a block holds at least four keys");
+
+      friend class ::TestStringMap;
+
+      template <class VV, class AA, std::size_t BB>
+      friend void swap(string_map<VV, AA, BB>& lhs, string_map<VV, AA, BB>& rhs);
+   public:
+      using Pair = custom::pair<std::string, V>;
+      using key_type = std::string;
+      using mapped_type = V;
+      using allocator_type = A;
+
+      class iterator;
+
+      //
+      // Construct
+      //
+      string_map() : numElements(0)
+      {}
+      explicit string_map(const A& alloc) : alloc(alloc), numElements(0)
+      {}
+      string_map(const string_map& rhs) = default;
+      string_map(string_map&& rhs) noexcept
+         : alloc(std::move(rhs.alloc)), firsts(std::move(rhs.firsts)), blocks(std::move(rhs.blocks)),
+           numElements(rhs.numElements)
+      {
+         rhs.clear();
+      }
+      template <class Iterator>
+      string_map(Iterator first, Iterator last, const A& alloc = A()) : alloc(alloc), numElements(0)
+      {
+         insert(first, last);
+      }
+      string_map(const std::initializer_list<Pair>& il, const A& alloc = A()) : alloc(alloc), numElements(0)
+      {
+         insert(il.begin(), il.end());
+      }
+      template <class C, class AA, class PP>
+      explicit string_map(const map<std::string, V, C, AA, PP>& rhs) : numElements(0)
+      {
+         insert(rhs.bst.begin(), rhs.bst.end());
+      }
+      ~string_map()
+      {}
+
+      //
+      // Assign
+      //
+      string_map& operator =(const string_map& rhs) = default;
+      string_map& operator =(string_map&& rhs) noexcept
+      {
+         clear();
+         swap(rhs);
+         return *this;
+      }
+      string_map& operator =(const std::initializer_list<Pair>& il)
+      {
+         clear();
+         insert(il.begin(), il.end());
+         return *this;
+      }
+      void swap(string_map& rhs) noexcept
+      {
+         std::swap(alloc, rhs.alloc);
+         firsts.swap(rhs.firsts);
+         blocks.swap(rhs.blocks);
+         std::swap(numElements, rhs.numElements);
+      }
+
+      //
+      // Iterator
+      //
+      iterator begin()
+      {
+         cursor c;
+         if (!blocks.empty())
+            c.key = firsts[0];
+         return iterator(this, std::move(c));
+      }
+      iterator rbegin()
+      {
+         cursor c = endCursor();
+         backward(c);
+         return iterator(this, std::move(c));
+      }
+      iterator end()
+      {
+         return iterator(this, endCursor());
+      }
+
+      //
+      // Access: any key that converts to a std::string_view
+      //
+      V& operator [] (std::string_view k)
+      {
+         return (*tryEmplace(k).first).second;
+      }
+      V& at(std::string_view k);
+      const V& at(std::string_view k) const;
+      iterator find(std::string_view k);
+      iterator lower_bound(std::string_view k)
+      {
+         bool equal;
+         return iterator(this, lowerCursor(k, equal));
+      }
+      iterator upper_bound(std::string_view k)
+      {
+         bool equal;
+         cursor c = lowerCursor(k, equal);
+         if (equal)
+            forward(c);
+         return iterator(this, std::move(c));
+      }
+      custom::pair<iterator, iterator> equal_range(std::string_view k)
+      {
+         return custom::pair<iterator, iterator>(lower_bound(k), upper_bound(k));
+      }
+
+      // call f(key, value) for every key that starts with prefix, in order
+      template <class F>
+      void visit_prefix(std::string_view prefix, F&& f) const;
+
+      //
+      // Insert
+      //
+      custom::pair<iterator, bool> insert(const Pair& rhs)
+      {
+         return tryEmplace(rhs.first, rhs.second);
+      }
+      custom::pair<iterator, bool> insert(Pair&& rhs)
+      {
+         return tryEmplace(rhs.first, std::move(rhs.second));
+      }
+      template <class M>
+      custom::pair<iterator, bool> insert_or_assign(std::string_view k, M&& obj);
+      template <class ... Args>
+      custom::pair<iterator, bool> try_emplace(std::string_view k, Args&& ... args)
+      {
+         return tryEmplace(k, std::forward<Args>(args)...);
+      }
+      template <class Iterator>
+      void insert(Iterator first, Iterator last);
+      void insert(const std::initializer_list<Pair>& il)
+      {
+         insert(il.begin(), il.end());
+      }
+
+      //
+      // Remove
+      //
+      void clear() noexcept
+      {
+         firsts.clear();
+         blocks.clear();
+         numElements = 0;
+      }
+      size_t erase(std::string_view k);
+      iterator erase(iterator it);
+
+      //
+      // Status
+      //
+      bool empty() const noexcept
+      {
+         return numElements == 0;
+      }
+      size_t size() const noexcept
+      {
+         return numElements;
+      }
+      size_t count(std::string_view k) const
+      {
+         cursor c;
+         return lowerBound(k, c) ? 1 : 0;
+      }
+      allocator_type get_allocator() const
+      {
+         return alloc;
+      }
+
+   private:
+      using ByteAlloc  = typename std::allocator_traits<A>::template rebind_alloc<unsigned char>;
+      using ValueAlloc = typename std::allocator_traits<A>::template rebind_alloc<V>;
+      using bytes_type = std::vector<unsigned char, ByteAlloc>;
+
+      // the keys after the first, coded, and every key's value
+      struct block
+      {
+         explicit block(const A& alloc) : suffixes(ByteAlloc(alloc)), values(ValueAlloc(alloc))
+         {}
+
+         bytes_type                 suffixes;  // shared count, rest count, rest: for keys 1 on
+         std::vector<V, ValueAlloc> values;    // values[i] goes with key i
+      };
+
+      // a key in a block, spelled out
+      struct cursor
+      {
+         size_t      b = 0;     // which block
+         size_t      i = 0;     // which key in the block
+         size_t      next = 0;  // where key i + 1 starts in the suffixes
+         std::string key;       // key i
+      };
+
+      cursor endCursor() const
+      {
+         cursor c;
+         c.b = blocks.size();
+         return c;
+      }
+      void seek(cursor& c) const;
+      void forward(cursor& c) const;
+      void backward(cursor& c) const;
+
+      bool lowerBound(std::string_view k, cursor& c) const;
+      cursor lowerCursor(std::string_view k, bool& equal) const;
+
+      template <class ... Args>
+      custom::pair<iterator, bool> tryEmplace(std::string_view k, Args&& ... args);
+      void insertAt(cursor& c, std::string_view k, V&& value);
+      void eraseAt(cursor& c);
+      void split(size_t b, cursor& c);
+      void join(size_t b);
+
+      static void putSize(bytes_type& bytes, size_t n);
+      static size_t getSize(const unsigned char* bytes, size_t& pos) noexcept;
+      static size_t shared(std::string_view lhs, std::string_view rhs) noexcept;
+      static void encode(bytes_type& bytes, std::string_view prev, std::string_view key);
+      static void decode(const bytes_type& bytes, size_t& pos, std::string& key);
+
+      A                        alloc;
+      std::vector<std::string> firsts;   // firsts[b] is the first key of blocks[b]
+      std::vector<block>       blocks;
+      size_t                   numElements;
+   };
+
+
+   /**********************************************************
+    * STRING MAP ITERATOR
+    * A key in a block, spelled out as it goes. Dereferencing
+    * gives a pair of references, as for flat_map: the key is
+    * the iterator's own copy.
+    *********************************************************/
+   template <class V, class A, std::size_t B>
+   class string_map<V, A, B>::iterator
+   {
+      friend class ::TestStringMap;
+      friend class string_map<V, A, B>;
+   public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type        = Pair;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = void;
+      using reference         = std::pair<const std::string&, V&>;
+
+      //
+      // Construct
+      //
+      iterator() : pMap(nullptr)
+      {}
+      iterator(string_map* pMap, cursor&& c) : pMap(pMap), c(std::move(c))
+      {}
+
+      //
+      // Compare
+      //
+      bool operator ==(const iterator& rhs) const
+      {
+         return pMap == rhs.pMap && c.b == rhs.c.b && c.i == rhs.c.i;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      //
+      // Access
+      //
+      reference operator *() const
+      {
+         return reference(c.key, pMap->blocks[c.b].values[c.i]);
+      }
+
+      //
+      // Increment: back from the first pair is the end, as in map
+      //
+      iterator& operator ++()
+      {
+         pMap->forward(c);
+         return *this;
+      }
+      iterator operator ++(int postfix)
+      {
+         iterator temp(*this);
+         pMap->forward(c);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         pMap->backward(c);
+         return *this;
+      }
+      iterator operator --(int postfix)
+      {
+         iterator temp(*this);
+         pMap->backward(c);
+         return temp;
+      }
+
+   private:
+
+      string_map* pMap;   // the map whose blocks these are
+      cursor      c;      // where in them
+   };
+
+
+   /*****************************************************
+    * STRING MAP :: AT
+    * Throws std::out_of_range, as map does
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   V& string_map<V, A, B>::at(std::string_view k)
+   {
+      cursor c;
+      if (!lowerBound(k, c))
+         throw std::out_of_range("invalid map<K, T> key");
+      return blocks[c.b].values[c.i];
+   }
+   template <class V, class A, std::size_t B>
+   const V& string_map<V, A, B>::at(std::string_view k) const
+   {
+      cursor c;
+      if (!lowerBound(k, c))
+         throw std::out_of_range("invalid map<K, T> key");
+      return blocks[c.b].values[c.i];
+   }
+
+   /*****************************************************
+    * STRING MAP :: FIND
+    * The search already knows the key and where the next
+    * one starts, so nothing is decoded again
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   typename string_map<V, A, B>::iterator string_map<V, A, B>::find(std::string_view k)
+   {
+      cursor c;
+      if (!lowerBound(k, c))
+         return end();
+      c.key = k;
+      return iterator(this, std::move(c));
+   }
+
+   /*****************************************************
+    * STRING MAP :: VISIT PREFIX
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   template <class F>
+   void string_map<V, A, B>::visit_prefix(std::string_view prefix, F&& f) const
+   {
+      bool equal;
+      for (cursor c = lowerCursor(prefix, equal);
+           c.b < blocks.size() && std::string_view(c.key).substr(0, prefix.size()) == prefix;
+           forward(c))
+         f(static_cast<const std::string&>(c.key), blocks[c.b].values[c.i]);
+   }
+
+   /*****************************************************
+    * STRING MAP :: INSERT OR ASSIGN
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   template <class M>
+   custom::pair<typename string_map<V, A, B>::iterator, bool>
+      string_map<V, A, B>::insert_or_assign(std::string_view k, M&& obj)
+   {
+      cursor c;
+      if (lowerBound(k, c))
+      {
+         blocks[c.b].values[c.i] = std::forward<M>(obj);
+         c.key = k;
+         return custom::pair<iterator, bool>(iterator(this, std::move(c)), false);
+      }
+      return tryEmplace(k, std::forward<M>(obj));
+   }
+
+   /*****************************************************
+    * STRING MAP :: INSERT RANGE
+    * Into an empty map, a range sorted with unique keys
+    * (checked in one pass) fills the blocks one after the
+    * other with no searching. Anything else goes in one
+    * pair at a time. The pairs may be custom::pair or
+    * anything else with a first and a second.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   template <class Iterator>
+   void string_map<V, A, B>::insert(Iterator first, Iterator last)
+   {
+      using category = typename std::iterator_traits<Iterator>::iterator_category;
+      if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+      {
+         bool sorted = empty();
+         if (sorted && first != last)
+            for (Iterator prev = first, it = std::next(first); sorted && it != last; prev = it, ++it)
+               sorted = std::string_view((*prev).first) < std::string_view((*it).first);
+
+         if (sorted)
+         {
+            std::string prev;
+            for (; first != last; ++first)
+            {
+               std::string_view k((*first).first);
+               if (blocks.empty() || blocks.back().values.size() == B)
+               {
+                  blocks.emplace_back(alloc);
+                  firsts.emplace_back(k);
+               }
+               else
+                  encode(blocks.back().suffixes, prev, k);
+               blocks.back().values.push_back((*first).second);
+               prev = k;
+               numElements++;
+            }
+            return;
+         }
+      }
+
+      for (; first != last; ++first)
+         tryEmplace((*first).first, (*first).second);
+   }
+
+   /*****************************************************
+    * STRING MAP :: ERASE
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   size_t string_map<V, A, B>::erase(std::string_view k)
+   {
+      cursor c;
+      if (!lowerBound(k, c))
+         return 0;
+      eraseAt(c);
+      return 1;
+   }
+   template <class V, class A, std::size_t B>
+   typename string_map<V, A, B>::iterator string_map<V, A, B>::erase(iterator it)
+   {
+      cursor c = std::move(it.c);
+      eraseAt(c);
+      if (c.b < blocks.size())
+         seek(c);
+      else
+         c = endCursor();
+      return iterator(this, std::move(c));
+   }
+
+   /*****************************************************
+    * STRING MAP :: SEEK
+    * Spell out key i of block b, from the block's first
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::seek(cursor& c) const
+   {
+      c.key = firsts[c.b];
+      c.next = 0;
+      for (size_t j = 0; j < c.i; j++)
+         decode(blocks[c.b].suffixes, c.next, c.key);
+   }
+
+   /*****************************************************
+    * STRING MAP :: FORWARD
+    * One key on: one entry decoded, or the next block's
+    * first key
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::forward(cursor& c) const
+   {
+      if (++c.i < blocks[c.b].values.size())
+      {
+         decode(blocks[c.b].suffixes, c.next, c.key);
+         return;
+      }
+
+      c.b++;
+      c.i = 0;
+      c.next = 0;
+      if (c.b < blocks.size())
+         c.key = firsts[c.b];
+      else
+         c.key.clear();
+   }
+
+   /*****************************************************
+    * STRING MAP :: BACKWARD
+    * One key back. A key is coded against the one before
+    * it, so this decodes from the block's first key up.
+    * Back from the end is the last key; back from the
+    * first key is the end.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::backward(cursor& c) const
+   {
+      if (c.i > 0)
+         c.i--;
+      else if (c.b > 0)
+      {
+         c.b--;
+         c.i = blocks[c.b].values.size() - 1;
+      }
+      else
+      {
+         c = endCursor();
+         return;
+      }
+      seek(c);
+   }
+
+   /*****************************************************
+    * STRING MAP :: LOWER BOUND
+    * Find the block, then run along it. m is how many bytes
+    * the key before (less than k) shares with k. For each
+    * key, shared is how many it shares with the key before:
+    *    shared > m: it agrees with the one before where that
+    *                one fell below k, so it is below k too
+    *    shared < m: it rose above the key before where that
+    *                one still agreed with k, so it is above k
+    *    shared = m: compare the rest, from byte m on
+    * Sets c to the first key not before k, with next set
+    * when that key is k. Returns whether it is.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   bool string_map<V, A, B>::lowerBound(std::string_view k, cursor& c) const
+   {
+      // the last block whose first key is not after k
+      size_t b = std::upper_bound(firsts.begin(), firsts.end(), k,
+                                  [](std::string_view k, const std::string& first) { return k < first; })
+               - firsts.begin();
+      c.next = 0;
+      if (b == 0)
+      {
+         c.b = 0;
+         c.i = 0;
+         return false;
+      }
+      c.b = --b;
+
+      const std::string& first = firsts[b];
+      size_t m = shared(first, k);
+      if (m == first.size() && m == k.size())
+      {
+         c.i = 0;
+         return true;
+      }
+
+      const unsigned char* suffixes = blocks[b].suffixes.data();
+      size_t count = blocks[b].values.size();
+      size_t pos = 0;
+      for (size_t i = 1; i < count; i++)
+      {
+         size_t numShared = getSize(suffixes, pos);
+         size_t numRest = getSize(suffixes, pos);
+         const unsigned char* rest = suffixes + pos;
+         pos += numRest;
+
+         if (numShared > m)
+            continue;
+         c.i = i;
+         if (numShared < m)
+            return false;
+
+         size_t j = 0;
+         while (j < numRest && m + j < k.size() && rest[j] == static_cast<unsigned char>(k[m + j]))
+            j++;
+         if (j == numRest && m + j == k.size())
+         {
+            c.next = pos;
+            return true;
+         }
+         if (j < numRest && (m + j == k.size() || rest[j] > static_cast<unsigned char>(k[m + j])))
+            return false;
+         m += j;
+      }
+
+      c.b = b + 1;
+      c.i = 0;
+      return false;
+   }
+
+   /*****************************************************
+    * STRING MAP :: LOWER CURSOR
+    * The first key not before k, spelled out
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   typename string_map<V, A, B>::cursor string_map<V, A, B>::lowerCursor(std::string_view k,
+                                                                        bool& equal) const
+   {
+      cursor c;
+      equal = lowerBound(k, c);
+      if (equal)
+         c.key = k;
+      else if (c.b < blocks.size())
+         seek(c);
+      return c;
+   }
+
+   /*****************************************************
+    * STRING MAP :: TRY EMPLACE
+    * Build the value only when the key is not there
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   template <class ... Args>
+   custom::pair<typename string_map<V, A, B>::iterator, bool>
+      string_map<V, A, B>::tryEmplace(std::string_view k, Args&& ... args)
+   {
+      cursor c;
+      if (lowerBound(k, c))
+      {
+         c.key = k;
+         return custom::pair<iterator, bool>(iterator(this, std::move(c)), false);
+      }
+
+      insertAt(c, k, V(std::forward<Args>(args)...));
+      numElements++;
+      return custom::pair<iterator, bool>(iterator(this, std::move(c)), true);
+   }
+
+   /*****************************************************
+    * STRING MAP :: INSERT AT
+    * Put k at c, the first key after it. A key after the
+    * last of one block goes at the end of that block, not
+    * at the front of the next. Only k and the key after it
+    * are coded anew. On return c is at k.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::insertAt(cursor& c, std::string_view k, V&& value)
+   {
+      if (blocks.empty())
+      {
+         firsts.emplace_back(k);
+         blocks.emplace_back(alloc);
+         blocks[0].values.push_back(std::move(value));
+         c = cursor();
+         c.key = k;
+         return;
+      }
+      if (c.i == 0 && c.b > 0)
+      {
+         c.b--;
+         c.i = blocks[c.b].values.size();
+      }
+
+      block& blk = blocks[c.b];
+      bytes_type coded{ ByteAlloc(alloc) };
+      size_t start = 0;
+      size_t end = 0;
+      if (c.i == 0)
+      {
+         // k is the new first key, and the old one is coded against it
+         encode(coded, k, firsts[c.b]);
+         c.next = 0;
+      }
+      else
+      {
+         // the keys on either side of k
+         cursor prev;
+         prev.b = c.b;
+         prev.i = c.i - 1;
+         seek(prev);
+         start = end = prev.next;
+         encode(coded, prev.key, k);
+         c.next = start + coded.size();
+         if (c.i < blk.values.size())
+         {
+            std::string next = prev.key;
+            decode(blk.suffixes, end, next);
+            encode(coded, k, next);
+         }
+      }
+
+      std::string first;
+      if (c.i == 0)
+         first = k;
+      blk.values.insert(blk.values.begin() + c.i, std::move(value));
+      try
+      {
+         blk.suffixes.insert(blk.suffixes.begin() + end, coded.begin(), coded.end());
+      }
+      catch (...)
+      {
+         blk.values.erase(blk.values.begin() + c.i);
+         throw;
+      }
+      blk.suffixes.erase(blk.suffixes.begin() + start, blk.suffixes.begin() + end);
+      if (c.i == 0)
+         firsts[c.b].swap(first);
+      c.key = k;
+
+      if (blk.values.size() > B)
+         split(c.b, c);
+   }
+
+   /*****************************************************
+    * STRING MAP :: SPLIT
+    * Move the back half of a full block into a new one.
+    * Its middle key is spelled out to be the new block's
+    * first; the keys after it are coded against it already
+    * and move over as they are. c follows its key.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::split(size_t b, cursor& c)
+   {
+      size_t half = blocks[b].values.size() / 2;
+      cursor mid;
+      mid.b = b;
+      mid.i = half - 1;
+      seek(mid);
+      size_t start = mid.next;
+      decode(blocks[b].suffixes, mid.next, mid.key);
+
+      firsts.insert(firsts.begin() + b + 1, mid.key);
+      blocks.insert(blocks.begin() + b + 1, block(alloc));
+      block& left = blocks[b];
+      block& right = blocks[b + 1];
+      right.suffixes.assign(left.suffixes.begin() + mid.next, left.suffixes.end());
+      right.values.assign(std::make_move_iterator(left.values.begin() + half),
+                          std::make_move_iterator(left.values.end()));
+      left.suffixes.resize(start);
+      left.values.erase(left.values.begin() + half, left.values.end());
+
+      if (c.b == b && c.i >= half)
+      {
+         c.b++;
+         c.i -= half;
+         c.next -= mid.next;
+      }
+   }
+
+   /*****************************************************
+    * STRING MAP :: ERASE AT
+    * Take out the key at c, coding the key after it against
+    * the key before. A block down to a quarter full joins a
+    * neighbor it fits in with. On return c is at the key
+    * that was after, but not spelled out.
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::eraseAt(cursor& c)
+   {
+      block& blk = blocks[c.b];
+      if (blk.values.size() == 1)
+      {
+         blocks.erase(blocks.begin() + c.b);
+         firsts.erase(firsts.begin() + c.b);
+         c.i = 0;
+         numElements--;
+         return;
+      }
+
+      if (c.i == 0)
+      {
+         // the second key becomes the first; the ones after are coded against it already
+         size_t pos = 0;
+         std::string second = firsts[c.b];
+         decode(blk.suffixes, pos, second);
+         blk.suffixes.erase(blk.suffixes.begin(), blk.suffixes.begin() + pos);
+         firsts[c.b].swap(second);
+      }
+      else
+      {
+         cursor prev;
+         prev.b = c.b;
+         prev.i = c.i - 1;
+         seek(prev);
+         size_t start = prev.next;
+         size_t end = start;
+         std::string key = prev.key;
+         decode(blk.suffixes, end, key);
+         if (c.i + 1 < blk.values.size())
+         {
+            size_t after = end;
+            decode(blk.suffixes, after, key);
+            bytes_type coded{ ByteAlloc(alloc) };
+            encode(coded, prev.key, key);
+            blk.suffixes.insert(blk.suffixes.begin() + after, coded.begin(), coded.end());
+            end = after;
+         }
+         blk.suffixes.erase(blk.suffixes.begin() + start, blk.suffixes.begin() + end);
+      }
+      blk.values.erase(blk.values.begin() + c.i);
+      numElements--;
+
+      size_t numLeft = blk.values.size();
+      if (numLeft <= B / 4)
+      {
+         if (c.b + 1 < blocks.size() && numLeft + blocks[c.b + 1].values.size() <= B)
+            join(c.b);
+         else if (c.b > 0 && blocks[c.b - 1].values.size() + numLeft <= B)
+         {
+            c.i += blocks[c.b - 1].values.size();
+            join(--c.b);
+         }
+      }
+      if (c.i == blocks[c.b].values.size())
+      {
+         c.b++;
+         c.i = 0;
+      }
+   }
+
+   /*****************************************************
+    * STRING MAP :: JOIN
+    * Append block b + 1 to block b: its first key is coded
+    * against b's last, and the rest come as they are
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::join(size_t b)
+   {
+      cursor last;
+      last.b = b;
+      last.i = blocks[b].values.size() - 1;
+      seek(last);
+
+      block& left = blocks[b];
+      block& right = blocks[b + 1];
+      encode(left.suffixes, last.key, firsts[b + 1]);
+      left.suffixes.insert(left.suffixes.end(), right.suffixes.begin(), right.suffixes.end());
+      left.values.insert(left.values.end(), std::make_move_iterator(right.values.begin()),
+                         std::make_move_iterator(right.values.end()));
+      blocks.erase(blocks.begin() + b + 1);
+      firsts.erase(firsts.begin() + b + 1);
+   }
+
+   /*****************************************************
+    * STRING MAP :: PUT SIZE and GET SIZE
+    * Seven bits a byte, low bits first, the top bit set on
+    * all but the last: a count under 128 is one byte
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::putSize(bytes_type& bytes, size_t n)
+   {
+      while (n >= 0x80)
+      {
+         bytes.push_back(static_cast<unsigned char>(n | 0x80));
+         n >>= 7;
+      }
+      bytes.push_back(static_cast<unsigned char>(n));
+   }
+   template <class V, class A, std::size_t B>
+   size_t string_map<V, A, B>::getSize(const unsigned char* bytes, size_t& pos) noexcept
+   {
+      size_t n = 0;
+      for (int shift = 0; ; shift += 7)
+      {
+         unsigned char byte = bytes[pos++];
+         n |= static_cast<size_t>(byte & 0x7f) << shift;
+         if (!(byte & 0x80))
+            return n;
+      }
+   }
+
+   /*****************************************************
+    * STRING MAP :: SHARED
+    * How many leading bytes two keys have in common
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   size_t string_map<V, A, B>::shared(std::string_view lhs, std::string_view rhs) noexcept
+   {
+      size_t n = lhs.size() < rhs.size() ? lhs.size() : rhs.size();
+      size_t i = 0;
+      while (i < n && lhs[i] == rhs[i])
+         i++;
+      return i;
+   }
+
+   /*****************************************************
+    * STRING MAP :: ENCODE and DECODE
+    * A key after prev is the count it shares with prev,
+    * the count of the rest, and the rest
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::encode(bytes_type& bytes, std::string_view prev, std::string_view key)
+   {
+      size_t numShared = shared(prev, key);
+      putSize(bytes, numShared);
+      putSize(bytes, key.size() - numShared);
+      bytes.insert(bytes.end(), key.begin() + numShared, key.end());
+   }
+   template <class V, class A, std::size_t B>
+   void string_map<V, A, B>::decode(const bytes_type& bytes, size_t& pos, std::string& key)
+   {
+      size_t numShared = getSize(bytes.data(), pos);
+      size_t numRest = getSize(bytes.data(), pos);
+      key.resize(numShared);
+      key.append(reinterpret_cast<const char*>(bytes.data() + pos), numRest);
+      pos += numRest;
+   }
+
+   /*****************************************************
+    * SWAP
+    * Swap two string maps
+    ****************************************************/
+   template <class V, class A, std::size_t B>
+   void swap(string_map<V, A, B>& lhs, string_map<V, A, B>& rhs)
+   {
+      lhs.swap(rhs);
+   }
+
+}; //  namespace custom
@@ -20,6 +20,30 @@
 #include <iostream>
 #include <string>
 #include <functional> // for std::less and std::greater
+#include <vector>
+#include <atomic>     // for std::atomic
+
+/***********************************************
+ * THREE WAY LESS
+ * An int comparator that can also compare three ways,
+ * counting how often each is used
+ ***********************************************/
+struct ThreeWayLess
+{
+   bool operator()(int lhs, int rhs) const
+   {
+      numLess++;
+      return lhs < rhs;
+   }
+   int three_way(int lhs, int rhs) const
+   {
+      numThreeWay++;
+      return (lhs < rhs) ? -1 : (rhs < lhs ? 1 : 0);
+   }
+   static void reset() { numLess = numThreeWay = 0; }
+   static inline int numLess = 0;
+   static inline int numThreeWay = 0;
+};
 
  /***********************************************
   * TEST BST
@@ -43,6 +67,13 @@ public:
       test_constructMove_standard();
       test_constructInitializer_empty();
       test_constructInitializer_standard();
+      test_constructInitializer_sorted();
+      test_buildSorted_sizes();
+      test_buildSorted_parallel();
+      test_construct_comparator();
+      test_construct_comparatorNoSpace();
+      test_construct_packed();
+      test_construct_packedNoSpace();
 
       // Assign
       test_assign_emptyToEmpty();
@@ -67,6 +98,10 @@ public:
       // Iterator
       test_begin_empty();
       test_begin_standard();
+      test_begin_cached();
+      test_begin_afterErase();
+      test_begin_knownAfterCopy();
+      test_rbegin_standard();
       test_end_standard();
       test_iterator_increment_standardToParent();
       test_iterator_increment_standardToChild();
@@ -74,6 +109,8 @@ public:
       test_iterator_increment_standardToGrandchild();
       test_iterator_increment_standardToDone();
       test_iterator_increment_standardEnd();
+      test_iterator_threaded();
+      test_iterator_threadedCopy();
       test_iterator_dereference_standardRead();
 
       // Find
@@ -81,16 +118,35 @@ public:
       test_find_standardBegin();
       test_find_standardLast();
       test_find_standardMissing();
+      test_find_threeWay();
+      test_find_threeWayString();
+      test_lowerBound_standard();
+      test_upperBound_standard();
+      test_equalRange_duplicates();
+      test_count_duplicates();
+      test_visitRange_standard();
+      test_visitRange_comparisons();
+      test_boundFrom_sweep();
+      test_boundFrom_comparisons();
 
       // Insert
       test_insert_oneLeft();
       test_insert_oneRight();
       test_insert_duplicate();
       test_insert_keepUnique();
+      test_insert_threeWayKeepUnique();
       test_insertMove_oneLeft();
       test_insertMove_oneRight();
       test_insertMove_duplicate();
       test_insertMove_keepUnique();
+      test_emplace_standard();
+      test_emplace_keepUnique();
+      test_insertHint_append();
+      test_insertHint_before();
+      test_insertHint_after();
+      test_insertHint_wrong();
+      test_insertHint_duplicate();
+      test_emplaceHint_end();
       test_insert_case1();
       test_insert_case2();
       test_insert_case3();
@@ -109,6 +165,16 @@ public:
       test_erase_noChildren();
       test_erase_oneChild();
       test_erase_twoChildren();
+      test_erase_rootLeaf();
+      test_erase_blackLeaf();
+      test_erase_redSibling();
+      test_erase_churn();
+      test_extract_standard();
+      test_extract_end();
+      test_extract_destroy();
+      test_insertHandle_standard();
+      test_insertHandle_duplicate();
+      test_merge_standard();
       test_clear_empty();
       test_clear_standard();
 
@@ -118,9 +184,76 @@ public:
       test_size_empty();
       test_size_standard();
 
+      // Order statistics
+      test_construct_countedSpace();
+      test_rank_standard();
+      test_nth_standard();
+      test_countRange_standard();
+      test_counted_insertErase();
+      test_counted_copyBuild();
+
+      // Parallel
+      test_parallelForEach_all();
+      test_parallelForEach_small();
+      test_splitters_sorted();
+
       report("BST");
    }
    
+   /***************************************
+    * PARALLEL
+    *    BST::parallel_for_each(f, threads)
+    *    BST::splitters(count)
+    ***************************************/
+
+   // every value once, whatever thread it was on
+   void test_parallelForEach_all()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 20000; i++)
+         v.push_back(i);
+      custom::BST<int> bst;
+      bst.buildSorted(v.begin(), v.size());
+      std::vector<std::atomic<int>> seen(v.size());
+      // exercise
+      bst.parallel_for_each([&seen](const int& i) { seen[i]++; }, 4);
+      // verify
+      bool once = true;
+      for (const std::atomic<int>& n : seen)
+         once = once && n.load() == 1;
+      assertUnit(once);
+   }  // teardown
+
+   // a small or empty tree is walked on this thread, in order
+   void test_parallelForEach_small()
+   {  // setup
+      custom::BST<int> bstEmpty;
+      custom::BST<int> bst({ 5, 1, 4, 2, 3 });
+      std::vector<int> values;
+      // exercise
+      bstEmpty.parallel_for_each([&values](const int& i) { values.push_back(i); }, 4);
+      bst.parallel_for_each([&values](const int& i) { values.push_back(i); }, 4);
+      // verify
+      assertUnit(values == std::vector<int>({ 1, 2, 3, 4, 5 }));
+   }  // teardown
+
+   // at least as many as asked for, from the tree, in order
+   void test_splitters_sorted()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 1000; i++)
+         bst.insert((i * 37) % 1000);
+      // exercise
+      std::vector<const int*> keys = bst.splitters(15);
+      // verify
+      assertUnit(keys.size() >= 15);
+      bool sorted = true;
+      for (size_t i = 1; i < keys.size(); i++)
+         sorted = sorted && *keys[i - 1] < *keys[i];
+      assertUnit(sorted);
+      assertUnit(bst.find(*keys[0]) != bst.end());
+   }  // teardown
+
    /***************************************
     * CREATE
     *     BST::BST()
@@ -146,6 +279,88 @@ public:
       assertEmptyFixture(bst);
    }  // teardown
 
+   // a tree ordered by a custom comparator
+   void test_construct_comparator()
+   {  // setup
+      custom::BST<int, std::greater<int>> bst;
+      // exercise
+      bst.insert(20);
+      bst.insert(10);
+      bst.insert(30);
+      // verify
+      //            (20b)
+      //       +------+------+
+      //     (30r)         (10r)
+      assertUnit(bst.numElements == 3);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         assertUnit(bst.root->data == 20);
+         assertUnit(bst.root->pLeft && bst.root->pLeft->data == 30);
+         assertUnit(bst.root->pRight && bst.root->pRight->data == 10);
+      }
+      assertUnit(*bst.begin() == 30);
+   }  // teardown
+
+   // the comparator lives in the tree, and an empty one takes no space
+   void test_construct_comparatorNoSpace()
+   {  // setup
+      struct Members
+      {
+         void* root;
+         size_t numElements;
+         std::allocator<int> alloc;
+         void* pFirst;
+         void* pLast;
+      };
+      // exercise
+      // verify
+      assertUnit(sizeof(custom::BST<int>) == sizeof(Members));
+      assertUnit(sizeof(custom::BST<int, std::greater<int>>) == sizeof(Members));
+   }  // teardown
+
+   // the packed layout keeps the color in the parent pointer
+   void test_construct_packed()
+   {  // setup
+      custom::BST<int, std::less<int>, std::allocator<int>, custom::rb_packed> bst;
+      // exercise
+      for (int i = 1; i <= 7; i++)
+         bst.insert(i);
+      // verify
+      //                 (2b)
+      //        +---------+---------+
+      //      (1b)                (4r)
+      //                     +------+------+
+      //                   (3b)          (6b)
+      //                              +----+----+
+      //                            (5r)      (7r)
+      assertUnit(bst.numElements == 7);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         assertUnit(bst.root->data == 2);
+         assertUnit(bst.root->red() == false);
+         assertUnit(bst.root->parent() == nullptr);
+         assertUnit(bst.root->pRight && bst.root->pRight->red() == true);
+         assertUnit(bst.root->pRight && bst.root->pRight->parent() == bst.root);
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      }
+      int expected = 1;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         assertUnit(*it == expected++);
+   }  // teardown
+
+   // the packed node is one word smaller than the plain one
+   void test_construct_packedNoSpace()
+   {  // setup
+      using Plain  = custom::BST<double, std::less<double>, std::allocator<double>, custom::rb_plain>::BNode;
+      using Packed = custom::BST<double, std::less<double>, std::allocator<double>, custom::rb_packed>::BNode;
+      // exercise
+      // verify
+      assertUnit(sizeof(Packed) == 3 * sizeof(void*) + sizeof(double));
+      assertUnit(sizeof(Packed) < sizeof(Plain));
+   }  // teardown
+
    /***************************************
     * COPY CONSTRUCTOR
     ***************************************/
@@ -421,7 +636,7 @@ public:
       assertUnit(Spy::numAssign() == 0);
       assertUnit(Spy::numAssignMove() == 0);
       assertUnit(Spy::numEquals() == 0);
-      assertUnit(Spy::numLessthan() == 10);
+      assertUnit(Spy::numLessthan() == 11);   // one to see the list is not sorted
       assertStandardFixture(bstDest);
       // teardown
       teardownStandardFixture(bstDest);
@@ -429,6 +644,97 @@ public:
 
 
 
+   // a sorted list is built directly, in order
+   void test_constructInitializer_sorted()
+   {  // setup
+      //                (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20b)     (40b) (60b)     (80b)
+      std::initializer_list<Spy> ilSrc{Spy(20), Spy(30), Spy(40), Spy(50), Spy(60), Spy(70), Spy(80)};
+      Spy::reset();
+      // exercise
+      custom::BST <Spy> bstDest(ilSrc);
+      // verify
+      assertUnit(Spy::numCopy() == 7);
+      assertUnit(Spy::numAlloc() == 7);
+      assertUnit(Spy::numLessthan() == 6);   // check it is sorted, nothing else
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(bstDest.numElements == 7);
+      assertUnit(bstDest.root != nullptr);
+      if (bstDest.root)
+      {
+         assertUnit(bstDest.root->data == Spy(50));
+         assertUnit(bstDest.root->isRed == false);
+         assertUnit(bstDest.root->pLeft->data == Spy(30));
+         assertUnit(bstDest.root->pRight->data == Spy(70));
+         assertUnit(bstDest.root->pRight->pRight->data == Spy(80));
+         assertUnit(bstDest.root->pRight->pRight->isRed == false);
+         assertUnit(bstDest.root->verifyRedBlack(bstDest.root->findDepth()));
+      }
+      // teardown
+      bstDest.clear();
+   }
+
+   // built on four threads or on one, the tree comes out the same
+   void test_buildSorted_parallel()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 20000; i++)
+         v.push_back(i);
+      custom::BST<int> bstOne;
+      custom::BST<int> bstFour;
+      custom::BST<int, std::less<int>, std::allocator<int>, custom::rb_counted<custom::rb_plain>> bstCounted;
+      // exercise
+      bstOne.buildSorted(v.begin(), v.size());
+      bstFour.buildSorted(v.begin(), v.size(), 4);
+      bstCounted.buildSorted(v.begin(), v.size(), 4);
+      // verify
+      assertUnit(bstFour.numElements == 20000);
+      assertUnit(bstFour.root->parent() == nullptr);
+      assertUnit(bstFour.root->verifyRedBlack(bstFour.root->findDepth()));
+      assertUnit(bstFour.root->data == bstOne.root->data);
+      assertUnit(bstFour.root->findDepth() == bstOne.root->findDepth());
+      bool same = true;
+      auto itOne = bstOne.begin();
+      for (auto it = bstFour.begin(); it != bstFour.end(); ++it, ++itOne)
+         same = same && *it == *itOne;
+      assertUnit(same);
+      assertUnit(itOne == bstOne.end());
+      assertUnit(bstCounted.rank(12345) == 12345);
+      assertUnit(*bstCounted.nth(777) == 777);
+   }  // teardown
+
+   // a tree built from sorted values is red-black for every size
+   void test_buildSorted_sizes()
+   {  // setup
+      std::vector<int> v;
+      bool valid = true;
+      for (int n = 0; n <= 40; n++)
+      {
+         custom::BST <int> bst;
+         // exercise
+         bst.buildSorted(v.begin(), v.size());
+         // verify
+         valid = valid && bst.numElements == v.size();
+         if (bst.root)
+         {
+            bst.root->verifyBTree();
+            valid = valid && bst.root->parent() == nullptr;
+            valid = valid && !bst.root->red();
+            valid = valid && bst.root->verifyRedBlack(bst.root->findDepth());
+            valid = valid && bst.root->computeSize() == n;
+         }
+         int expected = 0;
+         for (auto it = bst.begin(); it != bst.end(); ++it)
+            valid = valid && *it == expected++;
+         valid = valid && expected == n;
+         v.push_back(n);
+      }
+      assertUnit(valid);
+   }  // teardown
+
    /***************************************
     * EMPTY and SIZE
     ***************************************/
@@ -537,6 +843,131 @@ public:
       teardownStandardFixture(bst);
    }
 
+   /***************************************
+    * ORDER STATISTICS
+    *    BST::rank()
+    *    BST::nth()
+    *    BST::count_range()
+    ***************************************/
+
+   using CountedBST = custom::BST<int, std::less<int>, std::allocator<int>, custom::rb_counted<custom::rb_plain>>;
+
+   // the count is one size_t a node, and only when asked for
+   void test_construct_countedSpace()
+   {  // setup
+      using Packed  = custom::BST<double, std::less<double>, std::allocator<double>, custom::rb_packed>::BNode;
+      using Counted = custom::BST<double, std::less<double>, std::allocator<double>,
+                                  custom::rb_counted<custom::rb_packed>>::BNode;
+      // exercise
+      // verify
+      assertUnit(sizeof(Counted) == sizeof(Packed) + sizeof(size_t));
+      assertUnit(custom::is_counted<custom::rb_counted<custom::rb_plain>>::value);
+      assertUnit(!custom::is_counted<custom::rb_plain>::value);
+      assertUnit(custom::is_threaded<custom::rb_counted<custom::rb_default_threaded>>::value);
+   }  // teardown
+
+   // how many values go before a value there, one missing, and the ends
+   void test_rank_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      CountedBST bst{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      size_t rank20 = bst.rank(20);
+      size_t rank55 = bst.rank(55);
+      size_t rank80 = bst.rank(80);
+      size_t rank99 = bst.rank(99);
+      // verify
+      assertUnit(rank20 == 0);
+      assertUnit(rank55 == 4);
+      assertUnit(rank80 == 6);
+      assertUnit(rank99 == 7);
+   }  // teardown
+
+   // the value at each index, then past the end
+   void test_nth_standard()
+   {  // setup
+      CountedBST bst{ 50, 30, 70, 20, 40, 60, 80 };
+      bool inOrder = true;
+      // exercise
+      for (size_t i = 0; i < 7; i++)
+      {
+         auto it = bst.nth(i);
+         inOrder = inOrder && it != bst.end() && *it == 20 + 10 * (int)i;
+      }
+      auto itEnd = bst.nth(7);
+      // verify
+      assertUnit(inOrder);
+      assertUnit(itEnd == bst.end());
+   }  // teardown
+
+   // [lo, hi) by two ranks, whether or not the ends are there
+   void test_countRange_standard()
+   {  // setup
+      CountedBST bst{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      size_t n3070 = bst.count_range(30, 70);
+      size_t n3575 = bst.count_range(35, 75);
+      size_t n0099 = bst.count_range(0, 99);
+      size_t n7030 = bst.count_range(70, 30);
+      // verify
+      assertUnit(n3070 == 4);
+      assertUnit(n3575 == 4);
+      assertUnit(n0099 == 7);
+      assertUnit(n7030 == 0);
+   }  // teardown
+
+   // every rotation and removal keeps the counts right
+   void test_counted_insertErase()
+   {  // setup
+      CountedBST bst;
+      for (int i = 0; i < 200; i++)
+         bst.insert((i * 37) % 200);
+      // exercise
+      for (int i = 0; i < 200; i += 3)
+      {
+         auto it = bst.find(i);
+         bst.erase(it);
+      }
+      // verify
+      assertUnit(verifySizes(bst.root));
+      assertUnit(bst.nth(0) != bst.end() && *bst.nth(0) == 1);
+      assertUnit(bst.rank(100) == 66);        // 0..99 less the 34 multiples of 3
+      assertUnit(bst.count_range(0, 200) == bst.size());
+   }  // teardown
+
+   // copies, assignments and sorted builds come out counted
+   void test_counted_copyBuild()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 100; i++)
+         v.push_back(i);
+      CountedBST bstBuilt;
+      CountedBST bstAssigned{ 5, 6, 7 };
+      // exercise
+      bstBuilt.buildSorted(v.begin(), v.size());
+      CountedBST bstCopy(bstBuilt);
+      bstAssigned = bstBuilt;
+      // verify
+      assertUnit(verifySizes(bstBuilt.root));
+      assertUnit(verifySizes(bstCopy.root));
+      assertUnit(verifySizes(bstAssigned.root));
+      assertUnit(*bstCopy.nth(42) == 42);
+      assertUnit(bstAssigned.rank(42) == 42);
+   }  // teardown
+
+   // does every subtree know its own size?
+   static bool verifySizes(const CountedBST::BNode* pNode)
+   {
+      if (!pNode)
+         return true;
+      return pNode->subtreeSize == (size_t)pNode->computeSize() &&
+             verifySizes(pNode->pLeft) && verifySizes(pNode->pRight);
+   }
+
    /***************************************
     * Assignment
     *    BST::operator=(const BST &)
@@ -1067,7 +1498,7 @@ public:
       assertUnit(Spy::numAssign() == 0);
       assertUnit(Spy::numAssignMove() == 0);
       assertUnit(Spy::numEquals() == 0);
-      assertUnit(Spy::numLessthan() == 10);
+      assertUnit(Spy::numLessthan() == 11);   // one to see the list is not sorted
       assertStandardFixture(bstDest);
       // teardown
       teardownStandardFixture(bstDest);
@@ -1211,6 +1642,172 @@ public:
       teardownStandardFixture(bst2);
    }
 
+   /***************************************
+    * NODE HANDLES
+    *    BST::extract()
+    *    BST::insert(node_handle&&)
+    *    BST::merge()
+    ***************************************/
+
+   // extract takes the node out without destroying it
+   void test_extract_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::BNode* p30 = bst.root->pLeft;
+      Spy::reset();
+      // exercise
+      custom::BST<Spy>::node_handle nh = bst.extract(custom::BST<Spy>::iterator(p30));
+      // verify
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(!nh.empty());
+      assertUnit(nh.pNode == p30);
+      assertUnit(nh.value() == Spy(30));
+      assertUnit(p30->pLeft == nullptr);
+      assertUnit(p30->pRight == nullptr);
+      assertUnit(p30->pParent == nullptr);
+      assertUnit(bst.numElements == 6);
+      if (bst.root)
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      assertUnit(bst.find(Spy(30)) == bst.end());
+      // teardown
+      bst.clear();
+   }  // nh destroys [30]
+
+   // nothing to extract at the end
+   void test_extract_end()
+   {  // setup
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      custom::BST<Spy>::node_handle nh = bst.extract(bst.end());
+      // verify
+      assertUnit(nh.empty());
+      assertUnit(!nh);
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // a handle that still holds its node destroys it
+   void test_extract_destroy()
+   {  // setup
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      {
+         custom::BST<Spy>::node_handle nh = bst.extract(bst.begin());
+      }
+      // verify
+      assertUnit(Spy::numDestructor() == 1);  // [20] goes with the handle
+      assertUnit(Spy::numDelete() == 1);
+      assertUnit(bst.numElements == 6);
+      // teardown
+      bst.clear();
+   }
+
+   // move a node from one tree to another: no allocation, no copy
+   void test_insertHandle_standard()
+   {  // setup
+      custom::BST <Spy> bstSrc;
+      setupStandardFixture(bstSrc);
+      custom::BST <Spy> bstDest;
+      bstDest.insert(Spy(10));
+      bstDest.insert(Spy(90));
+      custom::BST<Spy>::BNode* p40 = bstSrc.root->pLeft->pRight;
+      Spy::reset();
+      // exercise
+      auto pairBST = bstDest.insert(bstSrc.extract(custom::BST<Spy>::iterator(p40)), true);
+      // verify
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(pairBST.second == true);
+      assertUnit(pairBST.first.pNode == p40);
+      assertUnit(bstSrc.numElements == 6);
+      assertUnit(bstDest.numElements == 3);
+      if (bstDest.root)
+         assertUnit(bstDest.root->verifyRedBlack(bstDest.root->findDepth()));
+      // teardown
+      bstSrc.clear();
+      bstDest.clear();
+   }
+
+   // a duplicate stays in the handle
+   void test_insertHandle_duplicate()
+   {  // setup
+      custom::BST <Spy> bstSrc;
+      setupStandardFixture(bstSrc);
+      custom::BST <Spy> bstDest;
+      bstDest.insert(Spy(40));
+      custom::BST<Spy>::BNode* p40 = bstSrc.root->pLeft->pRight;
+      custom::BST<Spy>::node_handle nh = bstSrc.extract(custom::BST<Spy>::iterator(p40));
+      Spy::reset();
+      // exercise
+      auto pairBST = bstDest.insert(std::move(nh), true);
+      // verify
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(pairBST.second == false);
+      assertUnit(pairBST.first == bstDest.begin());
+      assertUnit(nh.pNode == p40);
+      assertUnit(bstDest.numElements == 1);
+      // teardown
+      bstSrc.clear();
+      bstDest.clear();
+   }  // nh destroys [40]
+
+   // merge moves everything that is not already there
+   void test_merge_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bstSrc;
+      setupStandardFixture(bstSrc);
+      custom::BST <Spy> bstDest;
+      bstDest.insert(Spy(40));
+      bstDest.insert(Spy(45));
+      bstDest.insert(Spy(70));
+      Spy::reset();
+      // exercise
+      bstDest.merge(bstSrc, true);
+      // verify
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(bstDest.numElements == 8);  // 20 30 40 45 50 60 70 80
+      assertUnit(bstSrc.numElements == 2);   // 40 70
+      if (bstDest.root)
+         assertUnit(bstDest.root->verifyRedBlack(bstDest.root->findDepth()));
+      if (bstSrc.root)
+         assertUnit(bstSrc.root->verifyRedBlack(bstSrc.root->findDepth()));
+      assertUnit(*bstSrc.begin() == Spy(40));
+      int expect[] = { 20, 30, 40, 45, 50, 60, 70, 80 };
+      int i = 0;
+      bool inOrder = true;
+      for (custom::BST<Spy>::iterator it = bstDest.begin(); it != bstDest.end(); ++it)
+         inOrder = inOrder && *it == Spy(expect[i++]);
+      assertUnit(inOrder);
+      // teardown
+      bstSrc.clear();
+      bstDest.clear();
+   }
+
    /***************************************
     * CLEAR
     *    BST::clear()
@@ -1335,6 +1932,87 @@ public:
       teardownStandardFixture(bst);
    }
 
+   // insert and erase keep the ends up, so begin() does not walk
+   void test_begin_cached()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i : { 50, 30, 70, 20 })
+         bst.insert(i);
+      // exercise
+      bst.insert(10);
+      bst.insert(90);
+      // verify
+      assertUnit(bst.pFirst != nullptr && bst.pFirst->data == 10);
+      assertUnit(bst.pLast != nullptr && bst.pLast->data == 90);
+      assertUnit(*bst.begin() == 10);
+      assertUnit(*bst.rbegin() == 90);
+   }  // teardown
+
+   // erasing the first element moves the cached end to its successor
+   void test_begin_afterErase()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(i);
+      custom::BST <int>::iterator it = bst.begin();
+      // exercise
+      bst.erase(it);
+      it = bst.rbegin();
+      bst.erase(it);
+      // verify
+      assertUnit(bst.pFirst != nullptr && bst.pFirst->data == 30);
+      assertUnit(bst.pLast != nullptr && bst.pLast->data == 70);
+      assertUnit(*bst.begin() == 30);
+      assertUnit(*bst.rbegin() == 70);
+   }  // teardown
+
+   // a tree built or copied whole knows its ends at once: begin() on
+   // a const tree reads them and writes nothing
+   void test_begin_knownAfterCopy()
+   {  // setup
+      custom::BST <int> bstSrc{ 10, 20, 30, 40, 50 };   // built from sorted values
+      custom::BST <int> bstAssign;
+      bstAssign.insert(99);
+      // exercise
+      custom::BST <int> bstCopy(bstSrc);
+      bstAssign = bstSrc;
+      // verify
+      assertUnit(bstSrc.pFirst != nullptr && bstSrc.pFirst->data == 10);
+      assertUnit(bstSrc.pLast != nullptr && bstSrc.pLast->data == 50);
+      assertUnit(bstCopy.pFirst != nullptr && bstCopy.pFirst->data == 10);
+      assertUnit(bstCopy.pLast != nullptr && bstCopy.pLast->data == 50);
+      assertUnit(bstAssign.pFirst != nullptr && bstAssign.pFirst->data == 10);
+      assertUnit(bstAssign.pLast != nullptr && bstAssign.pLast->data == 50);
+   }  // teardown
+
+   // rbegin() from the standard fixture
+   void test_rbegin_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::iterator it;
+      Spy::reset();
+      // exercise
+      it = bst.rbegin();
+      // verify
+      assertUnit(Spy::numLessthan() == 0);    // does not look at any element
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(it.pNode != nullptr);
+      if (it.pNode)
+         assertUnit(it.pNode->data == Spy(80));
+      --it;
+      if (it.pNode)
+         assertUnit(it.pNode->data == Spy(70));
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
    // end() from the standard fixture.
    void test_end_standard()
    {  // setup
@@ -1367,6 +2045,56 @@ public:
       teardownStandardFixture(bst);
    }
 
+   // a threaded tree steps straight to the neighbor, through inserts and erases
+   void test_iterator_threaded()
+   {  // setup
+      custom::BST<int, std::less<int>, std::allocator<int>, custom::rb_threaded<custom::rb_plain>> bst;
+      for (int i : { 50, 30, 70, 20, 40, 60, 80, 10, 25, 65 })
+         bst.insert(i);
+      auto it = bst.find(30);
+      // exercise
+      bst.erase(it);           // two children
+      it = bst.find(10);
+      bst.erase(it);           // the first node
+      // verify
+      int expect[] = { 20, 25, 40, 50, 60, 65, 70, 80 };
+      int i = 0;
+      bool linked = true;
+      for (auto p = bst.pFirst; p; p = p->pNext, i++)
+         linked = linked && i < 8 && p->data == expect[i] && (p->pNext == nullptr || p->pNext->pPrev == p);
+      assertUnit(linked);
+      assertUnit(i == 8);
+      i = 7;
+      bool inOrder = true;
+      for (it = bst.rbegin(); it != bst.end(); --it, i--)
+         inOrder = inOrder && *it == expect[i];
+      assertUnit(inOrder);
+      assertUnit(i == -1);
+      if (bst.root)
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // copies and bulk builds thread the whole tree at once
+   void test_iterator_threadedCopy()
+   {  // setup
+      using Threaded = custom::BST<int, std::less<int>, std::allocator<int>, custom::rb_threaded<custom::rb_plain>>;
+      Threaded bstSrc{ 1, 2, 3, 4, 5, 6, 7, 8, 9 };   // sorted: built in one pass
+      // exercise
+      Threaded bstDest(bstSrc);
+      // verify
+      int i = 1;
+      bool inOrder = true;
+      for (auto it = bstDest.begin(); it != bstDest.end(); ++it, i++)
+         inOrder = inOrder && *it == i && it.pNode != bstSrc.find(i).pNode;
+      assertUnit(inOrder);
+      assertUnit(i == 10);
+      assertUnit(bstDest.root && bstDest.root->pPrev && bstDest.root->pPrev->pNext == bstDest.root);
+      i = 1;
+      for (auto it = bstSrc.begin(); it != bstSrc.end(); ++it, i++)
+         ;
+      assertUnit(i == 10);
+   }  // teardown
+
    // increment where the next node is the parent
    void test_iterator_increment_standardToParent()
    {  // setup
@@ -1695,8 +2423,8 @@ public:
       // exercise
       it = bst.find(s);
       // verify
-      assertUnit(Spy::numEquals() == 3);      // check [50][30][20]
-      assertUnit(Spy::numLessthan() == 2);    // compare [50][30]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 4);    // compare [50][30][20] then [20] once for equivalence
       assertUnit(Spy::numDestructor() == 0);
       assertUnit(Spy::numDelete() == 0);
       assertUnit(Spy::numAssign() == 0);
@@ -1738,8 +2466,8 @@ public:
       // exercise
       it = bst.find(s);
       // verify
-      assertUnit(Spy::numEquals() == 3);      // check [50][70][80]
-      assertUnit(Spy::numLessthan() == 2);    // compare [50][70]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 4);    // compare [50][70][80] then [80] once for equivalence
       assertUnit(Spy::numDestructor() == 0);
       assertUnit(Spy::numDelete() == 0);
       assertUnit(Spy::numAssign() == 0);
@@ -1761,12 +2489,170 @@ public:
       if (bst.root && bst.root->pRight)
          assertUnit(it.pNode == bst.root->pRight->pRight);
       assertStandardFixture(bst);
-      // teardown
-      teardownStandardFixture(bst);
-   }
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // attempt to find something where it is not there
+   void test_find_standardMissing()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::iterator it;
+      Spy s(42);
+      Spy::reset();
+      // exercise
+      it = bst.find(s);
+      // verify
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 4);    // compare [50][30][40] then [50] once for equivalence
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      assertUnit(it == bst.end());
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+
+
+   // a comparator with three_way() is called once a level
+   void test_find_threeWay()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST<int, ThreeWayLess> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      ThreeWayLess::reset();
+      // exercise
+      auto it40 = bst.find(40);
+      auto it42 = bst.find(42);
+      // verify
+      assertUnit(ThreeWayLess::numLess == 0);
+      assertUnit(ThreeWayLess::numThreeWay == 6); // [50][30][40] and [50][30][40]
+      assertUnit(it40 != bst.end());
+      if (it40 != bst.end())
+         assertUnit(*it40 == 40);
+      assertUnit(it42 == bst.end());
+   }  // teardown
+
+   // std::less<std::string> compares the strings once a level
+   void test_find_threeWayString()
+   {  // setup
+      custom::BST<std::string> bst{ "50", "30", "70", "20", "40", "60", "80" };
+      // exercise
+      auto it = bst.find("60");
+      // verify
+      assertUnit((custom::three_way<std::less<std::string>, std::string>::value));
+      assertUnit(!(custom::three_way<std::less<Spy>, Spy>::value));
+      assertUnit(it != bst.end());
+      if (it != bst.end())
+         assertUnit(*it == "60");
+      assertUnit(bst.find("65") == bst.end());
+   }  // teardown
+
+   // lower bound of a value there, between values, and past the end
+   void test_lowerBound_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy s40(40);
+      Spy s45(45);
+      Spy s90(90);
+      Spy::reset();
+      // exercise
+      auto it40 = bst.lower_bound(s40);
+      auto it45 = bst.lower_bound(s45);
+      auto it90 = bst.lower_bound(s90);
+      // verify
+      assertUnit(Spy::numLessthan() == 9);    // three levels each, no check at the bottom
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(it40 != bst.end() && *it40 == Spy(40));
+      assertUnit(it45 != bst.end() && *it45 == Spy(50));
+      assertUnit(it90 == bst.end());
+      assertStandardFixture(bst);
+   }  // teardown
+
+   // upper bound skips the value equal to it
+   void test_upperBound_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy s40(40);
+      Spy s10(10);
+      Spy s80(80);
+      // exercise
+      auto it40 = bst.upper_bound(s40);
+      auto it10 = bst.upper_bound(s10);
+      auto it80 = bst.upper_bound(s80);
+      // verify
+      assertUnit(it40 != bst.end() && *it40 == Spy(50));
+      assertUnit(it10 != bst.end() && *it10 == Spy(20));
+      assertUnit(it80 == bst.end());
+      assertStandardFixture(bst);
+   }  // teardown
 
-   // attempt to find something where it is not there
-   void test_find_standardMissing()
+   // equal range spans every duplicate, wherever rotations put them
+   void test_equalRange_duplicates()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 30; i++)
+         bst.insert(i % 5);
+      // exercise
+      auto range = bst.equal_range(3);
+      // verify
+      int n = 0;
+      bool same = true;
+      for (auto it = range.first; it != range.second; ++it, n++)
+         same = same && *it == 3;
+      assertUnit(same);
+      assertUnit(n == 6);
+      assertUnit(range.second != bst.end() && *range.second == 4);
+   }  // teardown
+
+   // count is 0 or 1 for unique values, the whole run otherwise
+   void test_count_duplicates()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 30; i++)
+         bst.insert(i % 5);
+      bst.insert(9);
+      // exercise
+      size_t n2 = bst.count(2);
+      size_t n9 = bst.count(9);
+      size_t n7 = bst.count(7);
+      // verify
+      assertUnit(n2 == 6);
+      assertUnit(n9 == 1);
+      assertUnit(n7 == 0);
+   }  // teardown
+
+   // visit [lo, hi) in order
+   void test_visitRange_standard()
    {  // setup
       //                 50 
       //          +-------+-------+
@@ -1775,30 +2661,77 @@ public:
       //    20        40    60        80  
       custom::BST <Spy> bst;
       setupStandardFixture(bst);
-      custom::BST<Spy>::iterator it;
-      Spy s(42);
+      std::vector<int> visited;
       Spy::reset();
       // exercise
-      it = bst.find(s);
+      bst.visit_range(Spy(30), Spy(70), [&visited](const Spy& s) { visited.push_back(s.get()); });
       // verify
-      assertUnit(Spy::numEquals() == 3);      // check [50][30][40]
-      assertUnit(Spy::numLessthan() == 3);    // compare [50][30][40]
-      assertUnit(Spy::numDestructor() == 0);
-      assertUnit(Spy::numDelete() == 0);
-      assertUnit(Spy::numAssign() == 0);
       assertUnit(Spy::numCopy() == 0);
-      assertUnit(Spy::numAlloc() == 0);
-      assertUnit(Spy::numDefault() == 0);
-      assertUnit(Spy::numNondefault() == 0);
-      assertUnit(Spy::numCopyMove() == 0);
-      assertUnit(Spy::numAssignMove() == 0);
-      assertUnit(it == bst.end());
+      assertUnit(visited == std::vector<int>({ 30, 40, 50, 60 }));
       assertStandardFixture(bst);
-      // teardown
-      teardownStandardFixture(bst);
-   }
+   }  // teardown
+
+   // subtrees outside the range are never entered
+   void test_visitRange_comparisons()
+   {  // setup
+      custom::BST<Spy> bst;
+      for (int i = 0; i < 1000; i++)
+         bst.insert(Spy(i));
+      Spy lo(500);
+      Spy hi(504);
+      int n = 0;
+      Spy::reset();
+      // exercise
+      bst.visit_range(lo, hi, [&n](const Spy&) { n++; });
+      // verify
+      assertUnit(n == 4);
+      assertUnit(Spy::numLessthan() < 60);    // about two a level, not two a value
+   }  // teardown
 
+   // from each bound to the next agrees with a search from the root,
+   // through duplicates, gaps and off the end
+   void test_boundFrom_sweep()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 300; i++)
+         bst.insert((i * 7) % 100 / 2 * 3);
+      bool same = true;
+      auto itLower = bst.end();
+      auto itUpper = bst.end();
+      // exercise
+      for (int k = -1; k < 155; k++)
+      {
+         itLower = bst.bound_from(itLower, k);
+         itUpper = bst.bound_from(itUpper, k, /*upper: */true);
+         same = same && itLower == bst.lower_bound(k) && itUpper == bst.upper_bound(k);
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(itLower == bst.end());
+   }  // teardown
 
+   // the next value over is found a few comparisons away, not a descent
+   void test_boundFrom_comparisons()
+   {  // setup
+      custom::BST<Spy> bst;
+      for (int i = 0; i < 1000; i++)
+         bst.insert(Spy(i));
+      std::vector<Spy> keys;
+      for (int i = 0; i < 1000; i++)
+         keys.push_back(Spy(i));
+      auto it = bst.end();
+      bool found = true;
+      Spy::reset();
+      // exercise
+      for (const Spy& k : keys)
+      {
+         it = bst.bound_from(it, k);
+         found = found && it != bst.end() && *it == k;
+      }
+      // verify
+      assertUnit(found);
+      assertUnit(Spy::numLessthan() < 1000 * 4);   // a descent each is 10 or more
+   }  // teardown
 
    /***************************************
     * Insert
@@ -2011,8 +2944,8 @@ public:
       // exercise
       auto pairBST = bst.insert(s, true /* keepUnique */);
       // verify
-      assertUnit(Spy::numLessthan() == 2);    // compare [50][30]
-      assertUnit(Spy::numEquals() == 3);      // compare [50][30][40]
+      assertUnit(Spy::numLessthan() == 4);    // compare [50][30][40] then [40] once for equivalence
+      assertUnit(Spy::numEquals() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDestructor() == 0);
@@ -2036,6 +2969,23 @@ public:
       teardownStandardFixture(bst);
    }
 
+   // a three-way comparator finds the duplicate without a second comparison
+   void test_insert_threeWayKeepUnique()
+   {  // setup
+      custom::BST<int, ThreeWayLess> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      ThreeWayLess::reset();
+      // exercise
+      auto pairBST = bst.insert(40, true /* keepUnique */);
+      // verify
+      assertUnit(ThreeWayLess::numLess == 0);
+      assertUnit(ThreeWayLess::numThreeWay == 3); // [50][30][40]
+      assertUnit(pairBST.second == false);
+      assertUnit(pairBST.first != bst.end());
+      if (pairBST.first != bst.end())
+         assertUnit(*(pairBST.first) == 40);
+      assertUnit(bst.size() == 7);
+   }  // teardown
+
 
    /***************************************
     * Insert Move
@@ -2250,8 +3200,8 @@ public:
       // exercise
       auto pairBST = bst.insert(std::move(s), true /* keepUnique */);
       // verify
-      assertUnit(Spy::numLessthan() == 2);    // compare [50][30]
-      assertUnit(Spy::numEquals() == 3);      // compare [50][30][40]
+      assertUnit(Spy::numLessthan() == 4);    // compare [50][30][40] then [40] once for equivalence
+      assertUnit(Spy::numEquals() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDestructor() == 0);
@@ -2276,6 +3226,220 @@ public:
       teardownStandardFixture(bst);
    }
 
+   /***************************************
+    * EMPLACE
+    *    BST::emplace(bool, Args&& ...)
+    ***************************************/
+
+   // emplace builds the value inside the new node
+   void test_emplace_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.emplace(false, 65);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [65] in the node
+      assertUnit(Spy::numAlloc() == 1);      // allocate [65]
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numLessthan() == 3);   // compare [50][70][60]
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      if (bst.root && bst.root->pRight && bst.root->pRight->pLeft)
+         assertUnit(pairBST.first.pNode == bst.root->pRight->pLeft->pRight);
+      // teardown
+      bst.clear();
+   }
+
+   // emplace of a duplicate destroys the new value again
+   void test_emplace_keepUnique()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.emplace(true, 40);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [40] in the node
+      assertUnit(Spy::numDestructor() == 1); // and destroy it when [40] is found
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(pairBST.second == false);
+      assertUnit(pairBST.first != bst.end());
+      if (pairBST.first != bst.end())
+         assertUnit(*(pairBST.first) == Spy(40));
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // appending with the last insert as the hint never searches the tree
+   void test_insertHint_append()
+   {  // setup
+      custom::BST <Spy> bst;
+      custom::BST <Spy>::iterator it = bst.end();
+      Spy::reset();
+      // exercise
+      for (int i = 0; i < 100; i++)
+         it = bst.insert(it, Spy(i), true).first;
+      // verify
+      assertUnit(Spy::numLessthan() == 99 * 2);   // compare with the hint both ways
+      assertUnit(bst.numElements == 100);
+      assertUnit(it != bst.end());
+      if (it != bst.end())
+         assertUnit(*it == Spy(99));
+      if (bst.root)
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      int i = 0;
+      bool inOrder = true;
+      for (it = bst.begin(); it != bst.end(); ++it, i++)
+         inOrder = inOrder && *it == Spy(i);
+      assertUnit(inOrder);
+      assertUnit(i == 100);
+      // teardown
+      bst.clear();
+   }
+
+   // the hint's node already has a left child: hang it off its predecessor
+   void test_insertHint_before()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST <Spy>::iterator hint(bst.root);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.insert(hint, Spy(45), true);
+      // verify
+      assertUnit(Spy::numLessthan() == 2);   // compare [50][40]
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      if (bst.root && bst.root->pLeft && bst.root->pLeft->pRight)
+         assertUnit(pairBST.first.pNode == bst.root->pLeft->pRight->pRight);
+      if (bst.root)
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      // teardown
+      bst.clear();
+   }
+
+   // a leaf hint: goes on the hint's free right side
+   void test_insertHint_after()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST <Spy>::iterator hint(bst.root->pRight->pLeft);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.insert(hint, Spy(65), true);
+      // verify
+      assertUnit(Spy::numLessthan() == 3);   // compare [60] both ways, then [70]
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      if (bst.root && bst.root->pRight && bst.root->pRight->pLeft)
+         assertUnit(pairBST.first.pNode == bst.root->pRight->pLeft->pRight);
+      // teardown
+      bst.clear();
+   }
+
+   // a hint in the wrong place still inserts in the right one
+   void test_insertHint_wrong()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST <Spy>::iterator hint(bst.root->pLeft->pLeft);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.insert(hint, Spy(65), true);
+      // verify
+      assertUnit(Spy::numLessthan() == 3 + 4);   // [20] both ways and [30], then the search
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      if (bst.root && bst.root->pRight && bst.root->pRight->pLeft)
+         assertUnit(pairBST.first.pNode == bst.root->pRight->pLeft->pRight);
+      // teardown
+      bst.clear();
+   }
+
+   // a hint equivalent to the value finds the duplicate
+   void test_insertHint_duplicate()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST <Spy>::iterator hint(bst.root->pLeft->pRight);
+      Spy s(40);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.insert(hint, s, true);
+      // verify
+      assertUnit(Spy::numLessthan() == 2);   // neither goes before the other
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(pairBST.second == false);
+      assertUnit(pairBST.first.pNode == hint.pNode);
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // end() as the hint: after the largest element
+   void test_emplaceHint_end()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.emplace_hint(bst.end(), true, 90);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [90] in the node
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numLessthan() == 1);   // compare [80]
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      if (bst.root && bst.root->pRight && bst.root->pRight->pRight)
+         assertUnit(pairBST.first.pNode == bst.root->pRight->pRight->pRight);
+      if (bst.root)
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      // teardown
+      bst.clear();
+   }
+
 
    /***************************************
     * Insert Balancing
@@ -3582,6 +4746,124 @@ public:
       bst.root = nullptr;
    }
 
+   // erase the only node in the tree
+   void test_erase_rootLeaf()
+   {  // setup
+      //    [[50b]]
+      custom::BST <int> bst{ 50 };
+      auto it = bst.begin();
+      // exercise
+      auto itReturn = bst.erase(it);
+      // verify
+      assertUnit(itReturn == bst.end());
+      assertUnit(bst.root == nullptr);
+      assertUnit(bst.numElements == 0);
+   }  // teardown
+
+   // erase a black leaf: the tree recolors to even out the black depth
+   void test_erase_blackLeaf()
+   {  // setup
+      //                 (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      // [[(20b)]]   (40b) (60b)     (80b)
+      custom::BST <int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      for (auto p : { bst.root->pLeft->pLeft, bst.root->pLeft->pRight,
+                      bst.root->pRight->pLeft, bst.root->pRight->pRight })
+         p->isRed = false;
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      auto it = bst.find(20);
+      // exercise
+      auto itReturn = bst.erase(it);
+      // verify
+      //                 (50b)
+      //          +-------+-------+
+      //        (30b)           (70r)
+      //          +----+     +----+----+
+      //             (40r) (60b)     (80b)
+      assertUnit(itReturn != bst.end());
+      if (itReturn != bst.end())
+         assertUnit(*itReturn == 30);
+      assertUnit(bst.numElements == 6);
+      assertUnit(bst.root->data == 50);
+      assertUnit(bst.root->pLeft->pLeft == nullptr);
+      assertUnit(bst.root->pLeft->pRight->isRed == true);
+      assertUnit(bst.root->pRight->isRed == true);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      assertUnit(bst.root->computeSize() == 6);
+   }  // teardown
+
+   // erase a black node whose sibling is red: rotate the sibling up first
+   void test_erase_redSibling()
+   {  // setup
+      //            (30b)
+      //       +------+------+
+      //  [[(20b)]]        (50r)
+      //                +----+----+
+      //              (40b)     (60b)
+      custom::BST <int> bst{ 30, 20, 50, 40, 60, 70 };
+      auto it70 = bst.find(70);
+      bst.erase(it70);
+      assertUnit(bst.root->data == 30);
+      assertUnit(bst.root->pRight->isRed == true);
+      auto it = bst.find(20);
+      // exercise
+      bst.erase(it);
+      // verify
+      //                 (50b)
+      //            +------+------+
+      //          (30b)         (60b)
+      //            +--+
+      //             (40r)
+      assertUnit(bst.numElements == 4);
+      assertUnit(bst.root->data == 50);
+      assertUnit(bst.root->isRed == false);
+      assertUnit(bst.root->pParent == nullptr);
+      assertUnit(bst.root->pLeft->data == 30);
+      assertUnit(bst.root->pLeft->pRight->data == 40);
+      assertUnit(bst.root->pLeft->pRight->isRed == true);
+      assertUnit(bst.root->pRight->data == 60);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // insert and erase in a scrambled order: the tree stays red-black
+   void test_erase_churn()
+   {  // setup
+      custom::BST <int> bst;
+      const int num = 200;
+      bool valid = true;
+      // exercise
+      for (int round = 0; round < 3; round++)
+      {
+         for (int i = 0; i < num; i++)
+            bst.insert((i * 37 + round) % num, true /* keepUnique */);
+         for (int i = 0; i < num; i += 2 + round)
+         {
+            auto it = bst.find((i * 53) % num);
+            if (it != bst.end())
+               bst.erase(it);
+            if (bst.root)
+            {
+               valid = valid && bst.root->verifyRedBlack(bst.root->findDepth());
+               valid = valid && bst.root->computeSize() == (int)bst.numElements;
+               bst.root->verifyBTree();
+            }
+         }
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+         assertUnit(bst.root->findDepth() <= 8); // black depth of at most log2(n+1)
+      int previous = -1;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+      {
+         assertUnit(previous < *it);
+         previous = *it;
+      }
+   }  // teardown
+
    /**************************************************************
     * SETUP STANDARD FIXTURE
     *                (50b)
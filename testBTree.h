@@ -0,0 +1,866 @@
+/***********************************************************************
+ * Header:
+ *    TEST BTREE
+ * Summary:
+ *    Unit tests for the B+tree backend
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "btree.h"      // class under test
+#include "search.h"     // the SIMD key search inside it
+#include "map.h"        // a map built on a BTree
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // spy is a mock class to monitor the class under test
+
+#include <algorithm>    // for std::lower_bound, the reference
+#include <atomic>       // for std::atomic
+#include <cstdint>      // for std::int64_t
+#include <cstdlib>      // for std::rand
+#include <limits>       // for std::numeric_limits
+#include <functional>   // for std::less
+#include <set>          // for std::multiset, the reference
+#include <string>
+#include <vector>
+
+/***********************************************
+ * PAIR LESS
+ * Orders pairs of an int and a Spy by the int, and
+ * the int keys in the inner nodes against them, the
+ * way map::value_compare does
+ ***********************************************/
+struct PairLess
+{
+   using Pair = custom::pair<int, Spy>;
+   bool operator()(const Pair& lhs, const Pair& rhs) const { return lhs.first < rhs.first; }
+   bool operator()(const Pair& lhs, int rhs)         const { return lhs.first < rhs;       }
+   bool operator()(int lhs, const Pair& rhs)         const { return lhs < rhs.first;       }
+   bool operator()(int lhs, int rhs)                 const { return lhs < rhs;             }
+};
+
+/***********************************************
+ * TEST BTREE
+ * Unit tests for the BTree class. Most use N = 4
+ * so that a few dozen values make several levels.
+ ***********************************************/
+class TestBTree : public UnitTest
+{
+   using Tree = custom::BTree<int, std::less<int>, std::allocator<int>, 4>;
+   using SpyTree = custom::BTree<Spy, std::less<Spy>, std::allocator<Spy>, 4>;
+   using PairTree = custom::BTree<custom::pair<int, Spy>, PairLess, std::allocator<custom::pair<int, Spy>>, 4>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_constructCopy_standard();
+      test_constructMove_standard();
+      test_buildSorted_sizes();
+      test_buildSorted_parallel();
+
+      // Assign
+      test_assign_standardToStandard();
+      test_swap_standard();
+
+      // Iterator
+      test_iterator_standard();
+
+      // Find
+      test_find_standard();
+      test_find_missing();
+      test_find_duplicatesAcrossLeaves();
+      test_bounds_duplicatesAcrossLeaves();
+      test_visitRange_acrossLeaves();
+      test_boundFrom_sweep();
+
+      // Insert
+      test_insert_ascending();
+      test_insert_random();
+      test_insert_keepUnique();
+      test_insert_duplicate();
+      test_emplace_standard();
+      test_insertHint_append();
+      test_insertHint_wrong();
+
+      // Remove
+      test_erase_returnNext();
+      test_erase_random();
+      test_erase_all();
+      test_clear_standard();
+
+      // Map
+      test_map_standard();
+      test_map_eraseRange();
+
+      // Key search
+      test_simdKeys_trait();
+      test_keyLowerBound_sizes();
+      test_keyUpperBound_duplicates();
+      test_keyBound_extremes();
+
+      // Parallel
+      test_parallelForEach_all();
+      test_splitters_sorted();
+
+      report("BTree");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor, no allocations
+   void test_construct_default()
+   {  // setup
+      Spy::reset();
+      // exercise
+      SpyTree bt;
+      // verify
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(bt.root == nullptr);
+      assertUnit(bt.height == 0);
+      assertUnit(bt.pFirst == nullptr);
+      assertUnit(bt.pLast == nullptr);
+      assertUnit(bt.size() == 0);
+      assertUnit(bt.begin() == bt.end());
+   }  // teardown
+
+   // copy is built bottom up: one copy a value, no comparisons
+   void test_constructCopy_standard()
+   {  // setup
+      PairTree btSrc;
+      for (int i = 0; i < 100; i++)
+         btSrc.insert(custom::pair<int, Spy>(i, Spy(i)));
+      Spy::reset();
+      // exercise
+      PairTree btDest(btSrc);
+      // verify
+      assertUnit(Spy::numCopy() == 100);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(btDest.size() == 100);
+      assertUnit(btSrc.size() == 100);
+      assertUnit(verify(btDest));
+      assertUnit(verify(btSrc));
+      assertUnit(btDest.root != btSrc.root);
+      assertUnit((*btDest.begin()).first == 0);
+      assertUnit((*btDest.rbegin()).first == 99);
+   }  // teardown
+
+   // move steals the nodes
+   void test_constructMove_standard()
+   {  // setup
+      SpyTree btSrc;
+      for (int i = 0; i < 100; i++)
+         btSrc.insert(Spy(i));
+      Spy::reset();
+      // exercise
+      SpyTree btDest(std::move(btSrc));
+      // verify
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(btDest.size() == 100);
+      assertUnit(btSrc.size() == 0);
+      assertUnit(btSrc.root == nullptr);
+      assertUnit(verify(btDest));
+      assertUnit(verify(btSrc));
+   }  // teardown
+
+   // every size builds a valid tree, whatever the last leaf gets
+   void test_buildSorted_sizes()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 200; i++)
+         v.push_back(i);
+      bool valid = true;
+      bool inOrder = true;
+      // exercise
+      for (size_t n = 0; n <= v.size(); n++)
+      {
+         Tree bt;
+         bt.buildSorted(v.begin(), n);
+         valid = valid && verify(bt) && bt.size() == n;
+         int expect = 0;
+         for (auto it = bt.begin(); it != bt.end(); ++it)
+            inOrder = inOrder && *it == expect++;
+         inOrder = inOrder && expect == (int)n;
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(inOrder);
+   }  // teardown
+
+   // the leaves filled on four threads hold what one thread puts there
+   void test_buildSorted_parallel()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 20000; i++)
+         v.push_back(i);
+      Tree bt;
+      // exercise
+      bt.buildSorted(v.begin(), v.size(), 4);
+      // verify
+      assertUnit(verify(bt));
+      assertUnit(bt.size() == 20000);
+      int expect = 0;
+      bool inOrder = true;
+      for (auto it = bt.begin(); it != bt.end(); ++it)
+         inOrder = inOrder && *it == expect++;
+      assertUnit(inOrder);
+      assertUnit(expect == 20000);
+   }  // teardown
+
+   /***************************************
+    * ASSIGN
+    ***************************************/
+
+   // assign replaces every value
+   void test_assign_standardToStandard()
+   {  // setup
+      Tree btSrc;
+      Tree btDest;
+      for (int i = 0; i < 50; i++)
+         btSrc.insert(i);
+      for (int i = 100; i < 130; i++)
+         btDest.insert(i);
+      // exercise
+      btDest = btSrc;
+      // verify
+      assertUnit(btDest.size() == 50);
+      assertUnit(verify(btDest));
+      assertUnit(*btDest.begin() == 0);
+      assertUnit(*btDest.rbegin() == 49);
+      assertUnit(btDest.find(100) == btDest.end());
+   }  // teardown
+
+   // swap trades roots, heights and leaf lists
+   void test_swap_standard()
+   {  // setup
+      Tree bt1;
+      Tree bt2;
+      for (int i = 0; i < 50; i++)
+         bt1.insert(i);
+      bt2.insert(99);
+      // exercise
+      bt1.swap(bt2);
+      // verify
+      assertUnit(bt1.size() == 1);
+      assertUnit(bt2.size() == 50);
+      assertUnit(bt1.height == 0);
+      assertUnit(bt2.height > 0);
+      assertUnit(verify(bt1));
+      assertUnit(verify(bt2));
+      assertUnit(*bt1.begin() == 99);
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // forward along the leaves and back again
+   void test_iterator_standard()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert((i * 37) % 100);
+      // exercise
+      int expect = 0;
+      bool forward = true;
+      for (auto it = bt.begin(); it != bt.end(); ++it)
+         forward = forward && *it == expect++;
+      bool backward = true;
+      for (auto it = bt.rbegin(); it != bt.end(); --it)
+         backward = backward && *it == --expect;
+      // verify
+      assertUnit(forward);
+      assertUnit(backward);
+      assertUnit(expect == 0);
+   }  // teardown
+
+   /***************************************
+    * FIND
+    ***************************************/
+
+   // every value can be found, and it is the value asked for
+   void test_find_standard()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert(i * 2);
+      // exercise
+      bool found = true;
+      for (int i = 0; i < 100; i++)
+      {
+         auto it = bt.find(i * 2);
+         found = found && it != bt.end() && *it == i * 2;
+      }
+      // verify
+      assertUnit(found);
+   }  // teardown
+
+   // values between the ones in the tree are missing
+   void test_find_missing()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert(i * 2);
+      // exercise
+      bool missing = true;
+      for (int i = -1; i < 200; i += 2)
+         missing = missing && bt.find(i) == bt.end();
+      // verify
+      assertUnit(missing);
+      assertUnit(bt.find(1000) == bt.end());
+   }  // teardown
+
+   // a run of equal values longer than a leaf: find the first one
+   void test_find_duplicatesAcrossLeaves()
+   {  // setup
+      custom::BTree<custom::pair<int, int>, std::less<custom::pair<int, int>>,
+                    std::allocator<custom::pair<int, int>>, 4> bt;
+      for (int i = 0; i < 20; i++)
+         bt.insert(custom::pair<int, int>(i < 5 || i >= 15 ? i : 7, i));
+      // exercise
+      auto it = bt.find(custom::pair<int, int>(7, 0));
+      // verify
+      assertUnit(verify(bt));
+      assertUnit(it != bt.end());
+      assertUnit((*it).first == 7);
+      assertUnit((*it).second == 5);  // the first one inserted
+      --it;
+      assertUnit((*it).first == 4);
+   }  // teardown
+
+   // the run of duplicates spans leaves: the bounds find both ends
+   void test_bounds_duplicatesAcrossLeaves()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 20; i++)
+         bt.insert(i < 5 ? 1 : (i < 15 ? 2 : 3));
+      // exercise
+      auto range = bt.equal_range(2);
+      auto itLower = bt.lower_bound(0);
+      auto itUpper = bt.upper_bound(3);
+      // verify
+      size_t n = 0;
+      for (auto it = range.first; it != range.second; ++it)
+         n += (*it == 2);
+      assertUnit(n == 10);
+      assertUnit(bt.count(2) == 10);
+      assertUnit(range.first != bt.end() && *range.first == 2);
+      assertUnit(range.second != bt.end() && *range.second == 3);
+      assertUnit(itLower == bt.begin());
+      assertUnit(itUpper == bt.end());
+      assertUnit(verify(bt));
+   }  // teardown
+
+   // visit [lo, hi) along the leaves
+   void test_visitRange_acrossLeaves()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert((i * 37) % 100);
+      std::vector<int> visited;
+      // exercise
+      bt.visit_range(17, 33, [&visited](int value) { visited.push_back(value); });
+      // verify
+      bool inOrder = visited.size() == 16;
+      for (size_t i = 0; i < visited.size(); i++)
+         inOrder = inOrder && visited[i] == 17 + (int)i;
+      assertUnit(inOrder);
+   }  // teardown
+
+   // from each bound to the next, across leaves and duplicates, agrees
+   // with a search from the root
+   void test_boundFrom_sweep()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 300; i++)
+         bt.insert((i * 7) % 100 / 2 * 3);
+      bool same = true;
+      auto itLower = bt.end();
+      auto itUpper = bt.end();
+      // exercise
+      for (int k = -1; k < 155; k++)
+      {
+         itLower = bt.bound_from(itLower, k);
+         itUpper = bt.bound_from(itUpper, k, /*upper: */true);
+         same = same && itLower == bt.lower_bound(k) && itUpper == bt.upper_bound(k);
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(itLower == bt.end());
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // ascending values split the rightmost leaf over and over
+   void test_insert_ascending()
+   {  // setup
+      Tree bt;
+      // exercise
+      for (int i = 0; i < 500; i++)
+         bt.insert(i);
+      // verify
+      assertUnit(bt.size() == 500);
+      assertUnit(bt.height >= 4);
+      assertUnit(verify(bt));
+   }  // teardown
+
+   // scattered values against a std::multiset
+   void test_insert_random()
+   {  // setup
+      Tree bt;
+      std::multiset<int> ref;
+      std::srand(12);
+      bool valid = true;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+      {
+         int value = std::rand() % 300;
+         bt.insert(value);
+         ref.insert(value);
+         valid = valid && verify(bt);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(std::vector<int>(bt.begin(), bt.end()) == std::vector<int>(ref.begin(), ref.end()));
+   }  // teardown
+
+   // keepUnique finds the one already there and builds nothing
+   void test_insert_keepUnique()
+   {  // setup
+      SpyTree bt;
+      for (int i = 0; i < 50; i++)
+         bt.insert(Spy(i));
+      Spy s(20);
+      Spy::reset();
+      // exercise
+      auto result = bt.insert(s, /*keepUnique: */true);
+      // verify
+      assertUnit(result.second == false);
+      assertUnit(*result.first == Spy(20));
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(bt.size() == 50);
+   }  // teardown
+
+   // without keepUnique equal values go after each other, in order
+   void test_insert_duplicate()
+   {  // setup
+      custom::BTree<custom::pair<int, int>, std::less<custom::pair<int, int>>,
+                    std::allocator<custom::pair<int, int>>, 4> bt;
+      // exercise
+      for (int i = 0; i < 30; i++)
+         bt.insert(custom::pair<int, int>(i % 3, i));
+      // verify
+      assertUnit(verify(bt));
+      bool stable = true;
+      int prevFirst = -1;
+      int prevSecond = -1;
+      for (auto it = bt.begin(); it != bt.end(); ++it)
+      {
+         stable = stable && ((*it).first > prevFirst || (*it).second > prevSecond);
+         prevFirst = (*it).first;
+         prevSecond = (*it).second;
+      }
+      assertUnit(stable);
+   }  // teardown
+
+   // emplace builds the value once and moves it into its slot
+   void test_emplace_standard()
+   {  // setup
+      SpyTree bt;
+      for (int i = 0; i < 3; i++)
+         bt.insert(Spy(i * 2));
+      Spy::reset();
+      // exercise
+      auto result = bt.emplace(/*keepUnique: */false, 3);
+      // verify
+      assertUnit(Spy::numNondefault() == 1);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(result.second == true);
+      assertUnit(*result.first == Spy(3));
+      assertUnit(bt.size() == 4);
+      assertUnit(verify(bt));
+   }  // teardown
+
+   // appending with end() as the hint is one comparison an insert
+   void test_insertHint_append()
+   {  // setup
+      SpyTree bt;
+      bt.insert(Spy(0));
+      int num = 0;
+      // exercise
+      for (int i = 1; i < 100; i++)
+      {
+         Spy s(i);
+         Spy::reset();
+         bt.insert(bt.end(), s, /*keepUnique: */true);
+         num += Spy::numLessthan();
+      }
+      // verify
+      assertUnit(num == 99);
+      assertUnit(bt.size() == 100);
+      assertUnit(verify(bt));
+   }  // teardown
+
+   // a hint in the wrong place still puts the value in the right one
+   void test_insertHint_wrong()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i += 2)
+         bt.insert(i);
+      bool valid = true;
+      // exercise
+      for (int i = 1; i < 100; i += 2)
+      {
+         bt.insert(bt.begin(), i, /*keepUnique: */true);
+         bt.insert(bt.find(i - 1), i + 1000, /*keepUnique: */false);
+         valid = valid && verify(bt);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(bt.size() == 150);
+      int expect = 0;
+      bool inOrder = true;
+      for (auto it = bt.begin(); expect < 100; ++it)
+         inOrder = inOrder && *it == expect++;
+      assertUnit(inOrder);
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // erase returns the value after the one erased, wherever it moved to
+   void test_erase_returnNext()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert(i);
+      // exercise
+      auto it = bt.find(10);
+      for (int i = 10; i < 60; i++)
+      {
+         assertUnit(*it == i);
+         it = bt.erase(it);
+      }
+      // verify
+      assertUnit(*it == 60);
+      assertUnit(bt.size() == 50);
+      assertUnit(verify(bt));
+      --it;
+      assertUnit(*it == 9);
+   }  // teardown
+
+   // scattered erases against a std::multiset
+   void test_erase_random()
+   {  // setup
+      Tree bt;
+      std::multiset<int> ref;
+      std::srand(34);
+      for (int i = 0; i < 600; i++)
+      {
+         int value = std::rand() % 200;
+         bt.insert(value);
+         ref.insert(value);
+      }
+      bool valid = true;
+      bool next = true;
+      // exercise
+      for (int i = 0; i < 500; i++)
+      {
+         int value = std::rand() % 200;
+         auto it = bt.find(value);
+         auto itRef = ref.find(value);
+         if (itRef == ref.end())
+         {
+            valid = valid && it == bt.end();
+            continue;
+         }
+         it = bt.erase(it);
+         itRef = ref.erase(itRef);
+         next = next && (itRef == ref.end() ? it == bt.end() : *it == *itRef);
+         valid = valid && verify(bt);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(next);
+      assertUnit(std::vector<int>(bt.begin(), bt.end()) == std::vector<int>(ref.begin(), ref.end()));
+   }  // teardown
+
+   // erase everything: the tree shrinks back down to nothing
+   void test_erase_all()
+   {  // setup
+      PairTree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert(custom::pair<int, Spy>((i * 37) % 100, Spy(i)));
+      Spy::reset();
+      // exercise
+      for (int i = 0; i < 100; i++)
+      {
+         auto it = bt.find((i * 59) % 100);
+         bt.erase(it);
+      }
+      // verify
+      assertUnit(bt.size() == 0);
+      assertUnit(bt.root == nullptr);
+      assertUnit(bt.height == 0);
+      assertUnit(bt.pFirst == nullptr);
+      assertUnit(Spy::numDelete() == 100);  // every value is gone
+      assertUnit(Spy::numAlloc() == 0);
+   }  // teardown
+
+   // clear frees every node and value
+   void test_clear_standard()
+   {  // setup
+      PairTree bt;
+      for (int i = 0; i < 100; i++)
+         bt.insert(custom::pair<int, Spy>(i, Spy(i)));
+      Spy::reset();
+      // exercise
+      bt.clear();
+      // verify
+      assertUnit(Spy::numDestructor() == 100);
+      assertUnit(Spy::numDelete() == 100);
+      assertUnit(bt.root == nullptr);
+      assertUnit(bt.size() == 0);
+      assertUnit(verify(bt));
+   }  // teardown
+
+   /***************************************
+    * MAP
+    ***************************************/
+
+   // a map on a B+tree reads and writes like any other
+   void test_map_standard()
+   {  // setup
+      custom::map<int, std::string, std::less<int>, std::allocator<custom::pair<int, std::string>>,
+                  custom::bplus<8>> m;
+      // exercise
+      for (int i = 0; i < 200; i++)
+         m[(i * 37) % 200] = std::to_string(i);
+      m.erase(100);
+      m.insert(custom::pair<int, std::string>(5, "no"));
+      // verify
+      assertUnit(m.size() == 199);
+      assertUnit(verify(m.bst));
+      assertUnit(m.at(0) == "0");
+      assertUnit(m[37] == "1");
+      assertUnit(m.find(100) == m.end());
+      assertUnit(m.count(5) == 1);
+      assertUnit(m[5] != "no");
+      int count = 0;
+      for (auto it = m.begin(); it != m.end(); ++it)
+         count++;
+      assertUnit(count == 199);
+   }  // teardown
+
+   // erasing a range when every erase moves the pairs after it
+   void test_map_eraseRange()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>,
+                  custom::bplus<4>> m;
+      for (int i = 0; i < 100; i++)
+         m[i] = i;
+      // exercise
+      auto it = m.erase(m.find(10), m.find(90));
+      // verify
+      assertUnit(m.size() == 20);
+      assertUnit((*it).first == 90);
+      assertUnit(verify(m.bst));
+      assertUnit(m.find(50) == m.end());
+      assertUnit(m.at(9) == 9);
+   }  // teardown
+
+   /***************************************
+    * KEY SEARCH
+    *    custom::simd_keys
+    *    custom::key_lower_bound()
+    *    custom::key_upper_bound()
+    ***************************************/
+
+   // only ascending ints, longs and doubles take the SIMD search
+   void test_simdKeys_trait()
+   {  // setup
+      using IntMap = custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>,
+                                 custom::bplus<>>;
+      using StringMap = custom::map<std::string, int>;
+      // exercise and verify
+      assertUnit((custom::simd_keys<std::less<int>, int>::value));
+      assertUnit((custom::simd_keys<std::less<>, std::int64_t>::value));
+      assertUnit((custom::simd_keys<std::less<double>, double>::value));
+      assertUnit((custom::simd_keys<IntMap::value_compare, int>::value));
+      assertUnit(!(custom::simd_keys<std::greater<int>, int>::value));
+      assertUnit(!(custom::simd_keys<std::less<unsigned>, unsigned>::value));
+      assertUnit(!(custom::simd_keys<std::less<char>, char>::value));
+      assertUnit(!(custom::simd_keys<StringMap::value_compare, std::string>::value));
+   }  // teardown
+
+   // every length, both sides of the bisection window, agrees with std::lower_bound
+   void test_keyLowerBound_sizes()
+   {  // setup
+      std::vector<int> keys;
+      bool agree = true;
+      // exercise
+      for (int n = 0; n < 200; n++)
+      {
+         for (int k = -1; k <= 2 * n + 1; k++)
+            agree = agree && custom::key_lower_bound(keys.data(), keys.size(), k) ==
+               static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), k) - keys.begin());
+         keys.push_back(2 * n);
+      }
+      // verify
+      assertUnit(agree);
+   }  // teardown
+
+   // runs of equal keys: the upper bound is past the whole run
+   void test_keyUpperBound_duplicates()
+   {  // setup
+      std::vector<double> keys;
+      for (int i = 0; i < 150; i++)
+         keys.push_back(static_cast<double>(i / 10) * 0.5);
+      bool agree = true;
+      // exercise
+      for (int i = -1; i < 16; i++)
+      {
+         double k = i * 0.5;
+         agree = agree && custom::key_upper_bound(keys.data(), keys.size(), k) ==
+            static_cast<size_t>(std::upper_bound(keys.begin(), keys.end(), k) - keys.begin());
+         agree = agree && custom::key_lower_bound(keys.data(), keys.size(), k) ==
+            static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), k) - keys.begin());
+      }
+      // verify
+      assertUnit(agree);
+   }  // teardown
+
+   // the smallest and largest keys there are
+   void test_keyBound_extremes()
+   {  // setup
+      const std::int64_t lo = std::numeric_limits<std::int64_t>::min();
+      const std::int64_t hi = std::numeric_limits<std::int64_t>::max();
+      std::int64_t keys[] = { lo, lo, -1, 0, 1, hi, hi };
+      // exercise and verify
+      assertUnit(custom::key_lower_bound(keys, 7, lo) == 0);
+      assertUnit(custom::key_upper_bound(keys, 7, lo) == 2);
+      assertUnit(custom::key_lower_bound(keys, 7, std::int64_t(0)) == 3);
+      assertUnit(custom::key_upper_bound(keys, 7, std::int64_t(0)) == 4);
+      assertUnit(custom::key_lower_bound(keys, 7, hi) == 5);
+      assertUnit(custom::key_upper_bound(keys, 7, hi) == 7);
+   }  // teardown
+
+   /***************************************
+    * PARALLEL
+    ***************************************/
+
+   // every value once, each run of leaves on whatever thread
+   void test_parallelForEach_all()
+   {  // setup
+      std::vector<int> v;
+      for (int i = 0; i < 20000; i++)
+         v.push_back(i);
+      Tree bt;
+      bt.buildSorted(v.begin(), v.size());
+      std::vector<std::atomic<int>> seen(v.size());
+      // exercise
+      bt.parallel_for_each([&seen](const int& i) { seen[i]++; }, 4);
+      // verify
+      bool once = true;
+      for (const std::atomic<int>& n : seen)
+         once = once && n.load() == 1;
+      assertUnit(once);
+   }  // teardown
+
+   // the first value of a leaf each, more than asked for, in order
+   void test_splitters_sorted()
+   {  // setup
+      Tree bt;
+      for (int i = 0; i < 1000; i++)
+         bt.insert((i * 37) % 1000);
+      // exercise
+      std::vector<const int*> keys = bt.splitters(15);
+      // verify
+      assertUnit(keys.size() > 15);
+      bool sorted = true;
+      for (size_t i = 1; i < keys.size(); i++)
+         sorted = sorted && *keys[i - 1] < *keys[i];
+      assertUnit(sorted);
+      assertUnit(*keys[0] == 0);
+   }  // teardown
+
+   /**************************************************************
+    * VERIFY
+    * Check every invariant of a B+tree: nodes half full, all
+    * leaves at one depth, parent links, the leaf list, and every
+    * value between the keys above it
+    *************************************************************/
+   template <class BT>
+   static bool verify(const BT& bt)
+   {
+      if (!bt.root)
+         return bt.numElements == 0 && bt.height == 0 && !bt.pFirst && !bt.pLast;
+
+      typename BT::Leaf* pExpect = bt.pFirst;
+      typename BT::Leaf* pPrev = nullptr;
+      size_t count = 0;
+      return bt.root->pParent == nullptr &&
+             verifyNode(bt, bt.root, bt.height, nullptr, nullptr, pExpect, pPrev, count) &&
+             pExpect == nullptr && pPrev == bt.pLast && count == bt.numElements;
+   }
+
+   template <class BT>
+   static bool verifyNode(const BT& bt, typename BT::Node* pNode, size_t depth,
+                          const typename BT::key_type* pLo, const typename BT::key_type* pHi,
+                          typename BT::Leaf*& pExpect, typename BT::Leaf*& pPrev, size_t& count)
+   {
+      const typename BT::value_compare& comp = bt.compare();
+      size_t min = (pNode == bt.root) ? 1 : BT::MIN;
+      if (depth == 0)
+      {
+         auto* pLeaf = static_cast<typename BT::Leaf*>(pNode);
+         if (pLeaf != pExpect || pLeaf->pPrev != pPrev || pLeaf->n < min || pLeaf->n > BT::MAX)
+            return false;
+         for (size_t i = 0; i < pLeaf->n; i++)
+         {
+            const auto& value = pLeaf->values()[i];
+            if ((pLo && comp(value, *pLo)) || (pHi && comp(*pHi, value)))
+               return false;
+            if (i > 0 && comp(value, pLeaf->values()[i - 1]))
+               return false;
+         }
+         count += pLeaf->n;
+         pPrev = pLeaf;
+         pExpect = pLeaf->pNext;
+         return true;
+      }
+
+      auto* pInner = static_cast<typename BT::Inner*>(pNode);
+      if (pInner->n < min || pInner->n > BT::MAX)
+         return false;
+      const typename BT::key_type* keys = pInner->keys();
+      for (size_t i = 0; i <= pInner->n; i++)
+      {
+         const typename BT::key_type* pLoChild = i == 0 ? pLo : keys + i - 1;
+         const typename BT::key_type* pHiChild = i == pInner->n ? pHi : keys + i;
+         if (i < pInner->n && ((pLo && comp(keys[i], *pLo)) || (pHi && comp(*pHi, keys[i]))))
+            return false;
+         if (pInner->children[i]->pParent != pInner ||
+             !verifyNode(bt, pInner->children[i], depth - 1, pLoChild, pHiChild, pExpect, pPrev, count))
+            return false;
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,290 @@
+/***********************************************************************
+ * Header:
+ *    TEST CONCURRENT MAP
+ * Summary:
+ *    Unit tests for the Left-Right concurrent map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "concurrent_map.h" // class under test
+#include "unitTest.h"       // unit test baseclass
+#include "spy.h"            // spy is a mock class to monitor the class under test
+
+#include <atomic>           // for std::atomic
+#include <stdexcept>        // for std::out_of_range
+#include <string>
+#include <thread>           // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST CONCURRENT MAP
+ * Unit tests for the concurrent_map class
+ ***********************************************/
+class TestConcurrentMap : public UnitTest
+{
+   using IntMap = custom::concurrent_map<int, int>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_map();
+
+      // Read
+      test_find_standard();
+      test_at_missing();
+      test_visitRange_standard();
+      test_read_indicators();
+
+      // Write
+      test_insert_bothSides();
+      test_insertOrAssign_standard();
+      test_erase_standard();
+      test_update_batch();
+      test_update_throwsFirst();
+
+      // Threads
+      test_threads_batchAtomic();
+
+      report("ConcurrentMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor: two empty copies, readers on the left
+   void test_construct_default()
+   {  // setup
+      // exercise
+      IntMap cm;
+      // verify
+      assertUnit(cm.empty());
+      assertUnit(cm.leftRight.load() == 0);
+      assertUnit(cm.versionIndex.load() == 0);
+      assertUnit(cm.sides[0].empty());
+      assertUnit(cm.sides[1].empty());
+   }  // teardown
+
+   // from a map: both copies get it
+   void test_construct_map()
+   {  // setup
+      custom::map<int, int> m = { {1, 10}, {2, 20} };
+      // exercise
+      IntMap cm(m);
+      // verify
+      assertUnit(cm.size() == 2);
+      assertUnit(cm.sides[0].size() == 2);
+      assertUnit(cm.sides[1].size() == 2);
+      assertUnit(m.size() == 2);
+   }  // teardown
+
+   /***************************************
+    * READ
+    ***************************************/
+
+   // a lookup returns a copy of the value, or nothing
+   void test_find_standard()
+   {  // setup
+      IntMap cm = { {1, 10}, {2, 20} };
+      // exercise
+      auto v2 = cm.find(2);
+      auto v3 = cm.find(3);
+      // verify
+      assertUnit(v2.has_value() && *v2 == 20);
+      assertUnit(!v3.has_value());
+      assertUnit(cm.contains(1));
+      assertUnit(!cm.contains(3));
+   }  // teardown
+
+   // at() throws the way map's does, and the read still departs
+   void test_at_missing()
+   {  // setup
+      IntMap cm = { {1, 10} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         cm.at(5);
+      }
+      catch (const std::out_of_range&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(cm.indicators[0].empty());
+      assertUnit(cm.indicators[1].empty());
+   }  // teardown
+
+   // the range goes through the copy being read
+   void test_visitRange_standard()
+   {  // setup
+      IntMap cm;
+      for (int i = 0; i < 20; i++)
+         cm.insert(custom::pair<int, int>(i, i * i));
+      int sum = 0;
+      // exercise
+      cm.visit_range(3, 6, [&sum](const custom::pair<int, int>& p) { sum += p.second; });
+      // verify
+      assertUnit(sum == 9 + 16 + 25);
+   }  // teardown
+
+   // a reader is counted while it reads, and not after
+   void test_read_indicators()
+   {  // setup
+      IntMap cm = { {1, 10} };
+      bool arrived = false;
+      // exercise
+      cm.read([&](const IntMap::map_type& m)
+      {
+         arrived = !cm.indicators[cm.versionIndex.load()].empty() && m.size() == 1;
+      });
+      // verify
+      assertUnit(arrived);
+      assertUnit(cm.indicators[0].empty());
+      assertUnit(cm.indicators[1].empty());
+   }  // teardown
+
+   /***************************************
+    * WRITE
+    ***************************************/
+
+   // each write lands in both copies and moves the readers over
+   void test_insert_bothSides()
+   {  // setup
+      IntMap cm;
+      // exercise
+      bool inserted = cm.insert(custom::pair<int, int>(7, 70));
+      bool again = cm.insert(custom::pair<int, int>(7, 71));
+      // verify
+      assertUnit(inserted);
+      assertUnit(!again);
+      assertUnit(cm.sides[0].at(7) == 70);
+      assertUnit(cm.sides[1].at(7) == 70);
+      assertUnit(cm.leftRight.load() == 0);   // two writes: back where it started
+      assertUnit(cm.versionIndex.load() == 0);
+   }  // teardown
+
+   // assign when present, insert when not
+   void test_insertOrAssign_standard()
+   {  // setup
+      IntMap cm = { {1, 10} };
+      // exercise
+      bool inserted1 = cm.insert_or_assign(1, 11);
+      bool inserted2 = cm.insert_or_assign(2, 20);
+      // verify
+      assertUnit(!inserted1);
+      assertUnit(inserted2);
+      assertUnit(cm.at(1) == 11);
+      assertUnit(cm.sides[0].at(1) == 11 && cm.sides[1].at(1) == 11);
+   }  // teardown
+
+   // erase reports whether the key was there
+   void test_erase_standard()
+   {  // setup
+      IntMap cm = { {1, 10}, {2, 20} };
+      // exercise
+      size_t erased = cm.erase(1);
+      size_t missing = cm.erase(1);
+      // verify
+      assertUnit(erased == 1);
+      assertUnit(missing == 0);
+      assertUnit(cm.sides[0].size() == 1 && cm.sides[1].size() == 1);
+   }  // teardown
+
+   // a batch runs once on each copy and returns the first result
+   void test_update_batch()
+   {  // setup
+      IntMap cm;
+      int calls = 0;
+      // exercise
+      size_t size = cm.update([&calls](IntMap::map_type& m)
+      {
+         calls++;
+         for (int i = 0; i < 10; i++)
+            m[i] = i;
+         return m.size();
+      });
+      // verify
+      assertUnit(calls == 2);
+      assertUnit(size == 10);
+      assertUnit(cm.sides[0].size() == 10 && cm.sides[1].size() == 10);
+   }  // teardown
+
+   // a batch that throws at once changes nothing readers can see
+   void test_update_throwsFirst()
+   {  // setup
+      IntMap cm = { {1, 10} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         cm.update([](IntMap::map_type& m) { m[2] = 20; throw std::out_of_range("stop"); });
+      }
+      catch (const std::out_of_range&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(cm.leftRight.load() == 0);
+      assertUnit(!cm.contains(2));
+      assertUnit(cm.sides[cm.leftRight.load()].size() == 1);
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // readers never see half a batch: the writer moves one unit between
+   // two keys at a time, so they always add up to the same total
+   void test_threads_batchAtomic()
+   {  // setup
+      IntMap cm = { {0, 1000}, {1, 0} };
+      std::atomic<bool> done(false);
+      std::atomic<int> torn(0);
+      std::atomic<long> reads(0);
+      std::vector<std::thread> readers;
+      for (int t = 0; t < 4; t++)
+         readers.emplace_back([&]()
+         {
+            while (!done.load())
+            {
+               int total = cm.read([](const IntMap::map_type& m) { return m.at(0) + m.at(1); });
+               if (total != 1000)
+                  torn++;
+               reads++;
+            }
+         });
+      while (reads.load() == 0)                // one core: let the readers start
+         std::this_thread::yield();
+      // exercise
+      for (int i = 0; i < 500; i++)
+         cm.update([](IntMap::map_type& m)
+         {
+            int from = m.at(0) > 0 ? 0 : 1;
+            m[from] -= 1;
+            m[1 - from] += 1;
+         });
+      done.store(true);
+      for (std::thread& t : readers)
+         t.join();
+      // verify
+      assertUnit(torn.load() == 0);
+      assertUnit(reads.load() > 0);
+      assertUnit(cm.at(0) == 500);
+      assertUnit(cm.at(1) == 500);
+      assertUnit(cm.sides[0].at(0) == cm.sides[1].at(0));
+   }  // teardown
+};
+
+#endif // DEBUG
@@ -0,0 +1,537 @@
+/***********************************************************************
+ * Header:
+ *    TEST FLAT MAP
+ * Summary:
+ *    Unit tests for the sorted-array map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "flat_map.h"   // class under test
+#include "map.h"        // to convert to and from
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // spy is a mock class to monitor the class under test
+
+#include <cstdlib>      // for std::rand
+#include <map>          // for std::map, the reference
+#include <stdexcept>    // for std::out_of_range
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST FLAT MAP
+ * Unit tests for the flat_map class
+ ***********************************************/
+class TestFlatMap : public UnitTest
+{
+   using SpyMap = custom::flat_map<Spy, int>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_range();
+      test_construct_sortedUnique();
+      test_constructCopy_standard();
+      test_constructMove_standard();
+
+      // Convert
+      test_fromMap_standard();
+      test_toMap_standard();
+
+      // Iterator
+      test_iterator_standard();
+      test_iterator_decrementBegin();
+
+      // Access
+      test_find_standard();
+      test_find_missing();
+      test_at_missing();
+      test_squareBracket_insert();
+      test_bounds_standard();
+      test_visitRange_standard();
+
+      // Insert
+      test_insert_random();
+      test_insert_duplicate();
+      test_insertRange_keepsExisting();
+      test_insertRange_comparisons();
+      test_insertHint_append();
+      test_tryEmplace_present();
+      test_insertOrAssign_standard();
+      test_merge_standard();
+
+      // Remove
+      test_erase_key();
+      test_erase_iterator();
+      test_erase_range();
+
+      // Status
+      test_swap_standard();
+
+      report("FlatMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor, no allocations
+   void test_construct_default()
+   {  // setup
+      Spy::reset();
+      // exercise
+      custom::flat_map<int, Spy> fm;
+      // verify
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(fm.size() == 0);
+      assertUnit(fm.empty());
+      assertUnit(fm.keys().capacity() == 0);
+      assertUnit(fm.begin() == fm.end());
+   }  // teardown
+
+   // unsorted input with a duplicate: the first of each key wins
+   void test_construct_range()
+   {  // setup
+      std::vector<custom::pair<int, int>> v = { {50, 1}, {30, 2}, {70, 3}, {30, 4}, {20, 5} };
+      // exercise
+      custom::flat_map<int, int> fm(v.begin(), v.end());
+      // verify
+      assertUnit(fm.size() == 4);
+      assertUnit(fm.keys() == std::vector<int>({ 20, 30, 50, 70 }));
+      assertUnit(fm.values() == std::vector<int>({ 5, 2, 1, 3 }));
+   }  // teardown
+
+   // sorted_unique appends, with no comparisons
+   void test_construct_sortedUnique()
+   {  // setup
+      std::vector<custom::pair<Spy, int>> v;
+      for (int i = 0; i < 100; i++)
+         v.push_back(custom::pair<Spy, int>(Spy(i), i));
+      Spy::reset();
+      // exercise
+      SpyMap fm(custom::sorted_unique, v.begin(), v.end());
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(fm.size() == 100);
+      assertUnit(fm.keys().front() == Spy(0));
+      assertUnit(fm.keys().back() == Spy(99));
+   }  // teardown
+
+   // copy is one copy of each value
+   void test_constructCopy_standard()
+   {  // setup
+      custom::flat_map<int, Spy> fmSrc;
+      for (int i = 0; i < 100; i++)
+         fmSrc[i] = Spy(i);
+      Spy::reset();
+      // exercise
+      custom::flat_map<int, Spy> fmDest(fmSrc);
+      // verify
+      assertUnit(Spy::numCopy() == 100);
+      assertUnit(fmDest.size() == 100);
+      assertUnit(fmSrc.size() == 100);
+      assertUnit(fmDest.keys() == fmSrc.keys());
+      assertUnit(fmDest.values().data() != fmSrc.values().data());
+   }  // teardown
+
+   // move steals both arrays
+   void test_constructMove_standard()
+   {  // setup
+      custom::flat_map<int, Spy> fmSrc;
+      for (int i = 0; i < 100; i++)
+         fmSrc[i] = Spy(i);
+      const Spy* pValues = fmSrc.values().data();
+      Spy::reset();
+      // exercise
+      custom::flat_map<int, Spy> fmDest(std::move(fmSrc));
+      // verify
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(fmDest.size() == 100);
+      assertUnit(fmSrc.size() == 0);
+      assertUnit(fmDest.values().data() == pValues);
+   }  // teardown
+
+   /***************************************
+    * CONVERT
+    ***************************************/
+
+   // the map's pairs come in order, with no comparisons
+   void test_fromMap_standard()
+   {  // setup
+      custom::map<Spy, int> m;
+      for (int i = 0; i < 100; i++)
+         m[Spy((i * 37) % 100)] = i;
+      Spy::reset();
+      // exercise
+      SpyMap fm(m);
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(fm.size() == 100);
+      assertUnit(fm.keys().front() == Spy(0));
+      assertUnit(fm.keys().back() == Spy(99));
+      assertUnit(fm.at(Spy(37)) == 1);
+   }  // teardown
+
+   // back to a map by the sorted bulk build, with no comparisons
+   void test_toMap_standard()
+   {  // setup
+      SpyMap fm;
+      for (int i = 0; i < 100; i++)
+         fm[Spy((i * 37) % 100)] = i;
+      Spy::reset();
+      // exercise
+      custom::map<Spy, int> m(fm);
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(m.size() == 100);
+      assertUnit((*m.begin()).first == Spy(0));
+      assertUnit(m.at(Spy(37)) == 1);
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // forward and back, writing through the value reference
+   void test_iterator_standard()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      for (int i = 0; i < 50; i++)
+         fm[(i * 7) % 50] = 0;
+      // exercise
+      int expect = 0;
+      bool forward = true;
+      for (auto it = fm.begin(); it != fm.end(); ++it)
+      {
+         forward = forward && (*it).first == expect;
+         (*it).second = expect++;
+      }
+      bool backward = true;
+      for (auto it = fm.rbegin(); it != fm.end(); --it)
+         backward = backward && (*it).first == --expect && (*it).second == expect;
+      // verify
+      assertUnit(forward);
+      assertUnit(backward);
+      assertUnit(expect == 0);
+   }  // teardown
+
+   // back from the first pair is the end, as in map
+   void test_iterator_decrementBegin()
+   {  // setup
+      custom::flat_map<int, int> fm = { {1, 1}, {2, 2} };
+      auto it = fm.begin();
+      // exercise
+      --it;
+      // verify
+      assertUnit(it == fm.end());
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // every key is found at its place
+   void test_find_standard()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      for (int i = 0; i < 300; i++)
+         fm[i * 2] = i;
+      bool found = true;
+      // exercise
+      for (int i = 0; i < 300; i++)
+      {
+         auto it = fm.find(i * 2);
+         found = found && it != fm.end() && (*it).second == i;
+      }
+      // verify
+      assertUnit(found);
+      assertUnit(fm.count(298) == 1);
+   }  // teardown
+
+   // keys between, before and after the stored ones
+   void test_find_missing()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      for (int i = 0; i < 300; i++)
+         fm[i * 2] = i;
+      bool missing = true;
+      // exercise
+      for (int i = -1; i < 601; i += 2)
+         missing = missing && fm.find(i) == fm.end();
+      // verify
+      assertUnit(missing);
+      assertUnit(fm.count(5) == 0);
+      assertUnit(fm.size() == 300);
+   }  // teardown
+
+   // at() throws the way map's does
+   void test_at_missing()
+   {  // setup
+      custom::flat_map<std::string, int> fm = { {"a", 1}, {"c", 3} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         fm.at("b");
+      }
+      catch (const std::out_of_range& error)
+      {
+         thrown = std::string(error.what()) == "invalid map<K, T> key";
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(fm.at("c") == 3);
+      assertUnit(fm.size() == 2);
+   }  // teardown
+
+   // [] adds a default value for a missing key
+   void test_squareBracket_insert()
+   {  // setup
+      custom::flat_map<int, Spy> fm;
+      fm[20] = Spy(20);
+      Spy::reset();
+      // exercise
+      Spy& s = fm[10];
+      // verify
+      assertUnit(Spy::numDefault() == 1);
+      assertUnit(s == Spy());
+      assertUnit(fm.size() == 2);
+      assertUnit(fm.keys().front() == 10);
+   }  // teardown
+
+   // bounds and equal ranges by key
+   void test_bounds_standard()
+   {  // setup
+      custom::flat_map<int, int> fm = { {10, 1}, {20, 2}, {30, 3} };
+      // exercise
+      auto itLower = fm.lower_bound(15);
+      auto itUpper = fm.upper_bound(20);
+      auto range = fm.equal_range(30);
+      // verify
+      assertUnit((*itLower).first == 20);
+      assertUnit((*itUpper).first == 30);
+      assertUnit((*range.first).first == 30);
+      assertUnit(range.second == fm.end());
+      assertUnit(fm.upper_bound(30) == fm.end());
+   }  // teardown
+
+   // visit the keys in [lo, hi) with their values
+   void test_visitRange_standard()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      for (int i = 0; i < 100; i++)
+         fm[i * 2] = i;
+      int sum = 0;
+      int n = 0;
+      // exercise
+      fm.visit_range(11, 21, [&sum, &n](const int& key, const int& value) { sum += value; n += key > 0; });
+      // verify
+      assertUnit(n == 5);
+      assertUnit(sum == 6 + 7 + 8 + 9 + 10);
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // random inserts and erases agree with std::map
+   void test_insert_random()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      std::map<int, int> expect;
+      std::srand(14);
+      bool same = true;
+      // exercise
+      for (int i = 0; i < 2000; i++)
+      {
+         int k = std::rand() % 500;
+         if (std::rand() % 3 == 0)
+            same = same && fm.erase(k) == expect.erase(k);
+         else
+            same = same && fm.insert(custom::pair<int, int>(k, i)).second == expect.insert({ k, i }).second;
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(fm.size() == expect.size());
+      auto it = fm.begin();
+      for (const auto& p : expect)
+      {
+         same = same && (*it).first == p.first && (*it).second == p.second;
+         ++it;
+      }
+      assertUnit(same);
+   }  // teardown
+
+   // a key already there is not replaced
+   void test_insert_duplicate()
+   {  // setup
+      custom::flat_map<int, int> fm = { {10, 1} };
+      // exercise
+      auto result = fm.insert(custom::pair<int, int>(10, 2));
+      // verify
+      assertUnit(result.second == false);
+      assertUnit((*result.first).second == 1);
+      assertUnit(fm.size() == 1);
+   }  // teardown
+
+   // keys in both keep the value already here
+   void test_insertRange_keepsExisting()
+   {  // setup
+      custom::flat_map<int, int> fm = { {20, 1}, {40, 1}, {60, 1} };
+      std::vector<custom::pair<int, int>> v = { {50, 2}, {40, 2}, {10, 2}, {70, 2} };
+      // exercise
+      fm.insert(v.begin(), v.end());
+      // verify
+      assertUnit(fm.keys() == std::vector<int>({ 10, 20, 40, 50, 60, 70 }));
+      assertUnit(fm.values() == std::vector<int>({ 2, 1, 1, 2, 1, 2 }));
+   }  // teardown
+
+   // a sorted range is checked and merged: O(n + m) comparisons
+   void test_insertRange_comparisons()
+   {  // setup
+      SpyMap fm;
+      for (int i = 0; i < 100; i++)
+         fm[Spy(i * 2)] = i;
+      std::vector<custom::pair<Spy, int>> v;
+      for (int i = 0; i < 100; i++)
+         v.push_back(custom::pair<Spy, int>(Spy(i * 2 + 1), i));
+      Spy::reset();
+      // exercise
+      fm.insert(v.begin(), v.end());
+      // verify
+      assertUnit(Spy::numLessthan() < 500);
+      assertUnit(fm.size() == 200);
+      assertUnit(fm.keys().front() == Spy(0));
+      assertUnit(fm.keys().back() == Spy(199));
+   }  // teardown
+
+   // ascending keys hinted with end() need two comparisons each
+   void test_insertHint_append()
+   {  // setup
+      SpyMap fm;
+      fm.insert(custom::pair<Spy, int>(Spy(0), 0));
+      Spy::reset();
+      // exercise
+      for (int i = 1; i < 100; i++)
+         fm.insert(fm.end(), custom::pair<Spy, int>(Spy(i), i));
+      // verify
+      assertUnit(Spy::numLessthan() == 99);
+      assertUnit(fm.size() == 100);
+      assertUnit(fm.keys().back() == Spy(99));
+   }  // teardown
+
+   // a present key leaves the arguments alone
+   void test_tryEmplace_present()
+   {  // setup
+      custom::flat_map<int, Spy> fm;
+      fm[5] = Spy(5);
+      Spy s(9);
+      Spy::reset();
+      // exercise
+      auto result = fm.try_emplace(5, std::move(s));
+      // verify
+      assertUnit(result.second == false);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(s == Spy(9));
+      assertUnit(fm.at(5) == Spy(5));
+   }  // teardown
+
+   // assign when present, insert when not
+   void test_insertOrAssign_standard()
+   {  // setup
+      custom::flat_map<int, int> fm = { {1, 1} };
+      // exercise
+      bool inserted1 = fm.insert_or_assign(1, 10).second;
+      bool inserted2 = fm.insert_or_assign(2, 20).second;
+      // verify
+      assertUnit(inserted1 == false);
+      assertUnit(inserted2 == true);
+      assertUnit(fm.values() == std::vector<int>({ 10, 20 }));
+   }  // teardown
+
+   // keys already here stay behind in the source
+   void test_merge_standard()
+   {  // setup
+      custom::flat_map<int, int> fmDest = { {1, 1}, {3, 1}, {5, 1} };
+      custom::flat_map<int, int> fmSrc  = { {2, 2}, {3, 2}, {6, 2} };
+      // exercise
+      fmDest.merge(fmSrc);
+      // verify
+      assertUnit(fmDest.keys() == std::vector<int>({ 1, 2, 3, 5, 6 }));
+      assertUnit(fmDest.values() == std::vector<int>({ 1, 2, 1, 1, 2 }));
+      assertUnit(fmSrc.keys() == std::vector<int>({ 3 }));
+      assertUnit(fmSrc.values() == std::vector<int>({ 2 }));
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // erase by key reports whether it was there
+   void test_erase_key()
+   {  // setup
+      custom::flat_map<int, int> fm = { {1, 1}, {2, 2}, {3, 3} };
+      // exercise
+      size_t erased = fm.erase(2);
+      size_t missing = fm.erase(4);
+      // verify
+      assertUnit(erased == 1);
+      assertUnit(missing == 0);
+      assertUnit(fm.keys() == std::vector<int>({ 1, 3 }));
+      assertUnit(fm.values() == std::vector<int>({ 1, 3 }));
+   }  // teardown
+
+   // the iterator returned is at the next pair
+   void test_erase_iterator()
+   {  // setup
+      custom::flat_map<int, int> fm = { {1, 1}, {2, 2}, {3, 3} };
+      // exercise
+      auto it = fm.erase(fm.find(2));
+      auto itEnd = fm.erase(fm.find(3));
+      // verify
+      assertUnit((*it).first == 3);
+      assertUnit(itEnd == fm.end());
+      assertUnit(fm.keys() == std::vector<int>({ 1 }));
+   }  // teardown
+
+   // a range shifts the rest down once
+   void test_erase_range()
+   {  // setup
+      custom::flat_map<int, int> fm;
+      for (int i = 0; i < 10; i++)
+         fm[i] = i;
+      // exercise
+      auto it = fm.erase(fm.find(2), fm.find(8));
+      // verify
+      assertUnit((*it).first == 8);
+      assertUnit(fm.keys() == std::vector<int>({ 0, 1, 8, 9 }));
+      assertUnit(fm.values() == std::vector<int>({ 0, 1, 8, 9 }));
+   }  // teardown
+
+   /***************************************
+    * STATUS
+    ***************************************/
+
+   // swap trades the arrays
+   void test_swap_standard()
+   {  // setup
+      custom::flat_map<int, int> fm1 = { {1, 1}, {2, 2} };
+      custom::flat_map<int, int> fm2 = { {9, 9} };
+      // exercise
+      swap(fm1, fm2);
+      // verify
+      assertUnit(fm1.keys() == std::vector<int>({ 9 }));
+      assertUnit(fm2.keys() == std::vector<int>({ 1, 2 }));
+   }  // teardown
+};
+
+#endif // DEBUG
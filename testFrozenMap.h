@@ -0,0 +1,298 @@
+/***********************************************************************
+ * Header:
+ *    TEST FROZEN MAP
+ * Summary:
+ *    Unit tests for the read-only Eytzinger map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "frozen_map.h" // class under test
+#include "flat_map.h"   // to build from
+#include "map.h"        // to build from
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // spy is a mock class to monitor the class under test
+
+#include <map>          // for std::map, the reference
+#include <stdexcept>    // for std::out_of_range
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST FROZEN MAP
+ * Unit tests for the frozen_map class
+ ***********************************************/
+class TestFrozenMap : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_layout();
+      test_construct_range();
+      test_fromMap_comparisons();
+      test_fromFlatMap_standard();
+      test_fromBplus_standard();
+
+      // Iterator
+      test_iterator_sizes();
+      test_iterator_decrementEnd();
+
+      // Access
+      test_find_sizes();
+      test_find_missing();
+      test_find_comparisons();
+      test_bounds_standard();
+      test_at_missing();
+
+      report("FrozenMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor, nothing in it
+   void test_construct_default()
+   {  // setup
+      Spy::reset();
+      // exercise
+      custom::frozen_map<int, Spy> fz;
+      // verify
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(fz.size() == 0);
+      assertUnit(fz.empty());
+      assertUnit(fz.begin() == fz.end());
+      assertUnit(fz.find(1) == fz.end());
+   }  // teardown
+
+   // seven keys make a perfect tree: the middle at the root
+   void test_construct_layout()
+   {  // setup
+      custom::map<int, int> m;
+      for (int i = 1; i <= 7; i++)
+         m[i * 10] = i;
+      // exercise
+      custom::frozen_map<int, int> fz(m);
+      // verify
+      //            40
+      //        20      60
+      //      10  30  50  70
+      assertUnit(fz.keySlots == std::vector<int>({ 40, 20, 60, 10, 30, 50, 70 }));
+      assertUnit(fz.valueSlots == std::vector<int>({ 4, 2, 6, 1, 3, 5, 7 }));
+   }  // teardown
+
+   // unsorted input with a duplicate: the first of each key wins
+   void test_construct_range()
+   {  // setup
+      std::vector<custom::pair<int, int>> v = { {50, 1}, {30, 2}, {70, 3}, {30, 4}, {20, 5} };
+      // exercise
+      custom::frozen_map<int, int> fz(v.begin(), v.end());
+      // verify
+      assertUnit(fz.size() == 4);
+      assertUnit(fz.at(30) == 2);
+      assertUnit(fz.at(20) == 5);
+      assertUnit((*fz.begin()).first == 20);
+      assertUnit((*fz.rbegin()).first == 70);
+   }  // teardown
+
+   // a map is already in order: one copy each, no comparisons
+   void test_fromMap_comparisons()
+   {  // setup
+      custom::map<Spy, Spy> m;
+      for (int i = 0; i < 100; i++)
+         m[Spy((i * 37) % 100)] = Spy(i);
+      Spy::reset();
+      // exercise
+      custom::frozen_map<Spy, Spy> fz(m);
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numCopy() == 200);
+      assertUnit(fz.size() == 100);
+      assertUnit(fz.count(Spy(37)) == 1);
+   }  // teardown
+
+   // a flat map gives the same layout as a map of the same pairs
+   void test_fromFlatMap_standard()
+   {  // setup
+      custom::map<int, int> m;
+      for (int i = 0; i < 100; i++)
+         m[i] = -i;
+      custom::flat_map<int, int> fm(m);
+      // exercise
+      custom::frozen_map<int, int> fzFlat(fm);
+      custom::frozen_map<int, int> fzMap(m);
+      // verify
+      assertUnit(fzFlat.keySlots == fzMap.keySlots);
+      assertUnit(fzFlat.valueSlots == fzMap.valueSlots);
+   }  // teardown
+
+   // a map on the B+tree works as well
+   void test_fromBplus_standard()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::bplus<4>> m;
+      for (int i = 0; i < 100; i++)
+         m[(i * 37) % 100] = i;
+      // exercise
+      custom::frozen_map<int, int> fz(m);
+      // verify
+      assertUnit(fz.size() == 100);
+      assertUnit(fz.at(37) == 1);
+      assertUnit((*fz.begin()).first == 0);
+      assertUnit((*fz.rbegin()).first == 99);
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // in order both ways, whatever shape the last level has
+   void test_iterator_sizes()
+   {  // setup
+      bool forward = true;
+      bool backward = true;
+      // exercise
+      for (int n = 0; n <= 70; n++)
+      {
+         custom::map<int, int> m;
+         for (int i = 0; i < n; i++)
+            m[i] = i;
+         custom::frozen_map<int, int> fz(m);
+         int expect = 0;
+         for (auto it = fz.begin(); it != fz.end(); ++it)
+            forward = forward && (*it).first == expect++;
+         forward = forward && expect == n;
+         for (auto it = fz.rbegin(); it != fz.end(); --it)
+            backward = backward && (*it).first == --expect;
+         backward = backward && expect == 0;
+      }
+      // verify
+      assertUnit(forward);
+      assertUnit(backward);
+   }  // teardown
+
+   // back from the end is the last pair; back from the first is the end
+   void test_iterator_decrementEnd()
+   {  // setup
+      custom::frozen_map<int, int> fz = { {1, 1}, {2, 2}, {3, 3} };
+      auto it = fz.end();
+      // exercise
+      --it;
+      auto itBegin = fz.begin();
+      --itBegin;
+      // verify
+      assertUnit((*it).first == 3);
+      assertUnit(itBegin == fz.end());
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // every key found, for every size of tree
+   void test_find_sizes()
+   {  // setup
+      bool found = true;
+      // exercise
+      for (int n = 1; n <= 70; n++)
+      {
+         custom::map<int, int> m;
+         for (int i = 0; i < n; i++)
+            m[i * 2] = i;
+         custom::frozen_map<int, int> fz(m);
+         for (int i = 0; i < n; i++)
+         {
+            auto it = fz.find(i * 2);
+            found = found && it != fz.end() && (*it).second == i;
+         }
+      }
+      // verify
+      assertUnit(found);
+   }  // teardown
+
+   // keys between, before and after the stored ones
+   void test_find_missing()
+   {  // setup
+      custom::map<int, int> m;
+      for (int i = 0; i < 100; i++)
+         m[i * 2] = i;
+      custom::frozen_map<int, int> fz(m);
+      bool missing = true;
+      // exercise
+      for (int i = -1; i < 201; i += 2)
+         missing = missing && fz.find(i) == fz.end() && fz.count(i) == 0;
+      // verify
+      assertUnit(missing);
+   }  // teardown
+
+   // one comparison a level, every time: 7 levels for 100 keys, plus one
+   void test_find_comparisons()
+   {  // setup
+      custom::map<Spy, int> m;
+      for (int i = 0; i < 100; i++)
+         m[Spy(i)] = i;
+      custom::frozen_map<Spy, int> fz(m);
+      Spy s(0);
+      Spy::reset();
+      // exercise
+      fz.find(s);
+      // verify
+      assertUnit(Spy::numLessthan() == 8);
+   }  // teardown
+
+   // lower and upper bounds agree with std::map
+   void test_bounds_standard()
+   {  // setup
+      custom::map<int, int> m;
+      std::map<int, int> expect;
+      for (int i = 0; i < 50; i++)
+      {
+         m[i * 3] = i;
+         expect[i * 3] = i;
+      }
+      custom::frozen_map<int, int> fz(m);
+      bool same = true;
+      // exercise
+      for (int k = -2; k < 152; k++)
+      {
+         auto lower = fz.lower_bound(k);
+         auto upper = fz.upper_bound(k);
+         auto lowerExpect = expect.lower_bound(k);
+         auto upperExpect = expect.upper_bound(k);
+         same = same && (lower == fz.end()) == (lowerExpect == expect.end());
+         same = same && (upper == fz.end()) == (upperExpect == expect.end());
+         same = same && (lower == fz.end() || (*lower).first == lowerExpect->first);
+         same = same && (upper == fz.end() || (*upper).first == upperExpect->first);
+      }
+      // verify
+      assertUnit(same);
+   }  // teardown
+
+   // at() throws the way map's does
+   void test_at_missing()
+   {  // setup
+      custom::frozen_map<std::string, int> fz = { {"a", 1}, {"c", 3} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         fz.at("b");
+      }
+      catch (const std::out_of_range& error)
+      {
+         thrown = std::string(error.what()) == "invalid map<K, T> key";
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(fz.at("c") == 3);
+   }  // teardown
+};
+
+#endif // DEBUG
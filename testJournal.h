@@ -0,0 +1,476 @@
+/***********************************************************************
+ * Header:
+ *    TEST JOURNAL
+ * Summary:
+ *    Unit tests for the map with a write-ahead log: logging, group
+ *    commit, checkpoints and recovery
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "journal.h"        // class under test
+#include "unitTest.h"       // unit test baseclass
+
+#include <chrono>           // for std::chrono::steady_clock
+#include <cstdint>          // for std::uint64_t
+#include <filesystem>       // for std::filesystem::temp_directory_path
+#include <fstream>          // for std::ofstream
+#include <random>           // for std::random_device
+#include <stdexcept>        // for std::runtime_error
+#include <string>
+
+/***********************************************
+ * TEST JOURNAL
+ * Unit tests for the journaled_map class
+ ***********************************************/
+class TestJournal : public UnitTest
+{
+   using IntMap = custom::journaled_map<int, int>;
+   using IntPair = custom::pair<int, int>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // the files go in a directory of their own, never the working one
+      dir = std::filesystem::temp_directory_path() /
+            ("testJournal-" + std::to_string(std::random_device()()) + "-" +
+             std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+      path = (dir / "map").string();
+
+      // Construct
+      test_construct_fresh();
+      test_construct_leftoverTemp();
+
+      // Write
+      test_insert_logged();
+      test_insert_duplicateNotLogged();
+      test_erase_missingNotLogged();
+      test_squareBracket_assign();
+      test_squareBracket_readDefault();
+
+      // Recover
+      test_recover_afterSync();
+      test_recover_destructorFlushes();
+      test_recover_clear();
+      test_recover_tornTail();
+      test_recover_otherTypes();
+
+      // Checkpoint
+      test_checkpoint_rotates();
+      test_checkpoint_thenWrites();
+      test_checkpoint_beforeCommit();
+      test_checkpoint_automatic();
+
+      std::filesystem::remove_all(dir);
+      report("Journal");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // nothing on disk: an empty map and the first log
+   void test_construct_fresh()
+   {  // setup
+      removeFiles();
+      {
+         // exercise
+         IntMap m(path);
+         // verify
+         assertUnit(m.empty());
+         assertUnit(m.generation() == 0);
+         assertUnit(std::filesystem::exists(file(0, ".log")));
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // a checkpoint that was never finished is thrown away
+   void test_construct_leftoverTemp()
+   {  // setup
+      removeFiles();
+      std::ofstream(file(3, ".ckpt.tmp")) << "half a checkpoint";
+      {
+         // exercise
+         IntMap m(path);
+         // verify
+         assertUnit(m.empty());
+         assertUnit(m.generation() == 0);
+         assertUnit(!std::filesystem::exists(file(3, ".ckpt.tmp")));
+      }
+      // teardown
+      removeFiles();
+   }
+
+   /***************************************
+    * WRITE
+    ***************************************/
+
+   // a new pair is logged once
+   void test_insert_logged()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         // exercise
+         auto result = m.insert(IntPair(5, 50));
+         // verify
+         assertUnit(result.second);
+         assertUnit(m.appended == 1);
+         assertUnit(m.at(5) == 50);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // inserting a key already there changes nothing, so logs nothing
+   void test_insert_duplicateNotLogged()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         m.insert(IntPair(5, 50));
+         // exercise
+         auto result = m.insert(IntPair(5, 99));
+         // verify
+         assertUnit(!result.second);
+         assertUnit(m.appended == 1);
+         assertUnit(m.at(5) == 50);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // erasing a missing key logs nothing
+   void test_erase_missingNotLogged()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         m.insert(IntPair(5, 50));
+         // exercise
+         size_t erased = m.erase(6);
+         // verify
+         assertUnit(erased == 0);
+         assertUnit(m.appended == 1);
+         assertUnit(m.erase(5) == 1);
+         assertUnit(m.appended == 2);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // m[k] = v goes through the log
+   void test_squareBracket_assign()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         // exercise
+         m[7] = 70;
+         m[7] = 71;
+         // verify
+         assertUnit(m.at(7) == 71);
+         assertUnit(m.appended == 3);   // the default, then two assignments
+      }
+      {
+         IntMap m(path);
+         assertUnit(m.at(7) == 71);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // reading m[k] of a missing key logs the default it puts in
+   void test_squareBracket_readDefault()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         // exercise
+         int value = m[8];
+         // verify
+         assertUnit(value == 0);
+         assertUnit(m.appended == 1);
+         int again = m[8];
+         assertUnit(again == 0);
+         assertUnit(m.appended == 1);
+      }
+      {
+         IntMap m(path);
+         assertUnit(m.count(8) == 1);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   /***************************************
+    * RECOVER
+    ***************************************/
+
+   // what sync() covered is there when the map is opened again
+   void test_recover_afterSync()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         for (int i = 0; i < 100; i++)
+            m.insert(IntPair(i, i * 10));
+         m.erase(50);
+         m.insert_or_assign(10, -1);
+         // exercise
+         m.sync();
+         // verify
+         assertUnit(m.durable == m.appended);
+      }
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 99);
+         assertUnit(m.count(50) == 0);
+         assertUnit(m.at(10) == -1);
+         assertUnit(m.at(99) == 990);
+         assertUnit(m.generation() == 1);   // the old log is never appended to
+         assertUnit((*m.begin()).first == 0);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // the destructor commits what was still waiting
+   void test_recover_destructorFlushes()
+   {  // setup
+      removeFiles();
+      {
+         custom::journal_options opts;
+         opts.commit_interval = std::chrono::milliseconds(10000);
+         IntMap m(path, opts);
+         // exercise
+         m.insert(IntPair(1, 100));
+         m.insert(IntPair(2, 200));
+      }
+      // verify
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 2);
+         assertUnit(m.at(2) == 200);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // nothing logged before a clear comes back
+   void test_recover_clear()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         m.insert(IntPair(1, 100));
+         m.insert(IntPair(2, 200));
+         // exercise
+         m.clear();
+         m.insert(IntPair(3, 300));
+      }
+      // verify
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 1);
+         assertUnit(m.at(3) == 300);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // a batch cut short by a crash is ignored, the whole ones before it are not
+   void test_recover_tornTail()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         m.insert(IntPair(1, 100));
+         m.sync();
+      }
+      {
+         // half of a batch of one record
+         std::ofstream out(file(0, ".log"), std::ios::binary | std::ios::app);
+         const char torn[] = { 9, 0, 0, 0, 1, 2, 3, 4, 1, 2 };
+         out.write(torn, sizeof(torn));
+      }
+      {
+         // exercise
+         IntMap m(path);
+         // verify
+         assertUnit(m.size() == 1);
+         assertUnit(m.at(1) == 100);
+         assertUnit(m.generation() == 1);
+         m.insert(IntPair(2, 200));
+      }
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 2);
+         assertUnit(m.at(2) == 200);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // a log of other types is refused rather than misread
+   void test_recover_otherTypes()
+   {  // setup
+      removeFiles();
+      {
+         custom::journaled_map<long long, long long> m(path);
+         m.insert(custom::pair<long long, long long>(1, 100));
+      }
+      // exercise
+      bool thrown = false;
+      try
+      {
+         IntMap m(path);
+      }
+      catch (const std::runtime_error&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+      // teardown
+      removeFiles();
+   }
+
+   /***************************************
+    * CHECKPOINT
+    ***************************************/
+
+   // a checkpoint starts the next log, and the older files go
+   void test_checkpoint_rotates()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         for (int i = 0; i < 1000; i++)
+            m.insert(IntPair(i, -i));
+         // exercise
+         m.checkpoint();
+         // verify
+         assertUnit(m.generation() == 1);
+      }
+      assertUnit(std::filesystem::exists(file(1, ".ckpt")));
+      assertUnit(std::filesystem::exists(file(1, ".log")));
+      assertUnit(!std::filesystem::exists(file(0, ".log")));
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 1000);
+         assertUnit(m.at(999) == -999);
+         assertUnit(m.generation() == 2);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // the log after a checkpoint is applied over it
+   void test_checkpoint_thenWrites()
+   {  // setup
+      removeFiles();
+      {
+         IntMap m(path);
+         for (int i = 0; i < 10; i++)
+            m.insert(IntPair(i, i));
+         m.checkpoint();
+         // exercise
+         m.erase(3);
+         m.insert_or_assign(4, 400);
+         m.insert(IntPair(20, 20));
+      }
+      // verify
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 10);
+         assertUnit(m.count(3) == 0);
+         assertUnit(m.at(4) == 400);
+         assertUnit(m.at(20) == 20);
+         assertUnit(m.at(9) == 9);
+         assertUnit((*m.begin()).first == 0);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // records not yet committed when the checkpoint starts go to the old log
+   void test_checkpoint_beforeCommit()
+   {  // setup
+      removeFiles();
+      custom::journal_options opts;
+      opts.commit_interval = std::chrono::milliseconds(10000);
+      {
+         IntMap m(path, opts);
+         m.insert(IntPair(1, 100));
+         m.insert(IntPair(2, 200));
+         // exercise
+         m.checkpoint();
+         m.insert(IntPair(3, 300));
+         m.erase(1);
+         // verify
+         assertUnit(m.generation() == 1);
+      }
+      assertUnit(std::filesystem::exists(file(1, ".ckpt")));
+      assertUnit(!std::filesystem::exists(file(0, ".log")));
+      {
+         IntMap m(path);
+         assertUnit(m.size() == 2);
+         assertUnit(m.count(1) == 0);
+         assertUnit(m.at(2) == 200);
+         assertUnit(m.at(3) == 300);
+      }
+      // teardown
+      removeFiles();
+   }
+
+   // a log grown past checkpoint_bytes checkpoints by itself
+   void test_checkpoint_automatic()
+   {  // setup
+      removeFiles();
+      custom::journal_options opts;
+      opts.checkpoint_bytes = 1000;
+      {
+         IntMap m(path, opts);
+         // exercise
+         for (int i = 0; i < 500; i++)
+            m.insert(IntPair(i, i));
+         // verify: 9 bytes a record, at least 112 records a log, and
+         // none started while the last is still being written
+         assertUnit(m.generation() >= 1);
+         assertUnit(m.generation() <= 4);
+      }
+      {
+         IntMap m(path, opts);
+         assertUnit(m.size() == 500);
+         assertUnit(m.at(499) == 499);
+      }
+      // teardown
+      removeFiles();
+   }
+
+private:
+   std::filesystem::path dir;   // made for this run, removed after it
+   std::string path;            // the test map, in dir
+
+   std::string file(std::uint64_t g, const char* suffix) const
+   {
+      return path + "." + std::to_string(g) + suffix;
+   }
+
+   // remove every file of the test map: empty the directory
+   void removeFiles() const
+   {
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+   }
+};
+
+#endif // DEBUG
@@ -15,6 +15,18 @@
 #include "testSpy.h"       // for the spy unit tests
 #include "testPair.h"      // for the pair unit tests
 #include "testBST.h"       // for the BST unit tests
+#include "testPool.h"      // for the node pool unit tests
+#include "testBTree.h"     // for the B+tree unit tests
+#include "testFlatMap.h"   // for the flat map unit tests
+#include "testFrozenMap.h" // for the frozen map unit tests
+#include "testConcurrentMap.h" // for the concurrent map unit tests
+#include "testShardedMap.h" // for the sharded map unit tests
+#include "testPersistentMap.h" // for the persistent map unit tests
+#include "testSetOperations.h" // for the parallel set operation unit tests
+#include "testSerialize.h" // for the binary map file unit tests
+#include "testStringMap.h" // for the string map unit tests
+#include "testSmallMap.h"  // for the small map unit tests
+#include "testJournal.h"   // for the journaled map unit tests
 #include "testMap.h"       // for the map unit tests
 int Spy::counters[] = {};
 
@@ -29,6 +41,18 @@ int main()
    TestSpy().run();
    TestPair().run();
    TestBST().run();
+   TestPool().run();
+   TestBTree().run();
+   TestFlatMap().run();
+   TestFrozenMap().run();
+   TestConcurrentMap().run();
+   TestShardedMap().run();
+   TestPersistentMap().run();
+   TestSetOperations().run();
+   TestSerialize().run();
+   TestStringMap().run();
+   TestSmallMap().run();
+   TestJournal().run();
    TestMap().run();
 #endif // DEBUG
    
@@ -15,8 +15,33 @@
 #include "spy.h"        // spy is a mock class to monitor the class under test
 
 #include <map>
+#include <string_view>
 #include <vector>
 
+/***********************************************
+ * COUNTING LESS
+ * An int comparator that counts how often it is used
+ ***********************************************/
+struct CountingLess
+{
+   bool operator()(int lhs, int rhs) const
+   {
+      num++;
+      return lhs < rhs;
+   }
+   static inline int num = 0;
+};
+
+// a comparator with state: the same type sorts either way
+struct Dir
+{
+   bool desc;
+   bool operator()(int lhs, int rhs) const
+   {
+      return desc ? rhs < lhs : lhs < rhs;
+   }
+};
+
 /***********************************************
  * TEST MAP
  * Unit tests for the Map class
@@ -30,6 +55,7 @@ public:
 
       // Construct
       test_construct_default();
+      test_construct_comparator();
       test_constructCopy_empty();
       test_constructCopy_one();
       test_constructCopy_standard();
@@ -42,6 +68,8 @@ public:
       test_constructRange_empty();
       test_constructRange_one();
       test_constructRange_standard();
+      test_constructRange_sorted();
+      test_constructRange_sortedUnique();
       test_destructor_empty();
       test_destructor_standard();
 
@@ -62,11 +90,17 @@ public:
       test_swap_standardToEmpty();
       test_swap_emptyToStandard();
       test_swap_standardToStandard();
+      test_assign_statefulComparator();
+      test_assign_statefulComparatorBplus();
+      test_assignMove_statefulComparator();
+      test_swap_statefulComparator();
 
       // Iterator
       test_begin_empty();
       test_begin_standard();
+      test_rbegin_standard();
       test_end_standard();
+      test_iterator_threaded();
       test_iterator_increment_standardToChild();
       test_iterator_increment_standardToParent();
       test_iterator_dereference_standardRead();
@@ -94,6 +128,21 @@ public:
       test_find_standardLeft();
       test_find_standardRight();
       test_find_standardMissing();
+      test_find_threeWay();
+      test_find_transparent();
+      test_count_standard();
+      test_lowerBound_standard();
+      test_upperBound_standard();
+      test_equalRange_missing();
+      test_visitRange_standard();
+      test_rank_standard();
+      test_nth_standard();
+      test_countRange_standard();
+      test_findMany_order();
+      test_findMany_comparisons();
+      test_findInterleaved_order();
+      test_findInterleaved_small();
+      test_findInterleaved_comparisons();
 
       // Insert
       test_insertCopy_empty();
@@ -101,16 +150,33 @@ public:
       test_insertCopy_standardMiddle();
       test_insertMove_empty();
       test_insertMove_standard();
+      test_emplace_standard();
+      test_emplace_duplicate();
+      test_tryEmplace_standard();
+      test_tryEmplace_duplicate();
+      test_insertOrAssign_standard();
+      test_insertOrAssign_duplicate();
+      test_insertHint_append();
+      test_emplaceHint_standard();
+      test_insertMany_standard();
+      test_insertMany_bplus();
 
       // Remove
       test_erase_emptyKey();
       test_erase_standardKey();
       test_erase_standardKeyMissing();
+      test_erase_transparent();
       test_erase_emptyIterator();
       test_erase_standardIterator();
       test_erase_standardIteratorMissing();
       test_erase_emptyRange();
       test_erase_standardRange();
+      test_erase_balanced();
+      test_extract_key();
+      test_extract_missing();
+      test_insertNode_rekey();
+      test_insertNode_duplicate();
+      test_merge_standard();
       test_clear_empty();
       test_clear_standard();
 
@@ -120,6 +186,13 @@ public:
       test_size_empty();
       test_size_standard();
 
+      // Stats
+      test_stats_allocations();
+      test_stats_comparisons();
+      test_stats_rotations();
+      test_stats_copies();
+      test_stats_reset();
+
       report("Map");
    }
 
@@ -149,6 +222,28 @@ public:
    }  // teardown
 
 
+   // keys ordered by a custom comparator, which is stored in the map and not in every pair
+   void test_construct_comparator()
+   {  // setup
+      custom::map<std::string, int, std::greater<std::string>> m;
+      // exercise
+      m["30"] = 30;
+      m["50"] = 50;
+      m["70"] = 70;
+      // verify
+      custom::map<std::string, int, std::greater<std::string>>::iterator it = m.begin();
+      assertUnit(m.size() == 3);
+      assertUnit((*it).first == std::string("70"));
+      ++it;
+      assertUnit((*it).first == std::string("50"));
+      ++it;
+      assertUnit((*it).first == std::string("30"));
+      ++it;
+      assertUnit(it == m.end());
+      assertUnit(m.key_comp()("b", "a") == true);
+      assertUnit(sizeof(custom::pair<std::string, int>) == sizeof(std::pair<std::string, int>));
+   }  // teardown
+
    /***************************************
     * COPY
     *     map::map(const map &)
@@ -185,8 +280,8 @@ public:
       //   +----+
       custom::map<std::string, Spy> mSrc;
       custom::pair<std::string, Spy> p50(std::string("50"), Spy(50));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode50;
-      bnode50 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(p50);
+      custom::map<std::string, Spy>::BST::BNode* bnode50;
+      bnode50 = new custom::map<std::string, Spy>::BST::BNode(p50);
       mSrc.bst.root = bnode50;
       mSrc.bst.numElements = 1;
       Spy::reset();
@@ -308,8 +403,8 @@ public:
       //   +----+
       custom::map<std::string, Spy> mSrc;
       custom::pair<std::string, Spy> p50(std::string("50"), Spy(50));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode50;
-      bnode50 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(p50);
+      custom::map<std::string, Spy>::BST::BNode* bnode50;
+      bnode50 = new custom::map<std::string, Spy>::BST::BNode(p50);
       mSrc.bst.root = bnode50;
       mSrc.bst.numElements = 1;
       Spy::reset();
@@ -545,6 +640,54 @@ public:
       teardownStandardFixture(m);
    }
 
+   // sorted input is checked in one pass and built without any searching
+   void test_constructRange_sorted()
+   {  // setup
+      std::vector<custom::pair<int, int>> v;
+      for (int i = 0; i < 100; i++)
+         v.push_back(custom::pair<int, int>(i, i * 10));
+      CountingLess::num = 0;
+      // exercise
+      custom::map<int, int, CountingLess> m(v.begin(), v.end());
+      // verify
+      assertUnit(CountingLess::num == 99);  // one comparison for each neighbor
+      assertUnit(m.size() == 100);
+      assertUnit(m.bst.root != nullptr);
+      if (m.bst.root)
+      {
+         assertUnit(m.bst.root->isRed == false);
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+         assertUnit(m.bst.root->computeSize() == 100);
+         m.bst.root->verifyBTree();
+      }
+      int expected = 0;
+      for (auto it = m.begin(); it != m.end(); ++it, expected++)
+         assertUnit((*it).first == expected && (*it).second == expected * 10);
+      // duplicates are not sorted-unique: back to one at a time
+      v.push_back(custom::pair<int, int>(99, 0));
+      custom::map<int, int, CountingLess> mDuplicate(v.begin(), v.end());
+      assertUnit(mDuplicate.size() == 100);
+      assertUnit(mDuplicate.at(99) == 990);
+   }  // teardown
+
+   // the caller can promise the input is sorted: not a single comparison
+   void test_constructRange_sortedUnique()
+   {  // setup
+      std::vector<custom::pair<int, int>> v;
+      for (int i = 0; i < 20; i++)
+         v.push_back(custom::pair<int, int>(i, i));
+      CountingLess::num = 0;
+      // exercise
+      custom::map<int, int, CountingLess> m(custom::sorted_unique, v.begin(), v.end());
+      // verify
+      assertUnit(CountingLess::num == 0);
+      assertUnit(m.size() == 20);
+      assertUnit(m.bst.root != nullptr);
+      if (m.bst.root)
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+      assertUnit(m.at(13) == 13);
+   }  // teardown
+
    // copy the standard fixture
    void test_constructRange_standard()
    {  // setup
@@ -860,10 +1003,10 @@ public:
       custom::map<std::string, Spy> mDes;
       custom::pair<std::string, Spy> pair40(std::string("40"), Spy(40));
       custom::pair<std::string, Spy> pair60(std::string("60"), Spy(60));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode40;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode60;
-      bnode40 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair40);
-      bnode60 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair60);
+      custom::map<std::string, Spy>::BST::BNode* bnode40;
+      custom::map<std::string, Spy>::BST::BNode* bnode60;
+      bnode40 = new custom::map<std::string, Spy>::BST::BNode(pair40);
+      bnode60 = new custom::map<std::string, Spy>::BST::BNode(pair60);
       bnode40->pRight = bnode60;
       bnode60->pParent = bnode40;
       bnode40->isRed = false;
@@ -1008,10 +1151,10 @@ public:
       custom::map<std::string, Spy> mDes;
       custom::pair<std::string, Spy> pair40(std::string("40"), Spy(40));
       custom::pair<std::string, Spy> pair60(std::string("60"), Spy(60));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode40;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode60;
-      bnode40 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair40);
-      bnode60 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair60);
+      custom::map<std::string, Spy>::BST::BNode* bnode40;
+      custom::map<std::string, Spy>::BST::BNode* bnode60;
+      bnode40 = new custom::map<std::string, Spy>::BST::BNode(pair40);
+      bnode60 = new custom::map<std::string, Spy>::BST::BNode(pair60);
       bnode40->pRight = bnode60;
       bnode60->pParent = bnode40;
       bnode40->isRed = false;
@@ -1151,10 +1294,10 @@ public:
       custom::map<std::string, Spy> m;
       custom::pair<std::string, Spy> pair40(std::string("40"), Spy(40));
       custom::pair<std::string, Spy> pair60(std::string("60"), Spy(60));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode40;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode60;
-      bnode40 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair40);
-      bnode60 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair60);
+      custom::map<std::string, Spy>::BST::BNode* bnode40;
+      custom::map<std::string, Spy>::BST::BNode* bnode60;
+      bnode40 = new custom::map<std::string, Spy>::BST::BNode(pair40);
+      bnode60 = new custom::map<std::string, Spy>::BST::BNode(pair60);
       bnode40->pRight = bnode60;
       bnode60->pParent = bnode40;
       bnode40->isRed = false;
@@ -1298,10 +1441,10 @@ public:
       custom::map<std::string, Spy> mRHS;
       custom::pair<std::string, Spy> pair40(std::string("40"), Spy(40));
       custom::pair<std::string, Spy> pair60(std::string("60"), Spy(60));
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode40;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode60;
-      bnode40 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair40);
-      bnode60 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair60);
+      custom::map<std::string, Spy>::BST::BNode* bnode40;
+      custom::map<std::string, Spy>::BST::BNode* bnode60;
+      bnode40 = new custom::map<std::string, Spy>::BST::BNode(pair40);
+      bnode60 = new custom::map<std::string, Spy>::BST::BNode(pair60);
       bnode40->pRight = bnode60;
       bnode60->pParent = bnode40;
       bnode40->isRed = false;
@@ -1360,6 +1503,141 @@ public:
    }
 
 
+   /***************************************
+    * NODE HANDLES
+    *     map::extract()
+    *     map::insert(node_type&&)
+    *     map::merge()
+    ***************************************/
+
+   // extract a pair by key
+   void test_extract_key()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      Spy::reset();
+      // exercise
+      custom::map<std::string, Spy>::node_type nh = m.extract(std::string("30"));
+      // verify
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(!nh.empty());
+      if (!nh.empty())
+      {
+         assertUnit(nh.key() == std::string("30"));
+         assertUnit(nh.mapped() == Spy(30));
+      }
+      assertUnit(m.size() == 2);
+      assertUnit(m.find(std::string("30")) == m.end());
+      // teardown
+      m.clear();
+   }
+
+   // extract a key that is not there
+   void test_extract_missing()
+   {  // setup
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      Spy::reset();
+      // exercise
+      custom::map<std::string, Spy>::node_type nh = m.extract(std::string("40"));
+      // verify
+      assertUnit(nh.empty());
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // change a key without freeing or allocating the node
+   void test_insertNode_rekey()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      Spy::reset();
+      // exercise
+      custom::map<std::string, Spy>::node_type nh = m.extract(m.begin());
+      nh.key() = std::string("90");
+      custom::map<std::string, Spy>::insert_return_type ret = m.insert(std::move(nh));
+      // verify
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      //    "50"     "70"     "90"   = m
+      //   +----+   +----+   +----+
+      //   | 50 | - | 70 | - | 30 |
+      //   +----+   +----+   +----+
+      assertUnit(ret.inserted == true);
+      assertUnit(ret.node.empty());
+      assertUnit(ret.position != m.end());
+      if (ret.position != m.end())
+         assertUnit((*ret.position).second == Spy(30));
+      assertUnit(m.size() == 3);
+      assertUnit(m.at(std::string("90")) == Spy(30));
+      // teardown
+      m.clear();
+   }
+
+   // a key that is already there comes back in the node
+   void test_insertNode_duplicate()
+   {  // setup
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::map<std::string, Spy> m2;
+      m2[std::string("50")] = Spy(99);
+      Spy::reset();
+      // exercise
+      custom::map<std::string, Spy>::insert_return_type ret = m.insert(m2.extract(m2.begin()));
+      // verify
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(ret.inserted == false);
+      assertUnit(!ret.node.empty());
+      if (!ret.node.empty())
+         assertUnit(ret.node.mapped() == Spy(99));
+      assertUnit(ret.position == m.find(std::string("50")));
+      assertStandardFixture(m);
+      assertUnit(m2.empty());
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // merge relinks the nodes of another map
+   void test_merge_standard()
+   {  // setup
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::map<std::string, Spy> m2;
+      m2[std::string("40")] = Spy(40);
+      m2[std::string("50")] = Spy(99);
+      m2[std::string("60")] = Spy(60);
+      Spy::reset();
+      // exercise
+      m.merge(m2);
+      // verify
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(m.size() == 5);
+      assertUnit(m.at(std::string("50")) == Spy(50));
+      assertUnit(m.at(std::string("60")) == Spy(60));
+      assertUnit(m2.size() == 1);
+      assertUnit(m2.at(std::string("50")) == Spy(99));
+      if (m.bst.root)
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+      // teardown
+      m.clear();
+   }
+
    /***************************************
     * CLEAR
     *     map::clear()
@@ -1414,6 +1692,87 @@ public:
       assertEmptyFixture(m);
    }  // teardown
 
+   // the comparator comes with the pairs it sorted
+   void test_assign_statefulComparator()
+   {  // setup
+      custom::map<int, int, Dir> mSrc(Dir{ true });
+      custom::map<int, int, Dir> mDest(Dir{ false });
+      for (int i = 0; i < 10; i++)
+         mSrc[i] = i * 10;
+      // exercise
+      mDest = mSrc;
+      // verify
+      assertUnit(mDest.key_comp().desc);
+      assertUnit((*mDest.begin()).first == 9);
+      bool found = true;
+      for (int i = 0; i < 10; i++)
+         found = found && mDest.find(i) != mDest.end() && (*mDest.find(i)).second == i * 10;
+      assertUnit(found);
+   }  // teardown
+
+   // so does a B+tree's
+   void test_assign_statefulComparatorBplus()
+   {  // setup
+      using Map = custom::map<int, int, Dir, std::allocator<custom::pair<int, int>>, custom::bplus<4>>;
+      Map mSrc(Dir{ true });
+      Map mDest(Dir{ false });
+      for (int i = 0; i < 20; i++)
+         mSrc[i] = i * 10;
+      // exercise
+      mDest = mSrc;
+      // verify
+      assertUnit(mDest.key_comp().desc);
+      assertUnit((*mDest.begin()).first == 19);
+      bool found = true;
+      for (int i = 0; i < 20; i++)
+         found = found && mDest.find(i) != mDest.end() && (*mDest.find(i)).second == i * 10;
+      assertUnit(found);
+   }  // teardown
+
+   // moving takes the comparator along with the nodes
+   void test_assignMove_statefulComparator()
+   {  // setup
+      custom::map<int, int, Dir> mSrc(Dir{ true });
+      custom::map<int, int, Dir> mDest(Dir{ false });
+      for (int i = 0; i < 10; i++)
+         mSrc[i] = i * 10;
+      // exercise
+      mDest = std::move(mSrc);
+      // verify
+      assertUnit(mDest.key_comp().desc);
+      assertUnit((*mDest.begin()).first == 9);
+      bool found = true;
+      for (int i = 0; i < 10; i++)
+         found = found && mDest.find(i) != mDest.end() && (*mDest.find(i)).second == i * 10;
+      assertUnit(found);
+   }  // teardown
+
+   // swapping swaps the comparators too
+   void test_swap_statefulComparator()
+   {  // setup
+      custom::map<int, int, Dir> mDesc(Dir{ true });
+      custom::map<int, int, Dir> mAsc(Dir{ false });
+      for (int i = 0; i < 10; i++)
+      {
+         mDesc[i] = i * 10;
+         mAsc[i + 100] = i;
+      }
+      // exercise
+      swap(mDesc, mAsc);
+      // verify
+      assertUnit(!mDesc.key_comp().desc);
+      assertUnit(mAsc.key_comp().desc);
+      assertUnit((*mDesc.begin()).first == 100);
+      assertUnit((*mAsc.begin()).first == 9);
+      bool found = true;
+      for (int i = 0; i < 10; i++)
+      {
+         found = found && mAsc.find(i) != mAsc.end() && (*mAsc.find(i)).second == i * 10;
+         found = found && mDesc.find(i + 100) != mDesc.end() && (*mDesc.find(i + 100)).second == i;
+      }
+      assertUnit(found);
+   }  // teardown
+
 
    /***************************************
     * ITERATOR
@@ -1460,6 +1819,58 @@ public:
       teardownStandardFixture(m);
    }
 
+   // rbegin() from the standard fixture
+   void test_rbegin_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::map<std::string, Spy>::iterator it;
+      Spy::reset();
+      // exercise
+      it = m.rbegin();
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(it != m.end());
+      if (it != m.end())
+         assertUnit((*it).first == std::string("70"));
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // a map with threaded nodes visits every pair in order, both ways
+   void test_iterator_threaded()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>,
+                  custom::rb_default_threaded> m;
+      for (int i = 0; i < 100; i++)
+         m[(i * 37) % 100] = i;
+      m.erase(50);
+      // exercise
+      int count = 0;
+      bool inOrder = true;
+      int prev = -1;
+      for (auto it = m.begin(); it != m.end(); ++it, count++)
+      {
+         inOrder = inOrder && (*it).first > prev;
+         prev = (*it).first;
+      }
+      int countBack = 0;
+      for (auto it = m.rbegin(); it != m.end(); --it)
+         countBack++;
+      // verify
+      assertUnit(inOrder);
+      assertUnit(count == 99);
+      assertUnit(countBack == 99);
+      assertUnit((*m.begin()).first == 0);
+      assertUnit((*m.rbegin()).first == 99);
+   }  // teardown
+
    // end() from the standard fixture
    void test_end_standard()
    {  // setup
@@ -1645,8 +2056,8 @@ public:
       // exercise
       it = m.find(s50);
       // verify
-      assertUnit(Spy::numDefault() == 1); // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopyMove() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);     
@@ -1682,8 +2093,8 @@ public:
       // exercise
       it = m.find(s30);
       // verify
-      assertUnit(Spy::numDefault() == 1); // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopyMove() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -1719,8 +2130,8 @@ public:
       // exercise
       it = m.find(s70);
       // verify
-      assertUnit(Spy::numDefault() == 1); // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopyMove() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -1756,8 +2167,8 @@ public:
       // exercise
       it = m.find(s99);
       // verify
-      assertUnit(Spy::numDefault() == 1); // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopyMove() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -1778,93 +2189,429 @@ public:
       teardownStandardFixture(m);
    }
 
-   /***************************************
-    * INSERT
-    *    map::insert(const T &)
-    ***************************************/
+   // string keys are compared three ways, once a level; Spy keys are not
+   void test_find_threeWay()
+   {  // setup
+      using StringMap = custom::map<std::string, Spy>;
+      using SpyMap    = custom::map<Spy, int>;
+      StringMap m;
+      setupStandardFixture(m);
+      // exercise
+      StringMap::iterator it = m.find("70");
+      // verify
+      assertUnit((custom::three_way<StringMap::value_compare, StringMap::Pair>::value));
+      assertUnit(!(custom::three_way<SpyMap::value_compare, SpyMap::Pair>::value));
+      assertUnit(it != m.end());
+      if (it != m.end())
+         assertUnit((*it).second == Spy(70));
+      // teardown
+      teardownStandardFixture(m);
+   }
 
-   // insert into an empty fixture
-   void test_insertCopy_empty()
+   // a transparent comparator finds string keys from a string_view or a literal
+   void test_find_transparent()
    {  // setup
-      custom::map<std::string, Spy> m;
-      custom::pair<std::string, Spy> pair50(std::string("50"), Spy(50));
+      custom::map<std::string, Spy, std::less<>> m;
+      m["30"] = Spy(30);
+      m["50"] = Spy(50);
+      m["70"] = Spy(70);
       Spy::reset();
       // exercise
-      m.insert(pair50);
+      auto it50 = m.find(std::string_view("50"));
+      auto it70 = m.find("70");
+      auto it99 = m.find(std::string_view("99"));
+      const Spy& s30 = m.at(std::string_view("30"));
       // verify
-      assertUnit(Spy::numCopy() == 1);      // copy-create [50]
-      assertUnit(Spy::numAlloc() == 1);     // allocate    [50]
       assertUnit(Spy::numDefault() == 0);
-      assertUnit(Spy::numDelete() == 0);
-      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numCopyMove() == 0);
-      assertUnit(Spy::numAssign() == 0);
-      assertUnit(Spy::numAssignMove() == 0);
-      assertUnit(Spy::numEquals() == 0);
-      assertUnit(Spy::numLessthan() == 0);
-      //    "50"
-      //   +----+
-      //   | 50 |
-      //   +----+
-      assertUnit(m.bst.numElements == 1);
-      assertUnit(m.bst.root != nullptr);
-      if (m.bst.root)
-      {
-         assertUnit(m.bst.root->data.first == std::string("50"));
-         assertUnit(m.bst.root->data.second == Spy(50));
-         assertUnit(m.bst.root->pLeft == nullptr);
-         assertUnit(m.bst.root->pRight == nullptr);
-         assertUnit(m.bst.root->pParent == nullptr);
-      }
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(it50 != m.end());
+      if (it50 != m.end())
+         assertUnit((*it50).second == Spy(50));
+      assertUnit(it70 != m.end());
+      if (it70 != m.end())
+         assertUnit((*it70).second == Spy(70));
+      assertUnit(it99 == m.end());
+      assertUnit(s30 == Spy(30));
+   }  // teardown
+
+   // count is one for a key that is there and zero for one that is not
+   void test_count_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      Spy::reset();
+      // exercise
+      size_t count30 = m.count(std::string("30"));
+      size_t count40 = m.count(std::string("40"));
+      // verify
+      assertUnit(count30 == 1);
+      assertUnit(count40 == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertStandardFixture(m);
       // teardown
       teardownStandardFixture(m);
    }
 
-   // insert onto the front of the standard fixture
-   void test_insertCopy_standardFront()
+   // lower bound by key, on a key and between keys
+   void test_lowerBound_standard()
    {  // setup
-      custom::pair<std::string, Spy> pair10(std::string("10"), Spy(10));
       //    "30"     "50"     "70"   = m
       //   +----+   +----+   +----+
       //   | 30 | - | 50 | - | 70 |
       //   +----+   +----+   +----+
       custom::map<std::string, Spy> m;
       setupStandardFixture(m);
-      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
       Spy::reset();
       // exercise
-      pReturn = m.insert(pair10);
+      auto it50 = m.lower_bound(std::string("50"));
+      auto it60 = m.lower_bound(std::string("60"));
+      auto it80 = m.lower_bound(std::string("80"));
       // verify
-      assertUnit(Spy::numCopy() == 1);      // copy-create [10]
-      assertUnit(Spy::numAlloc() == 1);     // allocate    [10]
-      assertUnit(Spy::numDefault() == 0);
-      assertUnit(Spy::numDelete() == 0);
-      assertUnit(Spy::numNondefault() == 0);
-      assertUnit(Spy::numCopyMove() == 0);
-      assertUnit(Spy::numAssign() == 0);
-      assertUnit(Spy::numAssignMove() == 0);
-      assertUnit(Spy::numEquals() == 0);
-      assertUnit(Spy::numLessthan() == 0);
-      //    "10"     "30"     "50"     "70"   = m
-      //   +----+   +----+   +----+   +----+
-      //   | 10 | - | 30 | - | 50 | - | 70 |
-      //   +----+   +----+   +----+   +----+
-      //   pReturn
-      //
-      assertUnit(pReturn.first.it.pNode != nullptr);
-      assertUnit(pReturn.second == true);
-      if (m.bst.root && m.bst.root->pLeft)
-         assertUnit(pReturn.first.it.pNode == m.bst.root->pLeft->pLeft);
-      assertUnit(m.bst.numElements == 4);
-      assertUnit(m.bst.root != nullptr);
-      //                  (50)
-      //              +-----+-----+
-      //            (30)        (70)
-      //          +---+
-      //        (10)
-      if (m.bst.root)
-      {
-         assertUnit(m.bst.root->data.first == std::string("50"));
+      assertUnit(Spy::numDefault() == 0);    // search by key alone: no blank Spy
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(it50 != m.end() && (*it50).first == "50");
+      assertUnit(it60 != m.end() && (*it60).first == "70");
+      assertUnit(it80 == m.end());
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // upper bound by key goes past an equal key
+   void test_upperBound_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      // exercise
+      auto it50 = m.upper_bound(std::string("50"));
+      auto it20 = m.upper_bound(std::string("20"));
+      auto it70 = m.upper_bound(std::string("70"));
+      // verify
+      assertUnit(it50 != m.end() && (*it50).first == "70");
+      assertUnit(it20 != m.end() && (*it20).first == "30");
+      assertUnit(it70 == m.end());
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // a missing key gives an empty range at where it would go
+   void test_equalRange_missing()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      // exercise
+      auto range40 = m.equal_range(std::string("40"));
+      auto range50 = m.equal_range(std::string("50"));
+      // verify
+      assertUnit(range40.first == range40.second);
+      assertUnit(range40.first != m.end() && (*range40.first).first == "50");
+      assertUnit(range50.first != m.end() && (*range50.first).first == "50");
+      assertUnit(range50.second != m.end() && (*range50.second).first == "70");
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // visit the pairs with keys in [lo, hi), on both backends
+   void test_visitRange_standard()
+   {  // setup
+      custom::map<int, int> m;
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::bplus<4>> mb;
+      for (int i = 0; i < 100; i++)
+      {
+         m[i * 2] = i;
+         mb[i * 2] = i;
+      }
+      std::vector<int> visited;
+      std::vector<int> visitedBplus;
+      // exercise
+      m.visit_range(11, 21, [&visited](const custom::pair<int, int>& p) { visited.push_back(p.first); });
+      mb.visit_range(11, 21, [&visitedBplus](const custom::pair<int, int>& p) { visitedBplus.push_back(p.first); });
+      // verify
+      assertUnit(visited == std::vector<int>({ 12, 14, 16, 18, 20 }));
+      assertUnit(visitedBplus == visited);
+   }  // teardown
+
+   // rank by key alone, on a counted map
+   void test_rank_standard()
+   {  // setup
+      custom::map<std::string, Spy, std::less<std::string>, std::allocator<custom::pair<std::string, Spy>>,
+                  custom::rb_default_counted> m;
+      m["50"] = Spy(50);
+      m["30"] = Spy(30);
+      m["70"] = Spy(70);
+      Spy::reset();
+      // exercise
+      size_t rank30 = m.rank(std::string("30"));
+      size_t rank60 = m.rank(std::string("60"));
+      // verify
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(rank30 == 0);
+      assertUnit(rank60 == 2);
+   }  // teardown
+
+   // the k-th pair: a percentile without walking
+   void test_nth_standard()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::rb_default_counted> m;
+      for (int i = 0; i < 1000; i++)
+         m[(i * 37) % 1000] = i;
+      // exercise
+      auto it90 = m.nth(900);
+      auto itEnd = m.nth(1000);
+      // verify
+      assertUnit(it90 != m.end() && (*it90).first == 900);
+      assertUnit(itEnd == m.end());
+   }  // teardown
+
+   // counts of a window survive erases
+   void test_countRange_standard()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::rb_default_counted> m;
+      for (int i = 0; i < 100; i++)
+         m[i] = i;
+      m.erase(m.find(10), m.find(20));
+      // exercise
+      size_t n = m.count_range(5, 25);
+      // verify
+      assertUnit(n == 10);
+      assertUnit(m.rank(50) == 40);
+   }  // teardown
+
+   // the answers come back in the order of the keys, on either backend
+   void test_findMany_order()
+   {  // setup
+      custom::map<int, int> m;
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::bplus<4>> mb;
+      for (int i = 0; i < 100; i += 2)
+      {
+         m[i] = i * 10;
+         mb[i] = i * 10;
+      }
+      std::vector<int> keys = { 50, 3, 98, 0, 51, 50, 200 };
+      std::vector<custom::map<int, int>::iterator> found;
+      std::vector<decltype(mb)::iterator> foundBplus;
+      // exercise
+      m.find_many(keys.begin(), keys.end(), std::back_inserter(found));
+      mb.find_many(keys.begin(), keys.end(), std::back_inserter(foundBplus));
+      // verify
+      bool same = found.size() == keys.size() && foundBplus.size() == keys.size();
+      for (size_t i = 0; same && i < keys.size(); i++)
+      {
+         same = same && found[i] == m.find(keys[i]);
+         same = same && foundBplus[i] == mb.find(keys[i]);
+      }
+      assertUnit(same);
+      assertUnit(found[0] != m.end() && (*found[0]).second == 500);
+      assertUnit(found[1] == m.end());
+      assertUnit(found[6] == m.end());
+   }  // teardown
+
+   // a sorted batch walks the tree once: far fewer comparisons than a
+   // descent from the root for each key
+   void test_findMany_comparisons()
+   {  // setup
+      custom::map<int, int, CountingLess> m;
+      std::vector<int> keys;
+      for (int i = 0; i < 1000; i++)
+      {
+         m[(i * 37) % 1000] = i;
+         keys.push_back(i);
+      }
+      std::vector<custom::map<int, int, CountingLess>::iterator> found;
+      CountingLess::num = 0;
+      // exercise
+      m.find_many(keys.begin(), keys.end(), std::back_inserter(found));
+      // verify
+      assertUnit(CountingLess::num < 1000 * 5);
+      bool same = found.size() == 1000;
+      for (int i = 0; same && i < 1000; i++)
+         same = found[i] != m.end() && (*found[i]).first == i;
+      assertUnit(same);
+   }  // teardown
+
+   // the answers come back in the order of the keys, more keys than
+   // there are lanes, found or not, on plain and threaded layouts
+   void test_findInterleaved_order()
+   {  // setup
+      custom::map<int, int> m;
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>,
+                  custom::rb_default_threaded> mt;
+      for (int i = 0; i < 1000; i += 2)
+      {
+         m[i] = i * 10;
+         mt[i] = i * 10;
+      }
+      std::vector<int> keys;
+      for (int i = 0; i < 500; i++)
+         keys.push_back((i * 7919) % 1100);
+      std::vector<custom::map<int, int>::iterator> found;
+      std::vector<decltype(mt)::iterator> foundThreaded;
+      // exercise
+      m.find_interleaved(keys.begin(), keys.end(), std::back_inserter(found));
+      mt.find_interleaved(keys.begin(), keys.end(), std::back_inserter(foundThreaded));
+      // verify
+      bool same = found.size() == keys.size() && foundThreaded.size() == keys.size();
+      for (size_t i = 0; same && i < keys.size(); i++)
+      {
+         same = same && found[i] == m.find(keys[i]);
+         same = same && foundThreaded[i] == mt.find(keys[i]);
+      }
+      assertUnit(same);
+      assertUnit(found[1] == m.end());                                    // 7919 % 1100 == 219
+      assertUnit(found[2] != m.end() && (*found[2]).second == 4380);      // 15838 % 1100 == 438
+   }  // teardown
+
+   // no keys, fewer keys than lanes, and an empty map
+   void test_findInterleaved_small()
+   {  // setup
+      custom::map<int, int> m{ custom::pair<int, int>(1, 10), custom::pair<int, int>(2, 20) };
+      custom::map<int, int> mEmpty;
+      std::vector<int> none;
+      std::vector<int> keys = { 2, 3, 1 };
+      std::vector<custom::map<int, int>::iterator> found;
+      std::vector<custom::map<int, int>::iterator> foundNone;
+      std::vector<custom::map<int, int>::iterator> foundEmpty;
+      // exercise
+      m.find_interleaved(none.begin(), none.end(), std::back_inserter(foundNone));
+      m.find_interleaved(keys.begin(), keys.end(), std::back_inserter(found));
+      mEmpty.find_interleaved(keys.begin(), keys.end(), std::back_inserter(foundEmpty));
+      // verify
+      assertUnit(foundNone.empty());
+      assertUnit(found.size() == 3);
+      assertUnit(found[0] != m.end() && (*found[0]).second == 20);
+      assertUnit(found[1] == m.end());
+      assertUnit(found[2] != m.end() && (*found[2]).second == 10);
+      assertUnit(foundEmpty.size() == 3);
+      assertUnit(foundEmpty[0] == mEmpty.end() && foundEmpty[2] == mEmpty.end());
+   }  // teardown
+
+   // taking turns costs no comparisons: the same as a find for each key
+   void test_findInterleaved_comparisons()
+   {  // setup
+      custom::map<int, int, CountingLess> m;
+      std::vector<int> keys;
+      for (int i = 0; i < 1000; i++)
+      {
+         m[(i * 37) % 1000] = i;
+         keys.push_back((i * 101) % 1500);
+      }
+      CountingLess::num = 0;
+      for (int k : keys)
+         m.find(k);
+      int numFind = CountingLess::num;
+      std::vector<custom::map<int, int, CountingLess>::iterator> found;
+      CountingLess::num = 0;
+      // exercise
+      m.find_interleaved(keys.begin(), keys.end(), std::back_inserter(found));
+      // verify
+      assertUnit(CountingLess::num == numFind);
+      assertUnit(found.size() == 1000);
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    *    map::insert(const T &)
+    ***************************************/
+
+   // insert into an empty fixture
+   void test_insertCopy_empty()
+   {  // setup
+      custom::map<std::string, Spy> m;
+      custom::pair<std::string, Spy> pair50(std::string("50"), Spy(50));
+      Spy::reset();
+      // exercise
+      m.insert(pair50);
+      // verify
+      assertUnit(Spy::numCopy() == 1);      // copy-create [50]
+      assertUnit(Spy::numAlloc() == 1);     // allocate    [50]
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      //    "50"
+      //   +----+
+      //   | 50 |
+      //   +----+
+      assertUnit(m.bst.numElements == 1);
+      assertUnit(m.bst.root != nullptr);
+      if (m.bst.root)
+      {
+         assertUnit(m.bst.root->data.first == std::string("50"));
+         assertUnit(m.bst.root->data.second == Spy(50));
+         assertUnit(m.bst.root->pLeft == nullptr);
+         assertUnit(m.bst.root->pRight == nullptr);
+         assertUnit(m.bst.root->pParent == nullptr);
+      }
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // insert onto the front of the standard fixture
+   void test_insertCopy_standardFront()
+   {  // setup
+      custom::pair<std::string, Spy> pair10(std::string("10"), Spy(10));
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy::reset();
+      // exercise
+      pReturn = m.insert(pair10);
+      // verify
+      assertUnit(Spy::numCopy() == 1);      // copy-create [10]
+      assertUnit(Spy::numAlloc() == 1);     // allocate    [10]
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      //    "10"     "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+   +----+
+      //   | 10 | - | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+   +----+
+      //   pReturn
+      //
+      assertUnit(pReturn.first.it.pNode != nullptr);
+      assertUnit(pReturn.second == true);
+      if (m.bst.root && m.bst.root->pLeft)
+         assertUnit(pReturn.first.it.pNode == m.bst.root->pLeft->pLeft);
+      assertUnit(m.bst.numElements == 4);
+      assertUnit(m.bst.root != nullptr);
+      //                  (50)
+      //              +-----+-----+
+      //            (30)        (70)
+      //          +---+
+      //        (10)
+      if (m.bst.root)
+      {
+         assertUnit(m.bst.root->data.first == std::string("50"));
          assertUnit(m.bst.root->data.second == Spy(50));
          assertUnit(m.bst.root->pParent == nullptr);
          assertUnit(m.bst.root->pLeft != nullptr);
@@ -2097,6 +2844,295 @@ public:
       teardownStandardFixture(m);
    }
 
+   /***************************************
+    * EMPLACE
+    *    map::emplace(Args&& ...)
+    *    map::try_emplace(const K &, Args&& ...)
+    *    map::insert_or_assign(const K &, M &&)
+    ***************************************/
+
+   // emplace builds the new value inside the node
+   void test_emplace_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy::reset();
+      // exercise
+      pReturn = m.emplace(std::string("60"), 60);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [60] in the node
+      assertUnit(Spy::numAlloc() == 1);      // allocate [60]
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      //    "30"     "50"     "60"     "70"   = m
+      //   +----+   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 60 | - | 70 |
+      //   +----+   +----+   +----+   +----+
+      assertUnit(pReturn.second == true);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(60));
+      assertUnit(m.size() == 4);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // an ascending stream of keys, each hinted with the last insert
+   void test_insertHint_append()
+   {  // setup
+      custom::map<int, int, CountingLess> m;
+      custom::map<int, int, CountingLess>::iterator it = m.end();
+      CountingLess::num = 0;
+      // exercise
+      for (int i = 0; i < 100; i++)
+         it = m.insert(it, custom::pair<int, int>(i, i * 10));
+      // verify
+      assertUnit(CountingLess::num == 99 * 2);  // two comparisons with the hint
+      assertUnit(m.size() == 100);
+      assertUnit(it != m.end());
+      if (it != m.end())
+         assertUnit((*it).first == 99);
+      assertUnit(m.at(42) == 420);
+      if (m.bst.root)
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+   }  // teardown
+
+   // an unsorted batch: the first pair of a key wins, and so does a key
+   // already there
+   void test_insertMany_standard()
+   {  // setup
+      custom::map<int, int> m;
+      m[5] = 50;
+      std::vector<custom::pair<int, int>> pairs;
+      for (int i = 0; i < 100; i++)
+         pairs.push_back(custom::pair<int, int>((i * 37) % 50, i));
+      // exercise
+      size_t inserted = m.insert_many(pairs.begin(), pairs.end());
+      // verify
+      assertUnit(inserted == 49);
+      assertUnit(m.size() == 50);
+      assertUnit(m.at(5) == 50);
+      assertUnit(m.at(37) == 1);
+      assertUnit(m.at(24) == 2);
+      if (m.bst.root)
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+   }  // teardown
+
+   // the same on the B+tree, with the batch splitting leaves as it goes
+   void test_insertMany_bplus()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::bplus<4>> m;
+      m[500] = -1;
+      std::vector<custom::pair<int, int>> pairs;
+      for (int i = 0; i < 1000; i++)
+         pairs.push_back(custom::pair<int, int>(i, i));
+      // exercise
+      size_t inserted = m.insert_many(pairs.begin(), pairs.end());
+      // verify
+      assertUnit(inserted == 999);
+      assertUnit(m.size() == 1000);
+      assertUnit(m.at(500) == -1);
+      int expect = 0;
+      bool inOrder = true;
+      for (auto it = m.begin(); it != m.end(); ++it)
+         inOrder = inOrder && (*it).first == expect++;
+      assertUnit(inOrder && expect == 1000);
+   }  // teardown
+
+   // emplace_hint builds the pair in the node next to the hint
+   void test_emplaceHint_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::map<std::string, Spy>::iterator it = m.find(std::string("70"));
+      Spy::reset();
+      // exercise
+      it = m.emplace_hint(it, std::string("60"), 60);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [60] in the node
+      assertUnit(Spy::numAlloc() == 1);      // allocate [60]
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      //    "30"     "50"     "60"     "70"   = m
+      //   +----+   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 60 | - | 70 |
+      //   +----+   +----+   +----+   +----+
+      assertUnit(it != m.end());
+      if (it != m.end())
+         assertUnit((*it).second == Spy(60));
+      assertUnit(m.size() == 4);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // emplace with a key that is there leaves the map alone
+   void test_emplace_duplicate()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy::reset();
+      // exercise
+      pReturn = m.emplace(std::string("50"), 99);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // the node is built before the search
+      assertUnit(Spy::numDestructor() == 1); // and destroyed when [50] is found
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(pReturn.second == false);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(50));
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // try_emplace builds the new value inside the node
+   void test_tryEmplace_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      std::string key("40");
+      Spy::reset();
+      // exercise
+      pReturn = m.try_emplace(key, 40);
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // build [40] in the node
+      assertUnit(Spy::numAlloc() == 1);      // allocate [40]
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      //    "30"     "40"     "50"     "70"   = m
+      //   +----+   +----+   +----+   +----+
+      //   | 30 | - | 40 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+   +----+
+      assertUnit(pReturn.second == true);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(40));
+      assertUnit(key == std::string("40"));
+      assertUnit(m.size() == 4);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // try_emplace with a key that is there does not touch the arguments
+   void test_tryEmplace_duplicate()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy s(99);
+      Spy::reset();
+      // exercise
+      pReturn = m.try_emplace(std::string("50"), std::move(s));
+      // verify
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);   // s is not moved from
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(pReturn.second == false);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(50));
+      assertUnit(s == Spy(99));
+      assertStandardFixture(m);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // insert_or_assign with a new key builds the pair in the node
+   void test_insertOrAssign_standard()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy s(60);
+      Spy::reset();
+      // exercise
+      pReturn = m.insert_or_assign(std::string("60"), s);
+      // verify
+      assertUnit(Spy::numCopy() == 1);       // copy-create [60] in the node
+      assertUnit(Spy::numAlloc() == 1);      // allocate [60]
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numAssign() == 0);
+      assertUnit(pReturn.second == true);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(60));
+      assertUnit(m.size() == 4);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
+   // insert_or_assign with a key that is there assigns the value
+   void test_insertOrAssign_duplicate()
+   {  // setup
+      //    "30"     "50"     "70"   = m
+      //   +----+   +----+   +----+
+      //   | 30 | - | 50 | - | 70 |
+      //   +----+   +----+   +----+
+      custom::map<std::string, Spy> m;
+      setupStandardFixture(m);
+      custom::pair<custom::map<std::string, Spy>::iterator, bool> pReturn;
+      Spy s(55);
+      Spy::reset();
+      // exercise
+      pReturn = m.insert_or_assign(std::string("50"), s);
+      // verify
+      assertUnit(Spy::numAssign() == 1);     // assign [55] to [50]
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(pReturn.second == false);
+      assertUnit(pReturn.first != m.end());
+      if (pReturn.first != m.end())
+         assertUnit((*pReturn.first).second == Spy(55));
+      assertUnit(m.size() == 3);
+      // teardown
+      teardownStandardFixture(m);
+   }
+
 
    /***************************************
     * SQUARE BRACKET
@@ -2118,8 +3154,8 @@ public:
       s = m[std::string("50")];
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [50]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);     
       assertUnit(Spy::numDelete() == 0);
@@ -2153,8 +3189,8 @@ public:
       s = m[std::string("30")];
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [30]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2188,8 +3224,8 @@ public:
       s = m[std::string("70")];
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [70]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2223,8 +3259,8 @@ public:
       m[std::string("50")] = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [55]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2264,8 +3300,8 @@ public:
       m[std::string("30")] = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [33]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2306,8 +3342,8 @@ public:
       m[std::string("70")] = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [77]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2342,10 +3378,10 @@ public:
       // exercise
       m[std::string("50")] = s;
       // verify
-      assertUnit(Spy::numCopy() == 1);       // copy-create [50]
+      assertUnit(Spy::numCopy() == 0);      // the pair is built in the node
       assertUnit(Spy::numAlloc() == 1);      // allocate    [50]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 1);   // default-construct the value in the node
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numAssign() == 1);     // use the assignment operator for [50]
       assertUnit(Spy::numNondefault() == 0);
       assertUnit(Spy::numCopyMove() == 0);
@@ -2384,10 +3420,10 @@ public:
       // exercise
       m[std::string("10")] = s;
       // verify
-      assertUnit(Spy::numCopy() == 1);       // copy-create [10]
+      assertUnit(Spy::numCopy() == 0);      // the pair is built in the node
       assertUnit(Spy::numAlloc() == 1);      // allocate    [10]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 1);   // default-construct the value in the node
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numAssign() == 1);     // use the assignment operator for [50]
       assertUnit(Spy::numDelete() == 0);
       assertUnit(Spy::numNondefault() == 0);
@@ -2457,10 +3493,10 @@ public:
       // exercise
       m[std::string("60")] = s;
       // verify
-      assertUnit(Spy::numCopy() == 1);       // copy-create [60]
+      assertUnit(Spy::numCopy() == 0);      // the pair is built in the node
       assertUnit(Spy::numAlloc() == 1);      // allocate    [60]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 1);   // default-construct the value in the node
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numAssign() == 1);     // use the assignment operator for [60]
       assertUnit(Spy::numDelete() == 0);
       assertUnit(Spy::numNondefault() == 0);
@@ -2536,8 +3572,8 @@ public:
       s = m.at(std::string("50"));
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [50]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2571,8 +3607,8 @@ public:
       s = m.at(std::string("30"));
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [30]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2606,8 +3642,8 @@ public:
       s = m.at(std::string("70"));
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [70]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2641,8 +3677,8 @@ public:
       m.at(std::string("50")) = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [55]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2682,8 +3718,8 @@ public:
       m.at(std::string("30")) = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [33]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2724,8 +3760,8 @@ public:
       m.at(std::string("70")) = s;
       // verify
       assertUnit(Spy::numAssign() == 1);     // assign [77]
-      assertUnit(Spy::numDefault() == 1);    // a blank Spy is created for comparison
-      assertUnit(Spy::numDestructor() == 1); // destroy it and the move-copy when done
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numDelete() == 0);
@@ -2768,8 +3804,8 @@ public:
       {
          assertUnit(e.what() == std::string("invalid map<K, T> key"));
       }
-      assertUnit(Spy::numDefault() == 1);    // create a default value during search
-      assertUnit(Spy::numDestructor() == 1); // create a default value during search
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);     
       assertUnit(Spy::numAssign() == 0);    
@@ -2805,8 +3841,8 @@ public:
       {
          assertUnit(e.what() == std::string("invalid map<K, T> key"));
       }
-      assertUnit(Spy::numDefault() == 1);    // create a default value during search
-      assertUnit(Spy::numDestructor() == 1); // create a default value during search
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numAssign() == 0);
@@ -2835,8 +3871,8 @@ public:
       // exercise
       size = m.erase(key);
       // verify
-      assertUnit(Spy::numDefault() == 1);      // create a default value for find
-      assertUnit(Spy::numDestructor() == 1);   // destroy the default value for find
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
       assertUnit(Spy::numCopyMove() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -2866,9 +3902,9 @@ public:
       // exercise
       size = m.erase(key);
       // verify
-      assertUnit(Spy::numDestructor() == 2);   // destroy [50] and default for find
+      assertUnit(Spy::numDestructor() == 1); // destroy [50]
       assertUnit(Spy::numDelete() == 1);       // delete  [50]  
-      assertUnit(Spy::numDefault() == 1);      // create default for find
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
       assertUnit(Spy::numAssign() == 0);
@@ -2922,8 +3958,8 @@ public:
       // exercise
       size = m.erase(key);
       // verify
-      assertUnit(Spy::numDestructor() == 1);   // default for find
-      assertUnit(Spy::numDefault() == 1);      // create default for find
+      assertUnit(Spy::numDestructor() == 0); // nothing temporary to destroy
+      assertUnit(Spy::numDefault() == 0);   // search by key alone: no blank Spy
       assertUnit(Spy::numDelete() == 0);
       assertUnit(Spy::numCopy() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -2943,6 +3979,49 @@ public:
       teardownStandardFixture(m);
    }
 
+   // erase by a string_view when the comparator is transparent
+   void test_erase_transparent()
+   {  // setup
+      custom::map<std::string, int, std::less<>> m;
+      m["30"] = 30;
+      m["50"] = 50;
+      m["70"] = 70;
+      // exercise
+      size_t size50 = m.erase(std::string_view("50"));
+      size_t size99 = m.erase("99");
+      // verify
+      assertUnit(size50 == 1);
+      assertUnit(size99 == 0);
+      assertUnit(m.size() == 2);
+      assertUnit(m.count("50") == 0);
+      assertUnit(m.count(std::string_view("30")) == 1);
+   }  // teardown
+
+   // erasing by key, iterator and range keeps the tree red-black
+   void test_erase_balanced()
+   {  // setup
+      custom::map<int, int> m;
+      for (int i = 0; i < 100; i++)
+         m[i] = i;
+      // exercise
+      for (int i = 0; i < 100; i += 3)
+         m.erase(i);
+      auto it = m.find(50);
+      for (int i = 0; i < 10 && it != m.end(); i++)
+         it = m.erase(it);
+      m.erase(m.find(1), m.find(20));
+      // verify
+      assertUnit(m.size() == 100 - 34 - 10 - 13);
+      assertUnit(m.bst.root != nullptr);
+      if (m.bst.root)
+      {
+         assertUnit(m.bst.root->verifyRedBlack(m.bst.root->findDepth()));
+         assertUnit(m.bst.root->computeSize() == (int)m.size());
+      }
+      assertUnit(m.find(1) == m.end());
+      assertUnit(m.find(20) != m.end());
+   }  // teardown
+
    // attempt to erase from an empty map
    void test_erase_emptyIterator()
    {  // setup
@@ -3139,6 +4218,111 @@ public:
       // teardown
       teardownStandardFixture(m);
    }
+
+   /***************************************
+    * STATS
+    *    map::stats()
+    ***************************************/
+
+   // every node made is counted, and every node given back
+   void test_stats_allocations()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::rb_default_stats> m;
+      for (int i = 0; i < 100; i++)
+         m[i] = i;
+      for (int i = 0; i < 30; i++)
+         m.erase(i * 3);
+      // exercise
+      custom::tree_stats before = m.stats();
+      m.clear();
+      custom::tree_stats after = m.stats();
+      // verify
+      assertUnit(before.allocations == 100);
+      assertUnit(before.deallocations == 30);
+      assertUnit(after.allocations == 100);
+      assertUnit(after.deallocations == 100);
+      assertUnit(after.height == 0);
+   }  // teardown
+
+   // the comparisons counted are the comparator's calls, one lookup a find
+   void test_stats_comparisons()
+   {  // setup
+      custom::map<int, int, CountingLess, std::allocator<custom::pair<int, int>>, custom::rb_default_stats> m;
+      for (int i = 0; i < 1000; i++)
+         m[(i * 37) % 1000] = i;
+      m.reset_stats();
+      CountingLess::num = 0;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         m.find(i * 2);
+      // verify
+      custom::tree_stats s = m.stats();
+      assertUnit(s.lookups == 1000);
+      assertUnit(s.comparisons == size_t(CountingLess::num));
+      assertUnit(s.comparisons_per_lookup() <= s.height + 1);
+      assertUnit(s.comparisons_per_lookup() > 8.0);
+   }  // teardown
+
+   // a sorted load needs no rotations and is as short as can be; one
+   // insert at a time in order rotates all the way
+   void test_stats_rotations()
+   {  // setup
+      using StatsMap = custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>,
+                                   custom::rb_default_stats>;
+      std::vector<custom::pair<int, int>> v;
+      for (int i = 0; i < 1023; i++)
+         v.push_back(custom::pair<int, int>(i, i));
+      // exercise
+      StatsMap loaded(custom::sorted_unique, v.begin(), v.end());
+      StatsMap inserted;
+      for (int i = 0; i < 1023; i++)
+         inserted[i] = i;
+      // verify
+      assertUnit(loaded.stats().rotations == 0);
+      assertUnit(loaded.stats().height == 10);
+      assertUnit(inserted.stats().rotations > 900);
+      assertUnit(inserted.stats().height <= 20);
+      assertUnit(inserted.stats().lookups == 1023);
+   }  // teardown
+
+   // copies and moves of the pairs, as the Spy in the value sees them
+   void test_stats_copies()
+   {  // setup
+      custom::map<int, Spy, std::less<int>, std::allocator<custom::pair<int, Spy>>, custom::rb_default_stats> m;
+      custom::pair<int, Spy> one(1, Spy(10));
+      Spy::reset();
+      // exercise
+      m.insert(one);
+      m.insert(custom::pair<int, Spy>(2, Spy(20)));
+      m.emplace(3, Spy(30));
+      auto copy = m;
+      custom::tree_stats s = m.stats();
+      custom::tree_stats sCopy = copy.stats();
+      // verify
+      assertUnit(s.copies == 1);
+      assertUnit(s.moves == 1);
+      assertUnit(sCopy.copies == 3);
+      assertUnit(sCopy.moves == 0);
+      assertUnit(Spy::numCopy() == int(s.copies + sCopy.copies));
+   }  // teardown
+
+   // the counters stay with their map: a copy starts from nothing
+   void test_stats_reset()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<custom::pair<int, int>>, custom::rb_default_stats> m;
+      for (int i = 0; i < 50; i++)
+         m[i] = i;
+      auto copy = m;
+      // exercise
+      m.reset_stats();
+      // verify
+      assertUnit(m.stats().allocations == 0);
+      assertUnit(m.stats().lookups == 0);
+      assertUnit(m.stats().height == copy.stats().height);
+      assertUnit(copy.stats().allocations == 50);
+      assertUnit(copy.stats().lookups == 0);
+   }  // teardown
+
    /****************************************************************
     * Setup Standard Fixture
     *    "30"     "50"     "70"
@@ -3161,12 +4345,12 @@ public:
       //               (50)b
       //           +-----+-----+
       //         (30)r        (70)r
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode30;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode50;
-      custom::BST < custom::pair<std::string, Spy> > ::BNode* bnode70;
-      bnode30 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair30);
-      bnode50 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair50);
-      bnode70 = new custom::BST < custom::pair<std::string, Spy> > ::BNode(pair70);
+      custom::map<std::string, Spy>::BST::BNode* bnode30;
+      custom::map<std::string, Spy>::BST::BNode* bnode50;
+      custom::map<std::string, Spy>::BST::BNode* bnode70;
+      bnode30 = new custom::map<std::string, Spy>::BST::BNode(pair30);
+      bnode50 = new custom::map<std::string, Spy>::BST::BNode(pair50);
+      bnode70 = new custom::map<std::string, Spy>::BST::BNode(pair70);
 
       // hook up the links and stuff
       bnode50->pLeft  = bnode30;
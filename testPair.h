@@ -30,6 +30,8 @@ public:
       test_create_default();
       test_create_nondefault();
       test_create_nondefaultMove();
+      test_create_noComparator();
+      test_create_piecewise();
       
       // Make Pair
       test_makePair_default();
@@ -154,7 +156,33 @@ public:
       // Spy()
       assertUnit(s.empty());
    }  // teardown
+
+   // a pair is just its two members: no comparator stored in every pair
+   void test_create_noComparator()
+   {  // setup
+      // exercise
+      // verify
+      assertUnit(sizeof(custom::pair<int, int>) == 2 * sizeof(int));
+      assertUnit(sizeof(custom::pair<double, double>) == 2 * sizeof(double));
+   }  // teardown
    
+   // build both members in place from two argument tuples
+   void test_create_piecewise()
+   {  // setup
+      Spy::reset();
+      // exercise
+      custom::pair <Spy, int> p(std::piecewise_construct,
+                                std::forward_as_tuple(99),
+                                std::forward_as_tuple(100));
+      // verify
+      assertUnit(Spy::numNondefault() == 1); // Spy(99) built in place
+      assertUnit(Spy::numCopy() == 0);       // nothing copied
+      assertUnit(Spy::numCopyMove() == 0);   // nothing moved
+      assertUnit(Spy::numDestructor() == 0); // no temporaries
+      // ( Spy(99), 100 )
+      assertStandardFixture(p);
+   }  // teardown
+
    /***************************************
     * MAKE PAIR
     ***************************************/
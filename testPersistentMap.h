@@ -0,0 +1,447 @@
+/***********************************************************************
+ * Header:
+ *    TEST PERSISTENT MAP
+ * Summary:
+ *    Unit tests for the copy-on-write persistent map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "persistent_map.h" // class under test
+#include "map.h"            // to build from
+#include "unitTest.h"       // unit test baseclass
+#include "spy.h"            // spy is a mock class to monitor the class under test
+
+#include <atomic>           // for std::atomic
+#include <map>              // for std::map, the reference
+#include <set>              // for std::set
+#include <stdexcept>        // for std::out_of_range
+#include <string>
+#include <thread>           // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST PERSISTENT MAP
+ * Unit tests for the persistent_map class
+ ***********************************************/
+class TestPersistentMap : public UnitTest
+{
+   using IntMap = custom::persistent_map<int, int>;
+   using IntPair = custom::pair<int, int>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_range();
+      test_fromMap_balanced();
+
+      // Snapshot
+      test_snapshot_sharesRoot();
+      test_snapshot_unchangedByInsert();
+      test_snapshot_unchangedByErase();
+      test_snapshot_unchangedByAssign();
+      test_snapshot_copiesPath();
+      test_write_inPlaceWhenUnshared();
+      test_snapshot_freesWhenDropped();
+
+      // Access
+      test_iterator_order();
+      test_lowerBound_standard();
+      test_at_missing();
+      test_visitRange_standard();
+
+      // Balance
+      test_insertErase_random();
+
+      // Threads
+      test_threads_readSnapshot();
+
+      report("PersistentMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor, nothing in it
+   void test_construct_default()
+   {  // setup
+      Spy::reset();
+      // exercise
+      custom::persistent_map<Spy, Spy> pm;
+      // verify
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(pm.empty());
+      assertUnit(pm.root == nullptr);
+      assertUnit(pm.begin() == pm.end());
+   }  // teardown
+
+   // unsorted input with a duplicate: the first of each key wins
+   void test_construct_range()
+   {  // setup
+      std::vector<IntPair> v = { {50, 1}, {30, 2}, {70, 3}, {30, 4}, {20, 5} };
+      // exercise
+      IntMap pm(v.begin(), v.end());
+      // verify
+      assertUnit(pm.size() == 4);
+      assertUnit(pm.at(30) == 2);
+      assertUnit((*pm.begin()).first == 20);
+      assertUnit(verifyBalanced(pm.root) > 0);
+   }  // teardown
+
+   // from a map: balanced, and no comparisons
+   void test_fromMap_balanced()
+   {  // setup
+      custom::map<Spy, int> m;
+      for (int i = 0; i < 100; i++)
+         m[Spy((i * 37) % 100)] = i;
+      Spy::reset();
+      // exercise
+      custom::persistent_map<Spy, int> pm(m);
+      // verify
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(pm.size() == 100);
+      assertUnit(pm.root->height == 7);
+      assertUnit(verifyBalanced(pm.root) == 7);
+      assertUnit(pm.at(Spy(37)) == 1);
+   }  // teardown
+
+   /***************************************
+    * SNAPSHOT
+    ***************************************/
+
+   // a snapshot is one more reference to the same root, and no copies
+   void test_snapshot_sharesRoot()
+   {  // setup
+      custom::persistent_map<Spy, Spy> pm;
+      for (int i = 0; i < 100; i++)
+         pm.insert(custom::pair<Spy, Spy>(Spy(i), Spy(i)));
+      Spy::reset();
+      // exercise
+      custom::persistent_map<Spy, Spy> snap = pm.snapshot();
+      // verify
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(snap.root == pm.root);
+      assertUnit(pm.root->refs.load() == 2);
+      assertUnit(snap.size() == 100);
+   }  // teardown
+
+   // inserts after a snapshot do not show in it
+   void test_snapshot_unchangedByInsert()
+   {  // setup
+      IntMap pm = { {1, 10}, {2, 20}, {3, 30} };
+      IntMap snap = pm.snapshot();
+      // exercise
+      for (int i = 4; i < 50; i++)
+         pm.insert(IntPair(i, i * 10));
+      // verify
+      assertUnit(pm.size() == 49);
+      assertUnit(snap.size() == 3);
+      assertUnit(!snap.contains(4));
+      assertUnit(toVector(snap) == std::vector<int>({ 1, 2, 3 }));
+      assertUnit(verifyBalanced(pm.root) > 0);
+      assertUnit(verifyBalanced(snap.root) > 0);
+   }  // teardown
+
+   // erases after a snapshot do not show in it
+   void test_snapshot_unchangedByErase()
+   {  // setup
+      IntMap pm;
+      for (int i = 0; i < 20; i++)
+         pm.insert(IntPair(i, i));
+      IntMap snap = pm.snapshot();
+      // exercise
+      for (int i = 0; i < 20; i += 2)
+         pm.erase(i);
+      // verify
+      assertUnit(pm.size() == 10);
+      assertUnit(snap.size() == 20);
+      assertUnit(toVector(snap).size() == 20);
+      assertUnit(!pm.contains(4) && snap.contains(4));
+      assertUnit(verifyBalanced(pm.root) > 0);
+   }  // teardown
+
+   // neither does a new value
+   void test_snapshot_unchangedByAssign()
+   {  // setup
+      IntMap pm = { {1, 10}, {2, 20}, {3, 30} };
+      IntMap snap = pm.snapshot();
+      // exercise
+      bool inserted = pm.insert_or_assign(3, 31);
+      // verify
+      assertUnit(!inserted);
+      assertUnit(pm.at(3) == 31);
+      assertUnit(snap.at(3) == 30);
+      assertUnit(pm.root != snap.root);
+      assertUnit(pm.root->pLeft == snap.root->pLeft);   // 1 was not on the path
+   }  // teardown
+
+   // one insert into a shared tree of 1000 copies only its path
+   void test_snapshot_copiesPath()
+   {  // setup
+      custom::persistent_map<int, Spy> pm;
+      for (int i = 0; i < 1000; i++)
+         pm.insert(custom::pair<int, Spy>(i * 2, Spy(i)));
+      custom::persistent_map<int, Spy> snap = pm.snapshot();
+      Spy::reset();
+      // exercise
+      pm.insert(custom::pair<int, Spy>(999, Spy(-1)));
+      // verify
+      int height = snap.root->height;
+      std::set<const void*> before;
+      collect(snap.root, before);
+      std::set<const void*> after;
+      collect(pm.root, after);
+      size_t fresh = 0;
+      for (const void* p : after)
+         fresh += before.count(p) ? 0 : 1;
+      assertUnit(fresh <= (size_t)height + 2);
+      assertUnit(Spy::numCopy() <= height + 2);
+      assertUnit(snap.size() == 1000 && pm.size() == 1001);
+   }  // teardown
+
+   // with no snapshot around, writes change the nodes where they stand
+   void test_write_inPlaceWhenUnshared()
+   {  // setup
+      custom::persistent_map<int, Spy> pm;
+      for (int i = 0; i < 100; i++)
+         pm.insert(custom::pair<int, Spy>(i, Spy(i)));
+      Spy::reset();
+      // exercise
+      pm.insert_or_assign(50, Spy(500));
+      pm.erase(25);
+      // verify
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(pm.at(50) == Spy(500));
+      assertUnit(pm.size() == 99);
+   }  // teardown
+
+   // the last map to let go of a node frees it
+   void test_snapshot_freesWhenDropped()
+   {  // setup
+      Spy::reset();
+      {
+         custom::persistent_map<int, Spy> pm;
+         for (int i = 0; i < 50; i++)
+            pm.insert(custom::pair<int, Spy>(i, Spy(i)));
+         {
+            custom::persistent_map<int, Spy> snap = pm.snapshot();
+            // exercise
+            for (int i = 0; i < 50; i += 3)
+               pm.erase(i);
+            pm.insert_or_assign(1, Spy(100));
+         }
+         assertUnit(pm.size() == 33);
+      }
+      // verify
+      assertUnit(Spy::numAlloc() == Spy::numDelete());
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // in key order, however the keys went in
+   void test_iterator_order()
+   {  // setup
+      IntMap pm;
+      for (int i = 0; i < 100; i++)
+         pm.insert(IntPair((i * 37) % 100, i));
+      // exercise
+      std::vector<int> keys = toVector(pm);
+      // verify
+      bool sorted = keys.size() == 100;
+      for (int i = 0; i < (int)keys.size(); i++)
+         sorted = sorted && keys[i] == i;
+      assertUnit(sorted);
+   }  // teardown
+
+   // lower bound agrees with std::map, and iterates on from there
+   void test_lowerBound_standard()
+   {  // setup
+      IntMap pm;
+      std::map<int, int> expect;
+      for (int i = 0; i < 50; i++)
+      {
+         pm.insert(IntPair(i * 3, i));
+         expect[i * 3] = i;
+      }
+      bool same = true;
+      // exercise
+      for (int k = -2; k < 152; k++)
+      {
+         auto it = pm.lower_bound(k);
+         auto itExpect = expect.lower_bound(k);
+         for (int step = 0; step < 3 && itExpect != expect.end(); step++, ++it, ++itExpect)
+            same = same && it != pm.end() && (*it).first == itExpect->first;
+         same = same && (itExpect != expect.end() || it == pm.end());
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(pm.find(4) == pm.end());
+      assertUnit(pm.find(6) != pm.end() && pm.find(6)->second == 2);
+   }  // teardown
+
+   // at() throws the way map's does
+   void test_at_missing()
+   {  // setup
+      custom::persistent_map<std::string, int> pm = { {"a", 1}, {"c", 3} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         pm.at("b");
+      }
+      catch (const std::out_of_range& error)
+      {
+         thrown = std::string(error.what()) == "invalid map<K, T> key";
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(pm.at("c") == 3);
+   }  // teardown
+
+   // [lo, hi), in order
+   void test_visitRange_standard()
+   {  // setup
+      IntMap pm;
+      for (int i = 0; i < 100; i++)
+         pm.insert(IntPair(i * 2, i));
+      std::vector<int> keys;
+      // exercise
+      pm.visit_range(11, 21, [&keys](const IntPair& p) { keys.push_back(p.first); });
+      // verify
+      assertUnit(keys == std::vector<int>({ 12, 14, 16, 18, 20 }));
+   }  // teardown
+
+   /***************************************
+    * BALANCE
+    ***************************************/
+
+   // random inserts and erases, snapshots taken along the way: each stays
+   // balanced and keeps what it had
+   void test_insertErase_random()
+   {  // setup
+      IntMap pm;
+      std::map<int, int> expect;
+      std::vector<IntMap> snaps;
+      std::vector<std::map<int, int>> snapsExpect;
+      bool same = true;
+      unsigned int seed = 12345;
+      // exercise
+      for (int i = 0; i < 3000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int k = (seed >> 16) % 500;
+         if ((seed >> 8) % 3)
+         {
+            same = same && pm.insert(IntPair(k, i)) == expect.insert({ k, i }).second;
+         }
+         else
+            same = same && pm.erase(k) == expect.erase(k);
+         if (i % 500 == 0)
+         {
+            snaps.push_back(pm.snapshot());
+            snapsExpect.push_back(expect);
+         }
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(pm.size() == expect.size());
+      assertUnit(verifyBalanced(pm.root) > 0);
+      for (size_t i = 0; i < snaps.size(); i++)
+      {
+         assertUnit(verifyBalanced(snaps[i].root) >= 0);
+         assertUnit(snaps[i].size() == snapsExpect[i].size());
+         std::vector<int> keys = toVector(snaps[i]);
+         size_t j = 0;
+         bool match = keys.size() == snapsExpect[i].size();
+         for (auto it = snapsExpect[i].begin(); match && it != snapsExpect[i].end(); ++it, ++j)
+            match = keys[j] == it->first && snaps[i].at(it->first) == it->second;
+         assertUnit(match);
+      }
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // a reader walks a snapshot while the writer keeps writing
+   void test_threads_readSnapshot()
+   {  // setup
+      IntMap pm;
+      for (int i = 0; i < 1000; i++)
+         pm.insert(IntPair(i, i));
+      IntMap snap = pm.snapshot();
+      std::atomic<bool> started(false);
+      long sum = 0;
+      std::thread reader([&]()
+      {
+         started.store(true);
+         for (int pass = 0; pass < 20; pass++)
+            for (auto it = snap.begin(); it != snap.end(); ++it)
+               sum += (*it).second;
+      });
+      while (!started.load())
+         std::this_thread::yield();
+      // exercise
+      for (int i = 0; i < 1000; i += 2)
+         pm.erase(i);
+      for (int i = 1; i < 1000; i += 2)
+         pm.insert_or_assign(i, 0);
+      reader.join();
+      // verify
+      assertUnit(sum == 20L * 999 * 1000 / 2);
+      assertUnit(pm.size() == 500);
+      assertUnit(pm.at(1) == 0);
+      assertUnit(snap.at(1) == 1);
+   }  // teardown
+
+private:
+   // the height of the subtree, or -1 if it is out of balance, out of
+   // order, or its heights are wrong
+   template <class Node>
+   static int verifyBalanced(const Node* p)
+   {
+      if (!p)
+         return 0;
+      int hLeft = verifyBalanced(p->pLeft);
+      int hRight = verifyBalanced(p->pRight);
+      if (hLeft < 0 || hRight < 0 || hLeft - hRight > 1 || hRight - hLeft > 1)
+         return -1;
+      if ((p->pLeft && !(p->pLeft->pair.first < p->pair.first)) ||
+          (p->pRight && !(p->pair.first < p->pRight->pair.first)))
+         return -1;
+      int height = 1 + (hLeft > hRight ? hLeft : hRight);
+      return height == p->height ? height : -1;
+   }
+
+   template <class Node>
+   static void collect(const Node* p, std::set<const void*>& nodes)
+   {
+      if (!p)
+         return;
+      nodes.insert(p);
+      collect(p->pLeft, nodes);
+      collect(p->pRight, nodes);
+   }
+
+   static std::vector<int> toVector(const custom::persistent_map<int, int>& pm)
+   {
+      std::vector<int> keys;
+      for (auto it = pm.begin(); it != pm.end(); ++it)
+         keys.push_back((*it).first);
+      return keys;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,465 @@
+/***********************************************************************
+ * Header:
+ *    TEST POOL
+ * Summary:
+ *    Unit tests for the node_pool allocator
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "pool.h"       // class under test
+#include "bst.h"        // trees that draw their nodes from the pool
+#include "map.h"
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // spy is a mock class to monitor the class under test
+
+#include <string>
+#include <type_traits>  // for std::is_trivially_copyable
+
+/***********************************************
+ * TEST POOL
+ * Unit tests for the node_pool allocator
+ ***********************************************/
+class TestPool : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Allocate
+      test_allocate_contiguous();
+      test_allocate_newChunk();
+      test_allocate_large();
+      test_allocate_tailReused();
+      test_deallocate_reuse();
+
+      // Copy and Rebind
+      test_copy_sharesArena();
+      test_rebind_sharesArena();
+      test_selectOnCopy_freshArena();
+
+      // Release
+      test_release_standard();
+
+      // Trees
+      test_bst_insertClear();
+      test_bst_copyOwnArena();
+      test_bst_moveTakesArena();
+      test_map_subscript();
+
+      // Clone
+      test_clone_chunksWhole();
+      test_clone_freeList();
+      test_bst_cloneTrivial();
+      test_bst_cloneAssign();
+      test_bst_cloneNotTrivial();
+      test_bst_clearTrivial();
+      test_map_cloneThreaded();
+      test_map_cloneGrow();
+
+      report("Pool");
+   }
+
+   /***************************************
+    * ALLOCATE
+    ***************************************/
+
+   // consecutive allocations come out of one chunk, side by side
+   void test_allocate_contiguous()
+   {  // setup
+      custom::node_pool<double> pool;
+      // exercise
+      double* p1 = pool.allocate(1);
+      double* p2 = pool.allocate(1);
+      double* p3 = pool.allocate(1);
+      // verify
+      assertUnit(pool.numChunks() == 1);
+      assertUnit(p1 != nullptr);
+      assertUnit(reinterpret_cast<char*>(p2) - reinterpret_cast<char*>(p1) == (long)pool.pArena->blockSize);
+      assertUnit(reinterpret_cast<char*>(p3) - reinterpret_cast<char*>(p2) == (long)pool.pArena->blockSize);
+   }  // teardown
+
+   // running off the end of a chunk starts a bigger one
+   void test_allocate_newChunk()
+   {  // setup
+      custom::node_pool<double> pool;
+      // exercise
+      for (size_t i = 0; i <= custom::arena::MIN_BLOCKS; i++)
+         pool.allocate(1);
+      // verify
+      assertUnit(pool.numChunks() == 2);
+      assertUnit(pool.pArena->chunkBlocks == custom::arena::MIN_BLOCKS * 4);
+   }  // teardown
+
+   // a request bigger than a chunk gets a chunk of its own
+   void test_allocate_large()
+   {  // setup
+      custom::node_pool<double> pool;
+      pool.allocate(1);
+      // exercise
+      double* p = pool.allocate(custom::arena::MIN_BLOCKS * 8);
+      // verify
+      assertUnit(p != nullptr);
+      assertUnit(pool.numChunks() == 2);
+      p[custom::arena::MIN_BLOCKS * 8 - 1] = 3.14;
+      assertUnit(p[custom::arena::MIN_BLOCKS * 8 - 1] == 3.14);
+   }  // teardown
+
+   // the end of a chunk too short for a request is not lost
+   void test_allocate_tailReused()
+   {  // setup
+      custom::node_pool<double> pool;
+      double* pLast = nullptr;
+      for (size_t i = 0; i < custom::arena::MIN_BLOCKS - 1; i++)
+         pLast = pool.allocate(1);
+      // exercise
+      pool.allocate(2);
+      double* p = pool.allocate(1);
+      // verify
+      assertUnit(pool.numChunks() == 2);
+      assertUnit(reinterpret_cast<char*>(p) - reinterpret_cast<char*>(pLast) == (long)pool.pArena->blockSize);
+   }  // teardown
+
+   // a freed block is handed out again before new memory is used
+   void test_deallocate_reuse()
+   {  // setup
+      custom::node_pool<double> pool;
+      double* p1 = pool.allocate(1);
+      pool.allocate(1);
+      // exercise
+      pool.deallocate(p1, 1);
+      double* p3 = pool.allocate(1);
+      // verify
+      assertUnit(p3 == p1);
+      assertUnit(pool.numChunks() == 1);
+   }  // teardown
+
+   /***************************************
+    * COPY and REBIND
+    ***************************************/
+
+   // a copy of a pool draws from the same arena
+   void test_copy_sharesArena()
+   {  // setup
+      custom::node_pool<double> pool1;
+      // exercise
+      custom::node_pool<double> pool2(pool1);
+      // verify
+      assertUnit(pool1 == pool2);
+      assertUnit(!pool1.unique());
+      assertUnit(pool1.pArena == pool2.pArena);
+   }  // teardown
+
+   // a rebound pool draws from the same arena
+   void test_rebind_sharesArena()
+   {  // setup
+      custom::node_pool<double> pool1;
+      // exercise
+      custom::node_pool<long double> pool2(pool1);
+      // verify
+      assertUnit(pool1 == pool2);
+      assertUnit(pool1.pArena == pool2.pArena);
+   }  // teardown
+
+   // copying a container should give the copy its own arena
+   void test_selectOnCopy_freshArena()
+   {  // setup
+      custom::node_pool<double> pool1;
+      // exercise
+      custom::node_pool<double> pool2 = pool1.select_on_container_copy_construction();
+      // verify
+      assertUnit(pool1 != pool2);
+      assertUnit(pool1.unique());
+      assertUnit(pool2.unique());
+   }  // teardown
+
+   /***************************************
+    * RELEASE
+    ***************************************/
+
+   // release gives back every chunk at once
+   void test_release_standard()
+   {  // setup
+      custom::node_pool<double> pool;
+      for (size_t i = 0; i < custom::arena::MIN_BLOCKS * 3; i++)
+         pool.allocate(1);
+      assertUnit(pool.numChunks() == 2);
+      // exercise
+      pool.release();
+      // verify
+      assertUnit(pool.numChunks() == 0);
+      assertUnit(pool.pArena->pChunks == nullptr);
+      assertUnit(pool.pArena->pFree == nullptr);
+      assertUnit(pool.pArena->chunkBlocks == custom::arena::MIN_BLOCKS);
+   }  // teardown
+
+   /***************************************
+    * TREES
+    ***************************************/
+
+   // a BST puts its nodes in the arena and releases it on clear
+   void test_bst_insertClear()
+   {  // setup
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert(Spy(i));
+      assertUnit(bst.alloc.numChunks() == 2);
+      assertUnit(bst.size() == 100);
+      Spy::reset();
+      // exercise
+      bst.clear();
+      // verify
+      assertUnit(Spy::numDestructor() == 100);  // every destructor still runs
+      assertUnit(Spy::numDelete() == 100);
+      assertUnit(bst.alloc.numChunks() == 0);   // but the memory goes back by the chunk
+      assertUnit(bst.root == nullptr);
+      assertUnit(bst.size() == 0);
+   }  // teardown
+
+   // a copied BST gets its own arena
+   void test_bst_copyOwnArena()
+   {  // setup
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstSrc;
+      for (int i = 0; i < 10; i++)
+         bstSrc.insert(Spy(i));
+      // exercise
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstDest(bstSrc);
+      // verify
+      assertUnit(bstDest.alloc != bstSrc.alloc);
+      assertUnit(bstDest.alloc.unique());
+      assertUnit(bstDest.alloc.numChunks() == 1);
+      assertUnit(bstDest.size() == 10);
+      assertUnit(*bstDest.begin() == Spy(0));
+   }  // teardown
+
+   // a moved BST takes the arena with the nodes
+   void test_bst_moveTakesArena()
+   {  // setup
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstSrc;
+      for (int i = 0; i < 10; i++)
+         bstSrc.insert(Spy(i));
+      custom::node_pool<custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>>::BNode> alloc(bstSrc.alloc);
+      // exercise
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstDest(std::move(bstSrc));
+      // verify
+      assertUnit(bstDest.alloc == alloc);
+      assertUnit(bstSrc.alloc != alloc);
+      assertUnit(bstDest.size() == 10);
+      assertUnit(bstSrc.size() == 0);
+      assertUnit(bstSrc.root == nullptr);
+   }  // teardown
+
+   // a map can be told to put its nodes in a pool
+   void test_map_subscript()
+   {  // setup
+      custom::map<std::string, int, std::less<std::string>, custom::node_pool<custom::pair<std::string, int>>> m;
+      // exercise
+      m["a"] = 1;
+      m["b"] = 2;
+      m["c"] = 3;
+      m.erase("c");
+      m["d"] = 4;
+      // verify
+      assertUnit(m.size() == 3);
+      assertUnit(m.bst.alloc.numChunks() == 1);
+      assertUnit(m.at("a") == 1);
+      assertUnit(m.at("b") == 2);
+      assertUnit(m.at("d") == 4);
+   }  // teardown
+
+   /***************************************
+    * CLONE
+    ***************************************/
+
+   // cloning an arena copies each chunk and says where it went
+   void test_clone_chunksWhole()
+   {  // setup
+      custom::node_pool<double> poolSrc;
+      std::vector<double*> blocks;
+      // chunks of MIN_BLOCKS and twice that, one block short of full
+      for (size_t i = 0; i < custom::arena::MIN_BLOCKS * 3 - 1; i++)
+      {
+         blocks.push_back(poolSrc.allocate(1));
+         *blocks.back() = (double)i;
+      }
+      custom::node_pool<double> poolDest;
+      // exercise
+      custom::relocation fix = poolDest.clone(poolSrc);
+      // verify
+      assertUnit(poolDest != poolSrc);
+      assertUnit(poolDest.numChunks() == 2);
+      assertUnit(poolSrc.numChunks() == 2);
+      assertUnit(fix((double*)nullptr) == nullptr);
+      bool same = true;
+      for (size_t i = 0; i < blocks.size(); i++)
+         same = same && fix(blocks[i]) != blocks[i] && *fix(blocks[i]) == (double)i;
+      assertUnit(same);
+      // the copy carries on where the source left off
+      assertUnit(poolDest.pArena->chunkBlocks == poolSrc.pArena->chunkBlocks);
+      assertUnit(poolDest.pArena->pEnd - poolDest.pArena->pNext == poolSrc.pArena->pEnd - poolSrc.pArena->pNext);
+      char* pNext = reinterpret_cast<char*>(fix(blocks.back())) + poolDest.pArena->blockSize;
+      assertUnit(reinterpret_cast<char*>(poolDest.allocate(1)) == pNext);
+   }  // teardown
+
+   // the free list of the clone runs through the clone's blocks
+   void test_clone_freeList()
+   {  // setup
+      custom::node_pool<double> poolSrc;
+      double* p1 = poolSrc.allocate(1);
+      double* p2 = poolSrc.allocate(1);
+      poolSrc.allocate(1);
+      poolSrc.deallocate(p1, 1);
+      poolSrc.deallocate(p2, 1);
+      custom::node_pool<double> poolDest;
+      // exercise
+      custom::relocation fix = poolDest.clone(poolSrc);
+      // verify
+      assertUnit(poolDest.allocate(1) == fix(p2));
+      assertUnit(poolDest.allocate(1) == fix(p1));
+      assertUnit(poolSrc.allocate(1) == p2);
+   }  // teardown
+
+   // a tree of trivially copyable pairs is copied a chunk at a time
+   void test_bst_cloneTrivial()
+   {  // setup
+      using Pair = custom::pair<int, double>;
+      custom::BST<Pair, std::less<Pair>, custom::node_pool<Pair>> bstSrc;
+      for (int i = 0; i < 200; i++)
+         bstSrc.insert(Pair(i, i / 2.0));
+      assertUnit(std::is_trivially_copyable<Pair>::value);
+      // exercise
+      custom::BST<Pair, std::less<Pair>, custom::node_pool<Pair>> bstDest(bstSrc);
+      // verify
+      assertUnit(bstDest.alloc != bstSrc.alloc);
+      assertUnit(bstDest.alloc.numChunks() == bstSrc.alloc.numChunks());
+      assertUnit(bstDest.size() == 200);
+      assertUnit(bstDest.root != bstSrc.root);
+      assertUnit(bstDest.root->parent() == nullptr);
+      int i = 0;
+      bool inOrder = true;
+      for (auto it = bstDest.begin(); it != bstDest.end(); ++it, ++i)
+         inOrder = inOrder && (*it).first == i && (*it).second == i / 2.0 &&
+                   bstSrc.find(*it) != it;
+      assertUnit(inOrder);
+      assertUnit(i == 200);
+#ifdef DEBUG
+      assertUnit(bstDest.root->verifyRedBlack(bstDest.root->findDepth()));
+#endif // DEBUG
+      // the copy is on its own: the source can go away
+      bstSrc.clear();
+      auto it = bstDest.find(Pair(150));
+      assertUnit(it != bstDest.end() && (*it).second == 75.0);
+      bstDest.erase(it);
+      bstDest.insert(Pair(500, 1.0));
+      assertUnit(bstDest.size() == 200);
+      assertUnit((*bstDest.rbegin()).first == 500);
+   }  // teardown
+
+   // assigning a tree of trivially copyable pairs clones too
+   void test_bst_cloneAssign()
+   {  // setup
+      custom::BST<int, std::less<int>, custom::node_pool<int>> bstSrc;
+      custom::BST<int, std::less<int>, custom::node_pool<int>> bstDest;
+      for (int i = 0; i < 100; i++)
+         bstSrc.insert(i);
+      for (int i = 0; i < 10; i++)
+         bstDest.insert(-i);
+      // exercise
+      bstDest = bstSrc;
+      bstDest = bstDest;
+      // verify
+      assertUnit(bstDest.alloc != bstSrc.alloc);
+      assertUnit(bstDest.size() == 100);
+      assertUnit(*bstDest.begin() == 0);
+      assertUnit(*bstDest.rbegin() == 99);
+      assertUnit(bstDest.find(-5) == bstDest.end());
+      assertUnit(bstDest.find(50) != bstDest.end());
+   }  // teardown
+
+   // other trees are still copied a node at a time
+   void test_bst_cloneNotTrivial()
+   {  // setup
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstSrc;
+      for (int i = 0; i < 10; i++)
+         bstSrc.insert(Spy(i));
+      Spy::reset();
+      // exercise
+      custom::BST<Spy, std::less<Spy>, custom::node_pool<Spy>> bstDest(bstSrc);
+      // verify
+      assertUnit(Spy::numCopy() == 10);
+      assertUnit(bstDest.size() == 10);
+   }  // teardown
+
+   // clearing a tree of trivially destructible pairs does not walk it
+   void test_bst_clearTrivial()
+   {  // setup
+      custom::BST<int, std::less<int>, custom::node_pool<int>> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert(i);
+      // exercise
+      bst.clear();
+      // verify
+      assertUnit(bst.alloc.numChunks() == 0);
+      assertUnit(bst.root == nullptr);
+      assertUnit(bst.size() == 0);
+      assertUnit(bst.begin() == bst.end());
+      bst.insert(3);
+      assertUnit(*bst.begin() == 3);
+   }  // teardown
+
+   // a threaded map is threaded again after the clone
+   void test_map_cloneThreaded()
+   {  // setup
+      using Pair = custom::pair<int, int>;
+      custom::map<int, int, std::less<int>, custom::node_pool<Pair>, custom::rb_default_threaded> mSrc;
+      for (int i = 0; i < 50; i++)
+         mSrc[i] = i * i;
+      // exercise
+      custom::map<int, int, std::less<int>, custom::node_pool<Pair>, custom::rb_default_threaded> mDest(mSrc);
+      // verify
+      mSrc.clear();
+      int i = 0;
+      bool forward = true;
+      for (auto it = mDest.begin(); it != mDest.end(); ++it, ++i)
+         forward = forward && (*it).first == i && (*it).second == i * i;
+      assertUnit(forward);
+      assertUnit(i == 50);
+      auto it = mDest.find(49);
+      for (i = 49; i > 0; i--)
+         --it;
+      assertUnit((*it).first == 0);
+   }  // teardown
+
+   // a copy grown past the end of its newest chunk starts another one
+   void test_map_cloneGrow()
+   {  // setup
+      using Pair = custom::pair<int, int>;
+      using Map = custom::map<int, int, std::less<int>, custom::node_pool<Pair>>;
+      bool grown = true;
+      for (int numSrc : { 1, 50, 193 })
+      {
+         Map mSrc;
+         for (int i = 0; i < numSrc; i++)
+            mSrc[i] = i;
+         Map mDest(mSrc);
+         size_t numChunks = mDest.get_allocator().numChunks();
+         // exercise
+         for (int i = numSrc; i < numSrc + 500; i++)
+            mDest[i] = i;
+         // verify
+         grown = grown && mDest.get_allocator().numChunks() > numChunks;
+         grown = grown && mDest.size() == size_t(numSrc + 500) && mSrc.size() == size_t(numSrc);
+         int i = 0;
+         for (auto it = mDest.begin(); it != mDest.end(); ++it, ++i)
+            grown = grown && (*it).first == i && (*it).second == i;
+      }
+      assertUnit(grown);
+   }  // teardown
+};
+
+#endif // DEBUG
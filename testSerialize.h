@@ -0,0 +1,366 @@
+/***********************************************************************
+ * Header:
+ *    TEST SERIALIZE
+ * Summary:
+ *    Unit tests for the binary map file: writing, loading, searching
+ *    in place and mapping it from disk
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "serialize.h"      // functions under test
+#include "map.h"            // the maps they write and load
+#include "unitTest.h"       // unit test baseclass
+
+#include <cstdint>          // for std::int64_t
+#include <cstdio>           // for std::remove
+#include <fstream>          // for std::ofstream
+#include <sstream>          // for std::stringstream
+#include <stdexcept>        // for std::runtime_error
+#include <string>
+
+/***********************************************
+ * TEST SERIALIZE
+ * Unit tests for serialize.h
+ ***********************************************/
+class TestSerialize : public UnitTest
+{
+   using IntPair = custom::pair<int, int>;
+   using IntMap = custom::map<int, int>;
+   using IntView = custom::map_view<int, int>;
+
+   // counts comparisons, to show a load builds rather than inserts
+   struct CountingLess
+   {
+      bool operator()(int lhs, int rhs) const
+      {
+         num++;
+         return lhs < rhs;
+      }
+      static inline int num = 0;
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Format
+      test_serialize_layout();
+      test_serialize_empty();
+
+      // Load
+      test_deserialize_roundTrip();
+      test_deserialize_replaces();
+      test_deserialize_linear();
+      test_deserialize_bplus();
+      test_deserialize_badMagic();
+      test_deserialize_badVersion();
+      test_deserialize_otherTypes();
+      test_deserialize_truncated();
+
+      // View
+      test_view_find();
+      test_view_bounds();
+      test_view_iterate();
+
+      // File
+      test_mappedFile_roundTrip();
+      test_mappedFile_missing();
+
+      report("Serialize");
+   }
+
+   /***************************************
+    * FORMAT
+    ***************************************/
+
+   // the header, then the keys, padding, and the values, little-endian
+   void test_serialize_layout()
+   {  // setup
+      IntMap m = { IntPair(0x0201, 7), IntPair(5, -1), IntPair(3, 9) };
+      std::stringstream out;
+      // exercise
+      custom::serialize(m, out);
+      // verify
+      std::string file = out.str();
+      const unsigned char* p = reinterpret_cast<const unsigned char*>(file.data());
+      assertUnit(file.size() == 32 + 12 + 4 + 12);
+      assertUnit(file.compare(0, 4, "CMAP") == 0);
+      assertUnit(p[4] == 1 && p[5] == 0 && p[6] == 0 && p[7] == 0);
+      assertUnit(p[8] == 4 && p[12] == 4);
+      assertUnit(p[16] == 3 && p[17] == 0);
+      assertUnit(p[32] == 3 && p[36] == 5);
+      assertUnit(p[40] == 0x01 && p[41] == 0x02 && p[42] == 0 && p[43] == 0);
+      assertUnit(p[44] == 0 && p[47] == 0);
+      assertUnit(p[48] == 9 && p[52] == 0xff && p[56] == 7);
+   }  // teardown
+
+   // no pairs: only the header
+   void test_serialize_empty()
+   {  // setup
+      IntMap m;
+      IntMap loaded = { IntPair(1, 1) };
+      std::stringstream out;
+      // exercise
+      custom::serialize(m, out);
+      custom::deserialize(out, loaded);
+      // verify
+      assertUnit(out.str().size() == 32);
+      assertUnit(loaded.empty());
+   }  // teardown
+
+   /***************************************
+    * LOAD
+    ***************************************/
+
+   // what goes out comes back, doubles and all
+   void test_deserialize_roundTrip()
+   {  // setup
+      custom::map<std::int64_t, double> m;
+      for (int i = 0; i < 1000; i++)
+         m[(i * 37) % 1000 - 500] = i / 4.0;
+      custom::map<std::int64_t, double> loaded;
+      std::stringstream file;
+      // exercise
+      custom::serialize(m, file);
+      custom::deserialize(file, loaded);
+      // verify
+      assertUnit(loaded.size() == 1000);
+      bool same = true;
+      auto itLoaded = loaded.begin();
+      for (auto it = m.begin(); it != m.end(); ++it, ++itLoaded)
+         same = same && (*it).first == (*itLoaded).first && (*it).second == (*itLoaded).second;
+      assertUnit(same);
+   }  // teardown
+
+   // whatever the map held before is gone
+   void test_deserialize_replaces()
+   {  // setup
+      IntMap m = { IntPair(1, 10), IntPair(2, 20) };
+      IntMap loaded = { IntPair(2, 99), IntPair(7, 70) };
+      std::stringstream file;
+      custom::serialize(m, file);
+      // exercise
+      custom::deserialize(file, loaded);
+      // verify
+      assertUnit(loaded.size() == 2);
+      assertUnit(loaded.at(2) == 20);
+      assertUnit(loaded.find(7) == loaded.end());
+   }  // teardown
+
+   // one comparison a pair to check the order, then a build with none
+   void test_deserialize_linear()
+   {  // setup
+      custom::map<int, int, CountingLess> m;
+      for (int i = 0; i < 1000; i++)
+         m[i] = i;
+      custom::map<int, int, CountingLess> loaded;
+      std::stringstream file;
+      custom::serialize(m, file);
+      CountingLess::num = 0;
+      // exercise
+      custom::deserialize(file, loaded);
+      // verify
+      assertUnit(loaded.size() == 1000);
+      assertUnit(CountingLess::num < 1000);
+   }  // teardown
+
+   // a file is a file: B+tree maps write and load it the same
+   void test_deserialize_bplus()
+   {  // setup
+      custom::map<int, int, std::less<int>, std::allocator<IntPair>, custom::bplus<16>> m;
+      for (int i = 0; i < 500; i++)
+         m[i * 3] = i;
+      IntMap loaded;
+      std::stringstream file;
+      // exercise
+      custom::serialize(m, file);
+      custom::deserialize(file, loaded);
+      // verify
+      assertUnit(loaded.size() == 500);
+      assertUnit(loaded.at(297) == 99);
+   }  // teardown
+
+   // not a map file at all
+   void test_deserialize_badMagic()
+   {  // setup
+      std::string file = fileOf({ IntPair(1, 1) });
+      file[0] = 'X';
+      // exercise and verify
+      assertUnit(rejected(file));
+   }  // teardown
+
+   // a later version is not read as this one
+   void test_deserialize_badVersion()
+   {  // setup
+      std::string file = fileOf({ IntPair(1, 1) });
+      file[4] = 2;
+      // exercise and verify
+      assertUnit(rejected(file));
+   }  // teardown
+
+   // the sizes in the header must be those of K and V
+   void test_deserialize_otherTypes()
+   {  // setup
+      custom::map<std::int64_t, int> m = { {1, 1}, {2, 2} };
+      std::stringstream out;
+      custom::serialize(m, out);
+      // exercise and verify
+      assertUnit(rejected(out.str()));
+   }  // teardown
+
+   // cut short anywhere: the header, the keys or the values
+   void test_deserialize_truncated()
+   {  // setup
+      std::string file = fileOf({ IntPair(1, 1), IntPair(2, 2), IntPair(3, 3) });
+      bool allRejected = true;
+      // exercise
+      for (size_t size = 0; size < file.size(); size++)
+         allRejected = allRejected && rejected(file.substr(0, size));
+      // verify
+      assertUnit(allRejected);
+   }  // teardown
+
+   /***************************************
+    * VIEW
+    ***************************************/
+
+   // find, count and at search the buffer itself
+   void test_view_find()
+   {  // setup
+      std::string file = fileOf({ IntPair(2, 20), IntPair(4, 40), IntPair(6, 60) });
+      IntView view(file.data(), file.size());
+      bool thrown = false;
+      // exercise
+      auto it = view.find(4);
+      try
+      {
+         view.at(5);
+      }
+      catch (const std::out_of_range&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(view.size() == 3);
+      assertUnit(it != view.end() && it.key() == 4 && it.value() == 40);
+      assertUnit(view.find(5) == view.end());
+      assertUnit(view.count(6) == 1 && view.count(7) == 0);
+      assertUnit(view.at(2) == 20);
+      assertUnit(thrown);
+   }  // teardown
+
+   // bounds between, on and past the keys
+   void test_view_bounds()
+   {  // setup
+      std::string file = fileOf({ IntPair(2, 20), IntPair(4, 40), IntPair(6, 60) });
+      IntView view(file.data(), file.size());
+      // exercise and verify
+      assertUnit(view.lower_bound(1) == view.begin());
+      assertUnit(view.lower_bound(4).key() == 4);
+      assertUnit(view.upper_bound(4).key() == 6);
+      assertUnit(view.lower_bound(5).key() == 6);
+      assertUnit(view.upper_bound(6) == view.end());
+   }  // teardown
+
+   // in key order, the pairs read out of the buffer
+   void test_view_iterate()
+   {  // setup
+      IntMap m;
+      for (int i = 0; i < 100; i++)
+         m[(i * 7) % 100] = i;
+      std::stringstream out;
+      custom::serialize(m, out);
+      std::string file = out.str();
+      IntView view(file.data(), file.size());
+      int expect = 0;
+      bool inOrder = true;
+      // exercise
+      for (auto it = view.begin(); it != view.end(); ++it)
+         inOrder = inOrder && (*it).first == expect++ && (*it).second == m[(*it).first];
+      // verify
+      assertUnit(inOrder);
+      assertUnit(expect == 100);
+      assertUnit(view.end() - view.begin() == 100);
+   }  // teardown
+
+   /***************************************
+    * FILE
+    ***************************************/
+
+   // written to disk, mapped back in, searched and loaded
+   void test_mappedFile_roundTrip()
+   {  // setup
+      const char* path = "testSerialize.bin";
+      IntMap m;
+      for (int i = 0; i < 5000; i++)
+         m[i * 2] = -i;
+      {
+         std::ofstream out(path, std::ios::binary);
+         custom::serialize(m, out);
+      }
+      IntMap loaded;
+      // exercise
+      {
+         custom::mapped_file file(path);
+         IntView view(file.data(), file.size());
+         assertUnit(view.size() == 5000);
+         assertUnit(view.at(9998) == -4999);
+         custom::deserialize(file.data(), file.size(), loaded);
+      }
+      // verify
+      assertUnit(loaded.size() == 5000);
+      assertUnit(loaded.at(1234) == -617);
+      // teardown
+      std::remove(path);
+   }
+
+   // no such file
+   void test_mappedFile_missing()
+   {  // setup
+      bool thrown = false;
+      // exercise
+      try
+      {
+         custom::mapped_file file("no/such/file.bin");
+      }
+      catch (const std::runtime_error&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+   }  // teardown
+
+private:
+   // the file of an int map holding these pairs
+   static std::string fileOf(const std::initializer_list<IntPair>& il)
+   {
+      IntMap m(il);
+      std::stringstream out;
+      custom::serialize(m, out);
+      return out.str();
+   }
+
+   // the int map loader throws for this file
+   static bool rejected(const std::string& file)
+   {
+      IntMap m;
+      try
+      {
+         custom::deserialize(file.data(), file.size(), m);
+      }
+      catch (const std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+};
+
+#endif // DEBUG
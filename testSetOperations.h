@@ -0,0 +1,270 @@
+/***********************************************************************
+ * Header:
+ *    TEST SET OPERATIONS
+ * Summary:
+ *    Unit tests for the parallel union, intersection and difference,
+ *    and the parallel build and walk of a map they rest on
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "set_operations.h" // functions under test
+#include "map.h"            // the maps they work on
+#include "unitTest.h"       // unit test baseclass
+
+#include <algorithm>        // for std::set_union and friends, the reference
+#include <atomic>           // for std::atomic
+#include <functional>       // for std::greater
+#include <iterator>         // for std::back_inserter
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST SET OPERATIONS
+ * Unit tests for set_operations.h
+ ***********************************************/
+class TestSetOperations : public UnitTest
+{
+   using IntPair = custom::pair<int, int>;
+   using IntMap = custom::map<int, int>;
+   using IntBPlus = custom::map<int, int, std::less<int>, std::allocator<IntPair>, custom::bplus<16>>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Map
+      test_constructParallel_standard();
+      test_parallelForEach_map();
+
+      // Set operations
+      test_union_standard();
+      test_union_ties();
+      test_intersection_standard();
+      test_difference_standard();
+      test_empty_either();
+      test_bplus_all();
+      test_comparator_kept();
+      test_small_oneSlice();
+
+      report("SetOperations");
+   }
+
+   /***************************************
+    * MAP
+    ***************************************/
+
+   // sorted_unique on four threads builds what it builds on one
+   void test_constructParallel_standard()
+   {  // setup
+      std::vector<IntPair> pairs;
+      for (int i = 0; i < 20000; i++)
+         pairs.push_back(IntPair(i * 2, i));
+      // exercise
+      IntMap m(custom::sorted_unique, pairs.begin(), pairs.end(), custom::parallel_t{ 4 });
+      // verify
+      assertUnit(m.size() == 20000);
+      assertUnit(equal(m, pairs));
+   }  // teardown
+
+   // every pair visited once
+   void test_parallelForEach_map()
+   {  // setup
+      IntMap m = evens(20000);
+      std::atomic<long long> sum(0);
+      std::atomic<int> count(0);
+      // exercise
+      m.parallel_for_each([&](const IntPair& p)
+      {
+         sum += p.first;
+         count++;
+      }, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(count.load() == 20000);
+      assertUnit(sum.load() == 20000LL * 19999);
+   }  // teardown
+
+   /***************************************
+    * SET OPERATIONS
+    ***************************************/
+
+   // evens and multiples of three: what std::set_union gives
+   void test_union_standard()
+   {  // setup
+      IntMap a = evens(20000);
+      IntMap b = threes(15000);
+      // exercise
+      IntMap u = custom::parallel_union(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(equal(u, reference(a, b, custom::set_operation<IntMap>::UNION)));
+   }  // teardown
+
+   // a key in both takes the pair from a
+   void test_union_ties()
+   {  // setup
+      IntMap a = { IntPair(1, 10), IntPair(2, 20) };
+      IntMap b = { IntPair(2, 99), IntPair(3, 30) };
+      // exercise
+      IntMap u = custom::parallel_union(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(u.size() == 3);
+      assertUnit(u.at(2) == 20);
+      assertUnit(u.at(3) == 30);
+      assertUnit(a.size() == 2 && b.size() == 2);
+   }  // teardown
+
+   // multiples of six, with a's values
+   void test_intersection_standard()
+   {  // setup
+      IntMap a = evens(20000);
+      IntMap b = threes(15000);
+      // exercise
+      IntMap i = custom::parallel_intersection(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(equal(i, reference(a, b, custom::set_operation<IntMap>::INTERSECTION)));
+      assertUnit(i.at(12) == 6);
+   }  // teardown
+
+   // evens that are not multiples of three
+   void test_difference_standard()
+   {  // setup
+      IntMap a = evens(20000);
+      IntMap b = threes(15000);
+      // exercise
+      IntMap d = custom::parallel_difference(a, b, custom::parallel_t{ 4 });
+      IntMap e = custom::parallel_difference(b, a, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(equal(d, reference(a, b, custom::set_operation<IntMap>::DIFFERENCE)));
+      assertUnit(equal(e, reference(b, a, custom::set_operation<IntMap>::DIFFERENCE)));
+   }  // teardown
+
+   // an empty map on either side
+   void test_empty_either()
+   {  // setup
+      IntMap a = evens(10000);
+      IntMap empty;
+      // exercise
+      IntMap u1 = custom::parallel_union(a, empty, custom::parallel_t{ 4 });
+      IntMap u2 = custom::parallel_union(empty, a, custom::parallel_t{ 4 });
+      IntMap i = custom::parallel_intersection(a, empty, custom::parallel_t{ 4 });
+      IntMap d1 = custom::parallel_difference(a, empty, custom::parallel_t{ 4 });
+      IntMap d2 = custom::parallel_difference(empty, a, custom::parallel_t{ 4 });
+      IntMap none = custom::parallel_union(empty, empty);
+      // verify
+      assertUnit(u1.size() == 10000 && u2.size() == 10000);
+      assertUnit(i.empty());
+      assertUnit(d1.size() == 10000);
+      assertUnit(d2.empty());
+      assertUnit(none.empty());
+   }  // teardown
+
+   // the same three on a B+tree map
+   void test_bplus_all()
+   {  // setup
+      IntBPlus a;
+      IntBPlus b;
+      for (int i = 0; i < 20000; i++)
+         a[i * 2] = i;
+      for (int i = 0; i < 15000; i++)
+         b[i * 3] = i;
+      // exercise
+      IntBPlus u = custom::parallel_union(a, b, custom::parallel_t{ 4 });
+      IntBPlus i = custom::parallel_intersection(a, b, custom::parallel_t{ 4 });
+      IntBPlus d = custom::parallel_difference(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(equal(u, reference(a, b, custom::set_operation<IntBPlus>::UNION)));
+      assertUnit(equal(i, reference(a, b, custom::set_operation<IntBPlus>::INTERSECTION)));
+      assertUnit(equal(d, reference(a, b, custom::set_operation<IntBPlus>::DIFFERENCE)));
+   }  // teardown
+
+   // the result orders its keys the way a does
+   void test_comparator_kept()
+   {  // setup
+      custom::map<int, int, std::greater<int>> a;
+      custom::map<int, int, std::greater<int>> b;
+      for (int i = 0; i < 10000; i++)
+      {
+         a[i] = i;
+         b[i + 5000] = i;
+      }
+      // exercise
+      auto u = custom::parallel_union(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(u.size() == 15000);
+      assertUnit((*u.begin()).first == 14999);
+      u[20000] = 0;
+      assertUnit((*u.begin()).first == 20000);
+   }  // teardown
+
+   // too small to be worth a thread: one slice, same answer
+   void test_small_oneSlice()
+   {  // setup
+      custom::map<std::string, int> a = { {"ant", 1}, {"bee", 2}, {"cat", 3} };
+      custom::map<std::string, int> b = { {"bee", 20}, {"dog", 40} };
+      // exercise
+      auto i = custom::parallel_intersection(a, b, custom::parallel_t{ 4 });
+      auto d = custom::parallel_difference(a, b, custom::parallel_t{ 4 });
+      // verify
+      assertUnit(i.size() == 1 && i.at("bee") == 2);
+      assertUnit(d.size() == 2 && d.find("bee") == d.end());
+   }  // teardown
+
+private:
+   // i * 2 => i for i in [0, n)
+   static IntMap evens(int n)
+   {
+      std::vector<IntPair> pairs;
+      for (int i = 0; i < n; i++)
+         pairs.push_back(IntPair(i * 2, i));
+      return IntMap(custom::sorted_unique, pairs.begin(), pairs.end());
+   }
+
+   // i * 3 => i for i in [0, n)
+   static IntMap threes(int n)
+   {
+      std::vector<IntPair> pairs;
+      for (int i = 0; i < n; i++)
+         pairs.push_back(IntPair(i * 3, i));
+      return IntMap(custom::sorted_unique, pairs.begin(), pairs.end());
+   }
+
+   // the same operation done by the standard library, one thread
+   template <class M>
+   static std::vector<IntPair> reference(M& a, M& b, typename custom::set_operation<M>::kind op)
+   {
+      std::vector<IntPair> va(a.begin(), a.end());
+      std::vector<IntPair> vb(b.begin(), b.end());
+      std::vector<IntPair> out;
+      auto less = [](const IntPair& lhs, const IntPair& rhs) { return lhs.first < rhs.first; };
+      if (op == custom::set_operation<M>::UNION)
+         std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(out), less);
+      else if (op == custom::set_operation<M>::INTERSECTION)
+         std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(out), less);
+      else
+         std::set_difference(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(out), less);
+      return out;
+   }
+
+   // the map holds exactly these pairs, in this order
+   template <class M>
+   static bool equal(M& m, const std::vector<IntPair>& pairs)
+   {
+      if (m.size() != pairs.size())
+         return false;
+      auto it = m.begin();
+      for (const IntPair& p : pairs)
+      {
+         if ((*it).first != p.first || (*it).second != p.second)
+            return false;
+         ++it;
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,334 @@
+/***********************************************************************
+ * Header:
+ *    TEST SHARDED MAP
+ * Summary:
+ *    Unit tests for the hash-sharded map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "sharded_map.h"    // class under test
+#include "unitTest.h"       // unit test baseclass
+
+#include <atomic>           // for std::atomic
+#include <stdexcept>        // for std::out_of_range
+#include <string>
+#include <thread>           // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST SHARDED MAP
+ * Unit tests for the sharded_map class
+ ***********************************************/
+class TestShardedMap : public UnitTest
+{
+   using IntMap = custom::sharded_map<int, int, 8>;
+   using IntPair = custom::pair<int, int>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_shard_spread();
+
+      // One key
+      test_insert_standard();
+      test_find_standard();
+      test_at_missing();
+      test_insertOrAssign_standard();
+      test_erase_standard();
+      test_clear_standard();
+
+      // Batches
+      test_findMany_order();
+      test_insertMany_duplicates();
+      test_eraseMany_standard();
+
+      // In order
+      test_forEachSorted_standard();
+      test_visitRange_standard();
+
+      // Threads
+      test_threads_disjointWriters();
+
+      report("ShardedMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor: every shard empty
+   void test_construct_default()
+   {  // setup
+      // exercise
+      IntMap sm;
+      // verify
+      assertUnit(sm.empty());
+      assertUnit(sm.size() == 0);
+      assertUnit(IntMap::shard_count() == 8);
+      for (size_t i = 0; i < 8; i++)
+         assertUnit(sm.shards[i].m.empty());
+   }  // teardown
+
+   // sequential keys land in every shard, and each where shard_index says
+   void test_shard_spread()
+   {  // setup
+      IntMap sm;
+      // exercise
+      for (int i = 0; i < 800; i++)
+         sm.insert(IntPair(i, i));
+      // verify
+      for (size_t i = 0; i < 8; i++)
+      {
+         assertUnit(sm.shards[i].m.size() > 50);
+         assertUnit(sm.shards[i].m.size() < 150);
+      }
+      assertUnit(sm.shards[sm.shard_index(42)].m.count(42) == 1);
+      assertUnit(sm.size() == 800);
+   }  // teardown
+
+   /***************************************
+    * ONE KEY
+    ***************************************/
+
+   // the second insert of a key changes nothing
+   void test_insert_standard()
+   {  // setup
+      IntMap sm;
+      // exercise
+      bool inserted = sm.insert(IntPair(7, 70));
+      bool again = sm.insert(IntPair(7, 71));
+      // verify
+      assertUnit(inserted);
+      assertUnit(!again);
+      assertUnit(sm.size() == 1);
+      assertUnit(sm.at(7) == 70);
+   }  // teardown
+
+   // a lookup returns a copy of the value, or nothing
+   void test_find_standard()
+   {  // setup
+      IntMap sm;
+      sm.insert(IntPair(1, 10));
+      sm.insert(IntPair(2, 20));
+      // exercise
+      auto v2 = sm.find(2);
+      auto v3 = sm.find(3);
+      // verify
+      assertUnit(v2.has_value() && *v2 == 20);
+      assertUnit(!v3.has_value());
+      assertUnit(sm.contains(1));
+      assertUnit(!sm.contains(3));
+   }  // teardown
+
+   // at() throws the way map's does
+   void test_at_missing()
+   {  // setup
+      custom::sharded_map<std::string, int> sm;
+      sm.insert(custom::pair<std::string, int>("a", 1));
+      bool thrown = false;
+      // exercise
+      try
+      {
+         sm.at("b");
+      }
+      catch (const std::out_of_range& error)
+      {
+         thrown = std::string(error.what()) == "invalid map<K, T> key";
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(sm.at("a") == 1);
+   }  // teardown
+
+   // assign when present, insert when not
+   void test_insertOrAssign_standard()
+   {  // setup
+      IntMap sm;
+      sm.insert(IntPair(1, 10));
+      // exercise
+      bool inserted1 = sm.insert_or_assign(1, 11);
+      bool inserted2 = sm.insert_or_assign(2, 20);
+      // verify
+      assertUnit(!inserted1);
+      assertUnit(inserted2);
+      assertUnit(sm.at(1) == 11);
+      assertUnit(sm.at(2) == 20);
+   }  // teardown
+
+   // erase reports whether the key was there
+   void test_erase_standard()
+   {  // setup
+      IntMap sm;
+      sm.insert(IntPair(1, 10));
+      sm.insert(IntPair(2, 20));
+      // exercise
+      size_t erased = sm.erase(1);
+      size_t missing = sm.erase(1);
+      // verify
+      assertUnit(erased == 1);
+      assertUnit(missing == 0);
+      assertUnit(sm.size() == 1);
+      assertUnit(sm.contains(2));
+   }  // teardown
+
+   // clear empties every shard
+   void test_clear_standard()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 100; i++)
+         sm.insert(IntPair(i, i));
+      // exercise
+      sm.clear();
+      // verify
+      assertUnit(sm.empty());
+      for (size_t i = 0; i < 8; i++)
+         assertUnit(sm.shards[i].m.empty());
+   }  // teardown
+
+   /***************************************
+    * BATCHES
+    ***************************************/
+
+   // the answers come back in the order of the keys, not of the shards
+   void test_findMany_order()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 100; i += 2)
+         sm.insert(IntPair(i, i * 10));
+      std::vector<int> keys = { 50, 3, 98, 0, 51, 50 };
+      // exercise
+      std::vector<std::optional<int>> values = sm.find_many(keys.begin(), keys.end());
+      // verify
+      assertUnit(values.size() == 6);
+      assertUnit(values[0].has_value() && *values[0] == 500);
+      assertUnit(!values[1].has_value());
+      assertUnit(values[2].has_value() && *values[2] == 980);
+      assertUnit(values[3].has_value() && *values[3] == 0);
+      assertUnit(!values[4].has_value());
+      assertUnit(values[5].has_value() && *values[5] == 500);
+   }  // teardown
+
+   // a key given twice keeps the first, and one already there is kept
+   void test_insertMany_duplicates()
+   {  // setup
+      IntMap sm;
+      sm.insert(IntPair(5, 50));
+      std::vector<IntPair> pairs = { {1, 10}, {5, 51}, {2, 20}, {1, 11}, {3, 30} };
+      // exercise
+      size_t inserted = sm.insert_many(pairs.begin(), pairs.end());
+      // verify
+      assertUnit(inserted == 3);
+      assertUnit(sm.size() == 4);
+      assertUnit(sm.at(1) == 10);
+      assertUnit(sm.at(5) == 50);
+   }  // teardown
+
+   // only the keys that were there count
+   void test_eraseMany_standard()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 20; i++)
+         sm.insert(IntPair(i, i));
+      std::vector<int> keys = { 3, 19, 25, 3, 0 };
+      // exercise
+      size_t erased = sm.erase_many(keys.begin(), keys.end());
+      // verify
+      assertUnit(erased == 3);
+      assertUnit(sm.size() == 17);
+      assertUnit(!sm.contains(3) && !sm.contains(19) && !sm.contains(0));
+   }  // teardown
+
+   /***************************************
+    * IN ORDER
+    ***************************************/
+
+   // the shards merge back into key order
+   void test_forEachSorted_standard()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 200; i++)
+         sm.insert(IntPair((i * 37) % 200, i));
+      std::vector<int> keys;
+      // exercise
+      sm.for_each_sorted([&keys](const IntPair& p) { keys.push_back(p.first); });
+      // verify
+      assertUnit(keys.size() == 200);
+      bool sorted = true;
+      for (int i = 0; i < (int)keys.size(); i++)
+         sorted = sorted && keys[i] == i;
+      assertUnit(sorted);
+   }  // teardown
+
+   // [lo, hi): from the lower bound in each shard, stopping at hi
+   void test_visitRange_standard()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 100; i++)
+         sm.insert(IntPair(i * 2, i));
+      std::vector<int> keys;
+      // exercise
+      sm.visit_range(11, 21, [&keys](const IntPair& p) { keys.push_back(p.first); });
+      // verify
+      assertUnit(keys == std::vector<int>({ 12, 14, 16, 18, 20 }));
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // four writers with their own keys, batches and single keys mixed, and
+   // a reader walking in order: nothing lost, and every walk sorted
+   void test_threads_disjointWriters()
+   {  // setup
+      IntMap sm;
+      std::atomic<int> unsorted(0);
+      std::atomic<bool> done(false);
+      std::thread reader([&]()
+      {
+         while (!done.load())
+         {
+            int prev = -1;
+            sm.for_each_sorted([&](const IntPair& p)
+            {
+               if (p.first <= prev)
+                  unsorted++;
+               prev = p.first;
+            });
+         }
+      });
+      std::vector<std::thread> writers;
+      // exercise
+      for (int t = 0; t < 4; t++)
+         writers.emplace_back([&sm, t]()
+         {
+            std::vector<IntPair> batch;
+            for (int i = 0; i < 250; i++)
+            {
+               if (i % 2)
+                  sm.insert(IntPair(t * 1000 + i, t));
+               else
+                  batch.push_back(IntPair(t * 1000 + i, t));
+            }
+            sm.insert_many(batch.begin(), batch.end());
+         });
+      for (std::thread& t : writers)
+         t.join();
+      done.store(true);
+      reader.join();
+      // verify
+      assertUnit(unsorted.load() == 0);
+      assertUnit(sm.size() == 1000);
+      assertUnit(sm.at(3249) == 3);
+   }  // teardown
+};
+
+#endif // DEBUG
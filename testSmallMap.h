@@ -0,0 +1,472 @@
+/***********************************************************************
+ * Header:
+ *    TEST SMALL MAP
+ * Summary:
+ *    Unit tests for the map with inline storage for its first pairs
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "small_map.h"  // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // spy is a mock class to monitor the class under test
+#include "pool.h"       // to see what the map allocates
+
+#include <stdexcept>    // for std::out_of_range
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST SMALL MAP
+ * Unit tests for the small_map class
+ ***********************************************/
+class TestSmallMap : public UnitTest
+{
+   using IntMap = custom::small_map<int, int, 4>;
+   using IntPair = custom::pair<int, int>;
+   using SpyMap = custom::small_map<Spy, Spy, 4>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_initializerList();
+      test_constructCopy_inline();
+      test_constructCopy_spilled();
+      test_constructMove_inline();
+      test_destruct_spy();
+
+      // Insert
+      test_insert_sorted();
+      test_insert_duplicate();
+      test_insert_spill();
+      test_insert_range();
+      test_squareBracket_standard();
+      test_insertOrAssign_standard();
+      test_tryEmplace_noAllocation();
+
+      // Access
+      test_find_inline();
+      test_find_spilled();
+      test_at_missing();
+      test_bounds_inline();
+
+      // Iterator
+      test_iterator_inline();
+      test_iterator_decrementBegin();
+      test_iterator_spilled();
+
+      // Remove
+      test_erase_inline();
+      test_eraseIterator_inline();
+      test_erase_spilled();
+      test_clear_backInline();
+
+      report("SmallMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor: empty and inline
+   void test_construct_default()
+   {  // setup
+      // exercise
+      IntMap sm;
+      // verify
+      assertUnit(sm.empty());
+      assertUnit(sm.size() == 0);
+      assertUnit(sm.is_inline());
+      assertUnit(sm.numInline == 0);
+      assertUnit(sm.begin() == sm.end());
+      assertUnit(IntMap::inline_capacity == 4);
+   }  // teardown
+
+   // initializer list: sorted into the array
+   void test_construct_initializerList()
+   {  // setup
+      // exercise
+      IntMap sm{ IntPair(30, 3), IntPair(10, 1), IntPair(20, 2) };
+      // verify
+      assertUnit(sm.is_inline());
+      assertUnit(sm.size() == 3);
+      assertUnit(sm.slots()[0].first == 10);
+      assertUnit(sm.slots()[1].first == 20);
+      assertUnit(sm.slots()[2].first == 30);
+   }  // teardown
+
+   // copy an inline map: the pairs are copied slot by slot
+   void test_constructCopy_inline()
+   {  // setup
+      IntMap smSrc{ IntPair(1, 10), IntPair(2, 20) };
+      // exercise
+      IntMap smDest(smSrc);
+      // verify
+      assertUnit(smDest.is_inline());
+      assertUnit(smDest.size() == 2);
+      assertUnit(smDest.at(2) == 20);
+      smDest[2] = 99;
+      assertUnit(smSrc.at(2) == 20);
+   }  // teardown
+
+   // copy a spilled map: the map is copied
+   void test_constructCopy_spilled()
+   {  // setup
+      IntMap smSrc;
+      for (int i = 0; i < 10; i++)
+         smSrc[i] = i * i;
+      // exercise
+      IntMap smDest(smSrc);
+      // verify
+      assertUnit(!smDest.is_inline());
+      assertUnit(smDest.size() == 10);
+      assertUnit(smDest.at(9) == 81);
+      assertUnit(smSrc.size() == 10);
+   }  // teardown
+
+   // move an inline map: the pairs move, the source is left empty
+   void test_constructMove_inline()
+   {  // setup
+      custom::small_map<std::string, int, 4> smSrc;
+      smSrc["b"] = 2;
+      smSrc["a"] = 1;
+      // exercise
+      custom::small_map<std::string, int, 4> smDest(std::move(smSrc));
+      // verify
+      assertUnit(smDest.size() == 2);
+      assertUnit(smDest.at("a") == 1);
+      assertUnit(smDest.at("b") == 2);
+      assertUnit(smSrc.empty());
+      assertUnit(smSrc.is_inline());
+   }  // teardown
+
+   // every pair made is destroyed, inline or spilled
+   void test_destruct_spy()
+   {  // setup
+      Spy::reset();
+      {
+         SpyMap smInline;
+         smInline[Spy(1)] = Spy(10);
+         smInline[Spy(2)] = Spy(20);
+         SpyMap smSpilled;
+         for (int i = 0; i < 6; i++)
+            smSpilled[Spy(i)] = Spy(i);
+      }  // exercise
+      // verify
+      assertUnit(Spy::numDestructor() == Spy::numDefault() + Spy::numNondefault() +
+                                         Spy::numCopy() + Spy::numCopyMove());
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // inserts keep the array sorted
+   void test_insert_sorted()
+   {  // setup
+      IntMap sm;
+      // exercise
+      sm.insert(IntPair(3, 30));
+      sm.insert(IntPair(1, 10));
+      sm.insert(IntPair(4, 40));
+      sm.insert(IntPair(2, 20));
+      // verify
+      assertUnit(sm.is_inline());
+      assertUnit(sm.size() == 4);
+      for (int i = 0; i < 4; i++)
+      {
+         assertUnit(sm.slots()[i].first == i + 1);
+         assertUnit(sm.slots()[i].second == (i + 1) * 10);
+      }
+   }  // teardown
+
+   // a key already there keeps its value
+   void test_insert_duplicate()
+   {  // setup
+      IntMap sm{ IntPair(1, 10) };
+      // exercise
+      custom::pair<IntMap::iterator, bool> result = sm.insert(IntPair(1, 99));
+      // verify
+      assertUnit(result.second == false);
+      assertUnit((*result.first).second == 10);
+      assertUnit(sm.size() == 1);
+   }  // teardown
+
+   // the pair past N moves them all into the map
+   void test_insert_spill()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(2, 20), IntPair(4, 40), IntPair(5, 50) };
+      assertUnit(sm.is_inline());
+      // exercise
+      custom::pair<IntMap::iterator, bool> result = sm.insert(IntPair(3, 30));
+      // verify
+      assertUnit(result.second);
+      assertUnit((*result.first).first == 3);
+      assertUnit(!sm.is_inline());
+      assertUnit(sm.numInline == 0);
+      assertUnit(sm.size() == 5);
+      assertUnit(sm.big.size() == 5);
+      int i = 1;
+      for (IntMap::iterator it = sm.begin(); it != sm.end(); ++it, ++i)
+         assertUnit((*it).first == i && (*it).second == i * 10);
+      assertUnit(i == 6);
+   }  // teardown
+
+   // a range: one at a time, then the rest in bulk
+   void test_insert_range()
+   {  // setup
+      std::vector<IntPair> v;
+      for (int i = 20; i > 0; i--)
+         v.push_back(IntPair(i, -i));
+      // exercise
+      IntMap sm(v.begin(), v.end());
+      // verify
+      assertUnit(!sm.is_inline());
+      assertUnit(sm.size() == 20);
+      assertUnit((*sm.begin()).first == 1);
+      assertUnit((*sm.rbegin()).first == 20);
+      assertUnit(sm.at(7) == -7);
+   }  // teardown
+
+   // subscript: insert when missing, modify in place
+   void test_squareBracket_standard()
+   {  // setup
+      IntMap sm;
+      // exercise
+      sm[5] = 50;
+      sm[5] += 1;
+      int missing = sm[6];
+      // verify
+      assertUnit(sm.size() == 2);
+      assertUnit(sm.at(5) == 51);
+      assertUnit(missing == 0);
+   }  // teardown
+
+   // insert or assign: inserts when missing, assigns otherwise
+   void test_insertOrAssign_standard()
+   {  // setup
+      IntMap sm{ IntPair(1, 10) };
+      // exercise
+      custom::pair<IntMap::iterator, bool> assigned = sm.insert_or_assign(1, 11);
+      custom::pair<IntMap::iterator, bool> inserted = sm.insert_or_assign(2, 20);
+      // verify
+      assertUnit(!assigned.second);
+      assertUnit(inserted.second);
+      assertUnit(sm.at(1) == 11);
+      assertUnit(sm.at(2) == 20);
+   }  // teardown
+
+   // inline, no node is allocated
+   void test_tryEmplace_noAllocation()
+   {  // setup
+      using Pair = custom::pair<int, int>;
+      custom::small_map<int, int, 4, std::less<int>, custom::node_pool<Pair>> sm;
+      // exercise
+      sm.try_emplace(2, 20);
+      sm.try_emplace(1, 10);
+      sm.try_emplace(2, 99);
+      // verify
+      assertUnit(sm.get_allocator().numChunks() == 0);
+      assertUnit(sm.size() == 2);
+      assertUnit(sm.at(2) == 20);
+      for (int i = 3; i < 6; i++)
+         sm.try_emplace(i, i);
+      assertUnit(sm.get_allocator().numChunks() == 1);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // find in the array
+   void test_find_inline()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(3, 30) };
+      // exercise
+      IntMap::iterator itHit = sm.find(3);
+      IntMap::iterator itMiss = sm.find(2);
+      // verify
+      assertUnit(itHit != sm.end());
+      assertUnit((*itHit).second == 30);
+      assertUnit(itMiss == sm.end());
+      assertUnit(sm.count(1) == 1);
+      assertUnit(sm.count(2) == 0);
+   }  // teardown
+
+   // find in the map
+   void test_find_spilled()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 10; i += 2)
+         sm[i] = i;
+      // exercise
+      IntMap::iterator itHit = sm.find(8);
+      IntMap::iterator itMiss = sm.find(7);
+      // verify
+      assertUnit(!sm.is_inline());
+      assertUnit(itHit != sm.end());
+      assertUnit((*itHit).second == 8);
+      assertUnit(itMiss == sm.end());
+      assertUnit(sm.count(8) == 1);
+   }  // teardown
+
+   // at throws for a missing key, inline or not
+   void test_at_missing()
+   {  // setup
+      IntMap sm{ IntPair(1, 10) };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         sm.at(2);
+      }
+      catch (const std::out_of_range&)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+   }  // teardown
+
+   // the bounds in the array
+   void test_bounds_inline()
+   {  // setup
+      IntMap sm{ IntPair(10, 1), IntPair(20, 2), IntPair(30, 3) };
+      // exercise
+      IntMap::iterator itLower = sm.lower_bound(20);
+      IntMap::iterator itUpper = sm.upper_bound(20);
+      IntMap::iterator itBetween = sm.lower_bound(25);
+      // verify
+      assertUnit((*itLower).first == 20);
+      assertUnit((*itUpper).first == 30);
+      assertUnit((*itBetween).first == 30);
+      assertUnit(sm.upper_bound(30) == sm.end());
+      assertUnit(sm.equal_range(20).first == itLower);
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // walk the array both ways
+   void test_iterator_inline()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(2, 20), IntPair(3, 30) };
+      // exercise
+      IntMap::iterator it = sm.begin();
+      ++it;
+      IntMap::iterator itPost = it++;
+      // verify
+      assertUnit((*itPost).first == 2);
+      assertUnit((*it).first == 3);
+      --it;
+      assertUnit((*it).first == 2);
+      assertUnit((*sm.rbegin()).first == 3);
+      ++it;
+      ++it;
+      assertUnit(it == sm.end());
+   }  // teardown
+
+   // back from the first pair is the end, as in map
+   void test_iterator_decrementBegin()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(2, 20) };
+      IntMap::iterator it = sm.begin();
+      // exercise
+      --it;
+      // verify
+      assertUnit(it == sm.end());
+   }  // teardown
+
+   // walk the map both ways
+   void test_iterator_spilled()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 8; i++)
+         sm[i] = i;
+      // exercise
+      IntMap::iterator it = sm.rbegin();
+      int i = 7;
+      for (; i > 0; i--)
+         --it;
+      // verify
+      assertUnit((*it).first == 0);
+      ++it;
+      assertUnit((*it).first == 1);
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // erase by key shifts the rest of the array down
+   void test_erase_inline()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(2, 20), IntPair(3, 30) };
+      // exercise
+      size_t erased = sm.erase(2);
+      size_t missing = sm.erase(2);
+      // verify
+      assertUnit(erased == 1);
+      assertUnit(missing == 0);
+      assertUnit(sm.size() == 2);
+      assertUnit(sm.slots()[0].first == 1);
+      assertUnit(sm.slots()[1].first == 3);
+   }  // teardown
+
+   // erase by iterator returns the pair after it
+   void test_eraseIterator_inline()
+   {  // setup
+      IntMap sm{ IntPair(1, 10), IntPair(2, 20), IntPair(3, 30) };
+      // exercise
+      IntMap::iterator it = sm.erase(sm.find(1));
+      // verify
+      assertUnit((*it).first == 2);
+      assertUnit(sm.size() == 2);
+      assertUnit(sm.erase(sm.end()) == sm.end());
+   }  // teardown
+
+   // once spilled, erasing leaves the pairs in the map
+   void test_erase_spilled()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 6; i++)
+         sm[i] = i;
+      // exercise
+      for (int i = 0; i < 5; i++)
+         sm.erase(i);
+      // verify
+      assertUnit(!sm.is_inline());
+      assertUnit(sm.size() == 1);
+      assertUnit((*sm.begin()).first == 5);
+      IntMap::iterator it = sm.erase(sm.begin());
+      assertUnit(it == sm.end());
+      assertUnit(sm.empty());
+   }  // teardown
+
+   // clear goes back to the inline array
+   void test_clear_backInline()
+   {  // setup
+      IntMap sm;
+      for (int i = 0; i < 6; i++)
+         sm[i] = i;
+      // exercise
+      sm.clear();
+      // verify
+      assertUnit(sm.empty());
+      assertUnit(sm.is_inline());
+      assertUnit(sm.big.empty());
+      sm[1] = 1;
+      assertUnit(sm.numInline == 1);
+   }  // teardown
+};
+
+#endif // DEBUG
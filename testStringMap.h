@@ -0,0 +1,437 @@
+/***********************************************************************
+ * Header:
+ *    TEST STRING MAP
+ * Summary:
+ *    Unit tests for the front-coded string map
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "string_map.h"     // class under test
+#include "map.h"            // to convert from
+#include "unitTest.h"       // unit test baseclass
+
+#include <cstdint>          // for std::uint32_t
+#include <cstdlib>          // for std::rand
+#include <map>              // for std::map, the reference
+#include <stdexcept>        // for std::out_of_range
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST STRING MAP
+ * Unit tests for the string_map class
+ ***********************************************/
+class TestStringMap : public UnitTest
+{
+   using UrlMap = custom::string_map<std::uint32_t>;
+   using SmallMap = custom::string_map<int, std::allocator<custom::pair<std::string, int>>, 4>;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_sorted();
+      test_construct_unsorted();
+      test_construct_fromMap();
+
+      // Coding
+      test_coding_sharedPrefix();
+      test_coding_bytesUnsigned();
+
+      // Find
+      test_find_standard();
+      test_find_prefixes();
+      test_at_missing();
+      test_bounds_standard();
+      test_visitPrefix_standard();
+
+      // Insert
+      test_insert_splits();
+      test_insertOrAssign_standard();
+
+      // Remove
+      test_erase_joins();
+      test_eraseIterator_next();
+
+      // Iterate
+      test_iterate_backward();
+
+      // Against std::map
+      test_random_reference();
+
+      report("StringMap");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor: no blocks
+   void test_construct_default()
+   {  // setup
+      // exercise
+      UrlMap m;
+      // verify
+      assertUnit(m.empty());
+      assertUnit(m.size() == 0);
+      assertUnit(m.blocks.empty());
+      assertUnit(m.begin() == m.end());
+   }  // teardown
+
+   // sorted input fills whole blocks, in order, with no searching
+   void test_construct_sorted()
+   {  // setup
+      std::vector<custom::pair<std::string, int>> pairs;
+      for (int i = 0; i < 10; i++)
+         pairs.push_back(custom::pair<std::string, int>(key(i), i));
+      // exercise
+      SmallMap m(pairs.begin(), pairs.end());
+      // verify
+      assertUnit(m.size() == 10);
+      assertUnit(m.blocks.size() == 3);
+      assertUnit(m.firsts[1] == key(4));
+      assertUnit(matches(m, pairs));
+   }  // teardown
+
+   // any other order goes in a pair at a time
+   void test_construct_unsorted()
+   {  // setup
+      // exercise
+      SmallMap m = { {"b", 2}, {"a", 1}, {"c", 3}, {"a", 9} };
+      // verify
+      assertUnit(m.size() == 3);
+      assertUnit(m.at("a") == 1);
+      assertUnit((*m.begin()).first == "a");
+   }  // teardown
+
+   // the same pairs as a map holds
+   void test_construct_fromMap()
+   {  // setup
+      custom::map<std::string, std::uint32_t> source;
+      for (int i = 0; i < 200; i++)
+         source[key(i)] = i;
+      // exercise
+      UrlMap m(source);
+      // verify
+      assertUnit(m.size() == 200);
+      assertUnit(m.at(key(123)) == 123);
+      assertUnit(m.blocks.size() == 7);
+   }  // teardown
+
+   /***************************************
+    * CODING
+    ***************************************/
+
+   // a long common prefix is stored once a block, not once a key
+   void test_coding_sharedPrefix()
+   {  // setup
+      const std::string prefix = "https://www.example.com/catalog/products/item?id=";
+      UrlMap m;
+      size_t keyBytes = 0;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+      {
+         std::string url = prefix + std::to_string(100000 + i);
+         keyBytes += url.size();
+         m[url] = i;
+      }
+      // verify
+      size_t stored = 0;
+      for (size_t b = 0; b < m.blocks.size(); b++)
+         stored += m.firsts[b].size() + m.blocks[b].suffixes.size();
+      assertUnit(m.size() == 1000);
+      assertUnit(stored * 5 < keyBytes);
+      assertUnit(m.at(prefix + "100500") == 500);
+   }  // teardown
+
+   // bytes order as unsigned char, as std::string does
+   void test_coding_bytesUnsigned()
+   {  // setup
+      SmallMap m;
+      std::string high = "a\xe9";
+      // exercise
+      m[high] = 2;
+      m["a~"] = 1;
+      m["a"] = 0;
+      m[std::string("a\x00z", 3)] = 3;
+      // verify
+      std::vector<std::string> keys;
+      for (auto it = m.begin(); it != m.end(); ++it)
+         keys.push_back((*it).first);
+      assertUnit(keys == std::vector<std::string>({ "a", std::string("a\x00z", 3), "a~", high }));
+   }  // teardown
+
+   /***************************************
+    * FIND
+    ***************************************/
+
+   // found, or the end
+   void test_find_standard()
+   {  // setup
+      SmallMap m = sorted(20);
+      // exercise
+      auto it = m.find(key(13));
+      auto itMissing = m.find("zzz");
+      // verify
+      assertUnit(it != m.end());
+      assertUnit((*it).first == key(13));
+      assertUnit((*it).second == 13);
+      assertUnit(itMissing == m.end());
+      assertUnit(m.count(key(0)) == 1 && m.count("x") == 0);
+      ++it;
+      assertUnit((*it).first == key(14));
+   }  // teardown
+
+   // a key that is the start of another is a key of its own
+   void test_find_prefixes()
+   {  // setup
+      SmallMap m = { {"", 0}, {"a", 1}, {"ab", 2}, {"abc", 3}, {"abd", 4}, {"b", 5} };
+      // exercise and verify
+      assertUnit(m.at("") == 0);
+      assertUnit(m.at("ab") == 2);
+      assertUnit(m.at("abd") == 4);
+      assertUnit(m.find("abcd") == m.end());
+      assertUnit(m.find("aa") == m.end());
+      assertUnit(m.count("abc") == 1);
+   }  // teardown
+
+   // at() throws the way map's does
+   void test_at_missing()
+   {  // setup
+      UrlMap m = { {"a", 1} };
+      bool thrown = false;
+      // exercise
+      try
+      {
+         m.at("b");
+      }
+      catch (const std::out_of_range& error)
+      {
+         thrown = std::string(error.what()) == "invalid map<K, T> key";
+      }
+      // verify
+      assertUnit(thrown);
+   }  // teardown
+
+   // bounds between keys, on them, before all and after all
+   void test_bounds_standard()
+   {  // setup
+      SmallMap m = { {"apple", 1}, {"apply", 2}, {"banana", 3}, {"band", 4}, {"bandana", 5} };
+      // exercise and verify
+      assertUnit((*m.lower_bound("a")).first == "apple");
+      assertUnit((*m.lower_bound("applf")).first == "apply");
+      assertUnit((*m.lower_bound("band")).first == "band");
+      assertUnit((*m.upper_bound("band")).first == "bandana");
+      assertUnit((*m.lower_bound("banda")).first == "bandana");
+      assertUnit(m.lower_bound("c") == m.end());
+      assertUnit(m.upper_bound("bandana") == m.end());
+   }  // teardown
+
+   // every key with the prefix, and nothing else
+   void test_visitPrefix_standard()
+   {  // setup
+      SmallMap m = { {"/a/x", 1}, {"/b", 2}, {"/b/c", 3}, {"/b/d/e", 4}, {"/bb", 5}, {"/c", 6} };
+      std::vector<int> values;
+      // exercise
+      m.visit_prefix("/b/", [&values](const std::string&, const int& v)
+      {
+         values.push_back(v);
+      });
+      // verify
+      assertUnit(values == std::vector<int>({ 3, 4 }));
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // a full block splits in two, and everything stays in order
+   void test_insert_splits()
+   {  // setup
+      SmallMap m;
+      // exercise
+      for (int i = 0; i < 10; i++)
+         assertUnit(m.insert(custom::pair<std::string, int>(key(9 - i), i)).second);
+      bool again = m.insert(custom::pair<std::string, int>(key(3), 99)).second;
+      // verify
+      assertUnit(!again);
+      assertUnit(m.size() == 10);
+      assertUnit(m.blocks.size() >= 3);
+      bool blocksOk = true;
+      for (size_t b = 0; b < m.blocks.size(); b++)
+         blocksOk = blocksOk && m.blocks[b].values.size() <= 4 && !m.blocks[b].values.empty();
+      assertUnit(blocksOk);
+      assertUnit(m.at(key(3)) == 6);
+   }  // teardown
+
+   // assign when present, insert when not
+   void test_insertOrAssign_standard()
+   {  // setup
+      SmallMap m = { {"a", 1} };
+      // exercise
+      bool inserted1 = m.insert_or_assign("a", 10).second;
+      bool inserted2 = m.insert_or_assign("b", 20).second;
+      // verify
+      assertUnit(!inserted1);
+      assertUnit(inserted2);
+      assertUnit(m.at("a") == 10 && m.at("b") == 20);
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // emptied blocks go, and nearly empty ones join a neighbor
+   void test_erase_joins()
+   {  // setup
+      SmallMap m = sorted(16);
+      // exercise
+      for (int i = 0; i < 16; i++)
+         if (i % 4 != 1)
+            assertUnit(m.erase(key(i)) == 1);
+      size_t missing = m.erase(key(0));
+      // verify
+      assertUnit(missing == 0);
+      assertUnit(m.size() == 4);
+      assertUnit(m.blocks.size() < 4);
+      std::vector<custom::pair<std::string, int>> left;
+      for (int i = 1; i < 16; i += 4)
+         left.push_back(custom::pair<std::string, int>(key(i), i));
+      assertUnit(matches(m, left));
+   }  // teardown
+
+   // erase(it) gives back the key that was after it
+   void test_eraseIterator_next()
+   {  // setup
+      SmallMap m = sorted(9);
+      // exercise
+      auto it = m.erase(m.find(key(3)));
+      auto itLast = m.erase(m.find(key(8)));
+      // verify
+      assertUnit((*it).first == key(4));
+      assertUnit(itLast == m.end());
+      assertUnit(m.size() == 7);
+   }  // teardown
+
+   /***************************************
+    * ITERATE
+    ***************************************/
+
+   // back from the end through every block to the first, then the end
+   void test_iterate_backward()
+   {  // setup
+      SmallMap m = sorted(11);
+      int expect = 10;
+      bool inOrder = true;
+      // exercise
+      auto it = m.end();
+      for (--it; it != m.end(); --it)
+         inOrder = inOrder && (*it).first == key(expect--);
+      // verify
+      assertUnit(inOrder);
+      assertUnit(expect == -1);
+      assertUnit((*m.rbegin()).first == key(10));
+   }  // teardown
+
+   /***************************************
+    * AGAINST STD::MAP
+    ***************************************/
+
+   // random paths in and out, checked against std::map all along
+   void test_random_reference()
+   {  // setup
+      SmallMap m;
+      std::map<std::string, int> reference;
+      std::srand(24);
+      bool same = true;
+      // exercise
+      for (int step = 0; step < 4000; step++)
+      {
+         std::string k = path();
+         int op = std::rand() % 4;
+         if (op < 2)
+         {
+            bool inserted = m.insert(custom::pair<std::string, int>(k, step)).second;
+            same = same && inserted == reference.insert(std::make_pair(k, step)).second;
+         }
+         else if (op == 2)
+            same = same && m.erase(k) == reference.erase(k);
+         else
+         {
+            auto it = m.lower_bound(k);
+            auto itRef = reference.lower_bound(k);
+            same = same && (it == m.end()) == (itRef == reference.end());
+            if (itRef != reference.end())
+               same = same && (*it).first == itRef->first && (*it).second == itRef->second;
+         }
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(m.size() == reference.size());
+      std::vector<custom::pair<std::string, int>> pairs;
+      for (const auto& p : reference)
+         pairs.push_back(custom::pair<std::string, int>(p.first, p.second));
+      assertUnit(matches(m, pairs));
+   }  // teardown
+
+private:
+   // keys that sort in the order of i and share a long prefix
+   static std::string key(int i)
+   {
+      std::string digits = std::to_string(i);
+      return "/usr/local/share/" + std::string(4 - digits.size(), '0') + digits;
+   }
+
+   // a small map of key(i) => i for i in [0, n)
+   static SmallMap sorted(int n)
+   {
+      std::vector<custom::pair<std::string, int>> pairs;
+      for (int i = 0; i < n; i++)
+         pairs.push_back(custom::pair<std::string, int>(key(i), i));
+      return SmallMap(pairs.begin(), pairs.end());
+   }
+
+   // a short random path, so that many share a start
+   static std::string path()
+   {
+      static const char* parts[] = { "/a", "/b", "/ab", "/c", "/", "x", "/a/b" };
+      std::string p;
+      for (int n = std::rand() % 4; n >= 0; n--)
+         p += parts[std::rand() % 7];
+      return p;
+   }
+
+   // the map holds exactly these pairs, in this order, both ways
+   template <class M>
+   static bool matches(M& m, const std::vector<custom::pair<std::string, int>>& pairs)
+   {
+      if (m.size() != pairs.size())
+         return false;
+      auto it = m.begin();
+      for (const auto& p : pairs)
+      {
+         if (it == m.end() || (*it).first != p.first || (int)(*it).second != p.second)
+            return false;
+         ++it;
+      }
+      if (it != m.end())
+         return false;
+      for (size_t i = pairs.size(); i > 0; i--)
+      {
+         --it;
+         if ((*it).first != pairs[i - 1].first)
+            return false;
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG